@@ -0,0 +1,174 @@
+// Generates src/pow5_table.h, the 128-bit powers of five float_conv.c uses
+// for Eisel–Lemire conversion. Built and run by src/Makefile, the output is
+// not checked in.
+//
+// Usage: gen_pow5_table > pow5_table.h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SMALLEST_POWER (-342)
+#define LARGEST_POWER 308
+
+// Enough for 2^(2 * 796 + 128), the widest dividend below.
+#define WORDS 64
+
+typedef struct {
+  uint32_t words[WORDS];
+} Big;
+
+void big_set(Big *big, uint32_t value) {
+  memset(big, 0, sizeof(Big));
+  big->words[0] = value;
+}
+
+void big_mul_small(Big *big, uint32_t factor) {
+  uint64_t carry = 0;
+
+  for (int i = 0; i < WORDS; i++) {
+    uint64_t product = (uint64_t)big->words[i] * factor + carry;
+    big->words[i] = (uint32_t)product;
+    carry = product >> 32;
+  }
+}
+
+int big_bit_length(const Big *big) {
+  for (int i = WORDS - 1; i >= 0; i--) {
+    if (big->words[i] != 0) {
+      return i * 32 + 32 - __builtin_clz(big->words[i]);
+    }
+  }
+
+  return 0;
+}
+
+int big_bit(const Big *big, int bit) {
+  return (big->words[bit / 32] >> (bit % 32)) & 1;
+}
+
+void big_set_bit(Big *big, int bit) {
+  big->words[bit / 32] |= (uint32_t)1 << (bit % 32);
+}
+
+void big_shl1(Big *big) {
+  for (int i = WORDS - 1; i > 0; i--) {
+    big->words[i] = big->words[i] << 1 | big->words[i - 1] >> 31;
+  }
+
+  big->words[0] <<= 1;
+}
+
+int big_compare(const Big *a, const Big *b) {
+  for (int i = WORDS - 1; i >= 0; i--) {
+    if (a->words[i] != b->words[i]) {
+      return a->words[i] < b->words[i] ? -1 : 1;
+    }
+  }
+
+  return 0;
+}
+
+void big_sub(Big *a, const Big *b) {
+  int64_t borrow = 0;
+
+  for (int i = 0; i < WORDS; i++) {
+    int64_t difference = (int64_t)a->words[i] - b->words[i] - borrow;
+    borrow = difference < 0;
+    a->words[i] = (uint32_t)(difference + (borrow << 32));
+  }
+}
+
+void big_add_small(Big *big, uint32_t value) {
+  uint64_t carry = value;
+
+  for (int i = 0; i < WORDS && carry != 0; i++) {
+    uint64_t sum = (uint64_t)big->words[i] + carry;
+    big->words[i] = (uint32_t)sum;
+    carry = sum >> 32;
+  }
+}
+
+// quotient = 2^exponent / divisor, by shift and subtract.
+void big_div_pow2(Big *quotient, int exponent, const Big *divisor) {
+  Big remainder;
+
+  big_set(quotient, 0);
+  big_set(&remainder, 0);
+
+  for (int bit = exponent; bit >= 0; bit--) {
+    big_shl1(&remainder);
+
+    if (bit == exponent) {
+      remainder.words[0] |= 1;
+    }
+
+    if (big_compare(&remainder, divisor) >= 0) {
+      big_sub(&remainder, divisor);
+      big_set_bit(quotient, bit);
+    }
+  }
+}
+
+// The 128 most significant bits of a value, truncated.
+void print_top_bits(const Big *big, int power) {
+  int length = big_bit_length(big);
+  uint64_t high = 0;
+  uint64_t low = 0;
+
+  for (int i = 0; i < 128; i++) {
+    int bit = length - 1 - i;
+    int value = bit >= 0 ? big_bit(big, bit) : 0;
+
+    if (i < 64) {
+      high = high << 1 | (uint64_t)value;
+    } else {
+      low = low << 1 | (uint64_t)value;
+    }
+  }
+
+  printf("  {0x%016llxull, 0x%016llxull}, // 5^%d\n", (unsigned long long)high,
+         (unsigned long long)low, power);
+}
+
+int main(void) {
+  printf("// Generated by meta/gen_pow5_table.c, do not edit.\n\n");
+  printf("#pragma once\n\n");
+  printf("#include <stdint.h>\n\n");
+  printf("#define POW5_SMALLEST_POWER (%d)\n", SMALLEST_POWER);
+  printf("#define POW5_LARGEST_POWER %d\n\n", LARGEST_POWER);
+  printf("// The 128 leading bits of each power of five, high word first.\n"
+         "// Negative powers are rounded up, the others truncated.\n");
+  printf("static const uint64_t pow5_table[][2] = {\n");
+
+  for (int q = SMALLEST_POWER; q < 0; q++) {
+    Big power;
+    Big quotient;
+
+    big_set(&power, 1);
+
+    for (int i = 0; i < -q; i++) {
+      big_mul_small(&power, 5);
+    }
+
+    // 2^z is the smallest power of two above 5^-q.
+    int z = big_bit_length(&power);
+    int exponent = q >= -27 ? z + 127 : 2 * z + 128;
+
+    big_div_pow2(&quotient, exponent, &power);
+    big_add_small(&quotient, 1);
+    print_top_bits(&quotient, q);
+  }
+
+  Big power;
+  big_set(&power, 1);
+
+  for (int q = 0; q <= LARGEST_POWER; q++) {
+    print_top_bits(&power, q);
+    big_mul_small(&power, 5);
+  }
+
+  printf("};\n");
+
+  return 0;
+}
@@ -0,0 +1,194 @@
+// Generates src/punct_dfa.h, the transition table scan_token() walks to match
+// punctuators. Built and run by src/Makefile, the output is not checked in.
+//
+// Usage: gen_punct_dfa > punct_dfa.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct punctuator {
+  const char *spelling;
+  const char *code;
+};
+
+// ISO/IEC 9899:2023 § 6.4.6, digraphs share the code of what they spell.
+const struct punctuator punctuators[] = {
+  {"[", "PU_LBRACKET"},   {"]", "PU_RBRACKET"},   {"(", "PU_LPAREN"},
+  {")", "PU_RPAREN"},     {"{", "PU_LBRACE"},     {"}", "PU_RBRACE"},
+  {".", "PU_PERIOD"},     {"->", "PU_ARROW"},     {"++", "PU_INC"},
+  {"--", "PU_DEC"},       {"&", "PU_AMP"},        {"*", "PU_STAR"},
+  {"+", "PU_PLUS"},       {"-", "PU_MINUS"},      {"~", "PU_TILDE"},
+  {"!", "PU_BANG"},       {"/", "PU_SLASH"},      {"%", "PU_PERCENT"},
+  {"<<", "PU_SHFL"},      {">>", "PU_SHFR"},      {"<", "PU_LT"},
+  {">", "PU_GT"},         {"<=", "PU_LTE"},       {">=", "PU_GTE"},
+  {"==", "PU_EE"},        {"!=", "PU_NE"},        {"^", "PU_CARET"},
+  {"|", "PU_PIPE"},       {"&&", "PU_LAND"},      {"||", "PU_LOR"},
+  {"?", "PU_QUESTION"},   {":", "PU_COLON"},      {"::", "PU_DCOLON"},
+  {";", "PU_SEMICOLON"},  {"...", "PU_ELLIPSIS"}, {"=", "PU_EQ"},
+  {"*=", "PU_STARE"},     {"/=", "PU_SLASHE"},    {"%=", "PU_PERCENTE"},
+  {"+=", "PU_PLUSE"},     {"-=", "PU_MINUSE"},    {"<<=", "PU_SHFLE"},
+  {">>=", "PU_SHFRE"},    {"&=", "PU_ANDE"},      {"^=", "PU_CARATE"},
+  {"|=", "PU_ORE"},       {",", "PU_COMMA"},      {"#", "PU_HASH"},
+  {"##", "PU_DHASH"},     {"<:", "PU_LBRACKET"},  {":>", "PU_RBRACKET"},
+  {"<%", "PU_LBRACE"},    {"%>", "PU_RBRACE"},    {"%:", "PU_HASH"},
+  {"%:%:", "PU_DHASH"},
+};
+
+#define PUNCTUATOR_COUNT (sizeof(punctuators) / sizeof(punctuators[0]))
+
+// Bounded by the total length of all spellings above.
+#define MAX_STATES 128
+
+#define DEAD_STATE 0
+#define START_STATE 1
+
+// Rows per state, one column per byte value.
+int transitions[MAX_STATES][256];
+const char *accepts[MAX_STATES];
+int state_count = START_STATE + 1;
+
+// Bytes that never continue a punctuator share class 0.
+int byte_class[256];
+int class_count = 1;
+
+void add_punctuator(const struct punctuator *punctuator) {
+  int state = START_STATE;
+
+  for (const char *c = punctuator->spelling; *c != '\0'; c++) {
+    unsigned char byte = (unsigned char)*c;
+
+    if (transitions[state][byte] == DEAD_STATE) {
+      if (state_count == MAX_STATES) {
+        fprintf(stderr, "gen_punct_dfa: too many states\n");
+        exit(1);
+      }
+
+      transitions[state][byte] = state_count++;
+    }
+
+    state = transitions[state][byte];
+  }
+
+  if (accepts[state] != NULL) {
+    fprintf(stderr, "gen_punct_dfa: duplicate spelling %s\n",
+            punctuator->spelling);
+    exit(1);
+  }
+
+  accepts[state] = punctuator->code;
+}
+
+void assign_classes(void) {
+  for (int byte = 0; byte < 256; byte++) {
+    for (int state = 0; state < state_count; state++) {
+      if (transitions[state][byte] != DEAD_STATE) {
+        byte_class[byte] = class_count++;
+        break;
+      }
+    }
+  }
+}
+
+void print_classes(void) {
+  printf("// Input class of each byte, 0 for bytes that never continue a "
+         "punctuator.\n");
+  printf("static const uint8_t punct_class[256] = {\n");
+
+  for (int byte = 0; byte < 256; byte++) {
+    if (byte_class[byte] != 0) {
+      printf("  ['%c'] = %d,\n", byte, byte_class[byte]);
+    }
+  }
+
+  printf("};\n\n");
+}
+
+void print_transitions(void) {
+  printf("// Next state by state and input class, PUNCT_DEAD stops the "
+         "match.\n");
+  printf("static const uint8_t "
+         "punct_next[PUNCT_STATE_COUNT][PUNCT_CLASS_COUNT] = {\n");
+
+  for (int state = 0; state < state_count; state++) {
+    printf("  {");
+
+    for (int byte = 0, column = 0; byte < 256; byte++) {
+      if (byte_class[byte] == 0) {
+        continue;
+      }
+
+      // Class 0 is implied by the leading zero.
+      if (column++ == 0) {
+        printf("0");
+      }
+
+      printf(", %d", transitions[state][byte]);
+    }
+
+    printf("},\n");
+  }
+
+  printf("};\n\n");
+}
+
+void print_accepts(void) {
+  printf("// Token code matched on reaching each state, TC_NONE for states "
+         "that only\n// prefix a punctuator.\n");
+  printf("static const uint8_t punct_accept[PUNCT_STATE_COUNT] = {\n");
+
+  for (int state = 0; state < state_count; state++) {
+    printf("  %s,\n", accepts[state] ? accepts[state] : "TC_NONE");
+  }
+
+  printf("};\n\n");
+}
+
+void print_expected(void) {
+  printf("// Bytes that continue each prefix-only state, for error "
+         "messages.\n");
+  printf("static const char *const punct_expected[PUNCT_STATE_COUNT] = {\n");
+
+  for (int state = 0; state < state_count; state++) {
+    if (state == DEAD_STATE || accepts[state] != NULL) {
+      printf("  NULL,\n");
+      continue;
+    }
+
+    const char *separator = "";
+    printf("  \"");
+
+    for (int byte = 0; byte < 256; byte++) {
+      if (transitions[state][byte] != DEAD_STATE) {
+        printf("%s%c", separator, byte);
+        separator = ", ";
+      }
+    }
+
+    printf("\",\n");
+  }
+
+  printf("};\n");
+}
+
+int main(void) {
+  for (size_t i = 0; i < PUNCTUATOR_COUNT; i++) {
+    add_punctuator(&punctuators[i]);
+  }
+
+  assign_classes();
+
+  printf("// Generated by meta/gen_punct_dfa.c, do not edit.\n\n");
+  printf("#pragma once\n\n");
+  printf("#define PUNCT_DEAD %d\n", DEAD_STATE);
+  printf("#define PUNCT_START %d\n", START_STATE);
+  printf("#define PUNCT_STATE_COUNT %d\n", state_count);
+  printf("#define PUNCT_CLASS_COUNT %d\n\n", class_count);
+
+  print_classes();
+  print_transitions();
+  print_accepts();
+  print_expected();
+
+  return 0;
+}
@@ -0,0 +1,171 @@
+// Generates src/xid_table.h, the XID_Start and XID_Continue code point ranges
+// the scanner accepts in identifiers. The Unicode Character Database is not
+// part of the tree, so the output is checked in; run this again to move to a
+// newer version of Unicode.
+//
+// Usage: gen_xid_table < DerivedCoreProperties.txt > xid_table.h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Far more than either property has, even before adjacent ranges merge.
+#define MAX_RANGES 4096
+
+#define RANGES_PER_LINE 3
+
+struct range {
+  uint32_t first;
+  uint32_t last;
+};
+
+struct property {
+  const char *name;
+  const char *table;
+  struct range ranges[MAX_RANGES];
+  size_t count;
+};
+
+struct property properties[] = {
+  {"XID_Start", "xid_start_ranges", {{0, 0}}, 0},
+  {"XID_Continue", "xid_continue_ranges", {{0, 0}}, 0},
+};
+
+#define PROPERTY_COUNT (sizeof(properties) / sizeof(properties[0]))
+
+int compare_ranges(const void *a, const void *b) {
+  const struct range *left = a;
+  const struct range *right = b;
+
+  return (left->first > right->first) - (left->first < right->first);
+}
+
+// Sorts the ranges and joins those that touch.
+void merge_ranges(struct property *property) {
+  size_t count = 0;
+
+  qsort(property->ranges, property->count, sizeof(struct range),
+        compare_ranges);
+
+  for (size_t i = 0; i < property->count; i++) {
+    struct range range = property->ranges[i];
+
+    if (count > 0 && range.first <= property->ranges[count - 1].last + 1) {
+      if (range.last > property->ranges[count - 1].last) {
+        property->ranges[count - 1].last = range.last;
+      }
+    } else {
+      property->ranges[count++] = range;
+    }
+  }
+
+  property->count = count;
+}
+
+// Lines look like "0041..005A    ; XID_Start # L&  [26] ...".
+void parse_line(const char *line) {
+  char *end;
+  uint32_t first = (uint32_t)strtoul(line, &end, 16);
+  uint32_t last = first;
+
+  if (end == line) {
+    return;
+  }
+
+  if (end[0] == '.' && end[1] == '.') {
+    last = (uint32_t)strtoul(end + 2, &end, 16);
+  }
+
+  while (*end == ' ') {
+    end++;
+  }
+
+  if (*end != ';') {
+    return;
+  }
+
+  end++;
+
+  while (*end == ' ') {
+    end++;
+  }
+
+  for (size_t i = 0; i < PROPERTY_COUNT; i++) {
+    struct property *property = &properties[i];
+    size_t length = strlen(property->name);
+
+    if (strncmp(end, property->name, length) != 0 ||
+        (end[length] != ' ' && end[length] != '#' && end[length] != '\n')) {
+      continue;
+    }
+
+    if (property->count == MAX_RANGES) {
+      fprintf(stderr, "Too many %s ranges\n", property->name);
+      exit(1);
+    }
+
+    property->ranges[property->count++] = (struct range){first, last};
+  }
+}
+
+void print_table(const struct property *property) {
+  printf("static const uint32_t %s[][2] = {\n", property->table);
+
+  for (size_t i = 0; i < property->count; i++) {
+    bool line_start = i % RANGES_PER_LINE == 0;
+    bool line_end = i % RANGES_PER_LINE == RANGES_PER_LINE - 1 ||
+                    i == property->count - 1;
+
+    printf("%s{0x%05x, 0x%05x},%s", line_start ? "  " : " ",
+           property->ranges[i].first, property->ranges[i].last,
+           line_end ? "\n" : "");
+  }
+
+  printf("};\n");
+}
+
+int main(void) {
+  char line[1024];
+  char version[64] = "unknown";
+
+  while (fgets(line, sizeof(line), stdin)) {
+    if (strncmp(line, "# DerivedCoreProperties-", 24) == 0) {
+      sscanf(line + 24, "%63[0-9.]", version);
+      size_t length = strlen(version);
+
+      if (length > 0 && version[length - 1] == '.') {
+        version[length - 1] = '\0';
+      }
+    } else if (line[0] != '#') {
+      parse_line(line);
+    }
+  }
+
+  for (size_t i = 0; i < PROPERTY_COUNT; i++) {
+    if (properties[i].count == 0) {
+      fprintf(stderr, "No %s ranges in the input\n", properties[i].name);
+      return 1;
+    }
+
+    merge_ranges(&properties[i]);
+  }
+
+  printf("// Generated by meta/gen_xid_table.c from Unicode %s, do not edit.\n\n",
+         version);
+  printf("#pragma once\n\n");
+  printf("#include <stdint.h>\n\n");
+  printf("// Sorted, inclusive code point ranges, see is_xid_start() and\n"
+         "// is_xid_continue().\n");
+
+  for (size_t i = 0; i < PROPERTY_COUNT; i++) {
+    if (i > 0) {
+      printf("\n");
+    }
+
+    print_table(&properties[i]);
+  }
+
+  return 0;
+}
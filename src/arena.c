@@ -0,0 +1,259 @@
+#include "arena.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Blocks are whole granules, so a bit per granule tells where each starts.
+#define GRANULE_SIZE 16
+#define CHUNK_GRANULES 4096
+#define BITMAP_WORDS (CHUNK_GRANULES / 64)
+
+// Larger blocks are not reused once freed, no node comes close.
+#define MAX_REUSED_GRANULES 64
+
+#define INITIAL_CHUNK_CAPACITY 16
+
+struct arena_chunk {
+  // Granules handed out so far, from the start of `data`.
+  size_t used;
+  // Fresh blocks, so sweeps skip chunks without any.
+  size_t fresh_count;
+
+  // A bit per granule: blocks starting there, those among them that are
+  // fresh, and the fresh ones that were marked.
+  uint64_t starts[BITMAP_WORDS];
+  uint64_t fresh[BITMAP_WORDS];
+  uint64_t marks[BITMAP_WORDS];
+
+  _Alignas(GRANULE_SIZE) unsigned char data[CHUNK_GRANULES * GRANULE_SIZE];
+};
+
+bool test_bit(const uint64_t *bitmap, size_t index) {
+  return bitmap[index / 64] & (UINT64_C(1) << (index % 64));
+}
+
+void set_bit(uint64_t *bitmap, size_t index) {
+  bitmap[index / 64] |= UINT64_C(1) << (index % 64);
+}
+
+void clear_bit(uint64_t *bitmap, size_t index) {
+  bitmap[index / 64] &= ~(UINT64_C(1) << (index % 64));
+}
+
+// Binary search for the chunk a block was cut from.
+struct arena_chunk *find_chunk(const Arena *arena, const void *block) {
+  const unsigned char *address = block;
+  size_t low = 0;
+  size_t high = arena->chunk_count;
+
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    struct arena_chunk *chunk = arena->chunks[middle];
+
+    if (address < chunk->data) {
+      high = middle;
+    } else if (address >= chunk->data + chunk->used * GRANULE_SIZE) {
+      low = middle + 1;
+    } else {
+      return chunk;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @return The index of the granule a block starts at, or -1 if the pointer is
+ * not a block of the arena.
+ */
+ptrdiff_t find_block(const Arena *arena, const void *block,
+                     struct arena_chunk **chunk) {
+  *chunk = find_chunk(arena, block);
+
+  if (*chunk == NULL) {
+    return -1;
+  }
+
+  size_t offset = (const unsigned char *)block - (*chunk)->data;
+  size_t index = offset / GRANULE_SIZE;
+
+  if (offset % GRANULE_SIZE != 0 || !test_bit((*chunk)->starts, index)) {
+    return -1;
+  }
+
+  return index;
+}
+
+// Blocks are cut one after the other, so each ends where the next starts.
+size_t block_granules(const struct arena_chunk *chunk, size_t index) {
+  size_t next = index + 1;
+
+  while (next < chunk->used) {
+    uint64_t word = chunk->starts[next / 64] >> (next % 64);
+
+    if (word != 0) {
+      next += __builtin_ctzll(word);
+      break;
+    }
+
+    next = (next / 64 + 1) * 64;
+  }
+
+  return (next < chunk->used ? next : chunk->used) - index;
+}
+
+void push_free_block(Arena *arena, void *block, size_t granules) {
+  if (granules > MAX_REUSED_GRANULES) {
+    return;
+  }
+
+  *(void **)block = arena->free_lists[granules];
+  arena->free_lists[granules] = block;
+}
+
+struct arena_chunk *add_chunk(Arena *arena) {
+  struct arena_chunk *chunk = malloc(sizeof(struct arena_chunk));
+
+  if (arena->chunk_count == arena->chunk_capacity) {
+    size_t capacity = arena->chunk_capacity == 0 ? INITIAL_CHUNK_CAPACITY
+                                                 : arena->chunk_capacity * 2;
+    struct arena_chunk **chunks =
+      realloc(arena->chunks, capacity * sizeof(struct arena_chunk *));
+
+    if (chunks == NULL) {
+      CRITICAL("arena", "Out of memory!");
+    }
+
+    arena->chunks = chunks;
+    arena->chunk_capacity = capacity;
+  }
+
+  if (arena->free_lists == NULL) {
+    arena->free_lists = calloc(MAX_REUSED_GRANULES + 1, sizeof(void *));
+  }
+
+  if (chunk == NULL || arena->free_lists == NULL) {
+    CRITICAL("arena", "Out of memory!");
+  }
+
+  chunk->used = 0;
+  chunk->fresh_count = 0;
+  memset(chunk->starts, 0, sizeof(chunk->starts));
+  memset(chunk->fresh, 0, sizeof(chunk->fresh));
+  memset(chunk->marks, 0, sizeof(chunk->marks));
+
+  // Keep the chunks sorted by address.
+  size_t i = arena->chunk_count;
+
+  while (i > 0 && arena->chunks[i - 1] > chunk) {
+    arena->chunks[i] = arena->chunks[i - 1];
+    i--;
+  }
+
+  arena->chunks[i] = chunk;
+  arena->chunk_count++;
+  return chunk;
+}
+
+void *arena_allocate(Arena *arena, size_t size) {
+  size_t granules = size == 0 ? 1 : (size + GRANULE_SIZE - 1) / GRANULE_SIZE;
+  struct arena_chunk *chunk;
+
+  if (granules > CHUNK_GRANULES) {
+    CRITICAL("arena", "Block too large!");
+  }
+
+  if (arena->free_lists && granules <= MAX_REUSED_GRANULES &&
+      arena->free_lists[granules]) {
+    void *block = arena->free_lists[granules];
+    arena->free_lists[granules] = *(void **)block;
+
+    size_t index = find_block(arena, block, &chunk);
+    set_bit(chunk->fresh, index);
+    chunk->fresh_count++;
+    return block;
+  }
+
+  chunk = arena->current;
+
+  if (chunk == NULL || chunk->used + granules > CHUNK_GRANULES) {
+    chunk = arena->current = add_chunk(arena);
+  }
+
+  size_t index = chunk->used;
+  chunk->used += granules;
+  set_bit(chunk->starts, index);
+  set_bit(chunk->fresh, index);
+  chunk->fresh_count++;
+
+  return &chunk->data[index * GRANULE_SIZE];
+}
+
+void arena_release(Arena *arena, void *block) {
+  struct arena_chunk *chunk;
+  ptrdiff_t index = find_block(arena, block, &chunk);
+
+  if (index < 0) {
+    return;
+  }
+
+  if (test_bit(chunk->fresh, index)) {
+    clear_bit(chunk->fresh, index);
+    clear_bit(chunk->marks, index);
+    chunk->fresh_count--;
+  }
+
+  push_free_block(arena, block, block_granules(chunk, index));
+}
+
+void arena_mark(Arena *arena, const void *block) {
+  struct arena_chunk *chunk;
+  ptrdiff_t index = find_block(arena, block, &chunk);
+
+  if (index >= 0 && test_bit(chunk->fresh, index)) {
+    set_bit(chunk->marks, index);
+  }
+}
+
+size_t arena_sweep(Arena *arena) {
+  size_t freed = 0;
+
+  for (size_t i = 0; i < arena->chunk_count; i++) {
+    struct arena_chunk *chunk = arena->chunks[i];
+
+    if (chunk->fresh_count == 0) {
+      continue;
+    }
+
+    for (size_t word = 0; word < BITMAP_WORDS; word++) {
+      uint64_t unmarked = chunk->fresh[word] & ~chunk->marks[word];
+
+      while (unmarked) {
+        size_t index = word * 64 + __builtin_ctzll(unmarked);
+        unmarked &= unmarked - 1;
+
+        push_free_block(arena, &chunk->data[index * GRANULE_SIZE],
+                        block_granules(chunk, index));
+        freed++;
+      }
+
+      chunk->fresh[word] = 0;
+      chunk->marks[word] = 0;
+    }
+
+    chunk->fresh_count = 0;
+  }
+
+  return freed;
+}
+
+void arena_free(Arena *arena) {
+  for (size_t i = 0; i < arena->chunk_count; i++) {
+    free(arena->chunks[i]);
+  }
+
+  free(arena->chunks);
+  free(arena->free_lists);
+  *arena = (Arena){0};
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct arena_chunk;
+
+/**
+ * Memory for nodes that mostly live and die together, carved out of large
+ * chunks so freeing them all is one pass over the chunks.
+ *
+ * Blocks allocated since the last arena_sweep() are fresh. A sweep frees
+ * the fresh blocks that were not marked with arena_mark() since, which is
+ * how the parse branches a GLR parser dropped are reclaimed without tracking
+ * them one by one. Freed blocks are reused by later allocations of the same
+ * size.
+ */
+typedef struct ArenaStruct {
+  // Sorted by address, to find the chunk a block is in.
+  struct arena_chunk **chunks;
+  size_t chunk_count;
+  size_t chunk_capacity;
+
+  // The chunk blocks are cut from, the last one made.
+  struct arena_chunk *current;
+
+  // Freed blocks, by their size in granules.
+  void **free_lists;
+} Arena;
+
+/**
+ * @return A block of at least `size` bytes, aligned for any node. Runs out of
+ * memory like the rest of the compiler, with CRITICAL.
+ */
+void *arena_allocate(Arena *arena, size_t size);
+
+/**
+ * Frees a block for reuse. Pointers that are not blocks of the arena are
+ * ignored.
+ */
+void arena_release(Arena *arena, void *block);
+
+/**
+ * Keeps a fresh block from being freed by the next sweep. Pointers that are
+ * not blocks of the arena are ignored.
+ */
+void arena_mark(Arena *arena, const void *block);
+
+/**
+ * Frees the fresh blocks that were not marked, and makes the others old.
+ *
+ * @return How many blocks were freed.
+ */
+size_t arena_sweep(Arena *arena);
+
+/**
+ * Frees every block at once, leaving the arena empty and ready for reuse.
+ */
+void arena_free(Arena *arena);
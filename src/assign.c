@@ -4,12 +4,22 @@
 #include "tree.h"
 #include "utils.h"
 
+#include <string.h>
+
 struct sized_array {
   uint64_t *array;
   size_t size;
 };
 
-uint64_t next_reg = 0;
+_Thread_local uint64_t next_reg = 0;
+
+// What this pass works out for each expression, indexed by its id. The tree
+// does not keep room for it.
+_Thread_local struct {
+  uint64_t *regs;
+  uint32_t *reg_counts;
+  size_t capacity;
+} registers;
 
 void translation_unit(struct translation_unit *unit);
 
@@ -42,9 +52,83 @@ uint64_t get_n_ary_reg_count(uint64_t *reg_count_array, size_t num_elements) {
 // Entry point
 void assign_registers() {
   AST tree = get_tree();
+  size_t count = get_expression_count();
+
+  free_registers();
+  registers.regs = calloc(count, sizeof(uint64_t));
+  registers.reg_counts = calloc(count, sizeof(uint32_t));
+
+  if (count > 0 && (!registers.regs || !registers.reg_counts)) {
+    CRITICAL("assign", "Out of memory!");
+  }
+
+  registers.capacity = count;
   translation_unit(tree);
 }
 
+uint64_t get_reg(const struct expression *expr) {
+  return expr->id < registers.capacity ? registers.regs[expr->id] : 0;
+}
+
+size_t get_reg_count(const struct expression *expr) {
+  return expr->id < registers.capacity ? registers.reg_counts[expr->id] : 0;
+}
+
+// Grows the tables for an expression made after assign_registers() sized
+// them.
+void reserve_registers(uint32_t id) {
+  if (id < registers.capacity) {
+    return;
+  }
+
+  size_t capacity = registers.capacity ? registers.capacity : 64;
+
+  while (capacity <= id) {
+    capacity *= 2;
+  }
+
+  uint64_t *regs = realloc(registers.regs, capacity * sizeof(uint64_t));
+
+  if (regs) {
+    registers.regs = regs;
+  }
+
+  uint32_t *reg_counts =
+    realloc(registers.reg_counts, capacity * sizeof(uint32_t));
+
+  if (reg_counts) {
+    registers.reg_counts = reg_counts;
+  }
+
+  if (!regs || !reg_counts) {
+    CRITICAL("assign", "Out of memory!");
+  }
+
+  size_t added = capacity - registers.capacity;
+
+  memset(&regs[registers.capacity], 0, added * sizeof(uint64_t));
+  memset(&reg_counts[registers.capacity], 0, added * sizeof(uint32_t));
+  registers.capacity = capacity;
+}
+
+void set_reg(const struct expression *expr, uint64_t reg) {
+  reserve_registers(expr->id);
+  registers.regs[expr->id] = reg;
+}
+
+void set_reg_count(const struct expression *expr, size_t reg_count) {
+  reserve_registers(expr->id);
+  registers.reg_counts[expr->id] = reg_count;
+}
+
+void free_registers(void) {
+  free(registers.regs);
+  free(registers.reg_counts);
+  registers.regs = NULL;
+  registers.reg_counts = NULL;
+  registers.capacity = 0;
+}
+
 void id(struct id *id) {
   UNUSED(id);
   // id->name
@@ -55,7 +139,7 @@ void token_specifier(struct specifier *specifier) {
   // specifier->_token
 }
 
-void id_specifier(struct specifier *specifier) { id(specifier->_id); }
+void id_specifier(struct specifier *specifier) { id(id_at(specifier->_id)); }
 
 void specifier(struct specifier *specifier) {
   switch (specifier->type) {
@@ -71,8 +155,8 @@ void specifier(struct specifier *specifier) {
 }
 
 void specifier_list(struct specifier_list *list) {
-  for (struct specifier *cur = list->head; cur != NULL; cur = cur->next) {
-    specifier(cur);
+  for (spec_ref cur = list->head; cur != NO_NODE; cur = spec_at(cur)->next) {
+    specifier(spec_at(cur));
   }
 }
 
@@ -81,51 +165,51 @@ void expression(struct expression *expr);
 void declaration(struct declaration *decl);
 
 void initialized_declarator(struct initialized_declarator *decl) {
-  id(decl->declarator);
+  id(id_at(decl->declarator));
 
   if (decl->initializer)
-    expression(decl->initializer);
+    expression(expr_at(decl->initializer));
 }
 
 void init_declarator_list(struct init_declarator_list *list) {
   if (list == NULL)
     return;
 
-  for (struct initialized_declarator *cur = list->head; cur != NULL;
-       cur = cur->next) {
-    initialized_declarator(cur);
+  for (init_decl_ref cur = list->head; cur != NO_NODE;
+       cur = init_decl_at(cur)->next) {
+    initialized_declarator(init_decl_at(cur));
   }
 }
 
 void declaration_list(struct declaration_list *list) {
-  struct declaration *cur = list->head;
-  struct declaration *next = NULL;
+  decl_ref cur = list->head;
+  decl_ref next = NO_NODE;
 
   while (cur) {
-    next = cur->next;
-    declaration(cur);
+    next = decl_at(cur)->next;
+    declaration(decl_at(cur));
     cur = next;
   }
 }
 
 void variable_definition(struct declaration *decl) {
-  specifier_list(decl->_var.specifiers);
-  init_declarator_list(decl->_var.init_declarator_list);
+  specifier_list(spec_list_at(decl->_var.specifiers));
+  init_declarator_list(init_decl_list_at(decl->_var.init_declarator_list));
 }
 
 void function_definition(struct declaration *decl) {
-  specifier_list(decl->_func.specifiers);
-  id(decl->_func.name);
+  specifier_list(spec_list_at(decl->_func.specifiers));
+  id(id_at(decl->_func.name));
 
   if (decl->_func.parameters)
-    declaration_list(decl->_func.parameters);
+    declaration_list(decl_list_at(decl->_func.parameters));
 
-  statement(decl->_func.body);
+  statement(stmt_at(decl->_func.body));
 }
 
 void type_definition(struct declaration *decl) {
-  specifier_list(decl->_type_def.specifiers);
-  id(decl->_type_def.name);
+  specifier_list(spec_list_at(decl->_type_def.specifiers));
+  id(id_at(decl->_type_def.name));
 }
 
 void declaration(struct declaration *decl) {
@@ -150,81 +234,81 @@ void statement_list(struct statement_list *list) {
   if (list == NULL)
     return;
 
-  for (struct statement *child = list->head; child != NULL;
-       child = child->next) {
-    statement(child);
+  for (stmt_ref child = list->head; child != NO_NODE;
+       child = stmt_at(child)->next) {
+    statement(stmt_at(child));
   }
 }
 
 void compound_stmt(struct statement *stmt) {
-  statement_list(stmt->_compound.statements);
+  statement_list(stmt_list_at(stmt->_compound.statements));
 }
 
 void continue_stmt(struct statement *stmt) { UNUSED(stmt); }
 
-void decl_stmt(struct statement *stmt) { declaration(stmt->_decl); }
+void decl_stmt(struct statement *stmt) { declaration(decl_at(stmt->_decl)); }
 
-void expr_stmt(struct statement *stmt) { expression(stmt->_expr); }
+void expr_stmt(struct statement *stmt) { expression(expr_at(stmt->_expr)); }
 
 void for_stmt(struct statement *stmt) {
   if (stmt->_for.decl) {
-    declaration(stmt->_for.decl);
+    declaration(decl_at(stmt->_for.decl));
   }
 
   if (stmt->_for.preloop_expression) {
-    expression(stmt->_for.preloop_expression);
+    expression(expr_at(stmt->_for.preloop_expression));
   }
 
   if (stmt->_for.condition) {
-    expression(stmt->_for.condition);
+    expression(expr_at(stmt->_for.condition));
   }
 
   if (stmt->_for.step_expression) {
-    expression(stmt->_for.step_expression);
+    expression(expr_at(stmt->_for.step_expression));
   }
 
   if (stmt->_for.body) {
-    statement(stmt->_for.body);
+    statement(stmt_at(stmt->_for.body));
   }
 }
 
-void goto_stmt(struct statement *stmt) { id(stmt->_goto); }
+void goto_stmt(struct statement *stmt) { id(id_at(stmt->_goto)); }
 
 void if_stmt(struct statement *stmt) {
   if (stmt->_if.condition) {
-    expression(stmt->_if.condition);
+    expression(expr_at(stmt->_if.condition));
   }
 
   if (stmt->_if.body) {
-    statement(stmt->_if.body);
+    statement(stmt_at(stmt->_if.body));
   }
 
   if (stmt->_if.else_body) {
-    statement(stmt->_if.else_body);
+    statement(stmt_at(stmt->_if.else_body));
   }
 }
 
-void label_stmt(struct statement *stmt) { id(stmt->_label.name); }
+void label_stmt(struct statement *stmt) { id(id_at(stmt->_label.name)); }
 
 void return_stmt(struct statement *stmt) {
   if (stmt->_return.ret_expr) {
-    expression(stmt->_return.ret_expr);
+    expression(expr_at(stmt->_return.ret_expr));
   }
 }
 
 void switch_stmt(struct statement *stmt) {
   if (stmt->_switch.condition) {
-    expression(stmt->_switch.condition);
+    expression(expr_at(stmt->_switch.condition));
   }
 
   if (stmt->_switch.body) {
-    statement(stmt->_switch.body);
+    statement(stmt_at(stmt->_switch.body));
   }
 }
 
 void switch_label_stmt(struct statement *stmt) {
   if (stmt->_switch_label.test) {
-    expression(stmt->_switch_label.test);
+    expression(expr_at(stmt->_switch_label.test));
   }
 }
 
@@ -232,11 +316,11 @@ void while_stmt(struct statement *stmt) {
   // stmt->_while.should_check_condition_first
 
   if (stmt->_while.condition) {
-    expression(stmt->_while.condition);
+    expression(expr_at(stmt->_while.condition));
   }
 
   if (stmt->_while.body) {
-    statement(stmt->_while.body);
+    statement(stmt_at(stmt->_while.body));
   }
 }
 
@@ -294,121 +378,127 @@ void assign_expression(struct expression *expr);
 void count_expression(struct expression *expr);
 struct sized_array count_expression_list(struct expression_list *list);
 
-void count_constant_expr(struct expression *expr) { expr->reg_count = 1; }
+void count_constant_expr(struct expression *expr) { set_reg_count(expr, 1); }
 
 void count_id_expression(struct expression *expr) {
-  id(expr->_id);
-  expr->reg_count = 1;
+  id(id_at(expr->_id));
+  set_reg_count(expr, 1);
 }
 
 void count_index_expression(struct expression *expr) {
   if (expr->_index.object) {
-    count_expression(expr->_index.object);
+    count_expression(expr_at(expr->_index.object));
   }
 
   if (expr->_index.index) {
-    count_expression(expr->_index.index);
+    count_expression(expr_at(expr->_index.index));
   }
 
   // reuse object reg
-  expr->reg_count = get_binary_reg_count(expr->_index.object->reg_count,
-                                         expr->_index.index->reg_count);
+  set_reg_count(
+    expr, get_binary_reg_count(get_reg_count(expr_at(expr->_index.object)),
+                               get_reg_count(expr_at(expr->_index.index))));
 }
 
 void count_func_call(struct expression *expr) {
   if (expr->_call.function_ptr) {
-    count_expression(expr->_call.function_ptr);
+    count_expression(expr_at(expr->_call.function_ptr));
   }
 
-  if (expr->_call.parameter_list == NULL) {
-    expr->reg_count = 1;
+  if (expr->_call.parameter_list == NO_NODE) {
+    set_reg_count(expr, 1);
     return;
   }
 
-  struct sized_array array = count_expression_list(expr->_call.parameter_list);
+  struct sized_array array =
+    count_expression_list(expr_list_at(expr->_call.parameter_list));
 
   // expression_list should have made space for the function pointer
-  array.array[array.size - 1] = expr->_call.function_ptr->reg_count;
+  array.array[array.size - 1] =
+    get_reg_count(expr_at(expr->_call.function_ptr));
 
   if (array.size == 0 || array.array == NULL) {
-    expr->reg_count = 1;
+    set_reg_count(expr, 1);
     return;
   }
 
-  expr->reg_count = get_n_ary_reg_count(array.array, array.size);
+  set_reg_count(expr, get_n_ary_reg_count(array.array, array.size));
   free(array.array);
 }
 
 void count_postfix_expr(struct expression *expr) {
   if (expr->_unary.base) {
-    count_expression(expr->_unary.base);
+    count_expression(expr_at(expr->_unary.base));
   }
 
   // expr->_unary.operator
 
   // reuse base reg
-  expr->reg_count = expr->_unary.base->reg_count;
+  set_reg_count(expr, get_reg_count(expr_at(expr->_unary.base)));
 }
 
 void count_unary_expr(struct expression *expr) {
   // expr->_unary.operator
 
   if (expr->_unary.base) {
-    count_expression(expr->_unary.base);
+    count_expression(expr_at(expr->_unary.base));
 
     // reuse base reg
-    expr->reg_count = expr->_unary.base->reg_count;
+    set_reg_count(expr, get_reg_count(expr_at(expr->_unary.base)));
   } else {
-    expr->reg_count = 0;
+    set_reg_count(expr, 0);
   }
 }
 
 void count_cast_expr(struct expression *expr) {
   if (expr->_cast.type) {
-    specifier_list(expr->_cast.type);
+    specifier_list(spec_list_at(expr->_cast.type));
   }
 
   if (expr->_cast.base) {
-    count_expression(expr->_cast.base);
+    count_expression(expr_at(expr->_cast.base));
   }
 
   // reuse base reg
-  expr->reg_count = expr->_cast.base->reg_count;
+  set_reg_count(expr, get_reg_count(expr_at(expr->_cast.base)));
 }
 
 void count_binary_expr(struct expression *expr) {
   if (expr->_binary.left) {
-    count_expression(expr->_binary.left);
+    count_expression(expr_at(expr->_binary.left));
   }
 
   // expr->_binary.operator
 
   if (expr->_binary.right) {
-    count_expression(expr->_binary.right);
+    count_expression(expr_at(expr->_binary.right));
   }
 
   // reuse left reg
-  expr->reg_count = get_binary_reg_count(expr->_binary.left->reg_count,
-                                         expr->_binary.right->reg_count);
+  set_reg_count(
+    expr, get_binary_reg_count(get_reg_count(expr_at(expr->_binary.left)),
+                               get_reg_count(expr_at(expr->_binary.right))));
 }
 
 void count_ternary_expr(struct expression *expr) {
   if (expr->_ternary.condition) {
-    count_expression(expr->_ternary.condition);
+    count_expression(expr_at(expr->_ternary.condition));
   }
 
   if (expr->_ternary.true_branch) {
-    count_expression(expr->_ternary.true_branch);
+    count_expression(expr_at(expr->_ternary.true_branch));
   }
 
   if (expr->_ternary.false_branch) {
-    count_expression(expr->_ternary.false_branch);
+    count_expression(expr_at(expr->_ternary.false_branch));
   }
 
   // reuse condition reg
-  expr->reg_count = max(expr->_ternary.condition->reg_count,
-                        max(expr->_ternary.true_branch->reg_count,
-                            expr->_ternary.false_branch->reg_count));
+  set_reg_count(
+    expr,
+    max(get_reg_count(expr_at(expr->_ternary.condition)),
+        max(get_reg_count(expr_at(expr->_ternary.true_branch)),
+            get_reg_count(expr_at(expr->_ternary.false_branch)))));
 }
 
 void count_expression(struct expression *expr) {
@@ -456,16 +546,16 @@ struct sized_array count_expression_list(struct expression_list *list) {
     return result;
   }
 
-  struct expression *cur = list->head;
+  expr_ref cur = list->head;
 
-  if (cur == NULL) {
+  if (cur == NO_NODE) {
     return result;
   }
 
-  while (cur != NULL) {
-    count_expression(cur);
+  while (cur != NO_NODE) {
+    count_expression(expr_at(cur));
     result.size++;
-    cur = cur->next;
+    cur = expr_at(cur)->next;
   }
 
   result.size++; // for the function ptr result.
@@ -473,10 +563,10 @@ struct sized_array count_expression_list(struct expression_list *list) {
 
   cur = list->head;
   size_t i = 0;
-  while (cur != NULL) {
-    count_expression(cur);
-    result.array[i++] = cur->reg_count;
-    cur = cur->next;
+  while (cur != NO_NODE) {
+    count_expression(expr_at(cur));
+    result.array[i++] = get_reg_count(expr_at(cur));
+    cur = expr_at(cur)->next;
   }
 
   return result;
@@ -484,102 +574,106 @@ struct sized_array count_expression_list(struct expression_list *list) {
 
 uint64_t assign_expression_list(struct expression_list *list);
 
-void assign_constant_expr(struct expression *expr) { expr->reg = next_reg; }
+void assign_constant_expr(struct expression *expr) { set_reg(expr, next_reg); }
 
-void assign_id_expression(struct expression *expr) { expr->reg = next_reg; }
+void assign_id_expression(struct expression *expr) { set_reg(expr, next_reg); }
 
 void assign_index_expression(struct expression *expr) {
   uint64_t object_count =
-    expr->_index.object ? expr->_index.object->reg_count : 0;
-  uint64_t index_count = expr->_index.index ? expr->_index.index->reg_count : 0;
+    expr->_index.object ? get_reg_count(expr_at(expr->_index.object)) : 0;
+  uint64_t index_count =
+    expr->_index.index ? get_reg_count(expr_at(expr->_index.index)) : 0;
 
   if (!expr->_index.object || !expr->_index.index) {
     CRITICAL("assign", "Index expression has no object or no index");
   }
 
   if (object_count >= index_count) {
-    assign_expression(expr->_index.object);
+    assign_expression(expr_at(expr->_index.object));
 
     next_reg++;
-    assign_expression(expr->_index.index);
+    assign_expression(expr_at(expr->_index.index));
     next_reg--;
 
     // reuse object reg
-    expr->reg = expr->_index.object->reg;
+    set_reg(expr, get_reg(expr_at(expr->_index.object)));
   } else {
-    assign_expression(expr->_index.index);
+    assign_expression(expr_at(expr->_index.index));
 
     next_reg++;
-    assign_expression(expr->_index.object);
+    assign_expression(expr_at(expr->_index.object));
     next_reg--;
 
     // reuse index reg
-    expr->reg = expr->_index.index->reg;
+    set_reg(expr, get_reg(expr_at(expr->_index.index)));
   }
 }
 
 void assign_func_call(struct expression *expr) {
   // Edge case: function call with no parameters
-  if (expr->_call.parameter_list == NULL) {
-    assign_expression(expr->_call.function_ptr);
+  if (expr->_call.parameter_list == NO_NODE) {
+    assign_expression(expr_at(expr->_call.function_ptr));
     return;
   }
 
+  struct expression_list *parameters = expr_list_at(expr->_call.parameter_list);
+
   // prepend function pointer to a parameter list
   struct expression_list list;
   list.head = expr->_call.function_ptr;
-  list.tail = expr->_call.parameter_list->tail;
+  list.tail = parameters->tail;
 
-  expr->_call.function_ptr->next = expr->_call.parameter_list->head;
+  expr_at(expr->_call.function_ptr)->next = parameters->head;
   uint64_t reg = assign_expression_list(&list);
 
-  expr->_call.parameter_list->head = list.head;
-  expr->_call.parameter_list->tail = list.tail;
+  parameters->head = list.head;
+  parameters->tail = list.tail;
 
-  expr->reg = reg;
+  set_reg(expr, reg);
 }
 
 void assign_postfix_expr(struct expression *expr) {
   if (expr->_unary.base) {
-    assign_expression(expr->_unary.base);
+    assign_expression(expr_at(expr->_unary.base));
   }
 
   // expr->_unary.operator
 
   // reuse base reg
-  expr->reg = expr->_unary.base->reg;
+  set_reg(expr, get_reg(expr_at(expr->_unary.base)));
 }
 
 void assign_unary_expr(struct expression *expr) {
   // expr->_unary.operator
 
   if (expr->_unary.base) {
-    assign_expression(expr->_unary.base);
+    assign_expression(expr_at(expr->_unary.base));
 
     // reuse base reg
-    expr->reg = expr->_unary.base->reg;
+    set_reg(expr, get_reg(expr_at(expr->_unary.base)));
   } else {
-    expr->reg = next_reg;
+    set_reg(expr, next_reg);
   }
 }
 
 void assign_cast_expr(struct expression *expr) {
   if (expr->_cast.type) {
-    specifier_list(expr->_cast.type);
+    specifier_list(spec_list_at(expr->_cast.type));
   }
 
   if (expr->_cast.base) {
-    assign_expression(expr->_cast.base);
+    assign_expression(expr_at(expr->_cast.base));
   }
 
   // reuse base reg
-  expr->reg = expr->_cast.base->reg;
+  set_reg(expr, get_reg(expr_at(expr->_cast.base)));
 }
 
 void assign_binary_expr(struct expression *expr) {
-  uint64_t left_count = expr->_binary.left ? expr->_binary.left->reg_count : 0;
+  uint64_t left_count =
+    expr->_binary.left ? get_reg_count(expr_at(expr->_binary.left)) : 0;
   uint64_t right_count =
-    expr->_binary.right ? expr->_binary.right->reg_count : 0;
+    expr->_binary.right ? get_reg_count(expr_at(expr->_binary.right)) : 0;
 
   if (!expr->_binary.left || !expr->_binary.right) {
     CRITICAL("assign",
@@ -587,41 +681,41 @@ void assign_binary_expr(struct expression *expr) {
   }
 
   if (left_count >= right_count) {
-    assign_expression(expr->_binary.left);
+    assign_expression(expr_at(expr->_binary.left));
 
     next_reg++;
-    assign_expression(expr->_binary.right);
+    assign_expression(expr_at(expr->_binary.right));
     next_reg--;
 
     // reuse left reg
-    expr->reg = expr->_binary.left->reg;
+    set_reg(expr, get_reg(expr_at(expr->_binary.left)));
   } else {
-    assign_expression(expr->_binary.right);
+    assign_expression(expr_at(expr->_binary.right));
 
     next_reg++;
-    assign_expression(expr->_binary.left);
+    assign_expression(expr_at(expr->_binary.left));
     next_reg--;
 
     // reuse right reg
-    expr->reg = expr->_binary.right->reg;
+    set_reg(expr, get_reg(expr_at(expr->_binary.right)));
   }
 }
 
 void assign_ternary_expr(struct expression *expr) {
   if (expr->_ternary.condition) {
-    assign_expression(expr->_ternary.condition);
+    assign_expression(expr_at(expr->_ternary.condition));
   }
 
   if (expr->_ternary.true_branch) {
-    assign_expression(expr->_ternary.true_branch);
+    assign_expression(expr_at(expr->_ternary.true_branch));
   }
 
   if (expr->_ternary.false_branch) {
-    assign_expression(expr->_ternary.false_branch);
+    assign_expression(expr_at(expr->_ternary.false_branch));
   }
 
   // reuse condition reg
-  expr->reg = expr->_ternary.condition->reg;
+  set_reg(expr, get_reg(expr_at(expr->_ternary.condition)));
 }
 
 void assign_expression(struct expression *expr) {
@@ -664,38 +758,38 @@ void assign_expression(struct expression *expr) {
 
 void reverse_sort_expression_list(struct expression_list *list) {
   // create new expression list
-  struct expression *head = NULL;
-  struct expression *tail = NULL;
+  expr_ref head = NO_NODE;
+  expr_ref tail = NO_NODE;
 
   while (list->head) {
     // iterate through the list find max reg count
-    struct expression *cur = list->head;
-    struct expression *prev = NULL;
-    struct expression *prev_of_max = NULL;
+    expr_ref cur = list->head;
+    expr_ref prev = NO_NODE;
+    expr_ref prev_of_max = NO_NODE;
     uint64_t max_reg_count = 0;
-    for (; cur != NULL; cur = cur->next) {
-      if (cur->reg_count > max_reg_count) {
-        max_reg_count = cur->reg_count;
+    for (; cur != NO_NODE; cur = expr_at(cur)->next) {
+      if (get_reg_count(expr_at(cur)) > max_reg_count) {
+        max_reg_count = get_reg_count(expr_at(cur));
         prev_of_max = prev;
       }
 
       prev = cur;
     }
 
-    cur = prev_of_max ? prev_of_max->next : list->head;
+    cur = prev_of_max ? expr_at(prev_of_max)->next : list->head;
 
     // remove max reg count from list
     if (prev_of_max) {
-      prev_of_max->next = prev_of_max->next->next;
+      expr_at(prev_of_max)->next = expr_at(cur)->next;
     } else {
-      list->head = list->head->next;
+      list->head = expr_at(list->head)->next;
     }
 
     // append max reg count to new list
-    if (head == NULL) {
+    if (head == NO_NODE) {
       head = cur;
     } else {
-      tail->next = cur;
+      expr_at(tail)->next = cur;
     }
 
     tail = cur;
@@ -711,22 +805,22 @@ uint64_t assign_expression_list(struct expression_list *list) {
   }
 
   reverse_sort_expression_list(list);
-  struct expression *cur = list->head;
+  expr_ref cur = list->head;
 
-  if (cur == NULL) {
+  if (cur == NO_NODE) {
     CRITICAL("assign", "Try to assign registers to empty expression list");
   }
 
   uint64_t start_reg = next_reg;
 
-  while (cur != NULL) {
-    assign_expression(cur);
+  while (cur != NO_NODE) {
+    assign_expression(expr_at(cur));
     next_reg++;
-    cur = cur->next;
+    cur = expr_at(cur)->next;
   }
 
   next_reg = start_reg;
-  return list->head->reg;
+  return get_reg(expr_at(list->head));
 }
 
 void expression(struct expression *expr) {
@@ -1,3 +1,22 @@
 #pragma once
 
+#include "ast.h"
+
 void assign_registers();
+
+/**
+ * @return The register assign_registers() put an expression's value in, 0
+ * for an expression it has not seen.
+ */
+uint64_t get_reg(const struct expression *expr);
+
+/**
+ * @return How many registers evaluating an expression takes, 0 for an
+ * expression assign_registers() has not seen.
+ */
+size_t get_reg_count(const struct expression *expr);
+
+/**
+ * Frees the registers of the last assign_registers().
+ */
+void free_registers(void);
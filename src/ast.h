@@ -1,10 +1,28 @@
 #pragma once
 
+#include "pool.h"
 #include "scanner.h"
 #include "stdbool.h"
 
 #include "symbol.h"
 
+// Nodes live in pools of their kind, see tree.h, and refer to each other by
+// index. NO_NODE (0) is none.
+typedef uint32_t id_ref;
+typedef uint32_t spec_ref;
+typedef uint32_t spec_list_ref;
+typedef uint32_t init_decl_ref;
+typedef uint32_t init_decl_list_ref;
+typedef uint32_t decl_ref;
+typedef uint32_t decl_list_ref;
+typedef uint32_t expr_ref;
+typedef uint32_t expr_list_ref;
+typedef uint32_t stmt_ref;
+typedef uint32_t stmt_list_ref;
+// Operators and constants of expressions, kept apart from the nodes the
+// passes walk.
+typedef uint32_t token_ref;
+
 enum statement_t {
   BREAK,
   COMPOUND,
@@ -51,123 +69,121 @@ enum declaration_t {
 };
 
 struct id {
-  Token *name;
+  Token name;
   struct symbol *symbol;
 };
 
 struct specifier {
   enum specifier_t type;
 
+  // this is a part of a list
+  spec_ref next;
+
   union {
-    Token *_token;
-    struct id *_id;
+    Token _token;
+    id_ref _id;
   };
-
-  // this is a part of a list
-  struct specifier *next;
 };
 
 struct specifier_list {
-  struct specifier *head;
+  spec_ref head;
 };
 
-struct expression;
-struct declaration_list;
-
 struct initialized_declarator {
-  struct id *declarator; // FIXME: replace id with declarator
-  struct expression *initializer;
+  id_ref declarator; // FIXME: replace id with declarator
+  expr_ref initializer;
 
   // this is a part of a list
-  struct initialized_declarator *next;
+  init_decl_ref next;
 };
 
 struct init_declarator_list {
-  struct initialized_declarator *head;
-  struct initialized_declarator *tail;
+  init_decl_ref head;
+  init_decl_ref tail;
 };
 
 struct type_definition {
-  struct specifier_list *specifiers;
-  struct id *name;
+  spec_list_ref specifiers;
+  id_ref name;
 };
 
 struct function {
-  struct specifier_list *specifiers;
-  struct id *name;
-  struct declaration_list *parameters;
-  struct statement *body;
+  spec_list_ref specifiers;
+  id_ref name;
+  decl_list_ref parameters;
+  stmt_ref body;
   struct scope *parameter_scope;
 };
 
 struct variable_definition {
-  struct specifier_list *specifiers;
-  struct init_declarator_list *init_declarator_list;
+  spec_list_ref specifiers;
+  init_decl_list_ref init_declarator_list;
 };
 
 struct declaration {
   enum declaration_t type;
 
+  // this is a part of a list
+  decl_ref next;
+
   union {
     struct type_definition _type_def;
     struct function _func;
     struct variable_definition _var;
   };
-
-  // this is a part of a list
-  struct declaration *next;
 };
 
 struct declaration_list {
-  struct declaration *head;
-  struct declaration *tail;
+  decl_ref head;
+  decl_ref tail;
 };
 
-struct expression_list;
-
 struct index_expr {
   enum index_t type;
 
-  struct expression *object;
-  struct expression *index;
+  expr_ref object;
+  expr_ref index;
 };
 
 struct call_expr {
-  struct expression *function_ptr;
+  expr_ref function_ptr;
 
   // After semantic analysis, this list will include the function pointer and
   // be sorted in evaluation order. Unless the list was null to begin with.
-  struct expression_list *parameter_list;
+  expr_list_ref parameter_list;
 };
 
 struct unary_expr {
-  Token *operator;
-  struct expression *base;
+  token_ref operator;
+  expr_ref base;
 };
 
 struct cast_expr {
-  struct specifier_list *type;
-  struct expression *base;
+  spec_list_ref type;
+  expr_ref base;
 };
 
 struct binary_expr {
-  Token *operator;
-  struct expression *left;
-  struct expression *right;
+  token_ref operator;
+  expr_ref left;
+  expr_ref right;
 };
 
 struct ternary_expr {
-  struct expression *condition;
-  struct expression *true_branch;
-  struct expression *false_branch;
+  expr_ref condition;
+  expr_ref true_branch;
+  expr_ref false_branch;
 };
 
 struct expression {
   enum expression_t type;
+  // The index of the expression in its pool, for annotations that passes keep
+  // in tables of their own, like registers in assign.c.
+  expr_ref id;
 
   union {
-    struct id *_id;
-    Token *_constant;
+    id_ref _id;
+    token_ref _constant;
     struct index_expr _index;
     struct call_expr _call;
     struct unary_expr _unary;
@@ -176,23 +192,16 @@ struct expression {
     struct ternary_expr _ternary;
   };
 
-  // register number
-  uint64_t reg;
-  size_t reg_count;
-
-  struct expression *next;
+  expr_ref next;
 };
 
 struct expression_list {
-  struct expression *head;
-  struct expression *tail;
+  expr_ref head;
+  expr_ref tail;
 };
 
-struct statement_list;
-struct statement;
-
 struct compound_statement {
-  struct statement_list *statements;
+  stmt_list_ref statements;
   struct scope *local_scope;
 };
 
@@ -200,59 +209,62 @@ struct for_statement {
   bool is_initializer_decl;
 
   // For the next two fields, only one of them is set.
-  struct declaration *decl;
-  struct expression *preloop_expression;
+  decl_ref decl;
+  expr_ref preloop_expression;
 
-  struct expression *condition;
-  struct expression *step_expression;
+  expr_ref condition;
+  expr_ref step_expression;
 
-  struct statement *body;
+  stmt_ref body;
 };
 
 struct if_statement {
-  struct expression *condition;
-  struct statement *body;
-  struct statement *else_body;
+  expr_ref condition;
+  stmt_ref body;
+  stmt_ref else_body;
 };
 
 struct label {
-  struct id *name;
+  id_ref name;
 };
 
 struct return_statement {
-  struct expression *ret_expr;
+  expr_ref ret_expr;
 };
 
 struct switch_label {
-  struct expression *test;
+  expr_ref test;
 };
 
 struct switch_statement {
-  struct expression *condition;
-  struct statement *body;
+  expr_ref condition;
+  stmt_ref body;
 };
 
 struct while_statement {
   bool should_check_condition_first;
-  struct expression *condition;
+  expr_ref condition;
 
-  struct statement *body;
+  stmt_ref body;
 };
 
 struct statement_list {
-  struct statement *head;
-  struct statement *tail;
+  stmt_ref head;
+  stmt_ref tail;
 };
 
 struct statement {
   enum statement_t type;
 
+  // this is a part of a list
+  stmt_ref next;
+
   union {
     struct compound_statement _compound;
-    struct declaration *_decl;
-    struct expression *_expr;
+    decl_ref _decl;
+    expr_ref _expr;
     struct for_statement _for;
-    struct id *_goto;
+    id_ref _goto;
     struct if_statement _if;
     struct label _label;
     struct return_statement _return;
@@ -260,9 +272,6 @@ struct statement {
     struct switch_label _switch_label;
     struct while_statement _while;
   };
-
-  // this is a part of a list
-  struct statement *next;
 };
 
 struct translation_unit {
@@ -1,4 +1,5 @@
 #include "debug_ast.h"
+#include "assign.h"
 #include "common.h"
 #include "log.h"
 #include "tree.h"
@@ -14,7 +15,7 @@ void print_ast() {
   print_translation_unit(tree);
 }
 
-size_t stack = 0;
+_Thread_local size_t stack = 0;
 
 char *get_prefix() {
   size_t length = 2 * stack + 1;
@@ -53,13 +54,15 @@ void print(const char *fmt, ...) {
   free(prefix);
 }
 
-void print_token(Token *token) { print("Token { %s }", token->data); }
+void print_token(Token *token) {
+  print("Token { %.*s }", (int)token->length, token->data);
+}
 
 void print_id(struct id *id) {
   print("Id");
 
   stack++;
-  print_token(id->name);
+  print_token(&id->name);
   print("Symbol: %p", id->symbol);
   stack--;
 }
@@ -68,7 +71,7 @@ void print_token_specifier(struct specifier *specifier) {
   print("Token specifier");
 
   stack++;
-  print_token(specifier->_token);
+  print_token(&specifier->_token);
   stack--;
 }
 
@@ -76,7 +79,7 @@ void print_id_specifier(struct specifier *specifier) {
   print("Id specifier");
 
   stack++;
-  print_id(specifier->_id);
+  print_id(id_at(specifier->_id));
   stack--;
 }
 
@@ -92,8 +95,8 @@ void print_specifier(struct specifier *specifier) {
 }
 
 void print_specifier_list(struct specifier_list *list) {
-  for (struct specifier *cur = list->head; cur != NULL; cur = cur->next) {
-    print_specifier(cur);
+  for (spec_ref cur = list->head; cur != NO_NODE; cur = spec_at(cur)->next) {
+    print_specifier(spec_at(cur));
   }
 }
 
@@ -105,10 +108,10 @@ void print_initialized_declarator(struct initialized_declarator *decl) {
   print("Initialized declarator");
 
   stack++;
-  print_id(decl->declarator);
+  print_id(id_at(decl->declarator));
 
   if (decl->initializer)
-    print_expression(decl->initializer);
+    print_expression(expr_at(decl->initializer));
   stack--;
 }
 
@@ -119,20 +122,20 @@ void print_init_declarator_list(struct init_declarator_list *list) {
   print("Init declarator list");
 
   stack++;
-  for (struct initialized_declarator *cur = list->head; cur != NULL;
-       cur = cur->next) {
-    print_initialized_declarator(cur);
+  for (init_decl_ref cur = list->head; cur != NO_NODE;
+       cur = init_decl_at(cur)->next) {
+    print_initialized_declarator(init_decl_at(cur));
   }
   stack--;
 }
 
 void print_declaration_list(struct declaration_list *list) {
-  struct declaration *cur = list->head;
-  struct declaration *next = NULL;
+  decl_ref cur = list->head;
+  decl_ref next = NO_NODE;
 
   while (cur) {
-    next = cur->next;
-    print_declaration(cur);
+    next = decl_at(cur)->next;
+    print_declaration(decl_at(cur));
     cur = next;
   }
 }
@@ -141,8 +144,9 @@ void print_variable_definition(struct declaration *decl) {
   print("Variable definition");
 
   stack++;
-  print_specifier_list(decl->_var.specifiers);
-  print_init_declarator_list(decl->_var.init_declarator_list);
+  print_specifier_list(spec_list_at(decl->_var.specifiers));
+  print_init_declarator_list(
+    init_decl_list_at(decl->_var.init_declarator_list));
   stack--;
 }
 
@@ -150,13 +154,13 @@ void print_function_definition(struct declaration *decl) {
   print("Function");
 
   stack++;
-  print_specifier_list(decl->_func.specifiers);
-  print_id(decl->_func.name);
+  print_specifier_list(spec_list_at(decl->_func.specifiers));
+  print_id(id_at(decl->_func.name));
 
   if (decl->_func.parameters)
-    print_declaration_list(decl->_func.parameters);
+    print_declaration_list(decl_list_at(decl->_func.parameters));
 
-  print_statement(decl->_func.body);
+  print_statement(stmt_at(decl->_func.body));
 
   print("Parameter scope: %p", decl->_func.parameter_scope);
   stack--;
@@ -166,8 +170,8 @@ void print_type_definition(struct declaration *decl) {
   print("Type definition");
 
   stack++;
-  print_specifier_list(decl->_type_def.specifiers);
-  print_id(decl->_type_def.name);
+  print_specifier_list(spec_list_at(decl->_type_def.specifiers));
+  print_id(id_at(decl->_type_def.name));
   stack--;
 }
 
@@ -197,9 +201,9 @@ void print_statement_list(struct statement_list *list) {
   if (list == NULL)
     return;
 
-  for (struct statement *child = list->head; child != NULL;
-       child = child->next) {
-    print_statement(child);
+  for (stmt_ref child = list->head; child != NO_NODE;
+       child = stmt_at(child)->next) {
+    print_statement(stmt_at(child));
   }
 }
 
@@ -207,7 +211,7 @@ void print_compound_stmt(struct statement *stmt) {
   print("Compound statement");
 
   stack++;
-  print_statement_list(stmt->_compound.statements);
+  print_statement_list(stmt_list_at(stmt->_compound.statements));
   print("Local scope: %p", stmt->_compound.local_scope);
   stack--;
 }
@@ -221,7 +225,7 @@ void print_decl_stmt(struct statement *stmt) {
   print("Declaration statement");
 
   stack++;
-  print_declaration(stmt->_decl);
+  print_declaration(decl_at(stmt->_decl));
   stack--;
 }
 
@@ -229,7 +233,7 @@ void print_expr_stmt(struct statement *stmt) {
   print("Expression");
 
   stack++;
-  print_expression(stmt->_expr);
+  print_expression(expr_at(stmt->_expr));
   stack--;
 }
 
@@ -239,23 +243,23 @@ void print_for_stmt(struct statement *stmt) {
   stack++;
 
   if (stmt->_for.decl) {
-    print_declaration(stmt->_for.decl);
+    print_declaration(decl_at(stmt->_for.decl));
   }
 
   if (stmt->_for.preloop_expression) {
-    print_expression(stmt->_for.preloop_expression);
+    print_expression(expr_at(stmt->_for.preloop_expression));
   }
 
   if (stmt->_for.condition) {
-    print_expression(stmt->_for.condition);
+    print_expression(expr_at(stmt->_for.condition));
   }
 
   if (stmt->_for.step_expression) {
-    print_expression(stmt->_for.step_expression);
+    print_expression(expr_at(stmt->_for.step_expression));
   }
 
   if (stmt->_for.body) {
-    print_statement(stmt->_for.body);
+    print_statement(stmt_at(stmt->_for.body));
   }
 
   stack--;
@@ -265,7 +269,7 @@ void print_goto_stmt(struct statement *stmt) {
   print("Goto");
 
   stack++;
-  print_id(stmt->_goto);
+  print_id(id_at(stmt->_goto));
   stack--;
 }
 
@@ -275,15 +279,15 @@ void print_if_stmt(struct statement *stmt) {
   stack++;
 
   if (stmt->_if.condition) {
-    print_expression(stmt->_if.condition);
+    print_expression(expr_at(stmt->_if.condition));
   }
 
   if (stmt->_if.body) {
-    print_statement(stmt->_if.body);
+    print_statement(stmt_at(stmt->_if.body));
   }
 
   if (stmt->_if.else_body) {
-    print_statement(stmt->_if.else_body);
+    print_statement(stmt_at(stmt->_if.else_body));
   }
 
   stack--;
@@ -293,7 +297,7 @@ void print_label_stmt(struct statement *stmt) {
   print("Label");
 
   stack++;
-  print_id(stmt->_label.name);
+  print_id(id_at(stmt->_label.name));
   stack--;
 }
 
@@ -302,7 +306,7 @@ void print_return_stmt(struct statement *stmt) {
 
   stack++;
   if (stmt->_return.ret_expr) {
-    print_expression(stmt->_return.ret_expr);
+    print_expression(expr_at(stmt->_return.ret_expr));
   }
   stack--;
 }
@@ -313,11 +317,11 @@ void print_switch_stmt(struct statement *stmt) {
   stack++;
 
   if (stmt->_switch.condition) {
-    print_expression(stmt->_switch.condition);
+    print_expression(expr_at(stmt->_switch.condition));
   }
 
   if (stmt->_switch.body) {
-    print_statement(stmt->_switch.body);
+    print_statement(stmt_at(stmt->_switch.body));
   }
 
   stack--;
@@ -328,7 +332,7 @@ void print_switch_label_stmt(struct statement *stmt) {
 
   stack++;
   if (stmt->_switch_label.test) {
-    print_expression(stmt->_switch_label.test);
+    print_expression(expr_at(stmt->_switch_label.test));
   }
   stack--;
 }
@@ -342,11 +346,11 @@ void print_while_stmt(struct statement *stmt) {
 
   stack++;
   if (stmt->_while.condition) {
-    print_expression(stmt->_while.condition);
+    print_expression(expr_at(stmt->_while.condition));
   }
 
   if (stmt->_while.body) {
-    print_statement(stmt->_while.body);
+    print_statement(stmt_at(stmt->_while.body));
   }
   stack--;
 }
@@ -416,14 +420,14 @@ void print_index_expression(struct expression *expr) {
   if (expr->_index.object) {
     print("Object");
     stack++;
-    print_expression(expr->_index.object);
+    print_expression(expr_at(expr->_index.object));
     stack--;
   }
 
   if (expr->_index.index) {
     print("Index");
     stack++;
-    print_expression(expr->_index.index);
+    print_expression(expr_at(expr->_index.index));
     stack--;
   }
   stack--;
@@ -437,14 +441,14 @@ void print_func_call(struct expression *expr) {
   if (expr->_call.function_ptr) {
     print("Function pointer");
     stack++;
-    print_expression(expr->_call.function_ptr);
+    print_expression(expr_at(expr->_call.function_ptr));
     stack--;
   }
 
   if (expr->_call.parameter_list) {
     print("Parameter list");
     stack++;
-    print_expression_list(expr->_call.parameter_list);
+    print_expression_list(expr_list_at(expr->_call.parameter_list));
     stack--;
   }
 
@@ -456,12 +460,10 @@ void print_postfix_expr(struct expression *expr) {
 
   stack++;
   if (expr->_unary.base) {
-    print_expression(expr->_unary.base);
+    print_expression(expr_at(expr->_unary.base));
   }
 
-  if (expr->_unary.operator) {
-    print_token(expr->_unary.operator);
-  }
+  print_token(token_at(expr->_unary.operator));
   stack--;
 }
 
@@ -469,12 +471,10 @@ void print_unary_expr(struct expression *expr) {
   print("Unary expression");
 
   stack++;
-  if (expr->_unary.operator) {
-    print_token(expr->_unary.operator);
-  }
+  print_token(token_at(expr->_unary.operator));
 
   if (expr->_unary.base) {
-    print_expression(expr->_unary.base);
+    print_expression(expr_at(expr->_unary.base));
   }
   stack--;
 }
@@ -485,11 +485,11 @@ void print_cast_expr(struct expression *expr) {
   stack++;
 
   if (expr->_cast.type) {
-    print_specifier_list(expr->_cast.type);
+    print_specifier_list(spec_list_at(expr->_cast.type));
   }
 
   if (expr->_cast.base) {
-    print_expression(expr->_cast.base);
+    print_expression(expr_at(expr->_cast.base));
   }
 
   stack--;
@@ -501,15 +501,13 @@ void print_binary_expr(struct expression *expr) {
   stack++;
 
   if (expr->_binary.left) {
-    print_expression(expr->_binary.left);
+    print_expression(expr_at(expr->_binary.left));
   }
 
-  if (expr->_binary.operator) {
-    print_token(expr->_binary.operator);
-  }
+  print_token(token_at(expr->_binary.operator));
 
   if (expr->_binary.right) {
-    print_expression(expr->_binary.right);
+    print_expression(expr_at(expr->_binary.right));
   }
 
   stack--;
@@ -521,15 +519,15 @@ void print_ternary_expr(struct expression *expr) {
   stack++;
 
   if (expr->_ternary.condition) {
-    print_expression(expr->_ternary.condition);
+    print_expression(expr_at(expr->_ternary.condition));
   }
 
   if (expr->_ternary.true_branch) {
-    print_expression(expr->_ternary.true_branch);
+    print_expression(expr_at(expr->_ternary.true_branch));
   }
 
   if (expr->_ternary.false_branch) {
-    print_expression(expr->_ternary.false_branch);
+    print_expression(expr_at(expr->_ternary.false_branch));
   }
 
   stack--;
@@ -545,13 +543,13 @@ void print_expression(struct expression *expr) {
   case CONST_EXPR:
     print("Constant");
     stack++;
-    print_token(expr->_constant);
+    print_token(token_at(expr->_constant));
     stack--;
     break;
   case ID_EXPR:
     print("Id expression");
     stack++;
-    print_id(expr->_id);
+    print_id(id_at(expr->_id));
     stack--;
     break;
   case INDEX:
@@ -579,8 +577,8 @@ void print_expression(struct expression *expr) {
     print("Unknown expression type");
   }
 
-  print("Register: r%lu", expr->reg);
-  print("Register count: %zu", expr->reg_count);
+  print("Register: r%lu", get_reg(expr));
+  print("Register count: %zu", get_reg_count(expr));
 }
 
 void print_expression_list(struct expression_list *list) {
@@ -589,16 +587,16 @@ void print_expression_list(struct expression_list *list) {
     return;
   }
 
-  struct expression *cur = list->head;
+  expr_ref cur = list->head;
 
-  if (cur == NULL) {
+  if (cur == NO_NODE) {
     print("(empty list)");
     return;
   }
 
-  while (cur != NULL) {
-    print_expression(cur);
-    cur = cur->next;
+  while (cur != NO_NODE) {
+    print_expression(expr_at(cur));
+    cur = expr_at(cur)->next;
   }
 }
 
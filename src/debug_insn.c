@@ -4,11 +4,11 @@
 
 #include "log.h"
 
-char insn_str[4096];
-const char *op_code;
-char op1_str[256];
-char op2_str[256];
-char op3_str[256];
+_Thread_local char insn_str[4096];
+_Thread_local const char *op_code;
+_Thread_local char op1_str[256];
+_Thread_local char op2_str[256];
+_Thread_local char op3_str[256];
 
 void debug_operand(char *str, Operand *op) {
   if (op == NULL) {
@@ -0,0 +1,70 @@
+#include "depend.h"
+#include "preprocess.h"
+
+#include <string.h>
+
+// Rules are wrapped with a backslash before going past this column.
+#define DEPENDENCY_LINE_WIDTH 78
+
+/**
+ * Writes a file name as make reads it: spaces and hashes are escaped with a
+ * backslash, dollar signs are doubled.
+ *
+ * @return The number of characters written.
+ */
+size_t write_make_name(FILE *output, const char *name, size_t length) {
+  size_t written = length;
+
+  for (size_t i = 0; i < length; i++) {
+    if (name[i] == ' ' || name[i] == '#') {
+      fputc('\\', output);
+      written++;
+    } else if (name[i] == '$') {
+      fputc('$', output);
+      written++;
+    }
+
+    fputc(name[i], output);
+  }
+
+  return written;
+}
+
+// Starts a new line first if the name would not fit on the current one.
+size_t write_prerequisite(FILE *output, const char *name, size_t column) {
+  size_t length = strlen(name);
+
+  if (column + 1 + length > DEPENDENCY_LINE_WIDTH) {
+    fputs(" \\\n ", output);
+    column = 1;
+  } else {
+    fputc(' ', output);
+    column++;
+  }
+
+  return column + write_make_name(output, name, length);
+}
+
+void write_dependencies(FILE *output, const char *path, bool system_headers) {
+  const char *base = strrchr(path, '/');
+  base = base ? base + 1 : path;
+
+  const char *suffix = strrchr(base, '.');
+  size_t stem = suffix ? (size_t)(suffix - base) : strlen(base);
+
+  size_t column = write_make_name(output, base, stem);
+  fputs(".o:", output);
+  column += 3;
+  column = write_prerequisite(output, path, column);
+
+  size_t count;
+  const IncludedFile *included = get_included_files(&count);
+
+  for (size_t i = 0; i < count; i++) {
+    if (system_headers || !included[i].system) {
+      column = write_prerequisite(output, included[i].path, column);
+    }
+  }
+
+  fputc('\n', output);
+}
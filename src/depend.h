@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * Writes a Makefile rule making the object file of a source depend on the
+ * source and every header it includes, like -M. The translation unit must
+ * have been preprocessed to its end, see set_directives_only().
+ *
+ * @param output Where to write the rule.
+ * @param path The path of the source. The target is its file name with the
+ * suffix replaced by ".o".
+ * @param system_headers Whether headers included with <...>, and those they
+ * include, are listed. Leaving them out is -MM.
+ */
+void write_dependencies(FILE *output, const char *path, bool system_headers);
@@ -0,0 +1,1082 @@
+#include "descent.h"
+#include "log.h"
+#include "parser.h"
+#include "precedence.h"
+#include "preprocess.h"
+#include "tree.h"
+
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_TOKEN_CAPACITY 256
+
+_Thread_local struct descent {
+  // Tokens of the external declaration being parsed, kept to replay them to
+  // the GLR parser. Those from `index` on are lookahead.
+  Token *tokens;
+  size_t count;
+  size_t capacity;
+  size_t index;
+
+  // Taken by fall_back().
+  jmp_buf fallback;
+
+  struct translation_unit *unit;
+  ParseStats stats;
+} rd;
+
+bool is_directive(const Token *token) {
+  return token->kind == PUNCT && token->code == PU_HASH &&
+         (token->flags & TF_LINE_START);
+}
+
+bool ends_declaration(struct splitter *splitter, const Token *token) {
+  if (token->flags & TF_LINE_START) {
+    splitter->in_directive = is_directive(token);
+  }
+
+  bool after_parameters = splitter->after_parameters;
+  splitter->after_parameters = false;
+
+  if (splitter->in_directive || token->kind != PUNCT) {
+    return false;
+  }
+
+  switch (token->code) {
+  case PU_LPAREN:
+  case PU_LBRACKET:
+    splitter->depth++;
+    break;
+  case PU_RPAREN:
+  case PU_RBRACKET:
+    if (splitter->depth > 0) {
+      splitter->depth--;
+    }
+
+    splitter->after_parameters =
+      token->code == PU_RPAREN && splitter->depth == 0;
+    break;
+  case PU_LBRACE:
+    if (splitter->depth == 0 && after_parameters && !splitter->initialized) {
+      splitter->in_body = true;
+    }
+
+    splitter->depth++;
+    break;
+  case PU_RBRACE:
+    if (splitter->depth > 0) {
+      splitter->depth--;
+    }
+
+    if (splitter->depth == 0 && splitter->in_body) {
+      *splitter = (struct splitter){0};
+      return true;
+    }
+
+    break;
+  case PU_EQ:
+    if (splitter->depth == 0) {
+      splitter->initialized = true;
+    }
+
+    break;
+  case PU_SEMICOLON:
+    if (splitter->depth == 0) {
+      *splitter = (struct splitter){0};
+      return true;
+    }
+
+    break;
+  default:
+    break;
+  }
+
+  return false;
+}
+
+// Token stream
+
+/**
+ * @return The token `n` past the next one, preprocessing up to it.
+ */
+Token *peek(size_t n) {
+  while (rd.index + n >= rd.count) {
+    if (rd.count == rd.capacity) {
+      size_t capacity =
+        rd.capacity == 0 ? INITIAL_TOKEN_CAPACITY : rd.capacity * 2;
+      Token *tokens = realloc(rd.tokens, capacity * sizeof(Token));
+
+      if (tokens == NULL) {
+        CRITICAL("parser", "Out of memory!");
+      }
+
+      rd.tokens = tokens;
+      rd.capacity = capacity;
+    }
+
+    rd.tokens[rd.count++] = *preprocess_token();
+  }
+
+  return &rd.tokens[rd.index + n];
+}
+
+bool at(enum token_code code) { return peek(0)->code == code; }
+
+Token take(void) {
+  Token token = *peek(0);
+  rd.index++;
+  return token;
+}
+
+/**
+ * Leaves the external declaration being parsed to the GLR parser.
+ */
+_Noreturn void fall_back(void) { longjmp(rd.fallback, 1); }
+
+bool accept_token(enum token_code code) {
+  if (at(code)) {
+    rd.index++;
+    return true;
+  }
+
+  return false;
+}
+
+void expect_token(enum token_code code) {
+  if (!accept_token(code)) {
+    fall_back();
+  }
+}
+
+bool at_attribute(void) {
+  return at(PU_LBRACKET) && peek(1)->code == PU_LBRACKET;
+}
+
+bool is_type_name(const Token *token) {
+  return token->kind == IDENTIFIER && is_type_alias(token->interned);
+}
+
+// An identifier that is not a typedef name, which the GLR parser reads as ID.
+bool is_plain_identifier(const Token *token) {
+  return token->kind == IDENTIFIER && !is_type_alias(token->interned);
+}
+
+bool is_qualifier(const Token *token) {
+  return token->code == KW_const || token->code == KW_restrict ||
+         token->code == KW_volatile || token->code == KW__Atomic;
+}
+
+/**
+ * @param type_only Only accept what a specifier-qualifier list may hold.
+ * @return Whether a token starts a declaration specifier, including those
+ * parse_specifier() leaves to the GLR parser.
+ */
+bool starts_specifier(const Token *token, bool type_only) {
+  if (token->kind == IDENTIFIER) {
+    return is_type_alias(token->interned);
+  }
+
+  if (token->kind != KEYWORD) {
+    return false;
+  }
+
+  switch (token->code) {
+  case KW_auto:
+  case KW_constexpr:
+  case KW_extern:
+  case KW_register:
+  case KW_static:
+  case KW_thread_local:
+  case KW_inline:
+  case KW__Noreturn:
+    return !type_only;
+  case KW_void:
+  case KW_bool:
+  case KW_char:
+  case KW_short:
+  case KW_int:
+  case KW_long:
+  case KW_float:
+  case KW_double:
+  case KW_signed:
+  case KW_unsigned:
+  case KW__BitInt:
+  case KW__Complex:
+  case KW__Decimal32:
+  case KW__Decimal64:
+  case KW__Decimal128:
+  case KW_struct:
+  case KW_union:
+  case KW_enum:
+  case KW_typeof:
+  case KW_typeof_unqual:
+  case KW_const:
+  case KW_restrict:
+  case KW_volatile:
+  case KW__Atomic:
+  case KW_alignas:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool at_declaration(void) {
+  return starts_specifier(peek(0), false) || at(KW_typedef) ||
+         at(KW_static_assert) || at_attribute();
+}
+
+// A '(' that starts a cast, or the operand of sizeof or alignof.
+bool at_type_name(void) {
+  return at(PU_LPAREN) && starts_specifier(peek(1), true);
+}
+
+bool at_label(void) {
+  return at(KW_case) || at(KW_default) ||
+         (is_plain_identifier(peek(0)) && peek(1)->code == PU_COLON);
+}
+
+// Expressions
+
+expr_ref parse_expression(void);
+expr_ref parse_assignment(void);
+expr_ref parse_cast(void);
+spec_list_ref parse_type_name(void);
+
+expr_ref parse_primary(void) {
+  Token token = *peek(0);
+
+  switch (token.kind) {
+  case IDENTIFIER:
+    if (is_type_alias(token.interned)) {
+      fall_back();
+    }
+
+    rd.index++;
+    return create_id_expression(create_id(&token));
+  case CONSTANT:
+  case STRING:
+    rd.index++;
+    return create_const_expression(&token);
+  case PUNCT:
+    if (token.code == PU_LPAREN) {
+      rd.index++;
+      expr_ref expr = parse_expression();
+      expect_token(PU_RPAREN);
+      return expr;
+    }
+
+    break;
+  }
+
+  fall_back();
+}
+
+expr_ref parse_member(void) {
+  Token name = take();
+
+  if (!is_plain_identifier(&name)) {
+    fall_back();
+  }
+
+  return create_id_expression(create_id(&name));
+}
+
+expr_list_ref parse_arguments(void) {
+  if (accept_token(PU_RPAREN)) {
+    return create_expr_list(NO_NODE);
+  }
+
+  expr_list_ref list = create_expr_list(parse_assignment());
+
+  while (accept_token(PU_COMMA)) {
+    list = append_expr(list, parse_assignment());
+  }
+
+  expect_token(PU_RPAREN);
+  return list;
+}
+
+expr_ref parse_postfix(expr_ref base) {
+  for (;;) {
+    Token op = *peek(0);
+
+    switch (op.code) {
+    case PU_LBRACKET: {
+      rd.index++;
+      expr_ref index = parse_expression();
+      expect_token(PU_RBRACKET);
+      base = create_array_index_expression(base, index);
+      break;
+    }
+    case PU_LPAREN:
+      rd.index++;
+      base = create_call_expression(base, parse_arguments());
+      break;
+    case PU_PERIOD:
+      rd.index++;
+      base = create_dot_index_expression(base, parse_member());
+      break;
+    case PU_ARROW:
+      rd.index++;
+      base = create_arrow_index_expression(base, parse_member());
+      break;
+    case PU_INC:
+    case PU_DEC:
+      rd.index++;
+      base = create_postfix_expression(base, &op);
+      break;
+    default:
+      return base;
+    }
+  }
+}
+
+expr_ref parse_unary(void) {
+  Token op = *peek(0);
+
+  switch (op.code) {
+  case PU_INC:
+  case PU_DEC:
+  case PU_AMP:
+  case PU_STAR:
+  case PU_PLUS:
+  case PU_MINUS:
+  case PU_TILDE:
+  case PU_BANG: {
+    rd.index++;
+    expr_ref base = parse_unary();
+    return create_unary_expression(&op, base);
+  }
+  case KW_sizeof: {
+    rd.index++;
+
+    if (!at_type_name()) {
+      expr_ref base = parse_unary();
+      return create_unary_expression(&op, base);
+    }
+
+    // The GLR parser keeps no type, nor any operand.
+    parse_type_name();
+
+    // A compound literal.
+    if (at(PU_LBRACE)) {
+      fall_back();
+    }
+
+    return create_unary_expression(&op, NO_NODE);
+  }
+  case KW_alignof:
+    rd.index++;
+    parse_type_name();
+    return create_unary_expression(&op, NO_NODE);
+  default:
+    return parse_postfix(parse_primary());
+  }
+}
+
+expr_ref parse_cast(void) {
+  if (!at_type_name()) {
+    return parse_unary();
+  }
+
+  spec_list_ref type = parse_type_name();
+
+  if (at(PU_LBRACE)) {
+    fall_back();
+  }
+
+  expr_ref base = parse_cast();
+  return create_cast_expression(type, base);
+}
+
+/**
+ * Parses the operators binding at least as tightly as `min_precedence` that
+ * follow an operand, by precedence climbing.
+ */
+expr_ref parse_binary(expr_ref left,
+                                uint8_t min_precedence) {
+  for (;;) {
+    Token op = *peek(0);
+    uint8_t precedence = binary_precedence[op.code];
+
+    if (precedence == 0 || precedence < min_precedence) {
+      return left;
+    }
+
+    rd.index++;
+    expr_ref right = parse_cast();
+
+    while (binary_precedence[peek(0)->code] > precedence) {
+      right = parse_binary(right, precedence + 1);
+    }
+
+    left = create_binary_expression(left, &op, right);
+  }
+}
+
+expr_ref parse_conditional_rest(expr_ref condition) {
+  if (!accept_token(PU_QUESTION)) {
+    return condition;
+  }
+
+  expr_ref true_branch = parse_expression();
+  expect_token(PU_COLON);
+  expr_ref false_branch =
+    parse_conditional_rest(parse_binary(parse_cast(), 1));
+
+  return create_ternary_expression(condition, true_branch, false_branch);
+}
+
+expr_ref parse_conditional(void) {
+  return parse_conditional_rest(parse_binary(parse_cast(), 1));
+}
+
+bool is_assignment_operator(enum token_code code) {
+  switch (code) {
+  case PU_EQ:
+  case PU_STARE:
+  case PU_SLASHE:
+  case PU_PERCENTE:
+  case PU_PLUSE:
+  case PU_MINUSE:
+  case PU_SHFLE:
+  case PU_SHFRE:
+  case PU_ANDE:
+  case PU_CARATE:
+  case PU_ORE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+expr_ref parse_assignment(void) {
+  // Only unary expressions are assigned to, not casts.
+  bool unary = !at_type_name();
+  expr_ref left = parse_cast();
+
+  if (!is_assignment_operator(peek(0)->code)) {
+    return parse_conditional_rest(parse_binary(left, 1));
+  }
+
+  if (!unary) {
+    fall_back();
+  }
+
+  Token op = take();
+  expr_ref right = parse_assignment();
+  return create_binary_expression(left, &op, right);
+}
+
+expr_ref parse_expression(void) {
+  expr_ref left = parse_assignment();
+
+  while (at(PU_COMMA)) {
+    Token op = take();
+    expr_ref right = parse_assignment();
+    left = create_binary_expression(left, &op, right);
+  }
+
+  return left;
+}
+
+expr_ref parse_expression_until(enum token_code end) {
+  return at(end) ? NO_NODE : parse_expression();
+}
+
+// Declarations
+
+/**
+ * Parses a specifier the GLR parser keeps a node for, or leaves the
+ * declaration to it.
+ *
+ * @param type_only Only accept a type specifier or qualifier.
+ */
+spec_ref parse_specifier(bool type_only) {
+  Token token = *peek(0);
+
+  if (is_type_name(&token)) {
+    rd.index++;
+    return create_id_specifier(create_id(&token));
+  }
+
+  if (!starts_specifier(&token, type_only)) {
+    fall_back();
+  }
+
+  switch (token.code) {
+  case KW__Atomic:
+    // An atomic type specifier.
+    if (peek(1)->code == PU_LPAREN) {
+      fall_back();
+    }
+
+    break;
+  case KW_struct:
+  case KW_union:
+    // Only references to tagged types, the GLR parser keeps no members.
+    if (!is_plain_identifier(peek(1)) || peek(2)->code == PU_LBRACE) {
+      fall_back();
+    }
+
+    rd.index++;
+    break;
+  case KW__BitInt:
+  case KW_enum:
+  case KW_typeof:
+  case KW_typeof_unqual:
+  case KW_alignas:
+    fall_back();
+  default:
+    break;
+  }
+
+  rd.index++;
+  return create_token_specifier(&token);
+}
+
+// A specifier after which a typedef name is no longer a specifier.
+bool is_type_specifier(const Token *token) {
+  return starts_specifier(token, true) && !is_qualifier(token) &&
+         token->code != KW_alignas;
+}
+
+/**
+ * @param typed A type specifier came before, so a typedef name is the name
+ * being declared, as in `int T;` in the scope of `typedef long T;`.
+ */
+spec_list_ref parse_specifiers_after(bool type_only, bool typed) {
+  typed = typed || is_type_specifier(peek(0));
+
+  spec_ref specifier = parse_specifier(type_only);
+
+  if (at_attribute()) {
+    fall_back();
+  }
+
+  if (!starts_specifier(peek(0), type_only) ||
+      (typed && is_type_name(peek(0)))) {
+    return create_specifier_list(specifier);
+  }
+
+  return prepend_specifier(specifier,
+                           parse_specifiers_after(type_only, typed));
+}
+
+/**
+ * @param type_only Parse a specifier-qualifier list.
+ */
+spec_list_ref parse_specifiers(bool type_only) {
+  return parse_specifiers_after(type_only, false);
+}
+
+/**
+ * Skips the pointers at the start of a declarator, which the tree does not
+ * keep.
+ *
+ * @return Whether there were any.
+ */
+bool skip_pointers(void) {
+  bool pointers = false;
+
+  while (accept_token(PU_STAR)) {
+    pointers = true;
+
+    if (at_attribute()) {
+      fall_back();
+    }
+
+    while (is_qualifier(peek(0))) {
+      rd.index++;
+    }
+  }
+
+  return pointers;
+}
+
+// The '(' of a cast, sizeof or alignof, up to the matching ')'. Abstract
+// declarators other than pointers are left to the GLR parser.
+spec_list_ref parse_type_name(void) {
+  expect_token(PU_LPAREN);
+  spec_list_ref specifiers = parse_specifiers(true);
+  skip_pointers();
+  expect_token(PU_RPAREN);
+  return specifiers;
+}
+
+// An array declarator suffix, of which the tree keeps nothing.
+void parse_array_suffix(void) {
+  expect_token(PU_LBRACKET);
+
+  bool is_static = accept_token(KW_static);
+  bool qualified = false;
+
+  while (is_qualifier(peek(0))) {
+    rd.index++;
+    qualified = true;
+  }
+
+  if (!is_static && qualified) {
+    is_static = accept_token(KW_static);
+  }
+
+  if (!is_static && at(PU_STAR) && peek(1)->code == PU_RBRACKET) {
+    rd.index++;
+  } else if (is_static || !at(PU_RBRACKET)) {
+    parse_assignment();
+  }
+
+  expect_token(PU_RBRACKET);
+}
+
+id_ref parse_declarator(void);
+
+id_ref parse_direct_declarator(void) {
+  Token token = *peek(0);
+  id_ref id;
+
+  // Past the specifiers, a typedef name is declared again in a block scope,
+  // see parse_specifiers_after().
+  if (is_plain_identifier(&token) ||
+      (is_type_name(&token) && type_scope_depth() > 0)) {
+    rd.index++;
+    id = create_id(&token);
+    hide_type_alias(token.interned);
+  } else if (token.code == PU_LPAREN) {
+    rd.index++;
+    id = parse_declarator();
+    expect_token(PU_RPAREN);
+  } else {
+    fall_back();
+  }
+
+  while (!at_attribute() && at(PU_LBRACKET)) {
+    parse_array_suffix();
+  }
+
+  if (at_attribute()) {
+    fall_back();
+  }
+
+  return id;
+}
+
+id_ref parse_declarator(void) {
+  skip_pointers();
+  return parse_direct_declarator();
+}
+
+init_decl_ref parse_init_declarator(id_ref declarator) {
+  expr_ref initializer = NO_NODE;
+
+  if (accept_token(PU_EQ)) {
+    // A braced initializer, to which the GLR parser gives no node.
+    if (at(PU_LBRACE)) {
+      fall_back();
+    }
+
+    initializer = parse_assignment();
+  }
+
+  return create_initialized_declarator(declarator, initializer);
+}
+
+decl_ref parse_parameter(void) {
+  if (at_attribute()) {
+    fall_back();
+  }
+
+  spec_list_ref specifiers = parse_specifiers(false);
+  init_decl_ref declarator = NO_NODE;
+
+  // A lone pointer is an abstract declarator, which the tree drops.
+  skip_pointers();
+
+  if (peek(0)->kind == IDENTIFIER) {
+    declarator =
+      create_initialized_declarator(parse_direct_declarator(), NO_NODE);
+  } else if (!at(PU_COMMA) && !at(PU_RPAREN)) {
+    fall_back();
+  }
+
+  return create_variable_declaration(specifiers,
+                                     create_init_declarator_list(declarator));
+}
+
+decl_list_ref parse_parameters(void) {
+  if (accept_token(PU_ELLIPSIS)) {
+    return NO_NODE;
+  }
+
+  decl_list_ref list = create_declaration_list(parse_parameter());
+
+  while (accept_token(PU_COMMA)) {
+    if (accept_token(PU_ELLIPSIS)) {
+      break;
+    }
+
+    list = append_declaration(list, parse_parameter());
+  }
+
+  return list;
+}
+
+stmt_ref parse_compound(void);
+
+decl_ref parse_function(spec_list_ref specifiers,
+                                   id_ref name) {
+  decl_list_ref parameters = NO_NODE;
+
+  // Parameters are in scope in the body.
+  expect_token(PU_LPAREN);
+  enter_type_scope();
+
+  if (!at(PU_RPAREN)) {
+    parameters = parse_parameters();
+  }
+
+  expect_token(PU_RPAREN);
+
+  if (!at(PU_LBRACE)) {
+    fall_back();
+  }
+
+  stmt_ref body = parse_compound();
+
+  leave_type_scope();
+  return create_function(specifiers, name, parameters, body);
+}
+
+decl_ref parse_typedef(void) {
+  expect_token(KW_typedef);
+
+  spec_list_ref specifiers = parse_specifiers(false);
+  id_ref name = parse_declarator();
+
+  expect_token(PU_SEMICOLON);
+  return create_type_definition(specifiers, register_type(name));
+}
+
+/**
+ * @param external Allow a function definition.
+ */
+decl_ref parse_declaration(bool external) {
+  if (at_attribute() || at(KW_static_assert)) {
+    fall_back();
+  }
+
+  if (at(KW_typedef)) {
+    return parse_typedef();
+  }
+
+  spec_list_ref specifiers = parse_specifiers(false);
+
+  if (accept_token(PU_SEMICOLON)) {
+    return create_variable_declaration(specifiers, NO_NODE);
+  }
+
+  // Function declarators are only known to the grammar with a body, and
+  // without pointers.
+  bool pointers = skip_pointers();
+  id_ref name = parse_direct_declarator();
+
+  if (external && !pointers && at(PU_LPAREN)) {
+    return parse_function(specifiers, name);
+  }
+
+  init_decl_list_ref list =
+    create_init_declarator_list(parse_init_declarator(name));
+
+  while (accept_token(PU_COMMA)) {
+    list = append_initialized_declarator(
+      list, parse_init_declarator(parse_declarator()));
+  }
+
+  expect_token(PU_SEMICOLON);
+  return create_variable_declaration(specifiers, list);
+}
+
+// Statements
+
+stmt_list_ref parse_statement(void);
+
+stmt_ref parse_label(void) {
+  Token token = take();
+
+  if (token.code == KW_case) {
+    expr_ref test = parse_conditional();
+    expect_token(PU_COLON);
+    return create_case_stmt(test);
+  }
+
+  expect_token(PU_COLON);
+
+  if (token.code == KW_default) {
+    return create_default_stmt();
+  }
+
+  return create_label_stmt(create_id(&token));
+}
+
+stmt_ref parse_secondary_block(void) {
+  if (at(PU_LBRACE)) {
+    return parse_compound();
+  }
+
+  return create_compound_stmt(parse_statement());
+}
+
+stmt_ref parse_for(void) {
+  expect_token(KW_for);
+  expect_token(PU_LPAREN);
+
+  if (at_declaration()) {
+    enter_type_scope();
+
+    decl_ref decl = parse_declaration(false);
+    expr_ref condition = parse_expression_until(PU_SEMICOLON);
+    expect_token(PU_SEMICOLON);
+    expr_ref step = parse_expression_until(PU_RPAREN);
+    expect_token(PU_RPAREN);
+    stmt_ref body = parse_secondary_block();
+
+    leave_type_scope();
+    return create_for_stmt_with_decl(decl, condition, step, body);
+  }
+
+  expr_ref init = parse_expression_until(PU_SEMICOLON);
+  expect_token(PU_SEMICOLON);
+  expr_ref condition = parse_expression_until(PU_SEMICOLON);
+  expect_token(PU_SEMICOLON);
+  expr_ref step = parse_expression_until(PU_RPAREN);
+  expect_token(PU_RPAREN);
+
+  return create_for_stmt_with_expr(init, condition, step,
+                                   parse_secondary_block());
+}
+
+// The '(' expression ')' of if, switch and while.
+expr_ref parse_condition(void) {
+  expect_token(PU_LPAREN);
+  expr_ref condition = parse_expression();
+  expect_token(PU_RPAREN);
+  return condition;
+}
+
+stmt_ref parse_unlabeled_statement(void) {
+  switch (peek(0)->code) {
+  case PU_LBRACE:
+    return parse_compound();
+  case KW_if: {
+    rd.index++;
+    expr_ref condition = parse_condition();
+    stmt_ref body = parse_secondary_block();
+    stmt_ref else_body = NO_NODE;
+
+    if (accept_token(KW_else)) {
+      else_body = parse_secondary_block();
+    }
+
+    return create_if_stmt(condition, body, else_body);
+  }
+  case KW_switch: {
+    rd.index++;
+    expr_ref condition = parse_condition();
+    return create_switch_stmt(condition, parse_secondary_block());
+  }
+  case KW_while: {
+    rd.index++;
+    expr_ref condition = parse_condition();
+    return create_while_stmt(condition, parse_secondary_block());
+  }
+  case KW_do: {
+    rd.index++;
+    stmt_ref body = parse_secondary_block();
+    expect_token(KW_while);
+    expr_ref condition = parse_condition();
+    expect_token(PU_SEMICOLON);
+    return create_do_while_stmt(body, condition);
+  }
+  case KW_for:
+    return parse_for();
+  case KW_goto: {
+    rd.index++;
+    Token token = take();
+
+    if (!is_plain_identifier(&token)) {
+      fall_back();
+    }
+
+    id_ref label = create_id(&token);
+    expect_token(PU_SEMICOLON);
+    return create_goto_stmt(label);
+  }
+  case KW_continue:
+    rd.index++;
+    expect_token(PU_SEMICOLON);
+    return create_continue_stmt();
+  case KW_break:
+    rd.index++;
+    expect_token(PU_SEMICOLON);
+    return create_break_stmt();
+  case KW_return: {
+    rd.index++;
+    expr_ref expr = parse_expression_until(PU_SEMICOLON);
+    expect_token(PU_SEMICOLON);
+    return create_return_stmt(expr);
+  }
+  default: {
+    expr_ref expr = parse_expression_until(PU_SEMICOLON);
+    expect_token(PU_SEMICOLON);
+    return create_expr_stmt(expr);
+  }
+  }
+}
+
+stmt_list_ref parse_statement(void) {
+  if (at_label()) {
+    stmt_ref label = parse_label();
+    return prepend_stmt(label, parse_statement());
+  }
+
+  return create_stmt_list(parse_unlabeled_statement());
+}
+
+stmt_ref parse_block_item(void) {
+  if (at_declaration()) {
+    return create_decl_stmt(parse_declaration(false));
+  }
+
+  if (at_label()) {
+    return parse_label();
+  }
+
+  return parse_unlabeled_statement();
+}
+
+stmt_ref parse_compound(void) {
+  stmt_list_ref items = NO_NODE;
+
+  expect_token(PU_LBRACE);
+  enter_type_scope();
+
+  while (!accept_token(PU_RBRACE)) {
+    stmt_ref item = parse_block_item();
+    items = items ? append_stmt(items, item) : create_stmt_list(item);
+  }
+
+  leave_type_scope();
+  return create_compound_stmt(items);
+}
+
+// External declarations
+
+void add_declarations(decl_ref first) {
+  for (decl_ref cur = first, next; cur != NO_NODE; cur = next) {
+    next = decl_at(cur)->next;
+
+    if (rd.unit) {
+      append_external_declaration(rd.unit, cur);
+    } else {
+      rd.unit = create_translation_unit(cur);
+    }
+  }
+}
+
+/**
+ * Parses the current external declaration again with the GLR parser, up to
+ * where ends_declaration() says it ends.
+ *
+ * @return The result of yyparse().
+ */
+int parse_with_glr(void) {
+  struct splitter splitter = {0};
+  size_t end = 0;
+
+  rd.index = 0;
+
+  for (;;) {
+    Token *token = peek(end++);
+
+    if (token->kind == EOF || ends_declaration(&splitter, token)) {
+      break;
+    }
+  }
+
+  int result = parse_tokens(rd.tokens, end);
+
+  if (result == 0) {
+    add_declarations(get_tree()->external_declarations.head);
+  }
+
+  rd.index = end;
+  rd.stats.fallbacks++;
+  return result;
+}
+
+int parse_external_declarations(void) {
+  rd.count = 0;
+  rd.index = 0;
+  rd.unit = NULL;
+  rd.stats = (ParseStats){0, 0, 0};
+
+  // The grammar needs one declaration, the GLR parser reports if there is
+  // none.
+  while (rd.unit == NULL || peek(0)->kind != EOF) {
+    struct type_alias *aliases = alias_list;
+    size_t scopes = type_scope_depth();
+
+    if (setjmp(rd.fallback) == 0) {
+      add_declarations(parse_declaration(true));
+      rd.stats.declarations++;
+    } else {
+      while (type_scope_depth() > scopes) {
+        leave_type_scope();
+      }
+
+      forget_type_aliases(aliases);
+
+      if (parse_with_glr() != 0) {
+        free(rd.tokens);
+        rd = (struct descent){0};
+        return 1;
+      }
+    }
+
+    // Only the lookahead is kept for the next declaration.
+    rd.stats.tokens += rd.index;
+    memmove(rd.tokens, &rd.tokens[rd.index],
+            (rd.count - rd.index) * sizeof(Token));
+    rd.count -= rd.index;
+    rd.index = 0;
+  }
+
+  set_tree(rd.unit);
+  free(rd.tokens);
+  rd.tokens = NULL;
+  rd.count = 0;
+  rd.capacity = 0;
+  return 0;
+}
+
+int parse_translation_unit(void) {
+  jmp_buf failed;
+  jmp_buf *outer = error_recovery;
+
+  // An error ends this translation unit, not the threads compiling others.
+  if (setjmp(failed) != 0) {
+    error_recovery = outer;
+    free(rd.tokens);
+    rd = (struct descent){0};
+    return 1;
+  }
+
+  error_recovery = &failed;
+  int result = parse_external_declarations();
+  error_recovery = outer;
+  return result;
+}
+
+ParseStats get_parse_stats(void) { return rd.stats; }
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "scanner.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct ParseStatsStruct {
+  // Tokens making up the external declarations parsed.
+  size_t tokens;
+  // External declarations parsed by recursive descent, and those handed to
+  // the GLR parser instead.
+  size_t declarations;
+  size_t fallbacks;
+} ParseStats;
+
+// Tracks brackets to find where external declarations end: at a ';' outside
+// of them, or at the '}' closing a function body.
+struct splitter {
+  size_t depth;
+  // An '=' outside of brackets, so braces start an initializer.
+  bool initialized;
+  // The last token closed a parenthesis outside of brackets.
+  bool after_parameters;
+  bool in_body;
+  bool in_directive;
+};
+
+/**
+ * @return Whether a token starts a directive, if it has not been
+ * preprocessed.
+ */
+bool is_directive(const Token *token);
+
+/**
+ * Feeds the next token of a translation unit to a splitter. Directives are
+ * skipped, so this works before and after preprocessing.
+ *
+ * @return true if the token ends an external declaration.
+ */
+bool ends_declaration(struct splitter *splitter, const Token *token);
+
+/**
+ * Parses the tokens of the preprocessor into the tree returned by get_tree(),
+ * like yyparse() but without forking parse stacks.
+ *
+ * External declarations are parsed by recursive descent, with typedef names
+ * telling declarations from expressions and casts from parenthesized
+ * expressions up front. One that uses a construct it does not handle, such as
+ * a struct or enum body, an attribute, a braced initializer, a compound
+ * literal, _Generic or an abstract declarator other than pointers, is parsed
+ * again by the GLR parser. So are syntax errors, which it reports.
+ *
+ * Errors and critical errors fail the translation unit rather than end the
+ * process, see error_recovery. The tree, preprocessor and typedef names are
+ * left to be freed as after a success.
+ *
+ * @return 0 on success, like yyparse().
+ */
+int parse_translation_unit(void);
+
+/**
+ * @return Counters for the last parse_translation_unit().
+ */
+ParseStats get_parse_stats(void);
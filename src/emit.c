@@ -1,9 +1,9 @@
 #include "emit.h"
 
+#include "assign.h"
 #include "common.h"
 #include "log.h"
 #include "tree.h"
-#include "utils.h"
 
 #include <errno.h>
 #include <stdio.h>
@@ -21,8 +21,8 @@
   } while (0)
 
 struct GenLabel {
-  char name[64];
   struct GenLabel *next;
+  char name[];
 };
 
 InstructionList *emit_statement(struct statement *stmt);
@@ -39,21 +39,26 @@ InstructionList *emit_rval_expression(struct expression *expr);
  */
 InstructionList *emit_expression(struct expression *expr);
 
-struct GenLabel *gen_label_list = NULL;
+_Thread_local struct GenLabel *gen_label_list = NULL;
+_Thread_local uint64_t label_counter = 0;
 
-const char *generate_label(const char *prefix) {
-  const char *label_prefix = (prefix != NULL) ? prefix : "L";
-  static uint64_t label_counter = 0;
-  struct GenLabel *new_label = malloc(sizeof(struct GenLabel));
+struct GenLabel *alloc_label(size_t size) {
+  struct GenLabel *new_label = malloc(sizeof(struct GenLabel) + size);
   if (new_label == NULL) {
     CRITICAL("emit", "Out of memory!");
   }
 
-  snprintf(new_label->name, sizeof(new_label->name), ".%s_%lu", label_prefix,
-           label_counter++);
-
   new_label->next = gen_label_list;
   gen_label_list = new_label;
+  return new_label;
+}
+
+const char *generate_label(const char *prefix) {
+  const char *label_prefix = (prefix != NULL) ? prefix : "L";
+  struct GenLabel *new_label = alloc_label(64);
+
+  snprintf(new_label->name, 64, ".%s_%lu", label_prefix, label_counter++);
+
   return new_label->name;
 }
 
@@ -65,6 +70,7 @@ void free_generated_labels(void) {
     cur = next;
   }
   gen_label_list = NULL;
+  label_counter = 0;
 }
 
 InstructionList *emit_control_flow(struct expression *condition, bool eval,
@@ -97,7 +103,9 @@ void emit_token_specifier(struct specifier *specifier) {
   // specifier->_token
 }
 
-void emit_id_specifier(struct specifier *specifier) { emit_id(specifier->_id); }
+void emit_id_specifier(struct specifier *specifier) {
+  emit_id(id_at(specifier->_id));
+}
 
 void emit_specifier(struct specifier *specifier) {
   switch (specifier->type) {
@@ -113,41 +121,41 @@ void emit_specifier(struct specifier *specifier) {
 }
 
 void emit_specifier_list(struct specifier_list *list) {
-  for (struct specifier *cur = list->head; cur != NULL; cur = cur->next) {
-    emit_specifier(cur);
+  for (spec_ref cur = list->head; cur != NO_NODE; cur = spec_at(cur)->next) {
+    emit_specifier(spec_at(cur));
   }
 }
 
 void emit_initialized_declarator(struct initialized_declarator *decl) {
-  emit_id(decl->declarator);
+  emit_id(id_at(decl->declarator));
 
   if (decl->initializer)
-    emit_expression(decl->initializer);
+    emit_expression(expr_at(decl->initializer));
 }
 
 void emit_init_declarator_list(struct init_declarator_list *list) {
   if (list == NULL)
     return;
 
-  for (struct initialized_declarator *cur = list->head; cur != NULL;
-       cur = cur->next) {
-    emit_initialized_declarator(cur);
+  for (init_decl_ref cur = list->head; cur != NO_NODE;
+       cur = init_decl_at(cur)->next) {
+    emit_initialized_declarator(init_decl_at(cur));
   }
 }
 
 InstructionList *emit_declaration_list(struct declaration_list *list) {
   InstructionList *insns = create_instruction_list();
 
-  for (struct declaration *cur = list->head; cur != NULL; cur = cur->next) {
-    APPEND_LIST(insns, emit_declaration(cur));
+  for (decl_ref cur = list->head; cur != NO_NODE; cur = decl_at(cur)->next) {
+    APPEND_LIST(insns, emit_declaration(decl_at(cur)));
   }
 
   return insns;
 }
 
 void emit_variable_definition(struct declaration *decl) {
-  emit_specifier_list(decl->_var.specifiers);
-  emit_init_declarator_list(decl->_var.init_declarator_list);
+  emit_specifier_list(spec_list_at(decl->_var.specifiers));
+  emit_init_declarator_list(init_decl_list_at(decl->_var.init_declarator_list));
 }
 
 InstructionList *emit_function(struct declaration *decl) {
@@ -155,8 +163,9 @@ InstructionList *emit_function(struct declaration *decl) {
 
   // Emit function label
   if (decl->_func.name) {
-    append_instruction(insns, ILABEL, OP_LABEL(decl->_func.name->name->data),
-                       OP_NONE, OP_NONE);
+    // Interned spellings are NUL-terminated and outlive the IR.
+    const char *label = interned_text(id_at(decl->_func.name)->name.interned);
+    append_instruction(insns, ILABEL, OP_LABEL(label), OP_NONE, OP_NONE);
   } else {
     CRITICAL("emit", "Function declaration without a name");
   }
@@ -165,7 +174,7 @@ InstructionList *emit_function(struct declaration *decl) {
 
   // Emit function body
   if (decl->_func.body) {
-    APPEND_LIST(insns, emit_statement(decl->_func.body));
+    APPEND_LIST(insns, emit_statement(stmt_at(decl->_func.body)));
   } else {
     // empty function body
     // This is a no-op, but we still need to emit an instruction to return for
@@ -179,8 +188,8 @@ InstructionList *emit_function(struct declaration *decl) {
 }
 
 void emit_type_definition(struct declaration *decl) {
-  emit_specifier_list(decl->_type_def.specifiers);
-  emit_id(decl->_type_def.name);
+  emit_specifier_list(spec_list_at(decl->_type_def.specifiers));
+  emit_id(id_at(decl->_type_def.name));
 }
 
 InstructionList *emit_declaration(struct declaration *decl) {
@@ -208,63 +217,68 @@ InstructionList *emit_statement_list(struct statement_list *list) {
   if (list == NULL)
     return insns;
 
-  for (struct statement *child = list->head; child != NULL;
-       child = child->next) {
-    APPEND_LIST(insns, emit_statement(child));
+  for (stmt_ref child = list->head; child != NO_NODE;
+       child = stmt_at(child)->next) {
+    APPEND_LIST(insns, emit_statement(stmt_at(child)));
   }
 
   return insns;
 }
 
 InstructionList *emit_compound_stmt(struct statement *stmt) {
-  return emit_statement_list(stmt->_compound.statements);
+  return emit_statement_list(stmt_list_at(stmt->_compound.statements));
 }
 
 void emit_continue_stmt(struct statement *stmt) { UNUSED(stmt); }
 
-void emit_decl_stmt(struct statement *stmt) { emit_declaration(stmt->_decl); }
+void emit_decl_stmt(struct statement *stmt) {
+  emit_declaration(decl_at(stmt->_decl));
+}
 
-void emit_expr_stmt(struct statement *stmt) { emit_expression(stmt->_expr); }
+void emit_expr_stmt(struct statement *stmt) {
+  emit_expression(expr_at(stmt->_expr));
+}
 
 void emit_for_stmt(struct statement *stmt) {
   if (stmt->_for.decl) {
-    emit_declaration(stmt->_for.decl);
+    emit_declaration(decl_at(stmt->_for.decl));
   }
 
   if (stmt->_for.preloop_expression) {
-    emit_expression(stmt->_for.preloop_expression);
+    emit_expression(expr_at(stmt->_for.preloop_expression));
   }
 
   if (stmt->_for.condition) {
-    emit_rval_expression(stmt->_for.condition);
+    emit_rval_expression(expr_at(stmt->_for.condition));
   }
 
   if (stmt->_for.step_expression) {
-    emit_expression(stmt->_for.step_expression);
+    emit_expression(expr_at(stmt->_for.step_expression));
   }
 
   if (stmt->_for.body) {
-    emit_statement(stmt->_for.body);
+    emit_statement(stmt_at(stmt->_for.body));
   }
 }
 
-void emit_goto_stmt(struct statement *stmt) { emit_id(stmt->_goto); }
+void emit_goto_stmt(struct statement *stmt) { emit_id(id_at(stmt->_goto)); }
 
 InstructionList *emit_if_stmt(struct statement *stmt) {
   const char *label_else = generate_label("else");
   const char *label_end = generate_label("end_if");
 
-  bool has_else = stmt->_if.else_body != NULL;
+  bool has_else = stmt->_if.else_body != NO_NODE;
 
-  InstructionList *insns = emit_control_flow(stmt->_if.condition, false,
-                                             has_else ? label_else : label_end);
+  InstructionList *insns =
+    emit_control_flow(expr_at(stmt->_if.condition), false,
+                      has_else ? label_else : label_end);
 
-  APPEND_LIST(insns, emit_statement(stmt->_if.body));
+  APPEND_LIST(insns, emit_statement(stmt_at(stmt->_if.body)));
 
   if (has_else) {
     append_instruction(insns, JUMP, OP_LABEL(label_end), OP_NONE, OP_NONE);
     append_instruction(insns, ILABEL, OP_LABEL(label_else), OP_NONE, OP_NONE);
-    APPEND_LIST(insns, emit_statement(stmt->_if.else_body));
+    APPEND_LIST(insns, emit_statement(stmt_at(stmt->_if.else_body)));
   }
 
   append_instruction(insns, ILABEL, OP_LABEL(label_end), OP_NONE, OP_NONE);
@@ -272,13 +286,15 @@ InstructionList *emit_if_stmt(struct statement *stmt) {
   return insns;
 }
 
-void emit_label_stmt(struct statement *stmt) { emit_id(stmt->_label.name); }
+void emit_label_stmt(struct statement *stmt) {
+  emit_id(id_at(stmt->_label.name));
+}
 
 InstructionList *emit_return_stmt(struct statement *stmt) {
   InstructionList *insns = create_instruction_list();
 
   if (stmt->_return.ret_expr) {
-    APPEND_LIST(insns, emit_rval_expression(stmt->_return.ret_expr));
+    APPEND_LIST(insns, emit_rval_expression(expr_at(stmt->_return.ret_expr)));
   }
 
   append_instruction(insns, IRETURN, OP_NONE, OP_NONE, OP_NONE);
@@ -287,17 +303,17 @@ InstructionList *emit_return_stmt(struct statement *stmt) {
 
 void emit_switch_stmt(struct statement *stmt) {
   if (stmt->_switch.condition) {
-    emit_rval_expression(stmt->_switch.condition);
+    emit_rval_expression(expr_at(stmt->_switch.condition));
   }
 
   if (stmt->_switch.body) {
-    emit_statement(stmt->_switch.body);
+    emit_statement(stmt_at(stmt->_switch.body));
   }
 }
 
 void emit_switch_label_stmt(struct statement *stmt) {
   if (stmt->_switch_label.test) {
-    emit_expression(stmt->_switch_label.test);
+    emit_expression(expr_at(stmt->_switch_label.test));
   }
 }
 
@@ -305,11 +321,11 @@ void emit_while_stmt(struct statement *stmt) {
   // stmt->_while.should_check_condition_first
 
   if (stmt->_while.condition) {
-    emit_rval_expression(stmt->_while.condition);
+    emit_rval_expression(expr_at(stmt->_while.condition));
   }
 
   if (stmt->_while.body) {
-    emit_statement(stmt->_while.body);
+    emit_statement(stmt_at(stmt->_while.body));
   }
 }
 
@@ -363,139 +379,164 @@ void emit_rval_expression_list(struct expression_list *list);
 
 InstructionList *emit_rval_constant_expr(struct expression *expr) {
   InstructionList *insns = create_instruction_list();
-  Constant value = eval_token(expr->_constant);
+  Constant value = token_at(expr->_constant)->constant;
 
-  append_instruction(insns, LOAD_CONST, OP_REG(expr->reg), OP_CONST(value.bits),
-                     OP_NONE);
+  append_instruction(insns, LOAD_CONST, OP_REG(get_reg(expr)),
+                     OP_CONST(value.bits), OP_NONE);
 
   return insns;
 }
 
-void emit_rval_id_expression(struct expression *expr) { emit_id(expr->_id); }
+void emit_rval_id_expression(struct expression *expr) {
+  emit_id(id_at(expr->_id));
+}
 
 void emit_rval_index_expression(struct expression *expr) {
   if (expr->_index.object) {
-    emit_rval_expression(expr->_index.object);
+    emit_rval_expression(expr_at(expr->_index.object));
   }
 
   if (expr->_index.index) {
-    emit_rval_expression(expr->_index.index);
+    emit_rval_expression(expr_at(expr->_index.index));
   }
 }
 
 void emit_rval_func_call(struct expression *expr) {
   if (expr->_call.function_ptr) {
-    emit_rval_expression(expr->_call.function_ptr);
+    emit_rval_expression(expr_at(expr->_call.function_ptr));
   }
 
   if (expr->_call.parameter_list) {
-    emit_rval_expression_list(expr->_call.parameter_list);
+    emit_rval_expression_list(expr_list_at(expr->_call.parameter_list));
   }
 }
 
 void emit_rval_postfix_expr(struct expression *expr) {
   if (expr->_unary.base) {
-    emit_rval_expression(expr->_unary.base);
+    emit_rval_expression(expr_at(expr->_unary.base));
   }
 
   // expr->_unary.operator
 }
 
 InstructionList *emit_rval_unary_expr(struct expression *expr) {
-  InstructionList *insns = emit_rval_expression(expr->_unary.base);
+  InstructionList *insns = emit_rval_expression(expr_at(expr->_unary.base));
 
+  const Token *operator = token_at(expr->_unary.operator);
   enum InstructionSet opcode = 0;
   Operand operand_second = OP_NONE;
 
-  if (strcmp(expr->_unary.operator->data, "!") == 0) {
+  switch (operator->code) {
+  case PU_BANG:
     opcode = LOGICAL_NOT;
-  } else if (strcmp(expr->_unary.operator->data, "~") == 0) {
+    break;
+  case PU_TILDE:
     opcode = BITWISE_NOT;
-  } else if (strcmp(expr->_unary.operator->data, "-") == 0) {
+    break;
+  case PU_MINUS:
     // FIXME: could be better. bitwise not and add 1.
     opcode = MULTIPLY;
     operand_second = OP_CONST(-1);
-  } else if (strcmp(expr->_unary.operator->data, "+") == 0) {
+    break;
+  case PU_PLUS:
     return insns;
-  } else {
-    CRITICALV("emit", "Unknown unary operator: %s",
-              expr->_unary.operator->data);
+  default:
+    CRITICALV("emit", "Unknown unary operator: %.*s", (int)operator->length,
+              operator->data);
   }
 
-  append_instruction(insns, opcode, OP_REG(expr->reg),
-                     OP_REG(expr->_unary.base->reg), operand_second);
+  append_instruction(insns, opcode, OP_REG(get_reg(expr)),
+                     OP_REG(get_reg(expr_at(expr->_unary.base))),
+                     operand_second);
   return insns;
 }
 
 void emit_rval_cast_expr(struct expression *expr) {
   if (expr->_cast.type) {
-    emit_specifier_list(expr->_cast.type);
+    emit_specifier_list(spec_list_at(expr->_cast.type));
   }
 
   if (expr->_cast.base) {
-    emit_rval_expression(expr->_cast.base);
+    emit_rval_expression(expr_at(expr->_cast.base));
   }
 }
 
 InstructionList *emit_rval_binary_expr(struct expression *expr) {
+  struct expression *left = expr_at(expr->_binary.left);
+  struct expression *right = expr_at(expr->_binary.right);
   struct expression *first =
-    expr->_binary.left->reg_count > expr->_binary.right->reg_count
-      ? expr->_binary.left
-      : expr->_binary.right;
+    get_reg_count(left) > get_reg_count(right) ? left : right;
   struct expression *second =
-    expr->_binary.left->reg_count > expr->_binary.right->reg_count
-      ? expr->_binary.right
-      : expr->_binary.left;
+    get_reg_count(left) > get_reg_count(right) ? right : left;
 
   InstructionList *insns = emit_rval_expression(first);
   APPEND_LIST(insns, emit_rval_expression(second));
 
+  const Token *operator = token_at(expr->_binary.operator);
   enum InstructionSet opcode = 0;
 
-  if (strcmp(expr->_binary.operator->data, "||") == 0) {
+  switch (operator->code) {
+  case PU_LOR:
     opcode = LOGICAL_OR;
-  } else if (strcmp(expr->_binary.operator->data, "&&") == 0) {
+    break;
+  case PU_LAND:
     opcode = LOGICAL_AND;
-  } else if (strcmp(expr->_binary.operator->data, "|") == 0) {
+    break;
+  case PU_PIPE:
     opcode = BITWISE_OR;
-  } else if (strcmp(expr->_binary.operator->data, "^") == 0) {
+    break;
+  case PU_CARET:
     opcode = BITWISE_XOR;
-  } else if (strcmp(expr->_binary.operator->data, "&") == 0) {
+    break;
+  case PU_AMP:
     opcode = BITWISE_AND;
-  } else if (strcmp(expr->_binary.operator->data, "==") == 0) {
+    break;
+  case PU_EE:
     opcode = EQUAL;
-  } else if (strcmp(expr->_binary.operator->data, "!=") == 0) {
+    break;
+  case PU_NE:
     opcode = NOT_EQUAL;
-  } else if (strcmp(expr->_binary.operator->data, ">=") == 0) {
+    break;
+  case PU_GTE:
     opcode = GREATER_EQUAL;
-  } else if (strcmp(expr->_binary.operator->data, "<=") == 0) {
+    break;
+  case PU_LTE:
     opcode = LESS_EQUAL;
-  } else if (strcmp(expr->_binary.operator->data, ">") == 0) {
+    break;
+  case PU_GT:
     opcode = GREATER_THAN;
-  } else if (strcmp(expr->_binary.operator->data, "<") == 0) {
+    break;
+  case PU_LT:
     opcode = LESS_THAN;
-  } else if (strcmp(expr->_binary.operator->data, ">>") == 0) {
+    break;
+  case PU_SHFR:
     opcode = RIGHT_SHIFT;
-  } else if (strcmp(expr->_binary.operator->data, "<<") == 0) {
+    break;
+  case PU_SHFL:
     opcode = LEFT_SHIFT;
-  } else if (strcmp(expr->_binary.operator->data, "-") == 0) {
+    break;
+  case PU_MINUS:
     opcode = SUBTRACT;
-  } else if (strcmp(expr->_binary.operator->data, "+") == 0) {
+    break;
+  case PU_PLUS:
     opcode = ADD;
-  } else if (strcmp(expr->_binary.operator->data, "%") == 0) {
+    break;
+  case PU_PERCENT:
     opcode = MODULO;
-  } else if (strcmp(expr->_binary.operator->data, "/") == 0) {
+    break;
+  case PU_SLASH:
     opcode = DIVIDE;
-  } else if (strcmp(expr->_binary.operator->data, "*") == 0) {
+    break;
+  case PU_STAR:
     opcode = MULTIPLY;
-  } else {
-    CRITICALV("emit", "Unknown binary operator: %s",
-              expr->_binary.operator->data);
+    break;
+  default:
+    CRITICALV("emit", "Unknown binary operator: %.*s", (int)operator->length,
+              operator->data);
   }
 
-  append_instruction(insns, opcode, OP_REG(expr->reg),
-                     OP_REG(expr->_binary.left->reg),
-                     OP_REG(expr->_binary.right->reg));
+  append_instruction(insns, opcode, OP_REG(get_reg(expr)),
+                     OP_REG(get_reg(left)), OP_REG(get_reg(right)));
 
   return insns;
 }
@@ -505,12 +546,13 @@ InstructionList *emit_rval_ternary_expr(struct expression *expr) {
   const char *end_label = generate_label("ternary_end");
 
   InstructionList *insns =
-    emit_control_flow(expr->_ternary.condition, false, false_label);
+    emit_control_flow(expr_at(expr->_ternary.condition), false, false_label);
 
-  APPEND_LIST(insns, emit_rval_expression(expr->_ternary.true_branch));
+  APPEND_LIST(insns, emit_rval_expression(expr_at(expr->_ternary.true_branch)));
   append_instruction(insns, JUMP, OP_LABEL(end_label), OP_NONE, OP_NONE);
   append_instruction(insns, ILABEL, OP_LABEL(false_label), OP_NONE, OP_NONE);
-  APPEND_LIST(insns, emit_rval_expression(expr->_ternary.false_branch));
+  APPEND_LIST(insns,
+              emit_rval_expression(expr_at(expr->_ternary.false_branch)));
   append_instruction(insns, ILABEL, OP_LABEL(end_label), OP_NONE, OP_NONE);
 
   return insns;
@@ -557,15 +599,15 @@ void emit_rval_expression_list(struct expression_list *list) {
     return;
   }
 
-  struct expression *cur = list->head;
+  expr_ref cur = list->head;
 
-  if (cur == NULL) {
+  if (cur == NO_NODE) {
     return;
   }
 
-  while (cur != NULL) {
-    emit_rval_expression(cur);
-    cur = cur->next;
+  while (cur != NO_NODE) {
+    emit_rval_expression(expr_at(cur));
+    cur = expr_at(cur)->next;
   }
 }
 
@@ -578,31 +620,33 @@ void emit_lval_constant_expr(struct expression *expr) {
   ERROR("emit", "L-value for constant expression is not supported");
 }
 
-void emit_lval_id_expression(struct expression *expr) { emit_id(expr->_id); }
+void emit_lval_id_expression(struct expression *expr) {
+  emit_id(id_at(expr->_id));
+}
 
 void emit_lval_index_expression(struct expression *expr) {
   if (expr->_index.object) {
-    emit_lval_expression(expr->_index.object);
+    emit_lval_expression(expr_at(expr->_index.object));
   }
 
   if (expr->_index.index) {
-    emit_lval_expression(expr->_index.index);
+    emit_lval_expression(expr_at(expr->_index.index));
   }
 }
 
 void emit_lval_func_call(struct expression *expr) {
   if (expr->_call.function_ptr) {
-    emit_lval_expression(expr->_call.function_ptr);
+    emit_lval_expression(expr_at(expr->_call.function_ptr));
   }
 
   if (expr->_call.parameter_list) {
-    emit_lval_expression_list(expr->_call.parameter_list);
+    emit_lval_expression_list(expr_list_at(expr->_call.parameter_list));
   }
 }
 
 void emit_lval_postfix_expr(struct expression *expr) {
   if (expr->_unary.base) {
-    emit_lval_expression(expr->_unary.base);
+    emit_lval_expression(expr_at(expr->_unary.base));
   }
 
   // expr->_unary.operator
@@ -612,43 +656,43 @@ void emit_lval_unary_expr(struct expression *expr) {
   // expr->_unary.operator
 
   if (expr->_unary.base) {
-    emit_lval_expression(expr->_unary.base);
+    emit_lval_expression(expr_at(expr->_unary.base));
   }
 }
 
 void emit_lval_cast_expr(struct expression *expr) {
   if (expr->_cast.type) {
-    emit_specifier_list(expr->_cast.type);
+    emit_specifier_list(spec_list_at(expr->_cast.type));
   }
 
   if (expr->_cast.base) {
-    emit_lval_expression(expr->_cast.base);
+    emit_lval_expression(expr_at(expr->_cast.base));
   }
 }
 
 void emit_lval_binary_expr(struct expression *expr) {
   if (expr->_binary.left) {
-    emit_lval_expression(expr->_binary.left);
+    emit_lval_expression(expr_at(expr->_binary.left));
   }
 
   // expr->_binary.operator
 
   if (expr->_binary.right) {
-    emit_lval_expression(expr->_binary.right);
+    emit_lval_expression(expr_at(expr->_binary.right));
   }
 }
 
 void emit_lval_ternary_expr(struct expression *expr) {
   if (expr->_ternary.condition) {
-    emit_lval_expression(expr->_ternary.condition);
+    emit_lval_expression(expr_at(expr->_ternary.condition));
   }
 
   if (expr->_ternary.true_branch) {
-    emit_lval_expression(expr->_ternary.true_branch);
+    emit_lval_expression(expr_at(expr->_ternary.true_branch));
   }
 
   if (expr->_ternary.false_branch) {
-    emit_lval_expression(expr->_ternary.false_branch);
+    emit_lval_expression(expr_at(expr->_ternary.false_branch));
   }
 }
 
@@ -697,15 +741,15 @@ void emit_lval_expression_list(struct expression_list *list) {
     return;
   }
 
-  struct expression *cur = list->head;
+  expr_ref cur = list->head;
 
-  if (cur == NULL) {
+  if (cur == NO_NODE) {
     return;
   }
 
-  while (cur != NULL) {
-    emit_lval_expression(cur);
-    cur = cur->next;
+  while (cur != NO_NODE) {
+    emit_lval_expression(expr_at(cur));
+    cur = expr_at(cur)->next;
   }
 }
 
@@ -0,0 +1,697 @@
+#include "float_conv.h"
+#include "pow5_table.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct float_format {
+  // Stored fraction bits, without the integer bit.
+  int mantissa_bits;
+  int bias;
+  // The x87 extended format stores its integer bit.
+  bool explicit_integer_bit;
+
+  // Eisel–Lemire applies when set, long double always takes the slow path.
+  bool fast_path;
+  // Powers of ten beyond which any 64-bit significand rounds to zero or
+  // infinity.
+  int smallest_power_of_ten;
+  int largest_power_of_ten;
+  // Powers of ten for which a product can land exactly halfway.
+  int min_exponent_round_to_even;
+  int max_exponent_round_to_even;
+  // Exact operands for the Clinger fast path.
+  uint64_t max_exact_mantissa;
+  int max_exact_power_of_ten;
+};
+
+const struct float_format float_format = {
+  23, 127, false, true, -65, 38, -17, 10, (uint64_t)1 << 24, 10,
+};
+
+const struct float_format double_format = {
+  52, 1023, false, true, -342, 308, -4, 23, (uint64_t)1 << 53, 22,
+};
+
+const struct float_format long_double_format = {
+  63, 16383, true, false, 0, 0, 0, 0, 0, 0,
+};
+
+// Decimal spelling reduced to w * 10^q, see parse_decimal().
+struct decimal_spelling {
+  uint64_t mantissa;
+  int64_t exponent;
+  // Nonzero digits were dropped past the 19 kept in the mantissa.
+  bool truncated;
+};
+
+// Exponents past this bound overflow or underflow every format anyway.
+#define EXPONENT_LIMIT 100000
+
+static inline bool is_digit_char(char c) { return '0' <= c && c <= '9'; }
+
+static inline unsigned hex_value(char c) {
+  if (is_digit_char(c)) {
+    return (unsigned)(c - '0');
+  }
+
+  return (unsigned)((c | 0x20) - 'a' + 10);
+}
+
+/**
+ * Parses the optional exponent part at `text[i]`.
+ *
+ * @return The exponent, clamped to +/- EXPONENT_LIMIT.
+ */
+int64_t parse_exponent(const char *text, size_t length, size_t i) {
+  if (i >= length) {
+    return 0;
+  }
+
+  // Skip the e, E, p or P.
+  i++;
+  bool negative = false;
+
+  if (i < length && (text[i] == '+' || text[i] == '-')) {
+    negative = text[i] == '-';
+    i++;
+  }
+
+  int64_t exponent = 0;
+
+  for (; i < length; i++) {
+    if (text[i] == '\'') {
+      continue;
+    }
+
+    if (exponent < EXPONENT_LIMIT) {
+      exponent = exponent * 10 + (text[i] - '0');
+    }
+  }
+
+  if (exponent > EXPONENT_LIMIT) {
+    exponent = EXPONENT_LIMIT;
+  }
+
+  return negative ? -exponent : exponent;
+}
+
+// Eight ASCII digits loaded little endian, checked and summed in parallel.
+static inline bool is_eight_digits(uint64_t chunk) {
+  return ((chunk & 0xf0f0f0f0f0f0f0f0) |
+          (((chunk + 0x0606060606060606) & 0xf0f0f0f0f0f0f0f0) >> 4)) ==
+         0x3333333333333333;
+}
+
+static inline uint32_t eight_digits_value(uint64_t chunk) {
+  chunk -= 0x3030303030303030;
+  chunk = (chunk * 10) + (chunk >> 8);
+  chunk = (((chunk & 0x000000ff000000ff) * 0x000f424000000064) +
+           (((chunk >> 16) & 0x000000ff000000ff) * 0x0000271000000001)) >>
+          32;
+  return (uint32_t)chunk;
+}
+
+struct decimal_spelling parse_decimal(const char *text, size_t length) {
+  struct decimal_spelling spelling = {0, 0, false};
+  int digits = 0;
+  bool after_point = false;
+  size_t i = 0;
+
+  for (; i < length && text[i] != 'e' && text[i] != 'E'; i++) {
+    if (text[i] == '\'') {
+      continue;
+    } else if (text[i] == '.') {
+      after_point = true;
+      continue;
+    }
+
+    uint64_t chunk;
+
+    // Long runs of significant digits go eight at a time.
+    if (digits != 0 && digits <= 11 && i + 8 <= length) {
+      memcpy(&chunk, &text[i], sizeof(chunk));
+
+      if (is_eight_digits(chunk)) {
+        spelling.mantissa =
+          spelling.mantissa * 100000000 + eight_digits_value(chunk);
+        spelling.exponent -= 8 * after_point;
+        digits += 8;
+        i += 7;
+        continue;
+      }
+    }
+
+    unsigned digit = (unsigned)(text[i] - '0');
+
+    if (digits == 0 && digit == 0) {
+      spelling.exponent -= after_point;
+    } else if (digits < 19) {
+      spelling.mantissa = spelling.mantissa * 10 + digit;
+      spelling.exponent -= after_point;
+      digits++;
+    } else {
+      spelling.truncated |= digit != 0;
+      spelling.exponent += !after_point;
+    }
+  }
+
+  spelling.exponent += parse_exponent(text, length, i);
+  return spelling;
+}
+
+/**
+ * Stores a rounded value in the layout of its format.
+ *
+ * @param significand The significand, integer bit included.
+ * @param biased The biased exponent, 0 for zero and subnormals.
+ */
+void encode(const struct float_format *format, uint64_t significand,
+            int64_t biased, Constant *constant) {
+  if (format->explicit_integer_bit) {
+    constant->bits = significand;
+    constant->exponent = (uint16_t)biased;
+  } else {
+    uint64_t fraction_mask = ((uint64_t)1 << format->mantissa_bits) - 1;
+    constant->bits =
+      (uint64_t)biased << format->mantissa_bits | (significand & fraction_mask);
+    constant->exponent = 0;
+  }
+}
+
+void encode_infinity(const struct float_format *format, Constant *constant) {
+  uint64_t significand = format->explicit_integer_bit ? (uint64_t)1 << 63 : 0;
+  encode(format, significand, 2 * (int64_t)format->bias + 1, constant);
+}
+
+typedef unsigned __int128 uint128_t;
+
+/**
+ * Rounds m * 2^(e - 127) to the format, ties to even.
+ *
+ * @param m The leading bits of the value, bit 127 set.
+ * @param e The exponent of bit 127.
+ * @param sticky Whether nonzero bits below `m` were dropped.
+ */
+void round_to_format(const struct float_format *format, uint128_t m, int64_t e,
+                     bool sticky, Constant *constant) {
+  int precision = format->mantissa_bits + 1;
+  int64_t min_exponent = 1 - format->bias;
+  int64_t drop = 128 - precision;
+
+  // Subnormals hold fewer bits.
+  if (e < min_exponent) {
+    drop += min_exponent - e;
+  }
+
+  uint64_t kept = 0;
+  bool half = false;
+  bool rest = true;
+
+  if (drop < 128) {
+    kept = (uint64_t)(m >> drop);
+    half = (m >> (drop - 1)) & 1;
+    rest = (m & (((uint128_t)1 << (drop - 1)) - 1)) != 0;
+  } else if (drop == 128) {
+    half = true;
+    rest = (m << 1) != 0;
+  }
+
+  if (half && (rest || sticky || (kept & 1))) {
+    kept++;
+
+    // Carried out of the precision, which wraps for 64-bit significands.
+    if (kept == 0 || (precision < 64 && kept >> precision)) {
+      kept = (uint64_t)1 << (precision - 1);
+      e++;
+    }
+  }
+
+  if (e < min_exponent) {
+    // Rounding may carry a subnormal into the smallest normal.
+    encode(format, kept, (int64_t)(kept >> (precision - 1)), constant);
+  } else if (e > format->bias) {
+    encode_infinity(format, constant);
+  } else {
+    encode(format, kept, e + format->bias, constant);
+  }
+}
+
+// Slow path, exact decimal arithmetic on the digits.
+
+// Holds the longest exact halfway point between two long double values,
+// around 11,500 significant digits for the smallest subnormals.
+#define DECIMAL_CAPACITY 11600
+
+// Largest shift without overflowing 9 << shift in 64 bits.
+#define MAX_SHIFT 60
+
+// Digits of 2^MAX_SHIFT, the most a left shift can add.
+#define MAX_SHIFT_DIGITS 19
+
+// The value is 0.digits * 10^point.
+struct decimal {
+  int count;
+  int64_t point;
+  // Nonzero digits were dropped past the capacity.
+  bool truncated;
+  uint8_t digits[DECIMAL_CAPACITY + MAX_SHIFT_DIGITS];
+};
+
+void trim_decimal(struct decimal *decimal) {
+  while (decimal->count > 0 && decimal->digits[decimal->count - 1] == 0) {
+    decimal->count--;
+  }
+
+  if (decimal->count == 0) {
+    decimal->point = 0;
+  }
+}
+
+void parse_big_decimal(const char *text, size_t length,
+                       struct decimal *decimal) {
+  bool after_point = false;
+  size_t i = 0;
+
+  decimal->count = 0;
+  decimal->point = 0;
+  decimal->truncated = false;
+
+  for (; i < length && text[i] != 'e' && text[i] != 'E'; i++) {
+    if (text[i] == '\'') {
+      continue;
+    } else if (text[i] == '.') {
+      after_point = true;
+      continue;
+    }
+
+    uint8_t digit = (uint8_t)(text[i] - '0');
+
+    if (decimal->count == 0 && digit == 0) {
+      decimal->point -= after_point;
+      continue;
+    }
+
+    decimal->point += !after_point;
+
+    if (decimal->count < DECIMAL_CAPACITY) {
+      decimal->digits[decimal->count++] = digit;
+    } else {
+      decimal->truncated |= digit != 0;
+    }
+  }
+
+  decimal->point += parse_exponent(text, length, i);
+  trim_decimal(decimal);
+}
+
+// Divides by 2^shift, shift <= MAX_SHIFT.
+void right_shift(struct decimal *decimal, unsigned shift) {
+  int read = 0;
+  int write = 0;
+  uint64_t n = 0;
+
+  // Pick up enough leading digits to cover the first shift.
+  for (; (n >> shift) == 0; read++) {
+    if (read >= decimal->count) {
+      if (n == 0) {
+        decimal->count = 0;
+        return;
+      }
+
+      while ((n >> shift) == 0) {
+        n *= 10;
+        read++;
+      }
+
+      break;
+    }
+
+    n = n * 10 + decimal->digits[read];
+  }
+
+  decimal->point -= read - 1;
+
+  uint64_t mask = ((uint64_t)1 << shift) - 1;
+
+  for (; read < decimal->count; read++) {
+    uint64_t digit = n >> shift;
+    n &= mask;
+    decimal->digits[write++] = (uint8_t)digit;
+    n = n * 10 + decimal->digits[read];
+  }
+
+  while (n > 0) {
+    uint64_t digit = n >> shift;
+    n &= mask;
+
+    if (write < DECIMAL_CAPACITY) {
+      decimal->digits[write++] = (uint8_t)digit;
+    } else {
+      decimal->truncated |= digit != 0;
+    }
+
+    n *= 10;
+  }
+
+  decimal->count = write;
+  trim_decimal(decimal);
+}
+
+// Multiplies by 2^shift, shift <= MAX_SHIFT.
+void left_shift(struct decimal *decimal, unsigned shift) {
+  // Written back to front with room for the new leading digits.
+  int write = decimal->count + MAX_SHIFT_DIGITS;
+  uint64_t n = 0;
+
+  for (int read = decimal->count - 1; read >= 0; read--) {
+    n += (uint64_t)decimal->digits[read] << shift;
+    uint64_t quotient = n / 10;
+    decimal->digits[--write] = (uint8_t)(n - 10 * quotient);
+    n = quotient;
+  }
+
+  while (n > 0) {
+    uint64_t quotient = n / 10;
+    decimal->digits[--write] = (uint8_t)(n - 10 * quotient);
+    n = quotient;
+  }
+
+  int count = decimal->count + MAX_SHIFT_DIGITS - write;
+  memmove(decimal->digits, &decimal->digits[write], (size_t)count);
+  decimal->point += count - decimal->count;
+
+  for (int i = DECIMAL_CAPACITY; i < count; i++) {
+    decimal->truncated |= decimal->digits[i] != 0;
+  }
+
+  decimal->count = count < DECIMAL_CAPACITY ? count : DECIMAL_CAPACITY;
+  trim_decimal(decimal);
+}
+
+void shift_decimal(struct decimal *decimal, int shift) {
+  while (shift > 0) {
+    unsigned step = shift < MAX_SHIFT ? (unsigned)shift : MAX_SHIFT;
+    left_shift(decimal, step);
+    shift -= (int)step;
+  }
+
+  while (shift < 0) {
+    unsigned step = -shift < MAX_SHIFT ? (unsigned)-shift : MAX_SHIFT;
+    right_shift(decimal, step);
+    shift += (int)step;
+  }
+}
+
+// Past these any format is zero or infinity, long double reaches ~1e4932
+// and ~4e-4951.
+#define DECIMAL_POINT_MAX 4934
+#define DECIMAL_POINT_MIN (-4952)
+
+void convert_big_decimal(const struct float_format *format, const char *text,
+                         size_t length, Constant *constant) {
+  struct decimal decimal;
+  parse_big_decimal(text, length, &decimal);
+
+  if (decimal.count == 0 || decimal.point < DECIMAL_POINT_MIN) {
+    encode(format, 0, 0, constant);
+    return;
+  } else if (decimal.point > DECIMAL_POINT_MAX) {
+    encode_infinity(format, constant);
+    return;
+  }
+
+  // Scale into [1/2, 1), powers of two that move the point by 0-8 digits.
+  static const int power_table[] = {1, 3, 6, 9, 13, 16, 19, 23, 26};
+  int64_t exponent = 0;
+
+  while (decimal.point > 0) {
+    int shift = decimal.point >= 9 ? 27 : power_table[decimal.point];
+    shift_decimal(&decimal, -shift);
+    exponent += shift;
+  }
+
+  while (decimal.point < 0 ||
+         (decimal.point == 0 && decimal.digits[0] < 5)) {
+    int shift = -decimal.point >= 9 ? 27 : power_table[-decimal.point];
+    shift_decimal(&decimal, shift);
+    exponent -= shift;
+  }
+
+  // The integer part now holds the 128 leading bits.
+  shift_decimal(&decimal, 128);
+
+  uint128_t m = 0;
+
+  for (int i = 0; i < decimal.point; i++) {
+    m = m * 10 + (i < decimal.count ? decimal.digits[i] : 0);
+  }
+
+  bool sticky = decimal.truncated || decimal.count > decimal.point;
+  round_to_format(format, m, exponent - 1, sticky, constant);
+}
+
+// Fast path, Eisel–Lemire over a 128-bit power of five.
+
+struct adjusted_mantissa {
+  uint64_t mantissa;
+  int32_t power2;
+};
+
+struct value128 {
+  uint64_t low;
+  uint64_t high;
+};
+
+static inline struct value128 full_multiplication(uint64_t a, uint64_t b) {
+  uint128_t product = (uint128_t)a * b;
+  return (struct value128){(uint64_t)product, (uint64_t)(product >> 64)};
+}
+
+// floor(log2(10^q)) + 63, exact for |q| < 1700.
+static inline int32_t binary_power(int32_t q) {
+  return (((152170 + 65536) * q) >> 16) + 63;
+}
+
+struct value128 product_approximation(int64_t q, uint64_t w, int precision) {
+  const uint64_t *power = pow5_table[q - POW5_SMALLEST_POWER];
+  uint64_t precision_mask = UINT64_MAX >> precision;
+  struct value128 first = full_multiplication(w, power[0]);
+
+  // Only the next word can change the bits that matter.
+  if ((first.high & precision_mask) == precision_mask) {
+    struct value128 second = full_multiplication(w, power[1]);
+    first.low += second.high;
+
+    if (second.high > first.low) {
+      first.high++;
+    }
+  }
+
+  return first;
+}
+
+/**
+ * Rounds w * 10^q to the format. The 128-bit product always decides the
+ * result for 19-digit mantissas (Mushtak and Lemire, 2023).
+ *
+ * @return The stored fraction and biased exponent.
+ */
+struct adjusted_mantissa compute_float(const struct float_format *format,
+                                       int64_t q, uint64_t w) {
+  struct adjusted_mantissa answer = {0, 0};
+  int32_t infinite_power = 2 * format->bias + 1;
+  int mantissa_bits = format->mantissa_bits;
+
+  if (w == 0 || q < format->smallest_power_of_ten) {
+    return answer;
+  } else if (q > format->largest_power_of_ten) {
+    answer.power2 = infinite_power;
+    return answer;
+  }
+
+  int leading_zeros = __builtin_clzll(w);
+  w <<= leading_zeros;
+
+  struct value128 product = product_approximation(q, w, mantissa_bits + 3);
+  int upper_bit = (int)(product.high >> 63);
+  int shift = upper_bit + 64 - mantissa_bits - 3;
+
+  answer.mantissa = product.high >> shift;
+  answer.power2 = binary_power((int32_t)q) + upper_bit - leading_zeros +
+                  format->bias;
+
+  if (answer.power2 <= 0) {
+    // Subnormal, or zero once shifted out.
+    if (-answer.power2 + 1 >= 64) {
+      answer.mantissa = 0;
+      answer.power2 = 0;
+      return answer;
+    }
+
+    answer.mantissa >>= -answer.power2 + 1;
+    answer.mantissa += answer.mantissa & 1;
+    answer.mantissa >>= 1;
+    answer.power2 = answer.mantissa < (uint64_t)1 << mantissa_bits ? 0 : 1;
+    return answer;
+  }
+
+  // An exact product halfway between two values rounds to even.
+  if (product.low <= 1 && q >= format->min_exponent_round_to_even &&
+      q <= format->max_exponent_round_to_even &&
+      (answer.mantissa & 3) == 1 &&
+      (answer.mantissa << shift) == product.high) {
+    answer.mantissa &= ~(uint64_t)1;
+  }
+
+  answer.mantissa += answer.mantissa & 1;
+  answer.mantissa >>= 1;
+
+  if (answer.mantissa >= (uint64_t)2 << mantissa_bits) {
+    answer.mantissa = (uint64_t)1 << mantissa_bits;
+    answer.power2++;
+  }
+
+  answer.mantissa &= ~((uint64_t)1 << mantissa_bits);
+
+  if (answer.power2 >= infinite_power) {
+    answer.mantissa = 0;
+    answer.power2 = infinite_power;
+  }
+
+  return answer;
+}
+
+static const double exact_powers_of_ten[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/**
+ * Clinger's fast path, one correctly rounded host operation on exact
+ * operands.
+ *
+ * @return false if the operands are not exact in the format.
+ */
+bool convert_exact(const struct float_format *format,
+                   struct decimal_spelling spelling, Constant *constant) {
+  if (spelling.truncated || spelling.mantissa > format->max_exact_mantissa ||
+      spelling.exponent < -format->max_exact_power_of_ten ||
+      spelling.exponent > format->max_exact_power_of_ten) {
+    return false;
+  }
+
+  if (format == &float_format) {
+    float value = (float)spelling.mantissa;
+    float power = (float)exact_powers_of_ten[llabs(spelling.exponent)];
+    value = spelling.exponent < 0 ? value / power : value * power;
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    constant->bits = bits;
+  } else {
+    double value = (double)spelling.mantissa;
+    double power = exact_powers_of_ten[llabs(spelling.exponent)];
+    value = spelling.exponent < 0 ? value / power : value * power;
+
+    memcpy(&constant->bits, &value, sizeof(constant->bits));
+  }
+
+  constant->exponent = 0;
+  return true;
+}
+
+void convert_decimal(const struct float_format *format, const char *text,
+                     size_t length, Constant *constant) {
+  if (format->fast_path) {
+    struct decimal_spelling spelling = parse_decimal(text, length);
+
+    if (convert_exact(format, spelling, constant)) {
+      return;
+    }
+
+    struct adjusted_mantissa answer =
+      compute_float(format, spelling.exponent, spelling.mantissa);
+
+    // Dropped digits put the value between w and w + 1, settled if both
+    // round the same way.
+    if (spelling.truncated) {
+      struct adjusted_mantissa above =
+        compute_float(format, spelling.exponent, spelling.mantissa + 1);
+
+      if (above.mantissa != answer.mantissa || above.power2 != answer.power2) {
+        convert_big_decimal(format, text, length, constant);
+        return;
+      }
+    }
+
+    constant->bits =
+      (uint64_t)answer.power2 << format->mantissa_bits | answer.mantissa;
+    constant->exponent = 0;
+    return;
+  }
+
+  convert_big_decimal(format, text, length, constant);
+}
+
+// Hexadecimal constants are exact in binary, they only need rounding once.
+void convert_hex(const struct float_format *format, const char *text,
+                 size_t length, Constant *constant) {
+  uint128_t m = 0;
+  int64_t exponent = 0;
+  bool sticky = false;
+  bool after_point = false;
+  size_t i = 2;
+
+  for (; i < length && text[i] != 'p' && text[i] != 'P'; i++) {
+    if (text[i] == '\'') {
+      continue;
+    } else if (text[i] == '.') {
+      after_point = true;
+      continue;
+    }
+
+    unsigned digit = hex_value(text[i]);
+
+    if (m == 0 && digit == 0) {
+      exponent -= 4 * after_point;
+    } else if ((m >> 124) == 0) {
+      m = m << 4 | digit;
+      exponent -= 4 * after_point;
+    } else {
+      sticky |= digit != 0;
+      exponent += 4 * !after_point;
+    }
+  }
+
+  exponent += parse_exponent(text, length, i);
+
+  if (m == 0) {
+    encode(format, 0, 0, constant);
+    return;
+  }
+
+  uint64_t high = (uint64_t)(m >> 64);
+  int leading_zeros =
+    high ? __builtin_clzll(high) : 64 + __builtin_clzll((uint64_t)m);
+  round_to_format(format, m << leading_zeros, exponent + 127 - leading_zeros,
+                  sticky, constant);
+}
+
+void convert_float(const char *text, size_t length, Constant *constant) {
+  const struct float_format *format = &double_format;
+
+  if (constant->type == CT_FLOAT) {
+    format = &float_format;
+  } else if (constant->type == CT_LONG_DOUBLE) {
+    format = &long_double_format;
+  }
+
+  if (length > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+    convert_hex(format, text, length, constant);
+  } else {
+    convert_decimal(format, text, length, constant);
+  }
+}
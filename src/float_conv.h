@@ -0,0 +1,17 @@
+#pragma once
+
+#include "scanner.h"
+
+#include <stddef.h>
+
+/**
+ * Converts the spelling of a floating constant to the nearest value of its
+ * type, rounding ties to even. Decimal and hexadecimal spellings are both
+ * exact, and the current locale is never consulted.
+ *
+ * @param text The spelling without its suffix, digit separators allowed.
+ * @param length The length of the spelling.
+ * @param constant Its type picks the format, CT_FLOAT, CT_DOUBLE or
+ * CT_LONG_DOUBLE. Its bits, and exponent for long double, receive the value.
+ */
+void convert_float(const char *text, size_t length, Constant *constant);
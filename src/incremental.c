@@ -0,0 +1,827 @@
+#include "incremental.h"
+#include "descent.h"
+#include "log.h"
+#include "parser.h"
+#include "preprocess.h"
+#include "scanner.h"
+#include "source.h"
+#include "tree.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_TEXT_CAPACITY 4096
+#define INITIAL_LIST_CAPACITY 64
+
+// The tokens of one external declaration of the main file, found by
+// ends_declaration() before it is parsed.
+struct segment {
+  // Tokens [first, end) of the main file.
+  size_t first;
+  size_t end;
+
+  // What they parsed to, in order.
+  decl_ref head;
+  decl_ref tail;
+
+  // Every typedef name registered before them.
+  struct type_alias *aliases;
+};
+
+// Replacing the segments of the previous source, see reparse_source().
+struct merge {
+  const Edit *edits;
+  size_t edit_count;
+
+  Token *old_tokens;
+  struct segment *old_segments;
+  size_t old_count;
+
+  // The newest typedef name of the previous source, kept up to date as
+  // segments are replaced.
+  struct type_alias *aliases;
+
+  // Directives are allowed until the first declaration starts.
+  bool allow_directives;
+
+  // The segments being replaced when lexing stopped at a directive, and the
+  // typedef names registered before them.
+  size_t replaced;
+  struct type_alias *replaced_aliases;
+};
+
+_Thread_local struct incremental {
+  const char *path;
+
+  // A copy of the source, edited in place so that tokens before an edit stay
+  // valid. Registered for `capacity` bytes, so its locations never move.
+  char *text;
+  size_t length;
+  size_t capacity;
+  SourceLocation base;
+
+  Token *tokens;
+  size_t token_count;
+  size_t token_capacity;
+
+  struct segment *segments;
+  size_t segment_count;
+  size_t segment_capacity;
+
+  // The lists of the source before the last edit, reused by the next one.
+  Token *spare_tokens;
+  size_t spare_token_capacity;
+  struct segment *spare_segments;
+  size_t spare_segment_capacity;
+
+  // The first segment also holds the directives at the top of the file.
+  bool prologue;
+
+  // Typedef names registered before the main file, such as those of a
+  // precompiled header.
+  struct type_alias *outer_aliases;
+
+  // Replays the tokens of one segment at a time to the preprocessor.
+  Scanner scanner;
+  struct translation_unit *unit;
+  bool active;
+
+  // Tokens of the main file at or after `shift_from` in the previous source
+  // move by `shift` bytes, see shift_token().
+  size_t shift_from;
+  ptrdiff_t shift;
+
+  IncrementalStats stats;
+} inc;
+
+// Lists
+
+void *grow_list(void *list, size_t *capacity, size_t needed, size_t size) {
+  if (needed <= *capacity) {
+    return list;
+  }
+
+  size_t new_capacity = *capacity ? *capacity : INITIAL_LIST_CAPACITY;
+
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+
+  void *grown = realloc(list, new_capacity * size);
+
+  if (!grown) {
+    CRITICAL("incremental", "Out of memory!");
+  }
+
+  *capacity = new_capacity;
+  return grown;
+}
+
+void append_token(const Token *token) {
+  // One more for the EOF that ends a segment while it is parsed.
+  inc.tokens = grow_list(inc.tokens, &inc.token_capacity, inc.token_count + 2,
+                         sizeof(Token));
+  inc.tokens[inc.token_count++] = *token;
+}
+
+void append_segment(const struct segment *segment) {
+  inc.segments = grow_list(inc.segments, &inc.segment_capacity,
+                           inc.segment_count + 1, sizeof(struct segment));
+  inc.segments[inc.segment_count++] = *segment;
+}
+
+size_t count_declarations(const struct segment *segment) {
+  size_t count = 0;
+
+  for (decl_ref cur = segment->head; cur != NO_NODE; cur = decl_at(cur)->next) {
+    count++;
+
+    if (cur == segment->tail)
+      break;
+  }
+
+  return count;
+}
+
+void destroy_segment(struct segment *segment) {
+  decl_ref cur = segment->head;
+
+  while (cur) {
+    decl_ref next = decl_at(cur)->next;
+    bool last = cur == segment->tail;
+
+    destroy_declaration(cur);
+
+    if (last)
+      break;
+
+    cur = next;
+  }
+
+  segment->head = NO_NODE;
+  segment->tail = NO_NODE;
+}
+
+void free_aliases(struct type_alias *from, struct type_alias *until) {
+  while (from != until) {
+    struct type_alias *next = from->next;
+    free(from);
+    from = next;
+  }
+}
+
+bool same_aliases(const struct type_alias *a, const struct type_alias *b,
+                  const struct type_alias *until) {
+  while (a != until && b != until) {
+    if (a->type_name != b->type_name) {
+      return false;
+    }
+
+    a = a->next;
+    b = b->next;
+  }
+
+  return a == until && b == until;
+}
+
+// Moving tokens
+
+size_t moved(size_t offset, ptrdiff_t shift) {
+  return (size_t)((ptrdiff_t)offset + shift);
+}
+
+void shift_token(Token *token) {
+  const char *from = &inc.text[inc.shift_from];
+  SourceLocation location = inc.base + (SourceLocation)inc.shift_from;
+
+  // Tokens from headers and macro definitions above stay where they are.
+  if (from <= token->data && token->data <= &inc.text[inc.capacity]) {
+    token->data += inc.shift;
+  }
+
+  if (location <= token->location &&
+      token->location <= inc.base + (SourceLocation)inc.capacity) {
+    token->location = (SourceLocation)moved(token->location, inc.shift);
+  }
+}
+
+void shift_id(id_ref id) {
+  if (id)
+    shift_token(&id_at(id)->name);
+}
+
+void shift_specifiers(spec_list_ref list) {
+  if (list == NO_NODE)
+    return;
+
+  for (struct specifier *cur = spec_at(spec_list_at(list)->head); cur != NULL;
+       cur = spec_at(cur->next)) {
+    if (cur->type == TOKEN) {
+      shift_token(&cur->_token);
+    } else {
+      shift_id(cur->_id);
+    }
+  }
+}
+
+void shift_statement(stmt_ref ref);
+void shift_expression(expr_ref ref);
+void shift_declaration(decl_ref ref);
+
+void shift_expression_list(expr_list_ref list) {
+  if (list == NO_NODE)
+    return;
+
+  for (expr_ref cur = expr_list_at(list)->head; cur != NO_NODE;
+       cur = expr_at(cur)->next) {
+    shift_expression(cur);
+  }
+}
+
+void shift_expression(expr_ref ref) {
+  struct expression *expr = expr_at(ref);
+
+  if (expr == NULL)
+    return;
+
+  switch (expr->type) {
+  case ID_EXPR:
+    shift_id(expr->_id);
+    break;
+  case CONST_EXPR:
+    shift_token(token_at(expr->_constant));
+    break;
+  case INDEX:
+    shift_expression(expr->_index.object);
+    shift_expression(expr->_index.index);
+    break;
+  case FUNC_CALL:
+    shift_expression(expr->_call.function_ptr);
+    shift_expression_list(expr->_call.parameter_list);
+    break;
+  case POSTFIX:
+  case UNARY:
+    shift_token(token_at(expr->_unary.operator));
+    shift_expression(expr->_unary.base);
+    break;
+  case CAST:
+    shift_specifiers(expr->_cast.type);
+    shift_expression(expr->_cast.base);
+    break;
+  case BINARY:
+    shift_token(token_at(expr->_binary.operator));
+    shift_expression(expr->_binary.left);
+    shift_expression(expr->_binary.right);
+    break;
+  case TERNARY:
+    shift_expression(expr->_ternary.condition);
+    shift_expression(expr->_ternary.true_branch);
+    shift_expression(expr->_ternary.false_branch);
+    break;
+  }
+}
+
+void shift_statement(stmt_ref ref) {
+  struct statement *stmt = stmt_at(ref);
+
+  if (stmt == NULL)
+    return;
+
+  switch (stmt->type) {
+  case BREAK:
+  case CONTINUE:
+    break;
+  case COMPOUND:
+    if (stmt->_compound.statements) {
+      for (stmt_ref cur = stmt_list_at(stmt->_compound.statements)->head;
+           cur != NO_NODE; cur = stmt_at(cur)->next) {
+        shift_statement(cur);
+      }
+    }
+
+    break;
+  case DECL:
+    shift_declaration(stmt->_decl);
+    break;
+  case EXPR:
+    shift_expression(stmt->_expr);
+    break;
+  case FOR:
+    if (stmt->_for.decl) {
+      shift_declaration(stmt->_for.decl);
+    }
+
+    shift_expression(stmt->_for.preloop_expression);
+    shift_expression(stmt->_for.condition);
+    shift_expression(stmt->_for.step_expression);
+    shift_statement(stmt->_for.body);
+    break;
+  case GOTO:
+    shift_id(stmt->_goto);
+    break;
+  case IF:
+    shift_expression(stmt->_if.condition);
+    shift_statement(stmt->_if.body);
+    shift_statement(stmt->_if.else_body);
+    break;
+  case LABEL:
+    shift_id(stmt->_label.name);
+    break;
+  case RETURN:
+    shift_expression(stmt->_return.ret_expr);
+    break;
+  case SWITCH:
+    shift_expression(stmt->_switch.condition);
+    shift_statement(stmt->_switch.body);
+    break;
+  case SWITCH_LABEL:
+    shift_expression(stmt->_switch_label.test);
+    break;
+  case WHILE:
+    shift_expression(stmt->_while.condition);
+    shift_statement(stmt->_while.body);
+    break;
+  }
+}
+
+void shift_declaration(decl_ref ref) {
+  struct declaration *decl = decl_at(ref);
+
+  switch (decl->type) {
+  case VARIABLE:
+    shift_specifiers(decl->_var.specifiers);
+
+    if (decl->_var.init_declarator_list) {
+      for (struct initialized_declarator *cur = init_decl_at(
+             init_decl_list_at(decl->_var.init_declarator_list)->head);
+           cur != NULL; cur = init_decl_at(cur->next)) {
+        shift_id(cur->declarator);
+        shift_expression(cur->initializer);
+      }
+    }
+
+    break;
+  case FUNCTION:
+    shift_specifiers(decl->_func.specifiers);
+    shift_id(decl->_func.name);
+
+    if (decl->_func.parameters) {
+      for (decl_ref cur = decl_list_at(decl->_func.parameters)->head;
+           cur != NO_NODE; cur = decl_at(cur)->next) {
+        shift_declaration(cur);
+      }
+    }
+
+    shift_statement(decl->_func.body);
+    break;
+  case TYPEDEF:
+    shift_specifiers(decl->_type_def.specifiers);
+    shift_id(decl->_type_def.name);
+    break;
+  }
+}
+
+// Lexing and parsing
+
+void copy_text(const char *file, size_t length) {
+  size_t cleared = inc.length > length ? inc.length : length;
+
+  memcpy(inc.text, file, length);
+  memset(&inc.text[length], 0, cleared - length + SOURCE_PADDING);
+  inc.length = length;
+
+  // Same buffer, so only its line table is rebuilt.
+  register_source(inc.path, inc.text, length);
+}
+
+void lex_token(size_t *index, Token *token) {
+  scan_token(inc.text, inc.base, index, token);
+  inc.stats.tokens_lexed++;
+}
+
+// Parses tokens [first, end) of the main file on their own, through the
+// preprocessor, and adds them as a segment.
+void parse_segment(size_t first, size_t end) {
+  const Token *last = &inc.tokens[end - 1];
+
+  // The parser stops right after the declaration.
+  inc.tokens[end] = (Token){
+    .kind = EOF,
+    .location = last->location + last->length,
+    .data = last->data + last->length,
+  };
+
+  struct segment segment = {first, end, NO_NODE, NO_NODE, alias_list};
+
+  inc.scanner.tokens = inc.tokens;
+  inc.scanner.index = first;
+
+  if (parse_translation_unit() != 0) {
+    CRITICAL("parser", "Failed to parse file!");
+  }
+
+  AST fragment = get_tree();
+  segment.head = fragment->external_declarations.head;
+  segment.tail = fragment->external_declarations.tail;
+
+  set_tree(inc.unit);
+  free_unused_declaration_branches(segment.head, segment.tail);
+
+  inc.stats.declarations_parsed += count_declarations(&segment);
+  append_segment(&segment);
+}
+
+// Copies an unchanged segment, moved by `shift` bytes.
+void reuse_segment(struct merge *merge, size_t i, ptrdiff_t shift) {
+  struct segment segment = merge->old_segments[i];
+  size_t first = inc.token_count;
+
+  for (size_t j = segment.first; j < segment.end; j++) {
+    Token token = merge->old_tokens[j];
+
+    token.data += shift;
+    token.location = (SourceLocation)moved(token.location, shift);
+    append_token(&token);
+  }
+
+  if (shift != 0) {
+    inc.shift_from = (size_t)(merge->old_tokens[segment.first].data - inc.text);
+    inc.shift = shift;
+
+    for (decl_ref cur = segment.head; cur != NO_NODE;
+         cur = decl_at(cur)->next) {
+      shift_declaration(cur);
+
+      if (cur == segment.tail)
+        break;
+    }
+  }
+
+  segment.first = first;
+  segment.end = inc.token_count;
+
+  inc.stats.declarations_reused += count_declarations(&segment);
+  append_segment(&segment);
+}
+
+// Offset just past the last token of a segment.
+size_t segment_end(const Token *tokens, const struct segment *segment) {
+  const Token *last = &tokens[segment->end - 1];
+  return (size_t)(last->data - inc.text) + last->length;
+}
+
+size_t old_segment_end(const struct merge *merge, size_t i) {
+  return segment_end(merge->old_tokens, &merge->old_segments[i]);
+}
+
+/**
+ * Drops old segments [first, end) for those just parsed, whose typedef names
+ * were registered after `before`.
+ */
+void replace_segments(struct merge *merge, size_t first, size_t end,
+                      struct type_alias *before) {
+  struct type_alias *old_top = end < merge->old_count
+                                 ? merge->old_segments[end].aliases
+                                 : merge->aliases;
+
+  // Typedef names of the segments after come on top of the new ones.
+  if (merge->aliases == old_top) {
+    merge->aliases = alias_list;
+  } else {
+    struct type_alias *cur = merge->aliases;
+
+    while (cur->next != old_top) {
+      cur = cur->next;
+    }
+
+    cur->next = alias_list;
+  }
+
+  for (size_t i = end;
+       i < merge->old_count && merge->old_segments[i].aliases == old_top; i++) {
+    merge->old_segments[i].aliases = alias_list;
+  }
+
+  free_aliases(old_top, before);
+
+  for (size_t i = first; i < end; i++) {
+    destroy_segment(&merge->old_segments[i]);
+  }
+}
+
+/**
+ * Builds the tokens and segments of the edited source, lexing and parsing
+ * from the end of the last segment before each edit until a segment ends
+ * where an old one did.
+ *
+ * @return false if lexing stopped at a directive that is not allowed.
+ */
+bool merge_edits(struct merge *merge) {
+  size_t i = 0;
+  size_t k = 0;
+  ptrdiff_t shift = 0;
+
+  for (;;) {
+    while (i < merge->old_count &&
+           (k == merge->edit_count ||
+            old_segment_end(merge, i) <= merge->edits[k].start)) {
+      reuse_segment(merge, i, shift);
+      i++;
+    }
+
+    if (k == merge->edit_count) {
+      break;
+    }
+
+    size_t replaced = i;
+    struct type_alias *before =
+      i < merge->old_count ? merge->old_segments[i].aliases : merge->aliases;
+    size_t index = i > 0 ? moved(old_segment_end(merge, i - 1), shift) : 0;
+    size_t first = inc.token_count;
+    struct splitter splitter = {0};
+    bool code = false;
+    Token token;
+
+    set_type_aliases(before);
+
+    for (;;) {
+      lex_token(&index, &token);
+
+      if (is_directive(&token) && (!merge->allow_directives || code)) {
+        merge->replaced = replaced;
+        merge->replaced_aliases = before;
+        return false;
+      }
+
+      if (token.kind == EOF) {
+        break;
+      }
+
+      append_token(&token);
+      bool ends = ends_declaration(&splitter, &token);
+      code = code || !splitter.in_directive;
+
+      if (!ends) {
+        continue;
+      }
+
+      parse_segment(first, inc.token_count);
+      first = inc.token_count;
+
+      // Edits now behind the segment no longer stop a resync.
+      while (k < merge->edit_count &&
+             moved(merge->edits[k].start, shift) +
+                 merge->edits[k].new_length <=
+               index) {
+        shift += (ptrdiff_t)merge->edits[k].new_length -
+                 (ptrdiff_t)merge->edits[k].old_length;
+        k++;
+      }
+
+      if (k < merge->edit_count && moved(merge->edits[k].start, shift) < index) {
+        continue;
+      }
+
+      size_t old_index = moved(index, -shift);
+
+      while (i < merge->old_count && old_segment_end(merge, i) < old_index) {
+        i++;
+      }
+
+      if (i == merge->old_count || old_segment_end(merge, i) != old_index) {
+        continue;
+      }
+
+      // Different typedef names could change how later segments parse.
+      struct type_alias *old_top = i + 1 < merge->old_count
+                                     ? merge->old_segments[i + 1].aliases
+                                     : merge->aliases;
+
+      if (!same_aliases(alias_list, old_top, before)) {
+        continue;
+      }
+
+      replace_segments(merge, replaced, ++i, before);
+      break;
+    }
+
+    if (token.kind == EOF) {
+      if (inc.token_count > first) {
+        parse_segment(first, inc.token_count);
+      }
+
+      replace_segments(merge, replaced, merge->old_count, before);
+      set_type_aliases(merge->aliases);
+      append_token(&token);
+      return true;
+    }
+  }
+
+  set_type_aliases(merge->aliases);
+
+  Token eof = {
+    .kind = EOF,
+    .location = inc.base + (SourceLocation)inc.length,
+    .data = &inc.text[inc.length],
+  };
+
+  append_token(&eof);
+  return true;
+}
+
+// Drops everything parsed from the main file.
+void release_unit(void) {
+  for (size_t i = 0; i < inc.segment_count; i++) {
+    destroy_segment(&inc.segments[i]);
+  }
+
+  forget_type_aliases(inc.outer_aliases);
+
+  inc.segment_count = 0;
+  inc.token_count = 0;
+  inc.prologue = false;
+
+  if (inc.unit) {
+    inc.unit->external_declarations = (struct declaration_list){0};
+  }
+}
+
+// Undoes a merge_edits() that stopped at a directive.
+void abandon_merge(struct merge *merge) {
+  for (size_t i = merge->replaced; i < merge->old_count; i++) {
+    destroy_segment(&merge->old_segments[i]);
+  }
+
+  forget_type_aliases(merge->replaced_aliases);
+  set_type_aliases(merge->aliases);
+  release_unit();
+}
+
+void link_segments(void) {
+  struct declaration_list *list = &inc.unit->external_declarations;
+  *list = (struct declaration_list){0};
+
+  for (size_t i = 0; i < inc.segment_count; i++) {
+    struct segment *segment = &inc.segments[i];
+
+    if (list->tail) {
+      decl_at(list->tail)->next = segment->head;
+    } else {
+      list->head = segment->head;
+    }
+
+    list->tail = segment->tail;
+  }
+
+  if (list->tail) {
+    decl_at(list->tail)->next = NO_NODE;
+  }
+
+  set_tree(inc.unit);
+}
+
+bool parse_source(const char *path, const char *file, size_t length) {
+  if (!inc.active) {
+    inc.outer_aliases = alias_list;
+    inc.unit = calloc(1, sizeof(struct translation_unit));
+
+    if (!inc.unit) {
+      CRITICAL("incremental", "Out of memory!");
+    }
+
+    inc.active = true;
+  }
+
+  release_unit();
+  inc.path = path;
+  inc.stats = (IncrementalStats){0, 0, 0};
+
+  if (!inc.text || inc.capacity < length) {
+    size_t capacity = INITIAL_TEXT_CAPACITY;
+
+    while (capacity < length) {
+      capacity *= 2;
+    }
+
+    // Nothing references the old text once the unit is released.
+    unregister_source(inc.text);
+    free(inc.text);
+    inc.text = calloc(capacity + SOURCE_PADDING + 1, 1);
+
+    if (!inc.text) {
+      CRITICAL("incremental", "Out of memory!");
+    }
+
+    inc.length = 0;
+    inc.capacity = capacity;
+    inc.base = register_source(path, inc.text, capacity);
+
+    if (inc.base == NO_LOCATION) {
+      CRITICAL("incremental", "Out of source locations!");
+    }
+  }
+
+  copy_text(file, length);
+  init_scanner(&inc.scanner, inc.text);
+  init_preprocessor(&inc.scanner, path);
+  set_tree(inc.unit);
+
+  // Everything is new, as if replacing an empty source.
+  Edit edit = {0, 0, length};
+  struct merge merge = {
+    .edits = &edit,
+    .edit_count = 1,
+    .aliases = alias_list,
+    .allow_directives = true,
+  };
+
+  if (!merge_edits(&merge)) {
+    abandon_merge(&merge);
+    link_segments();
+    return false;
+  }
+
+  inc.prologue = inc.segment_count > 0 && is_directive(&inc.tokens[0]);
+  link_segments();
+  return true;
+}
+
+bool reparse_source(const char *file, size_t length, const Edit *edits,
+                    size_t edit_count) {
+  // The preprocessor cannot run the directives at the top again on its own.
+  if (!inc.active || inc.capacity < length ||
+      (inc.prologue && edit_count > 0 &&
+       edits[0].start < segment_end(inc.tokens, &inc.segments[0]))) {
+    return parse_source(inc.path, file, length);
+  }
+
+  struct merge merge = {
+    .edits = edits,
+    .edit_count = edit_count,
+    .old_tokens = inc.tokens,
+    .old_segments = inc.segments,
+    .old_count = inc.segment_count,
+    .aliases = alias_list,
+  };
+
+  size_t token_capacity = inc.token_capacity;
+  size_t segment_capacity = inc.segment_capacity;
+
+  // Most tokens and segments are copied over, into the lists of the source
+  // before the previous edit.
+  inc.tokens = grow_list(inc.spare_tokens, &inc.spare_token_capacity,
+                         token_capacity, sizeof(Token));
+  inc.token_count = 0;
+  inc.token_capacity = inc.spare_token_capacity;
+  inc.segments =
+    grow_list(inc.spare_segments, &inc.spare_segment_capacity,
+              segment_capacity, sizeof(struct segment));
+  inc.segment_count = 0;
+  inc.segment_capacity = inc.spare_segment_capacity;
+  inc.stats = (IncrementalStats){0, 0, 0};
+
+  copy_text(file, length);
+  bool merged = merge_edits(&merge);
+
+  if (!merged) {
+    abandon_merge(&merge);
+  }
+
+  inc.spare_tokens = merge.old_tokens;
+  inc.spare_token_capacity = token_capacity;
+  inc.spare_segments = merge.old_segments;
+  inc.spare_segment_capacity = segment_capacity;
+
+  if (!merged) {
+    // A directive was added, which only a full parse can place.
+    return parse_source(inc.path, file, length);
+  }
+
+  link_segments();
+  return true;
+}
+
+IncrementalStats get_incremental_stats(void) { return inc.stats; }
+
+void free_incremental(void) {
+  if (!inc.active) {
+    return;
+  }
+
+  release_unit();
+
+  if (get_tree() == inc.unit) {
+    set_tree(NULL);
+  }
+
+  free(inc.unit);
+  unregister_source(inc.text);
+  free(inc.text);
+  free(inc.tokens);
+  free(inc.segments);
+  free(inc.spare_tokens);
+  free(inc.spare_segments);
+
+  inc = (struct incremental){0};
+}
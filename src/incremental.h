@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A replaced range of bytes: [start, start + old_length) of the previous
+// source became new_length bytes.
+typedef struct EditStruct {
+  size_t start;
+  size_t old_length;
+  size_t new_length;
+} Edit;
+
+typedef struct IncrementalStatsStruct {
+  // Tokens lexed by the last parse_source() or reparse_source().
+  size_t tokens_lexed;
+  // External declarations parsed, and kept from the previous parse.
+  size_t declarations_parsed;
+  size_t declarations_reused;
+} IncrementalStats;
+
+/**
+ * Lexes and parses a main file for reparse_source(), making it the tree
+ * returned by get_tree(). Declarations are parsed one at a time, so the
+ * tokens, typedef names and nodes of each one can be reused by later edits.
+ *
+ * Directives are only supported before the first declaration, where the
+ * preprocessor runs them once; macros they define are still expanded
+ * everywhere. Sources with directives further down are rejected, the whole
+ * pipeline handles those.
+ *
+ * The tree is neither linked nor transformed, later phases change it and
+ * must not run on it while edits are still expected.
+ *
+ * @param path The path of the file, for diagnostics and quoted includes.
+ * Must outlive free_incremental().
+ * @param file The contents, which are copied.
+ * @param length The length of the contents.
+ * @return false if the source has directives after its first declaration.
+ */
+bool parse_source(const char *path, const char *file, size_t length);
+
+/**
+ * Brings the tree up to date with an edited version of the source last given
+ * to parse_source() or reparse_source().
+ *
+ * Lexing starts at the end of the last declaration before the first edit and
+ * stops at the first declaration boundary past an edit that was also one
+ * before it, as tokens do not depend on what precedes them. Only the
+ * declarations in between are parsed again, and spliced into the tree in
+ * place of the old ones. If they declare other typedef names than before,
+ * everything after them is parsed again too.
+ *
+ * Edits to the directives at the top, or to the declaration that follows
+ * them, parse the whole source again.
+ *
+ * @param file The edited contents, which are copied.
+ * @param length The length of the edited contents.
+ * @param edits The edits, in order and not overlapping, with their start in
+ * the previous source.
+ * @param edit_count The number of edits.
+ * @return false if the edited source has directives after its first
+ * declaration, in which case the tree is empty.
+ */
+bool reparse_source(const char *file, size_t length, const Edit *edits,
+                    size_t edit_count);
+
+/**
+ * @return Counters for the last parse_source() or reparse_source().
+ */
+IncrementalStats get_incremental_stats(void);
+
+/**
+ * Releases the tree, tokens and typedef names of the parsed source. Tokens
+ * from headers reference the preprocessor, so this must come before
+ * free_preprocessor().
+ */
+void free_incremental(void);
@@ -0,0 +1,184 @@
+#include "intern.h"
+#include "log.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_BUCKET_COUNT 1024
+#define STRING_BLOCK_SIZE 65536
+
+struct interned_string {
+  uint32_t hash;
+  uint32_t length;
+  const char *text;
+};
+
+// Spellings are packed into large blocks instead of being allocated one by
+// one.
+struct string_block {
+  struct string_block *next;
+  size_t used;
+  size_t size;
+  char data[];
+};
+
+// Indexed by id, entry 0 stands for NO_INTERN.
+_Thread_local struct interned_string *entries = NULL;
+_Thread_local size_t entry_count = 0;
+_Thread_local size_t entry_capacity = 0;
+
+// Open addressing over ids, NO_INTERN marks an empty bucket. The bucket count
+// is a power of two and at most half the buckets are used.
+_Thread_local intern_t *buckets = NULL;
+_Thread_local size_t bucket_count = 0;
+
+_Thread_local struct string_block *string_blocks = NULL;
+
+// FNV-1a
+uint32_t hash_spelling(const char *text, size_t length) {
+  uint32_t hash = 2166136261u;
+
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)text[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+const char *store_spelling(const char *text, size_t length) {
+  struct string_block *block = string_blocks;
+
+  if (block == NULL || block->size - block->used < length + 1) {
+    size_t size =
+      length + 1 > STRING_BLOCK_SIZE ? length + 1 : STRING_BLOCK_SIZE;
+    block = malloc(sizeof(struct string_block) + size);
+
+    if (block == NULL) {
+      CRITICAL("intern", "Out of memory!");
+    }
+
+    block->used = 0;
+    block->size = size;
+    block->next = string_blocks;
+    string_blocks = block;
+  }
+
+  char *copy = &block->data[block->used];
+  memcpy(copy, text, length);
+  copy[length] = '\0';
+  block->used += length + 1;
+
+  return copy;
+}
+
+void place_in_bucket(intern_t id) {
+  size_t mask = bucket_count - 1;
+  size_t slot = entries[id].hash & mask;
+
+  while (buckets[slot] != NO_INTERN) {
+    slot = (slot + 1) & mask;
+  }
+
+  buckets[slot] = id;
+}
+
+void grow_buckets(void) {
+  size_t count = bucket_count ? bucket_count * 2 : INITIAL_BUCKET_COUNT;
+  intern_t *grown = calloc(count, sizeof(intern_t));
+
+  if (grown == NULL) {
+    CRITICAL("intern", "Out of memory!");
+  }
+
+  free(buckets);
+  buckets = grown;
+  bucket_count = count;
+
+  for (intern_t id = 1; id < entry_count; id++) {
+    place_in_bucket(id);
+  }
+}
+
+intern_t add_entry(const char *text, size_t length, uint32_t hash) {
+  if (entry_count == entry_capacity) {
+    size_t capacity =
+      entry_capacity ? entry_capacity * 2 : INITIAL_BUCKET_COUNT;
+    struct interned_string *grown =
+      realloc(entries, capacity * sizeof(struct interned_string));
+
+    if (grown == NULL) {
+      CRITICAL("intern", "Out of memory!");
+    }
+
+    entries = grown;
+    entry_capacity = capacity;
+
+    if (entry_count == 0) {
+      entries[0] = (struct interned_string){0, 0, ""};
+      entry_count = 1;
+    }
+  }
+
+  intern_t id = (intern_t)entry_count++;
+
+  entries[id].hash = hash;
+  entries[id].length = (uint32_t)length;
+  entries[id].text = store_spelling(text, length);
+
+  return id;
+}
+
+intern_t intern(const char *text, size_t length) {
+  uint32_t hash = hash_spelling(text, length);
+
+  if ((entry_count + 1) * 2 > bucket_count) {
+    grow_buckets();
+  }
+
+  size_t mask = bucket_count - 1;
+
+  for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    intern_t id = buckets[slot];
+
+    if (id == NO_INTERN) {
+      id = add_entry(text, length, hash);
+      buckets[slot] = id;
+      return id;
+    }
+
+    struct interned_string *entry = &entries[id];
+
+    if (entry->hash == hash && entry->length == length &&
+        memcmp(entry->text, text, length) == 0) {
+      return id;
+    }
+  }
+}
+
+const char *interned_text(intern_t id) { return entries[id].text; }
+
+size_t interned_length(intern_t id) { return entries[id].length; }
+
+uint32_t interned_hash(intern_t id) { return entries[id].hash; }
+
+void free_interned_strings(void) {
+  struct string_block *block = string_blocks;
+
+  while (block != NULL) {
+    struct string_block *next = block->next;
+    free(block);
+    block = next;
+  }
+
+  free(entries);
+  free(buckets);
+
+  string_blocks = NULL;
+  entries = NULL;
+  entry_count = 0;
+  entry_capacity = 0;
+  buckets = NULL;
+  bucket_count = 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Identifies a distinct spelling, equal spellings always get the same id.
+typedef uint32_t intern_t;
+
+// Never returned by intern().
+#define NO_INTERN 0
+
+/**
+ * Interns a spelling, copying it on first sight.
+ *
+ * @param text The spelling, need not be NUL-terminated.
+ * @param length The length of the spelling.
+ * @return The id of the spelling.
+ */
+intern_t intern(const char *text, size_t length);
+
+/**
+ * @return The NUL-terminated spelling of an interned id. It stays valid until
+ * free_interned_strings().
+ */
+const char *interned_text(intern_t id);
+
+size_t interned_length(intern_t id);
+
+/**
+ * @return The hash of the spelling, computed once when it was interned.
+ */
+uint32_t interned_hash(intern_t id);
+
+/**
+ * Releases every interned spelling. Ids handed out before are invalid after.
+ */
+void free_interned_strings(void);
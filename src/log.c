@@ -16,6 +16,8 @@
 #define C(file, color)
 #endif
 
+_Thread_local jmp_buf *error_recovery = NULL;
+
 void log_message(int level, const char *section, const char *msg,
                  const char *file, int lineno, ...) {
   FILE *output_file = level < WARNING_LEVEL ? stderr : stdout;
@@ -52,6 +54,11 @@ void log_message(int level, const char *section, const char *msg,
 
   va_end(args);
 
-  if (level < WARNING_LEVEL)
+  if (level < WARNING_LEVEL) {
+    if (error_recovery) {
+      longjmp(*error_recovery, level);
+    }
+
     exit(level);
+  }
 }
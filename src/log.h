@@ -1,5 +1,6 @@
 #pragma once
 
+#include <setjmp.h>
 #include <stdlib.h>
 
 #define DEBUG_LEVEL 10
@@ -20,6 +21,9 @@
 #define CRITICAL(section, msg)                                                 \
   log_message(CRITICAL_LEVEL, section, msg, __FILE__, __LINE__);
 
+#define WARNINGV(section, msg, ...)                                            \
+  log_message(WARNING_LEVEL, section, msg, __FILE__, __LINE__, __VA_ARGS__);
+
 #define ERRORV(section, msg, ...)                                              \
   log_message(ERROR_LEVEL, section, msg, __FILE__, __LINE__, __VA_ARGS__);
 
@@ -41,5 +45,12 @@
     }                                                                          \
   } while (0)
 
+/**
+ * Where errors and critical errors jump on this thread, with longjmp() and
+ * their level, instead of ending the process. Set while a translation unit is
+ * parsed, see parse_translation_unit(), so that other threads go on.
+ */
+extern _Thread_local jmp_buf *error_recovery;
+
 void log_message(int level, const char *section, const char *msg,
                  const char *file, int lineno, ...);
@@ -3,98 +3,197 @@
 #include "assign.h"
 #include "common.h"
 #include "debug_ast.h"
+#include "depend.h"
 #include "debug_insn.h"
+#include "descent.h"
 #include "emit.h"
 #include "log.h"
 #include "parser.h"
+#include "pch.h"
+#include "preprocess.h"
 #include "scanner.h"
+#include "source.h"
 #include "symbol.h"
 #include "transforms.h"
 #include "tree.h"
 
+#include <string.h>
+#include <unistd.h>
+
+// Sources at least this long are scanned up front on several threads, with
+// each thread getting at least PARALLEL_SCAN_CHUNK bytes.
+#define PARALLEL_SCAN_THRESHOLD (1 << 20)
+#define PARALLEL_SCAN_CHUNK (256 * 1024)
+
+// Checks and lowers the parsed translation unit.
+void compile_translation_unit(void) {
+  link_symbols();
+
+  // After semantic analysis
+  transform_ast();
+  assign_registers();
+
+#ifndef NDEBUG
+  print_ast();
+#endif
+
+  InstructionList *ir_insns = emit_intermediate_representation();
+  if (ir_insns == NULL) {
+    CRITICAL("emit", "Failed to emit intermediate representation!");
+  }
+
+#ifndef NDEBUG
+  debug_insns(ir_insns);
+#endif
+
+  destroy_instruction_list(ir_insns);
+  free_generated_labels();
+  free_registers();
+}
+
 int main(int args, char **argv) {
-  if (args < 2) {
+  const char *path = NULL;
+  const char *output = NULL;
+  const char *include_pch = NULL;
+  bool emit_pch = false;
+  bool list_dependencies = false;
+  bool system_headers = true;
+
+  for (int i = 1; i < args; i++) {
+    if (strcmp(argv[i], "-M") == 0 || strcmp(argv[i], "-MM") == 0) {
+      list_dependencies = true;
+      system_headers = argv[i][2] != 'M';
+    } else if (strcmp(argv[i], "--emit-pch") == 0) {
+      emit_pch = true;
+    } else if (strcmp(argv[i], "--include-pch") == 0 && i + 1 < args) {
+      include_pch = argv[++i];
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < args) {
+      output = argv[++i];
+    } else if (strcmp(argv[i], "-I") == 0 && i + 1 < args) {
+      add_include_directory(argv[++i]);
+    } else if (strncmp(argv[i], "-I", 2) == 0 && argv[i][2] != '\0') {
+      add_include_directory(&argv[i][2]);
+    } else if (!path) {
+      path = argv[i];
+    } else {
+      CRITICAL("cli", "More than one input file!");
+    }
+  }
+
+  if (!path) {
     CRITICAL("cli", "No input file!");
   }
 
-  FILE *input = fopen(argv[1], "r");
+  if (emit_pch && !output) {
+    CRITICAL("cli", "No output file for the precompiled header!");
+  }
+
+  // Typedef names must be known before the parser reads the main file.
+  if (include_pch && !load_pch(include_pch)) {
+    CRITICAL("cli", "Failed to load precompiled header!");
+  }
 
-  if (!input) {
+  // The source stays mapped for the whole compilation, so tokens and later
+  // phases can reference its text without copying.
+  SourceBuffer source;
+
+  if (!load_source(path, &source)) {
     CRITICAL("cli", "Failed to open input file!");
   }
 
-  TRY(fseek(input, 0, SEEK_END));
-  long file_size = ftell(input);
+  // Registered first, so diagnostics name the file.
+  if (register_source(path, source.data, source.length) == NO_LOCATION) {
+    CRITICAL("cli", "Input file is too large!");
+  }
+
+  const char *file = source.data;
 
-  CHECK(file_size);
+  // Only directives are read, the file is neither lexed nor parsed.
+  if (list_dependencies) {
+    Scanner scanner;
+    FILE *rule = output ? fopen(output, "w") : stdout;
 
-  TRY(fseek(input, 0, SEEK_SET));
+    if (!rule) {
+      CRITICAL("cli", "Failed to open output file!");
+    }
 
-  char *file = malloc(file_size + 1);
-  if (!file) {
-    ERROR("file", "Out of memory!");
-  }
+    init_scanner(&scanner, file);
+    set_directives_only(true);
+    init_preprocessor(&scanner, path);
 
-  size_t read_len = fread(file, sizeof(char), file_size, input);
+    while (preprocess_token()->kind != EOF) {
+    }
 
-  if (read_len != (size_t)file_size) {
-    // FIXME: do not fail here...
-    ERROR("read", "Failed to read whole file!");
+    write_dependencies(rule, path, system_headers);
+
+    if (rule != stdout) {
+      fclose(rule);
+    }
+
+    free_preprocessor();
+    free_interned_strings();
+    free_sources();
+    release_source(&source);
+    return 0;
   }
 
-  file[file_size] = '\0';
+  Scanner scanner;
+  Token *tokens = NULL;
 
-  TRY(fclose(input));
+  if (source.length >= PARALLEL_SCAN_THRESHOLD) {
+    size_t chunk_count = source.length / PARALLEL_SCAN_CHUNK;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
 
-  Token *tokens = scan(file);
+    if (cpus > 0 && chunk_count > (size_t)cpus) {
+      chunk_count = (size_t)cpus;
+    }
 
-  free(file);
+    tokens = scan_parallel(file, source.length, chunk_count);
 
-  if (tokens == NULL) {
-    CRITICAL("lex", "Failed to scan file!");
+    if (tokens == NULL) {
+      CRITICAL("lex", "Failed to scan file!");
+    }
+
+    init_scanner_from_tokens(&scanner, file, tokens);
+  } else {
+    init_scanner(&scanner, file);
   }
 
 #ifndef NDEBUG
-  for (Token *cur = tokens; cur != NULL; cur = cur->next) {
-    DEBUG("token [%d, %s, %zu:%zu, %zu:%zu]", cur->kind, cur->data,
-          cur->span.start.line_number, cur->span.start.column,
-          cur->span.end.line_number, cur->span.end.column);
-  }
+  // Tokens are logged as the parser gets them, after preprocessing.
+  set_token_dump(true);
 #endif
 
-  init_parser(tokens);
-  int result = yyparse();
+  init_preprocessor(&scanner, path);
+  int result = parse_translation_unit();
 
   if (result != 0) {
     CRITICAL("parser", "Failed to parse file!");
   }
 
+  if (emit_pch) {
+    // Code is only generated for the translation units that include it.
+    if (!save_pch(output)) {
+      CRITICAL("pch", "Failed to write precompiled header!");
+    }
+  } else {
+    seed_translation_unit();
+  }
+
   free_type_alias_memory();
   free_unused_parse_branches();
 
-  link_symbols();
-
-  // After semantic analysis
-  transform_ast();
-  assign_registers();
-
-#ifndef NDEBUG
-  print_ast();
-#endif
-
-  InstructionList *ir_insns = emit_intermediate_representation();
-  if (ir_insns == NULL) {
-    CRITICAL("emit", "Failed to emit intermediate representation!");
+  if (!emit_pch) {
+    compile_translation_unit();
   }
 
-#ifndef NDEBUG
-  debug_insns(ir_insns);
-#endif
-
-  destroy_instruction_list(ir_insns);
-  free_generated_labels();
   destroy_ast();
-  free_list(tokens);
+  free_pch();
+  free_preprocessor();
+  free_tokens(tokens);
+  free_interned_strings();
+  free_sources();
+  release_source(&source);
 
   return 0;
 }
@@ -1,14 +1,93 @@
 #pragma once
 
+#include "ast.h"
 #include "scanner.h"
 #include <stdbool.h>
 #include <stdio.h>
 
-void init_parser(Token *list);
+/**
+ * Prepares the parser to pull tokens from the preprocessor on demand, so only
+ * the scanner's lookahead and the tokens kept by AST nodes are ever in
+ * memory. See init_preprocessor().
+ *
+ * Like every phase, the parser keeps its state per thread, so threads can
+ * compile translation units of their own at the same time.
+ */
+void init_parser(void);
 int yyparse(void);
 
+/**
+ * Parses a run of tokens instead of the preprocessor's, as if an EOF token
+ * followed them. They are not preprocessed again.
+ *
+ * @return The result of yyparse().
+ */
+int parse_tokens(const Token *tokens, size_t count);
+
+// A name declared by typedef, which the parser reads as TYPE_ALIAS, or one
+// declared in a block scope that hides a typedef name of an outer scope.
+struct type_alias {
+  intern_t type_name;
+  bool hidden;
+  // The entry for the same name this one shadows, while it is indexed.
+  struct type_alias *shadowed;
+  struct type_alias *next;
+};
+
+// Every typedef name in scope, the most recent first. Read-only, use
+// set_type_aliases() to switch to another list.
+extern _Thread_local struct type_alias *alias_list;
+
+/**
+ * Makes the parser read a name as a typedef name from now on, as if a
+ * typedef declared it. It goes out of scope with the innermost block scope.
+ */
+void add_type_alias(intern_t name);
+
+/**
+ * Makes a typedef's declarator name a type, see add_type_alias().
+ *
+ * @return The declarator.
+ */
+id_ref register_type(id_ref type);
+
+/**
+ * Makes the parser read a typedef name of an outer scope as an identifier
+ * until the innermost block scope ends, for a declaration that reuses it.
+ * Does nothing at file scope, or if the name is not a typedef name.
+ */
+void hide_type_alias(intern_t name);
+
+/**
+ * @return Whether the parser reads a name as a typedef name. Takes the same
+ * time however many there are.
+ */
+bool is_type_alias(intern_t name);
+
+/**
+ * Starts a block scope, whose typedef names and hidden names are forgotten by
+ * the matching leave_type_scope().
+ */
+void enter_type_scope(void);
+void leave_type_scope(void);
+
+/**
+ * @return How many block scopes were entered and not left yet.
+ */
+size_t type_scope_depth(void);
+
+/**
+ * Forgets and frees the entries added since `newest` was the newest.
+ */
+void forget_type_aliases(struct type_alias *newest);
+
+/**
+ * Switches to a list of typedef names kept from earlier, without freeing the
+ * current one. Cheapest when one list is the other with names added on top.
+ */
+void set_type_aliases(struct type_alias *list);
+
 void free_type_alias_memory(void);
 
 // internal
-int yylex(void);
 void yyerror(char const *s);
@@ -2,31 +2,40 @@
 #define _GNU_SOURCE
 #include "parser.h"
 #include "log.h"
+#include "preprocess.h"
 #include "tree.h"
 #include <string.h>
 #include <stdlib.h>
 
-struct id *register_type(struct id *new_type);
 %}
 
 %glr-parser
-%expect 214
+%define api.pure
+%expect 213
 %expect-rr 1
 
+// Tokens are held by value: the preprocessor reuses its slot once the parser
+// has pulled past them, and deferred GLR actions may run much later.
 %union {
-  Token *tokenval;
-  struct id *idval;
-  struct specifier *specval;
-  struct specifier_list *speclistval;
-  struct declaration *declval;
-  struct declaration_list *decllistval;
-  struct statement *stmtval;
-  struct statement_list *stmtlistval;
+  Token tokenval;
+  id_ref idval;
+  spec_ref specval;
+  spec_list_ref speclistval;
+  decl_ref declval;
+  decl_list_ref decllistval;
+  stmt_ref stmtval;
+  stmt_list_ref stmtlistval;
   struct translation_unit *unitval;
-  struct expression *exprval;
-  struct expression_list *exprlistval;
-  struct initialized_declarator* initdeclval;
-  struct init_declarator_list* initdecllistval;
+  expr_ref exprval;
+  expr_list_ref exprlistval;
+  init_decl_ref initdeclval;
+  init_decl_list_ref initdecllistval;
+}
+
+%code {
+// The parser is pure: its stacks and lookahead are local to yyparse(), so
+// threads can parse at once.
+int yylex(YYSTYPE *lvalp);
 }
 
 %token ID CONST STR TYPE_ALIAS
@@ -108,6 +117,25 @@ struct id *register_type(struct id *new_type);
 %token P_ORE "|="
 %token P_DHASH "##"
 
+// Binary operators, loosest first, see binary_expression. These are the levels
+// of binary_precedence in precedence.h, test_binary_precedence checks they
+// agree.
+%left "||"
+%left "&&"
+%left '|'
+%left '^'
+%left '&'
+%left "==" "!="
+%left '<' '>' "<=" ">="
+%left "<<" ">>"
+%left '+' '-'
+%left '*' '/' '%'
+
+// A dangling "else" belongs to the nearest if: shifting it beats reducing an
+// if statement without one. Left to %dprec, the outer if would take it.
+%precedence THEN
+%precedence "else"
+
 %type<tokenval> ID CONST STR TYPE_ALIAS
 
 %type<tokenval> K_alignas K_alignof K_auto K_bool K_break K_case K_char K_const
@@ -152,10 +180,8 @@ struct id *register_type(struct id *new_type);
 %type<stmtlistval> statement
 
 %type<exprval> primary_expression postfix_expression unary_expression
-%type<exprval> cast_expression multiplicative_expression additive_expression
-%type<exprval> shift_expression relational_expression equality_expression
-%type<exprval> and_expression xor_expression or_expression logical_and_expression
-%type<exprval> logical_or_expression conditional_expression assignment_expression
+%type<exprval> cast_expression binary_expression conditional_expression
+%type<exprval> assignment_expression
 %type<exprval> expression expression_opt constant_expression id_expression
 %type<exprval> initializer
 %type<exprlistval> argument_expression_list argument_expression_list_opt
@@ -178,10 +204,10 @@ struct id *register_type(struct id *new_type);
 
   /* Expressions (following A.2.1) */
   primary_expression: identifier { $$ = create_id_expression($1); }
-    | CONST { $$ = create_const_expression($1); }
-    | STR { $$ = create_const_expression($1); }
+    | CONST { $$ = create_const_expression(&$1); }
+    | STR { $$ = create_const_expression(&$1); }
     | '(' expression ')' { $$ = $2; }
-    | generic_selection { $$ = NULL; }
+    | generic_selection { $$ = NO_NODE; }
 
   generic_selection:
     "_Generic" '(' assignment_expression ',' generic_assoc_list ')';
@@ -197,9 +223,9 @@ struct id *register_type(struct id *new_type);
     | postfix_expression '(' argument_expression_list_opt ')' { $$ = create_call_expression($1, $3); }
     | postfix_expression '.' id_expression { $$ = create_dot_index_expression($1, $3); }
     | postfix_expression "->" id_expression { $$ = create_arrow_index_expression($1, $3); }
-    | postfix_expression "++" { $$ = create_postfix_expression($1, $2); }
-    | postfix_expression "--" { $$ = create_postfix_expression($1, $2); }
-    | compound_literal { $$ = NULL; };
+    | postfix_expression "++" { $$ = create_postfix_expression($1, &$2); }
+    | postfix_expression "--" { $$ = create_postfix_expression($1, &$2); }
+    | compound_literal { $$ = NO_NODE; };
 
   argument_expression_list: assignment_expression { $$ = create_expr_list($1); }
     | argument_expression_list ',' assignment_expression { $$ = append_expr($1, $3); }
@@ -210,12 +236,12 @@ struct id *register_type(struct id *new_type);
     | storage_class_specifiers storage_class_specifier;
 
   unary_expression: postfix_expression { $$ = $1; }
-    | "++" unary_expression { $$ = create_unary_expression($1, $2); }
-    | "--" unary_expression { $$ = create_unary_expression($1, $2); }
-    | unary_op unary_expression { $$ = create_unary_expression($1, $2); }
-    | "sizeof" unary_expression { $$ = create_unary_expression($1, $2); }
-    | "sizeof" '(' type_name ')' { $$ = create_unary_expression($1, NULL); /* FIXME */ }
-    | "alignof" '(' type_name ')' { $$ = create_unary_expression($1, NULL); /* FIXME */ }
+    | "++" unary_expression { $$ = create_unary_expression(&$1, $2); }
+    | "--" unary_expression { $$ = create_unary_expression(&$1, $2); }
+    | unary_op unary_expression { $$ = create_unary_expression(&$1, $2); }
+    | "sizeof" unary_expression { $$ = create_unary_expression(&$1, $2); }
+    | "sizeof" '(' type_name ')' { $$ = create_unary_expression(&$1, NO_NODE); /* FIXME */ }
+    | "alignof" '(' type_name ')' { $$ = create_unary_expression(&$1, NO_NODE); /* FIXME */ }
 
   unary_op: '&' { $$ = $1; }
     | '*' { $$ = $1; }
@@ -227,49 +253,33 @@ struct id *register_type(struct id *new_type);
   cast_expression: unary_expression %dprec 2 { $$ = $1; }
     | '(' type_name ')' cast_expression %dprec 1 { $$ = create_cast_expression($2, $4); }
 
-  multiplicative_expression: cast_expression { $$ = $1; }
-    | multiplicative_expression '*' cast_expression { $$ = create_binary_expression($1, $2, $3); }
-    | multiplicative_expression '/' cast_expression { $$ = create_binary_expression($1, $2, $3); }
-    | multiplicative_expression '%' cast_expression { $$ = create_binary_expression($1, $2, $3); }
-
-  additive_expression: multiplicative_expression
-    | additive_expression '+' multiplicative_expression { $$ = create_binary_expression($1, $2, $3); }
-    | additive_expression '-' multiplicative_expression { $$ = create_binary_expression($1, $2, $3); }
-
-  shift_expression: additive_expression  { $$ = $1; }
-    | shift_expression "<<" additive_expression { $$ = create_binary_expression($1, $2, $3); }
-    | shift_expression ">>" additive_expression { $$ = create_binary_expression($1, $2, $3); }
-
-  relational_expression: shift_expression  { $$ = $1; }
-    | relational_expression '<' shift_expression { $$ = create_binary_expression($1, $2, $3); }
-    | relational_expression '>' shift_expression { $$ = create_binary_expression($1, $2, $3); }
-    | relational_expression "<=" shift_expression { $$ = create_binary_expression($1, $2, $3); }
-    | relational_expression ">=" shift_expression { $$ = create_binary_expression($1, $2, $3); }
-
-  equality_expression: relational_expression  { $$ = $1; }
-    | equality_expression "==" relational_expression{ $$ = create_binary_expression($1, $2, $3); }
-    | equality_expression "!=" relational_expression { $$ = create_binary_expression($1, $2, $3); }
-
-  and_expression: equality_expression  { $$ = $1; }
-    | and_expression '&' equality_expression { $$ = create_binary_expression($1, $2, $3); }
-
-  xor_expression: and_expression  { $$ = $1; }
-    | xor_expression '^' and_expression { $$ = create_binary_expression($1, $2, $3); }
-
-  or_expression: xor_expression  { $$ = $1; }
-    | or_expression '|' xor_expression { $$ = create_binary_expression($1, $2, $3); }
-
-  logical_and_expression: or_expression  { $$ = $1; }
-    | logical_and_expression "&&" or_expression { $$ = create_binary_expression($1, $2, $3); }
-
-  logical_or_expression: logical_and_expression  { $$ = $1; }
-    | logical_or_expression "||" logical_and_expression { $$ = create_binary_expression($1, $2, $3); }
-
-  conditional_expression: logical_or_expression  { $$ = $1; }
-    | logical_or_expression '?' expression ':' conditional_expression { $$ = create_ternary_expression($1, $3, $5); }
+  // Binary operators take one reduction each, with the precedence declared
+  // for them above instead of a nonterminal per level.
+  binary_expression: cast_expression { $$ = $1; }
+    | binary_expression '*' binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression '/' binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression '%' binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression '+' binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression '-' binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression "<<" binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression ">>" binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression '<' binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression '>' binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression "<=" binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression ">=" binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression "==" binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression "!=" binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression '&' binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression '^' binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression '|' binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression "&&" binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+    | binary_expression "||" binary_expression { $$ = create_binary_expression($1, &$2, $3); }
+
+  conditional_expression: binary_expression  { $$ = $1; }
+    | binary_expression '?' expression ':' conditional_expression { $$ = create_ternary_expression($1, $3, $5); }
 
   assignment_expression: conditional_expression  { $$ = $1; }
-    | unary_expression assignment_op assignment_expression { $$ = create_binary_expression($1, $2, $3); }
+    | unary_expression assignment_op assignment_expression { $$ = create_binary_expression($1, &$2, $3); }
 
   assignment_op: '=' { $$ = $1; }
     | "*=" { $$ = $1; }
@@ -284,16 +294,16 @@ struct id *register_type(struct id *new_type);
     | "|=" { $$ = $1; }
 
   expression: assignment_expression  { $$ = $1; }
-    | expression ',' assignment_expression { $$ = create_binary_expression($1, $2, $3); }
+    | expression ',' assignment_expression { $$ = create_binary_expression($1, &$2, $3); }
 
   constant_expression: conditional_expression  { $$ = $1; }
 
   /* Declarations (following A.2.2) */
-  declaration: declaration_specifiers ';' %dprec 2 { $$ = create_variable_declaration($1, NULL); }
+  declaration: declaration_specifiers ';' %dprec 2 { $$ = create_variable_declaration($1, NO_NODE); }
     |  declaration_specifiers init_declarator_list ';' %dprec 1 { $$ = create_variable_declaration($1, $2); }
     |  attribute_specifier_sequence declaration_specifiers init_declarator_list ';' { $$ = create_variable_declaration($2, $3); }
-    |  static_assert_declaration { $$ = NULL; /* FIXME */ }
-    |  attribute_declaration { $$ = NULL; /* FIXME */ }
+    |  static_assert_declaration { $$ = NO_NODE; /* FIXME */ }
+    |  attribute_declaration { $$ = NO_NODE; /* FIXME */ }
     |  attribute_specifier_sequence_opt typedef_declaration { $$ = $2; }
 
   declaration_specifiers: declaration_specifier attribute_specifier_sequence_opt { $$ = create_specifier_list($1); }
@@ -306,7 +316,7 @@ struct id *register_type(struct id *new_type);
   init_declarator_list: init_declarator { $$ = create_init_declarator_list($1); }
     | init_declarator_list ',' init_declarator { $$ = append_initialized_declarator($1, $3); }
 
-  init_declarator: declarator { $$ = create_initialized_declarator($1, NULL); }
+  init_declarator: declarator { $$ = create_initialized_declarator($1, NO_NODE); }
     | declarator '=' initializer { $$ = create_initialized_declarator($1, $3); }
 
   attribute_declaration: attribute_specifier_sequence ';';
@@ -318,28 +328,28 @@ struct id *register_type(struct id *new_type);
   typedef_declarator: declarator { $$ = register_type($1); }
 
   /* `typedef` was removed from this rule. */
-  storage_class_specifier: "auto" { $$ = create_token_specifier($1); }
-    | "constexpr" { $$ = create_token_specifier($1); }
-    | "extern" { $$ = create_token_specifier($1); }
-    | "register" { $$ = create_token_specifier($1); }
-    | "static" { $$ = create_token_specifier($1); }
-    | "thread_local" { $$ = create_token_specifier($1); }
-
-  type_specifier: "void" { $$ = create_token_specifier($1); }
-    | "bool" { $$ = create_token_specifier($1); }
-    | "char" { $$ = create_token_specifier($1); }
-    | "short" { $$ = create_token_specifier($1); }
-    | "int" { $$ = create_token_specifier($1); }
-    | "long" { $$ = create_token_specifier($1); }
-    | "float" { $$ = create_token_specifier($1); }
-    | "double" { $$ = create_token_specifier($1); }
-    | "signed" { $$ = create_token_specifier($1); }
-    | "unsigned" { $$ = create_token_specifier($1); }
-    | "_BitInt" '(' constant_expression ')' { $$ = create_token_specifier($1); /* FIXME */}
-    | "_Complex" { $$ = create_token_specifier($1); }
-    | "_Decimal32" { $$ = create_token_specifier($1); }
-    | "_Decimal64" { $$ = create_token_specifier($1); }
-    | "_Decimal128" { $$ = create_token_specifier($1); }
+  storage_class_specifier: "auto" { $$ = create_token_specifier(&$1); }
+    | "constexpr" { $$ = create_token_specifier(&$1); }
+    | "extern" { $$ = create_token_specifier(&$1); }
+    | "register" { $$ = create_token_specifier(&$1); }
+    | "static" { $$ = create_token_specifier(&$1); }
+    | "thread_local" { $$ = create_token_specifier(&$1); }
+
+  type_specifier: "void" { $$ = create_token_specifier(&$1); }
+    | "bool" { $$ = create_token_specifier(&$1); }
+    | "char" { $$ = create_token_specifier(&$1); }
+    | "short" { $$ = create_token_specifier(&$1); }
+    | "int" { $$ = create_token_specifier(&$1); }
+    | "long" { $$ = create_token_specifier(&$1); }
+    | "float" { $$ = create_token_specifier(&$1); }
+    | "double" { $$ = create_token_specifier(&$1); }
+    | "signed" { $$ = create_token_specifier(&$1); }
+    | "unsigned" { $$ = create_token_specifier(&$1); }
+    | "_BitInt" '(' constant_expression ')' { $$ = create_token_specifier(&$1); /* FIXME */}
+    | "_Complex" { $$ = create_token_specifier(&$1); }
+    | "_Decimal32" { $$ = create_token_specifier(&$1); }
+    | "_Decimal64" { $$ = create_token_specifier(&$1); }
+    | "_Decimal128" { $$ = create_token_specifier(&$1); }
     | atomic_type_specifier { $$ = $1; }
     | struct_or_union_specifier { $$ = $1; }
     | enum_specifier { $$ = $1; }
@@ -347,8 +357,8 @@ struct id *register_type(struct id *new_type);
     | typeof_specifier { $$ = $1; }
 
   struct_or_union_specifier:
-  struct_or_union attribute_specifier_sequence_opt identifier_opt '{' member_declaration_list '}' { $$ = create_token_specifier($1); /* FIXME */}
-    | struct_or_union attribute_specifier_sequence_opt ID { $$ = create_token_specifier($1); /* FIXME */}
+  struct_or_union attribute_specifier_sequence_opt identifier_opt '{' member_declaration_list '}' { $$ = create_token_specifier(&$1); /* FIXME */}
+    | struct_or_union attribute_specifier_sequence_opt ID { $$ = create_token_specifier(&$1); /* FIXME */}
 
   struct_or_union: "struct" { $$ = $1; }
     | "union" { $$ = $1; }
@@ -374,8 +384,8 @@ struct id *register_type(struct id *new_type);
     | declarator_opt ':' constant_expression;
 
   enum_specifier:
-  "enum" attribute_specifier_sequence_opt identifier_opt enum_type_specifier_opt '{' enumerator_list comma_opt '}' { $$ = create_token_specifier($1); /* FIXME */}
-    | "enum" ID enum_type_specifier_opt { $$ = create_token_specifier($1); /* FIXME */}
+  "enum" attribute_specifier_sequence_opt identifier_opt enum_type_specifier_opt '{' enumerator_list comma_opt '}' { $$ = create_token_specifier(&$1); /* FIXME */}
+    | "enum" ID enum_type_specifier_opt { $$ = create_token_specifier(&$1); /* FIXME */}
 
   enumerator_list: enumerator
     | enumerator_list ',' enumerator;
@@ -385,28 +395,28 @@ struct id *register_type(struct id *new_type);
 
   enum_type_specifier: ':' specifier_qualifier_list;
 
-  atomic_type_specifier: "_Atomic" '(' type_name ')' { $$ = create_token_specifier($1); /* FIXME */}
+  atomic_type_specifier: "_Atomic" '(' type_name ')' { $$ = create_token_specifier(&$1); /* FIXME */}
 
-  typeof_specifier: "typeof" '(' typeof_specifier_argument ')' { $$ = create_token_specifier($1); /* FIXME */}
-    | "typeof_unqual" '(' typeof_specifier_argument ')' { $$ = create_token_specifier($1); /* FIXME */}
+  typeof_specifier: "typeof" '(' typeof_specifier_argument ')' { $$ = create_token_specifier(&$1); /* FIXME */}
+    | "typeof_unqual" '(' typeof_specifier_argument ')' { $$ = create_token_specifier(&$1); /* FIXME */}
 
   typeof_specifier_argument: expression
     | type_name;
 
-  type_qualifier: "const" { $$ = create_token_specifier($1); }
-    | "restrict" { $$ = create_token_specifier($1); }
-    | "volatile" { $$ = create_token_specifier($1); }
-    | "_Atomic" { $$ = create_token_specifier($1); }
+  type_qualifier: "const" { $$ = create_token_specifier(&$1); }
+    | "restrict" { $$ = create_token_specifier(&$1); }
+    | "volatile" { $$ = create_token_specifier(&$1); }
+    | "_Atomic" { $$ = create_token_specifier(&$1); }
 
-  function_specifier: "inline" { $$ = create_token_specifier($1); }
-    | "_Noreturn" { $$ = create_token_specifier($1); }
+  function_specifier: "inline" { $$ = create_token_specifier(&$1); }
+    | "_Noreturn" { $$ = create_token_specifier(&$1); }
 
-  alignment_specifier: "alignas" '(' type_name ')' { $$ = create_token_specifier($1); /* FIXME */}
-    | "alignas" '(' constant_expression ')' { $$ = create_token_specifier($1); /* FIXME */}
+  alignment_specifier: "alignas" '(' type_name ')' { $$ = create_token_specifier(&$1); /* FIXME */}
+    | "alignas" '(' constant_expression ')' { $$ = create_token_specifier(&$1); /* FIXME */}
 
   declarator: pointer_opt direct_declarator { $$ = $2; }
 
-  direct_declarator: ID attribute_specifier_sequence_opt { $$ = create_id($1); }
+  direct_declarator: ID attribute_specifier_sequence_opt { $$ = create_id(&$1); }
     | '(' declarator ')' { $$ = $2; }
     | array_declarator attribute_specifier_sequence_opt { $$ = $1; }
     // | function_declarator attribute_specifier_sequence_opt { $$ = $1; }
@@ -425,7 +435,7 @@ struct id *register_type(struct id *new_type);
 
   parameter_type_list: parameter_list { $$ = $1; }
     | parameter_list ',' "..." { $$ = $1; /* FIXME */}
-    | "..." { $$ = NULL; /* FIXME */}
+    | "..." { $$ = NO_NODE; /* FIXME */}
 
   parameter_list: parameter_declaration { $$ = create_declaration_list($1); }
     | parameter_list ',' parameter_declaration { $$ = append_declaration($1, $3); }
@@ -437,8 +447,8 @@ struct id *register_type(struct id *new_type);
   parameter_declarator_l: parameter_declarator { $$ = create_init_declarator_list($1); }
 
   /* The following rule does not appear in the spec. */
-  parameter_declarator: declarator %dprec 2 { $$ = create_initialized_declarator($1, NULL); }
-    | abstract_declarator_opt %dprec 1 { $$ = NULL; }
+  parameter_declarator: declarator %dprec 2 { $$ = create_initialized_declarator($1, NO_NODE); }
+    | abstract_declarator_opt %dprec 1 { $$ = NO_NODE; }
 
   type_name: specifier_qualifier_list abstract_declarator_opt { $$ = $1; }
 
@@ -460,14 +470,14 @@ struct id *register_type(struct id *new_type);
     The ID should have been registered by the lexer hack already. ID was
     replaced by TYPE_ALIAS
   */
-  typedef_name: TYPE_ALIAS { $$ = create_id($1); }
+  typedef_name: TYPE_ALIAS { $$ = create_id(&$1); }
 
   braced_initializer: '{' '}'
     | '{' initializer_list '}'
     | '{' initializer_list ',' '}';
 
   initializer: assignment_expression { $$ = $1; }
-    | braced_initializer { $$ = NULL; }
+    | braced_initializer { $$ = NO_NODE; }
 
   initializer_list_member: designation_opt initializer;
   initializer_list: initializer_list_member
@@ -547,8 +557,8 @@ struct id *register_type(struct id *new_type);
   expression_statement: expression_opt ';' { $$ = create_expr_stmt($1); }
     | attribute_specifier_sequence expression ';' { $$ = create_expr_stmt($2); }
 
-  selection_statement: "if" '(' expression ')' secondary_block %dprec 1 { $$ = create_if_stmt($3, $5, NULL); }
-    | "if" '(' expression ')' secondary_block "else" secondary_block %dprec 2 { $$ = create_if_stmt($3, $5, $7); }
+  selection_statement: "if" '(' expression ')' secondary_block %prec THEN { $$ = create_if_stmt($3, $5, NO_NODE); }
+    | "if" '(' expression ')' secondary_block "else" secondary_block { $$ = create_if_stmt($3, $5, $7); }
     | "switch" '(' expression ')' secondary_block { $$ = create_switch_stmt($3, $5); }
 
   iteration_statement: "while" '(' expression ')' secondary_block { $$ = create_while_stmt($3, $5); }
@@ -562,7 +572,7 @@ struct id *register_type(struct id *new_type);
     | "return" expression_opt ';' { $$ = create_return_stmt($2); }
 
   /* The following non-terminal definitions do not appear in spec. */
-  identifier: ID { $$ = create_id($1); }
+  identifier: ID { $$ = create_id(&$1); }
   id_expression: identifier { $$ = create_id_expression($1); }
   identifier_opt: %empty | ID;
   balanced_token_sequence_opt: %empty | balanced_token_sequence;
@@ -571,19 +581,19 @@ struct id *register_type(struct id *new_type);
   designation_opt: %empty | designation;
   direct_abstract_declarator_opt: %empty | direct_abstract_declarator;
   abstract_declarator_opt: %empty | abstract_declarator;
-  parameter_type_list_opt: %empty { $$ = NULL; }
+  parameter_type_list_opt: %empty { $$ = NO_NODE; }
     | parameter_type_list { $$ = $1; }
   assignment_expression_opt: %empty | assignment_expression;
   type_qualifier_list_opt: %empty | type_qualifier_list;
   pointer_opt: %empty | pointer;
   declarator_opt: %empty | declarator;
   enum_type_specifier_opt: %empty | enum_type_specifier;
-  argument_expression_list_opt: %empty { $$ = create_expr_list(NULL); }
+  argument_expression_list_opt: %empty { $$ = create_expr_list(NO_NODE); }
     | argument_expression_list { $$ = $1; }
   storage_class_specifiers_opt: %empty | storage_class_specifiers;
   attribute_specifier_sequence_opt: %empty | attribute_specifier_sequence;
-  expression_opt: %empty { $$ = NULL; } | expression { $$ = $1; }
-  block_item_list_opt: %empty { $$ = NULL; }
+  expression_opt: %empty { $$ = NO_NODE; } | expression { $$ = $1; }
+  block_item_list_opt: %empty { $$ = NO_NODE; }
     | block_item_list { $$ = $1; }
 
   // For trailing comma support
@@ -593,22 +603,51 @@ struct id *register_type(struct id *new_type);
   enumeration_constant: ID;
 %%
 
-Token *cur;
-Token *next;
+// Copy of the last token handed to the parser, for error reporting.
+_Thread_local Token cur;
 
-struct type_alias {
-  const char *type_name;
-  struct type_alias *next;
-};
+// Tokens handed to the parser instead of the preprocessor's, see
+// parse_tokens().
+_Thread_local struct replay {
+  const Token *tokens;
+  size_t count;
+  size_t index;
+  // Past them.
+  Token end;
+} replay;
+
+_Thread_local struct type_alias *alias_list = NULL;
+
+#define INITIAL_ALIAS_SLOTS 256
+#define INITIAL_SCOPE_CAPACITY 16
 
-struct type_alias *alias_list = NULL;
+// The newest entry of alias_list for a name, or NULL if it is not in it.
+struct alias_slot {
+  intern_t name;
+  struct type_alias *newest;
+};
 
-void init_parser(Token *list) {
+// Indexes alias_list by name with open addressing. Names stay in their slot
+// when their last entry is forgotten, so removing needs no tombstones, and
+// are dropped when the table grows.
+_Thread_local struct alias_table {
+  struct alias_slot *slots;
+  size_t capacity;
+  size_t count;
+
+  // alias_list when each block scope still open was entered.
+  struct type_alias **scopes;
+  size_t scope_count;
+  size_t scope_capacity;
+} aliases;
+
+void init_parser(void) {
 #if YYDEBUG
   yydebug = 1;
 #endif
-  cur = NULL;
-  next = list;
+  cur = (Token){.kind = EOF};
+  // A parse that failed with an error may not have dropped its tokens.
+  replay = (struct replay){0};
 }
 
 void free_type_alias_memory(void) {
@@ -620,162 +659,362 @@ void free_type_alias_memory(void) {
     free(cur);
     cur = next;
   }
+
+  alias_list = NULL;
+
+  free(aliases.slots);
+  free(aliases.scopes);
+  aliases = (struct alias_table){0};
 }
 
-int get_keyword() {
-  if (!next)
-    return YYUNDEF;
-
-  if (strcmp(next->data, "alignas") == 0) return K_alignas;
-  if (strcmp(next->data, "alignof") == 0) return K_alignof;
-  if (strcmp(next->data, "auto") == 0) return K_auto;
-  if (strcmp(next->data, "bool") == 0) return K_bool;
-  if (strcmp(next->data, "break") == 0) return K_break;
-  if (strcmp(next->data, "case") == 0) return K_case;
-  if (strcmp(next->data, "char") == 0) return K_char;
-  if (strcmp(next->data, "const") == 0) return K_const;
-  if (strcmp(next->data, "constexpr") == 0) return K_constexpr;
-  if (strcmp(next->data, "continue") == 0) return K_continue;
-  if (strcmp(next->data, "default") == 0) return K_default;
-  if (strcmp(next->data, "do") == 0) return K_do;
-  if (strcmp(next->data, "double") == 0) return K_double;
-  if (strcmp(next->data, "else") == 0) return K_else;
-  if (strcmp(next->data, "enum") == 0) return K_enum;
-  if (strcmp(next->data, "extern") == 0) return K_extern;
-  if (strcmp(next->data, "float") == 0) return K_float;
-  if (strcmp(next->data, "for") == 0) return K_for;
-  if (strcmp(next->data, "goto") == 0) return K_goto;
-  if (strcmp(next->data, "if") == 0) return K_if;
-  if (strcmp(next->data, "inline") == 0) return K_inline;
-  if (strcmp(next->data, "int") == 0) return K_int;
-  if (strcmp(next->data, "long") == 0) return K_long;
-  if (strcmp(next->data, "register") == 0) return K_register;
-  if (strcmp(next->data, "restrict") == 0) return K_restrict;
-  if (strcmp(next->data, "return") == 0) return K_return;
-  if (strcmp(next->data, "short") == 0) return K_short;
-  if (strcmp(next->data, "signed") == 0) return K_signed;
-  if (strcmp(next->data, "sizeof") == 0) return K_sizeof;
-  if (strcmp(next->data, "static") == 0) return K_static;
-  if (strcmp(next->data, "static_assert") == 0) return K_static_assert;
-  if (strcmp(next->data, "struct") == 0) return K_struct;
-  if (strcmp(next->data, "switch") == 0) return K_switch;
-  if (strcmp(next->data, "thread_local") == 0) return K_thread_local;
-  if (strcmp(next->data, "typedef") == 0) return K_typedef;
-  if (strcmp(next->data, "typeof") == 0) return K_typeof;
-  if (strcmp(next->data, "typeof_unqual") == 0) return K_typeof_unqual;
-  if (strcmp(next->data, "union") == 0) return K_union;
-  if (strcmp(next->data, "unsigned") == 0) return K_unsigned;
-  if (strcmp(next->data, "void") == 0) return K_void;
-  if (strcmp(next->data, "volatile") == 0) return K_volatile;
-  if (strcmp(next->data, "while") == 0) return K_while;
-  if (strcmp(next->data, "_Atomic") == 0) return K__Atomic;
-  if (strcmp(next->data, "_BitInt") == 0) return K__BitInt;
-  if (strcmp(next->data, "_Complex") == 0) return K__Complex;
-  if (strcmp(next->data, "_Decimal128") == 0) return K__Decimal128;
-  if (strcmp(next->data, "_Decimal32") == 0) return K__Decimal32;
-  if (strcmp(next->data, "_Decimal64") == 0) return K__Decimal64;
-  if (strcmp(next->data, "_Generic") == 0) return K__Generic;
-  if (strcmp(next->data, "_Imaginary") == 0) return K__Imaginary;
-  if (strcmp(next->data, "_Noreturn") == 0) return K__Noreturn;
-
-  return YYUNDEF;
+// Maps the scanner's token codes onto Bison token kinds. Digraphs were already
+// folded into the punctuator they spell by the scanner.
+static const int token_table[TC_COUNT] = {
+  [TC_NONE] = YYUNDEF,
+  [KW_alignas] = K_alignas,
+  [KW_alignof] = K_alignof,
+  [KW_auto] = K_auto,
+  [KW_bool] = K_bool,
+  [KW_break] = K_break,
+  [KW_case] = K_case,
+  [KW_char] = K_char,
+  [KW_const] = K_const,
+  [KW_constexpr] = K_constexpr,
+  [KW_continue] = K_continue,
+  [KW_default] = K_default,
+  [KW_do] = K_do,
+  [KW_double] = K_double,
+  [KW_else] = K_else,
+  [KW_enum] = K_enum,
+  [KW_extern] = K_extern,
+  [KW_float] = K_float,
+  [KW_for] = K_for,
+  [KW_goto] = K_goto,
+  [KW_if] = K_if,
+  [KW_inline] = K_inline,
+  [KW_int] = K_int,
+  [KW_long] = K_long,
+  [KW_register] = K_register,
+  [KW_restrict] = K_restrict,
+  [KW_return] = K_return,
+  [KW_short] = K_short,
+  [KW_signed] = K_signed,
+  [KW_sizeof] = K_sizeof,
+  [KW_static] = K_static,
+  [KW_static_assert] = K_static_assert,
+  [KW_struct] = K_struct,
+  [KW_switch] = K_switch,
+  [KW_thread_local] = K_thread_local,
+  [KW_typedef] = K_typedef,
+  [KW_typeof] = K_typeof,
+  [KW_typeof_unqual] = K_typeof_unqual,
+  [KW_union] = K_union,
+  [KW_unsigned] = K_unsigned,
+  [KW_void] = K_void,
+  [KW_volatile] = K_volatile,
+  [KW_while] = K_while,
+  [KW__Atomic] = K__Atomic,
+  [KW__BitInt] = K__BitInt,
+  [KW__Complex] = K__Complex,
+  [KW__Decimal128] = K__Decimal128,
+  [KW__Decimal32] = K__Decimal32,
+  [KW__Decimal64] = K__Decimal64,
+  [KW__Generic] = K__Generic,
+  [KW__Imaginary] = K__Imaginary,
+  [KW__Noreturn] = K__Noreturn,
+  [PC_false] = CONST,
+  [PC_nullptr] = CONST,
+  [PC_true] = CONST,
+  [PU_LBRACKET] = '[',
+  [PU_RBRACKET] = ']',
+  [PU_LPAREN] = '(',
+  [PU_RPAREN] = ')',
+  [PU_LBRACE] = '{',
+  [PU_RBRACE] = '}',
+  [PU_PERIOD] = '.',
+  [PU_ARROW] = P_ARROW,
+  [PU_INC] = P_INC,
+  [PU_DEC] = P_DEC,
+  [PU_AMP] = '&',
+  [PU_STAR] = '*',
+  [PU_PLUS] = '+',
+  [PU_MINUS] = '-',
+  [PU_TILDE] = '~',
+  [PU_BANG] = '!',
+  [PU_SLASH] = '/',
+  [PU_PERCENT] = '%',
+  [PU_SHFL] = P_SHFL,
+  [PU_SHFR] = P_SHFR,
+  [PU_LT] = '<',
+  [PU_GT] = '>',
+  [PU_LTE] = P_LTE,
+  [PU_GTE] = P_GTE,
+  [PU_EE] = P_EE,
+  [PU_NE] = P_NE,
+  [PU_CARET] = '^',
+  [PU_PIPE] = '|',
+  [PU_LAND] = P_LAND,
+  [PU_LOR] = P_LOR,
+  [PU_QUESTION] = '?',
+  [PU_COLON] = ':',
+  [PU_DCOLON] = P_DCOLON,
+  [PU_SEMICOLON] = ';',
+  [PU_ELLIPSIS] = P_ELLIPSIS,
+  [PU_EQ] = '=',
+  [PU_STARE] = P_STARE,
+  [PU_SLASHE] = P_SLASHE,
+  [PU_PERCENTE] = P_PERCENTE,
+  [PU_PLUSE] = P_PLUSE,
+  [PU_MINUSE] = P_MINUSE,
+  [PU_SHFLE] = P_SHFLE,
+  [PU_SHFRE] = P_SHFRE,
+  [PU_ANDE] = P_ANDE,
+  [PU_CARATE] = P_CARATE,
+  [PU_ORE] = P_ORE,
+  [PU_COMMA] = ',',
+  [PU_HASH] = '#',
+  [PU_DHASH] = P_DHASH,
+};
+
+// The slot of a name, or the empty one it would take.
+struct alias_slot *find_alias_slot(intern_t name) {
+  size_t mask = aliases.capacity - 1;
+  size_t i = interned_hash(name) & mask;
+
+  while (aliases.slots[i].name != name && aliases.slots[i].name != NO_INTERN) {
+    i = (i + 1) & mask;
+  }
+
+  return &aliases.slots[i];
 }
 
-int get_punct() {
-  if (!next)
-    return YYUNDEF;
+void grow_alias_table(void) {
+  struct alias_slot *old = aliases.slots;
+  size_t old_capacity = aliases.capacity;
+  size_t capacity = old_capacity ? old_capacity * 2 : INITIAL_ALIAS_SLOTS;
 
-  const char *comp = next->data;
+  aliases.slots = calloc(capacity, sizeof(struct alias_slot));
 
-  if (next->length == 1) {
-    return comp[0];
+  if (aliases.slots == NULL) {
+    CRITICAL("parser", "Out of memory!");
   }
 
-  if (strcmp(comp, "->") == 0) return P_ARROW;
-  if (strcmp(comp, "++") == 0) return P_INC;
-  if (strcmp(comp, "--") == 0) return P_DEC;
-  if (strcmp(comp, "<<") == 0) return P_SHFL;
-  if (strcmp(comp, ">>") == 0) return P_SHFR;
-  if (strcmp(comp, "<=") == 0) return P_LTE;
-  if (strcmp(comp, ">=") == 0) return P_GTE;
-  if (strcmp(comp, "==") == 0) return P_EE;
-  if (strcmp(comp, "!=") == 0) return P_NE;
-  if (strcmp(comp, "&&") == 0) return P_LAND;
-  if (strcmp(comp, "||") == 0) return P_LOR;
-  if (strcmp(comp, "::") == 0) return P_DCOLON;
-  if (strcmp(comp, "...") == 0) return P_ELLIPSIS;
-  if (strcmp(comp, "*=") == 0) return P_STARE;
-  if (strcmp(comp, "/=") == 0) return P_SLASHE;
-  if (strcmp(comp, "%=") == 0) return P_PERCENTE;
-  if (strcmp(comp, "+=") == 0) return P_PLUSE;
-  if (strcmp(comp, "-=") == 0) return P_MINUSE;
-  if (strcmp(comp, "<<=") == 0) return P_SHFLE;
-  if (strcmp(comp, ">>=") == 0) return P_SHFRE;
-  if (strcmp(comp, "&=") == 0) return P_ANDE;
-  if (strcmp(comp, "^=") == 0) return P_CARATE;
-  if (strcmp(comp, "|=") == 0) return P_ORE;
-  if (strcmp(comp, "##") == 0) return P_DHASH;
-
-  // See ISO/IEC 9899:2023 § 6.4.6 cl. 3
-  if (strcmp(comp, "<:") == 0) return '[';
-  if (strcmp(comp, ":>") == 0) return ']';
-  if (strcmp(comp, "<%") == 0) return '{';
-  if (strcmp(comp, "%>") == 0) return '}';
-  if (strcmp(comp, "%:") == 0) return '#';
-  if (strcmp(comp, "%:%:") == 0) return P_DHASH;
-
-  return YYUNDEF;
+  aliases.capacity = capacity;
+  aliases.count = 0;
+
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old[i].newest) {
+      *find_alias_slot(old[i].name) = old[i];
+      aliases.count++;
+    }
+  }
+
+  free(old);
+}
+
+void index_alias(struct type_alias *alias) {
+  if ((aliases.count + 1) * 2 > aliases.capacity) {
+    grow_alias_table();
+  }
+
+  struct alias_slot *slot = find_alias_slot(alias->type_name);
+
+  if (slot->name == NO_INTERN) {
+    slot->name = alias->type_name;
+    aliases.count++;
+  }
+
+  alias->shadowed = slot->newest;
+  slot->newest = alias;
+}
+
+// Only for the newest entry of its name.
+void unindex_alias(const struct type_alias *alias) {
+  find_alias_slot(alias->type_name)->newest = alias->shadowed;
 }
 
-struct id *register_type(struct id *new_type) {
+void push_type_alias(intern_t name, bool hidden) {
   struct type_alias *new_alias = malloc(sizeof(struct type_alias));
 
   if (new_alias == NULL) {
-    ERROR("parser", "Out of memory!");
+    CRITICAL("parser", "Out of memory!");
   }
 
+  new_alias->type_name = name;
+  new_alias->hidden = hidden;
+  new_alias->next = alias_list;
+  index_alias(new_alias);
+  alias_list = new_alias;
+}
+
+void add_type_alias(intern_t name) {
+  push_type_alias(name, false);
+}
+
+id_ref register_type(id_ref type) {
+  const struct id *new_type = id_at(type);
+
 #ifndef NDEBUG
-  DEBUG("Registering %s... (line %zu:%zu)",
-    new_type->name->data,
-    new_type->name->span.start.line_number,
-    new_type->name->span.start.column
+  Coord pos = location_coord(new_type->name.location);
+  DEBUG("Registering %.*s... (line %zu:%zu)",
+    (int)new_type->name.length, new_type->name.data,
+    pos.line_number, pos.column
   );
 #endif
 
-  new_alias->type_name = new_type->name->data; // Bad object sharing...
-  new_alias->next = alias_list;
-  alias_list = new_alias;
+  add_type_alias(new_type->name.interned);
+
+  return type;
+}
+
+void hide_type_alias(intern_t name) {
+  if (aliases.scope_count > 0 && is_type_alias(name)) {
+    push_type_alias(name, true);
+  }
+}
+
+bool is_type_alias(intern_t name) {
+  if (aliases.capacity == 0) {
+    return false;
+  }
 
-  return new_type;
+  const struct type_alias *newest = find_alias_slot(name)->newest;
+  return newest != NULL && !newest->hidden;
 }
 
-int is_next_type_alias(void) {
-  for (struct type_alias *cur = alias_list; cur != NULL; cur = cur->next) {
-    if (strcmp(next->data, cur->type_name) == 0) {
-      return TYPE_ALIAS;
+void enter_type_scope(void) {
+  if (aliases.scope_count == aliases.scope_capacity) {
+    size_t capacity = aliases.scope_capacity ? aliases.scope_capacity * 2
+                                             : INITIAL_SCOPE_CAPACITY;
+    struct type_alias **scopes =
+      realloc(aliases.scopes, capacity * sizeof(struct type_alias *));
+
+    if (scopes == NULL) {
+      CRITICAL("parser", "Out of memory!");
     }
+
+    aliases.scopes = scopes;
+    aliases.scope_capacity = capacity;
   }
 
+  aliases.scopes[aliases.scope_count++] = alias_list;
+}
+
+void leave_type_scope(void) {
+  forget_type_aliases(aliases.scopes[--aliases.scope_count]);
+}
+
+size_t type_scope_depth(void) {
+  return aliases.scope_count;
+}
+
+void forget_type_aliases(struct type_alias *newest) {
+  while (alias_list != newest) {
+    struct type_alias *next = alias_list->next;
+    unindex_alias(alias_list);
+    free(alias_list);
+    alias_list = next;
+  }
+}
+
+void set_type_aliases(struct type_alias *list) {
+  size_t added = 0;
+  struct type_alias *cur = list;
+
+  while (cur != alias_list && cur != NULL) {
+    cur = cur->next;
+    added++;
+  }
+
+  // Unless `list` is on top of the current one, unindex down to where they
+  // meet, or all of it.
+  if (cur != alias_list) {
+    while (alias_list != list && alias_list != NULL) {
+      unindex_alias(alias_list);
+      alias_list = alias_list->next;
+    }
+
+    if (alias_list == list) {
+      return;
+    }
+  }
+
+  struct type_alias **added_aliases =
+    malloc(added * sizeof(struct type_alias *));
+
+  if (added > 0 && added_aliases == NULL) {
+    CRITICAL("parser", "Out of memory!");
+  }
+
+  cur = list;
+
+  for (size_t i = 0; i < added; i++) {
+    added_aliases[i] = cur;
+    cur = cur->next;
+  }
+
+  // The oldest first, so each shadows the one before.
+  while (added > 0) {
+    index_alias(added_aliases[--added]);
+  }
+
+  free(added_aliases);
+  alias_list = list;
+}
+
+int is_next_type_alias(const Token *next) {
   // Only ID's can possibly be a TYPE_ALIAS
-  return ID;
+  return is_type_alias(next->interned) ? TYPE_ALIAS : ID;
+}
+
+const Token *replay_token(void) {
+  if (replay.index < replay.count) {
+    return &replay.tokens[replay.index++];
+  }
+
+  return &replay.end;
 }
 
-int yylex(void) {
-  if (!next)
-    return YYUNDEF;
+int parse_tokens(const Token *tokens, size_t count) {
+  const Token *last = &tokens[count - 1];
 
+  init_parser();
+  replay = (struct replay){tokens, count, 0, {.kind = EOF}};
+
+  if (last->kind != EOF) {
+    replay.end.location = last->location + last->length;
+    replay.end.data = last->data + last->length;
+  } else {
+    replay.end = *last;
+  }
+
+  size_t scopes = aliases.scope_count;
+  int result = yyparse();
+
+  // A syntax error can leave block scopes open.
+  while (aliases.scope_count > scopes) {
+    leave_type_scope();
+  }
+
+  replay = (struct replay){0};
+  return result;
+}
+
+int yylex(YYSTYPE *lvalp) {
+  // Tokens are preprocessed on demand. Type aliases are classified here,
+  // after every declaration before this token has been reduced and
+  // registered.
+  const Token *next = replay.tokens ? replay_token() : preprocess_token();
   int ret = YYUNDEF;
 
-  yylval.tokenval = next;
+  lvalp->tokenval = *next;
   switch (next->kind) {
   case IDENTIFIER:
     ret = ID;
     break;
   case KEYWORD:
-    ret = get_keyword();
-    break;
   case PUNCT:
-    ret = get_punct();
+    ret = token_table[next->code];
     break;
   case CONSTANT:
     ret = CONST;
@@ -789,31 +1028,42 @@ int yylex(void) {
   }
 
   if (ret == ID) {
-    ret = is_next_type_alias();
+    ret = is_next_type_alias(next);
+  }
+
+  // Any brace starts a scope, those of struct bodies and initializers never
+  // declare typedef names anyway. Declarations before the '}' have been
+  // reduced by now.
+  if (ret == '{') {
+    enter_type_scope();
+  } else if (ret == '}' && aliases.scope_count > 0) {
+    leave_type_scope();
   }
 
-  cur = next;
-  next = next->next;
+  cur = *next;
 
   return ret;
 }
 
 const char *get_token_kind(void) {
-  switch (cur->kind) {
+  switch (cur.kind) {
   case IDENTIFIER: return "identifier";
   case KEYWORD: return "keyword";
   case PUNCT: return "symbol";
   case CONSTANT: return "constant";
   case STRING: return "string literal";
+  case OTHER: return "character";
   default:
   case EOF: return "End of file";
   }
 }
 
 void yyerror(char const *s) {
-  if (cur) {
-    ERRORV("parser", "%s at %s \"%s\" (line %zu:%zu)", s, get_token_kind(), cur->data,
-           cur->span.start.line_number, cur->span.start.column);
+  if (cur.data) {
+    char where[LOCATION_TEXT_SIZE];
+    format_location(cur.location, where, sizeof(where));
+    ERRORV("parser", "%s at %s \"%.*s\" (%s)", s, get_token_kind(),
+           (int)cur.length, cur.data, where);
   } else {
     ERROR("parser", s);
   }
@@ -0,0 +1,937 @@
+#include "pch.h"
+#include "log.h"
+#include "parser.h"
+#include "source.h"
+#include "tree.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PCH_MAGIC "CUPCH\0\0"
+#define PCH_VERSION 1
+
+#define INITIAL_SECTION_CAPACITY 64
+
+// A precompiled header is the header below followed by its sections, in the
+// order of the fields and in native byte order. Every section is aligned by
+// the size of those before it, so the file can be used where it is mapped.
+//
+// Declarations are a pre-order stream of words. Every node starts with its
+// type plus one, or 0 for a NULL node, and every list with its length plus
+// one, or 0 for a NULL list. Tokens are taken in order from the token
+// section as nodes need them.
+struct pch_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t token_count;
+  uint32_t name_count;
+  uint32_t alias_count;
+  uint32_t word_count;
+  uint32_t text_size;
+};
+
+struct pch_token {
+  uint64_t bits;
+  // Offset of the spelling in the text section.
+  uint32_t text;
+  uint32_t length;
+  // Index of the name plus one for interned tokens, 0 otherwise.
+  uint32_t name;
+  kind_t kind;
+  uint8_t code;
+  uint8_t flags;
+  uint8_t constant_type;
+  uint16_t exponent;
+};
+
+// A distinct spelling, interned once when the header is loaded.
+struct pch_name {
+  uint32_t text;
+  uint32_t length;
+};
+
+// The sections of the header being written.
+_Thread_local struct {
+  struct pch_token *tokens;
+  size_t token_count;
+  size_t token_capacity;
+
+  struct pch_name *names;
+  size_t name_count;
+  size_t name_capacity;
+
+  uint32_t *aliases;
+  size_t alias_count;
+  size_t alias_capacity;
+
+  uint32_t *words;
+  size_t word_count;
+  size_t word_capacity;
+
+  char *text;
+  size_t text_size;
+  size_t text_capacity;
+
+  // Index plus one of the name of each interned id, 0 until it is written.
+  uint32_t *name_of;
+  size_t name_of_capacity;
+} out;
+
+// The loaded header, read in place.
+_Thread_local struct {
+  const char *path;
+  SourceBuffer buffer;
+  bool loaded;
+
+  const struct pch_header *header;
+  const struct pch_token *tokens;
+  const struct pch_name *names;
+  const uint32_t *aliases;
+  const uint32_t *words;
+  const char *text;
+
+  // The interned id of each name.
+  intern_t *ids;
+
+  size_t next_token;
+  size_t next_word;
+
+  // Waiting for seed_translation_unit().
+  decl_list_ref declarations;
+} in;
+
+// Writing
+
+/**
+ * Grows an array to hold at least `needed` elements.
+ */
+void *reserve(void *array, size_t *capacity, size_t needed, size_t size) {
+  if (needed <= *capacity) {
+    return array;
+  }
+
+  size_t new_capacity = *capacity ? *capacity : INITIAL_SECTION_CAPACITY;
+
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+
+  void *grown = realloc(array, new_capacity * size);
+
+  if (!grown) {
+    CRITICAL("pch", "Out of memory!");
+  }
+
+  *capacity = new_capacity;
+  return grown;
+}
+
+void put(uint32_t word) {
+  out.words = reserve(out.words, &out.word_capacity, out.word_count + 1,
+                      sizeof(uint32_t));
+  out.words[out.word_count++] = word;
+}
+
+uint32_t write_text(const char *data, size_t length) {
+  if (out.text_size + length + 1 > UINT32_MAX) {
+    CRITICAL("pch", "Precompiled header is too large!");
+  }
+
+  size_t offset = out.text_size;
+
+  out.text =
+    reserve(out.text, &out.text_capacity, offset + length + 1, sizeof(char));
+  memcpy(&out.text[offset], data, length);
+  out.text[offset + length] = '\0';
+  out.text_size += length + 1;
+
+  return offset;
+}
+
+uint32_t write_name(intern_t id) {
+  if (id >= out.name_of_capacity) {
+    size_t old_capacity = out.name_of_capacity;
+
+    out.name_of = reserve(out.name_of, &out.name_of_capacity, id + 1,
+                          sizeof(uint32_t));
+    memset(&out.name_of[old_capacity], 0,
+           (out.name_of_capacity - old_capacity) * sizeof(uint32_t));
+  }
+
+  if (out.name_of[id] == 0) {
+    out.names = reserve(out.names, &out.name_capacity, out.name_count + 1,
+                        sizeof(struct pch_name));
+    out.names[out.name_count].length = interned_length(id);
+    out.names[out.name_count].text =
+      write_text(interned_text(id), interned_length(id));
+    out.name_of[id] = ++out.name_count;
+  }
+
+  return out.name_of[id];
+}
+
+void save_token(const Token *token) {
+  struct pch_token saved = {
+    .bits = token->constant.bits,
+    .length = token->length,
+    .kind = token->kind,
+    .code = token->code,
+    .flags = token->flags,
+    .constant_type = token->constant.type,
+    .exponent = token->constant.exponent,
+  };
+
+  if (token->interned != NO_INTERN) {
+    saved.name = write_name(token->interned);
+  }
+
+  // Names spelled with universal character names are interned in UTF-8, so
+  // their spelling is kept apart.
+  if (saved.name && !(token->flags & TF_UCN)) {
+    saved.text = out.names[saved.name - 1].text;
+  } else {
+    saved.text = write_text(token->data, token->length);
+  }
+
+  out.tokens = reserve(out.tokens, &out.token_capacity, out.token_count + 1,
+                       sizeof(struct pch_token));
+  out.tokens[out.token_count++] = saved;
+}
+
+void save_expression(expr_ref ref);
+void save_statement(stmt_ref ref);
+void save_declaration_list(const struct declaration_list *list);
+
+void save_id(id_ref id) {
+  put(id != NO_NODE);
+
+  if (id) {
+    save_token(&id_at(id)->name);
+  }
+}
+
+void save_specifier_list(spec_list_ref ref) {
+  const struct specifier_list *list = spec_list_at(ref);
+
+  if (!list) {
+    put(0);
+    return;
+  }
+
+  uint32_t count = 0;
+
+  for (spec_ref cur = list->head; cur != NO_NODE; cur = spec_at(cur)->next) {
+    count++;
+  }
+
+  put(count + 1);
+
+  for (const struct specifier *cur = spec_at(list->head); cur != NULL;
+       cur = spec_at(cur->next)) {
+    put(cur->type + 1);
+
+    switch (cur->type) {
+    case TOKEN:
+      save_token(&cur->_token);
+      break;
+    case ID_SPEC:
+      save_id(cur->_id);
+      break;
+    }
+  }
+}
+
+void save_init_declarator_list(init_decl_list_ref ref) {
+  const struct init_declarator_list *list = init_decl_list_at(ref);
+
+  if (!list) {
+    put(0);
+    return;
+  }
+
+  uint32_t count = 0;
+
+  for (init_decl_ref cur = list->head; cur != NO_NODE;
+       cur = init_decl_at(cur)->next) {
+    count++;
+  }
+
+  put(count + 1);
+
+  for (const struct initialized_declarator *cur = init_decl_at(list->head);
+       cur != NULL; cur = init_decl_at(cur->next)) {
+    save_id(cur->declarator);
+    save_expression(cur->initializer);
+  }
+}
+
+void save_declaration(decl_ref ref) {
+  const struct declaration *decl = decl_at(ref);
+
+  if (!decl) {
+    put(0);
+    return;
+  }
+
+  put(decl->type + 1);
+
+  switch (decl->type) {
+  case VARIABLE:
+    save_specifier_list(decl->_var.specifiers);
+    save_init_declarator_list(decl->_var.init_declarator_list);
+    break;
+  case FUNCTION:
+    save_specifier_list(decl->_func.specifiers);
+    save_id(decl->_func.name);
+    save_declaration_list(decl_list_at(decl->_func.parameters));
+    save_statement(decl->_func.body);
+    break;
+  case TYPEDEF:
+    save_specifier_list(decl->_type_def.specifiers);
+    save_id(decl->_type_def.name);
+    break;
+  }
+}
+
+void save_declaration_list(const struct declaration_list *list) {
+  if (!list) {
+    put(0);
+    return;
+  }
+
+  uint32_t count = 0;
+
+  for (decl_ref cur = list->head; cur != NO_NODE; cur = decl_at(cur)->next) {
+    count++;
+  }
+
+  put(count + 1);
+
+  for (decl_ref cur = list->head; cur != NO_NODE; cur = decl_at(cur)->next) {
+    save_declaration(cur);
+  }
+}
+
+void save_statement_list(stmt_list_ref ref) {
+  const struct statement_list *list = stmt_list_at(ref);
+
+  if (!list) {
+    put(0);
+    return;
+  }
+
+  uint32_t count = 0;
+
+  for (stmt_ref cur = list->head; cur != NO_NODE; cur = stmt_at(cur)->next) {
+    count++;
+  }
+
+  put(count + 1);
+
+  for (stmt_ref cur = list->head; cur != NO_NODE; cur = stmt_at(cur)->next) {
+    save_statement(cur);
+  }
+}
+
+void save_statement(stmt_ref ref) {
+  const struct statement *stmt = stmt_at(ref);
+
+  if (!stmt) {
+    put(0);
+    return;
+  }
+
+  put(stmt->type + 1);
+
+  switch (stmt->type) {
+  case BREAK:
+  case CONTINUE:
+    break;
+  case COMPOUND:
+    save_statement_list(stmt->_compound.statements);
+    break;
+  case DECL:
+    save_declaration(stmt->_decl);
+    break;
+  case EXPR:
+    save_expression(stmt->_expr);
+    break;
+  case FOR:
+    save_declaration(stmt->_for.decl);
+    save_expression(stmt->_for.preloop_expression);
+    save_expression(stmt->_for.condition);
+    save_expression(stmt->_for.step_expression);
+    save_statement(stmt->_for.body);
+    break;
+  case GOTO:
+    save_id(stmt->_goto);
+    break;
+  case IF:
+    save_expression(stmt->_if.condition);
+    save_statement(stmt->_if.body);
+    save_statement(stmt->_if.else_body);
+    break;
+  case LABEL:
+    save_id(stmt->_label.name);
+    break;
+  case RETURN:
+    save_expression(stmt->_return.ret_expr);
+    break;
+  case SWITCH:
+    save_expression(stmt->_switch.condition);
+    save_statement(stmt->_switch.body);
+    break;
+  case SWITCH_LABEL:
+    save_expression(stmt->_switch_label.test);
+    break;
+  case WHILE:
+    put(stmt->_while.should_check_condition_first);
+    save_expression(stmt->_while.condition);
+    save_statement(stmt->_while.body);
+    break;
+  }
+}
+
+void save_expression_list(expr_list_ref ref) {
+  const struct expression_list *list = expr_list_at(ref);
+
+  if (!list) {
+    put(0);
+    return;
+  }
+
+  uint32_t count = 0;
+
+  for (expr_ref cur = list->head; cur != NO_NODE; cur = expr_at(cur)->next) {
+    count++;
+  }
+
+  put(count + 1);
+
+  for (expr_ref cur = list->head; cur != NO_NODE; cur = expr_at(cur)->next) {
+    save_expression(cur);
+  }
+}
+
+void save_expression(expr_ref ref) {
+  const struct expression *expr = expr_at(ref);
+
+  if (!expr) {
+    put(0);
+    return;
+  }
+
+  put(expr->type + 1);
+
+  switch (expr->type) {
+  case ID_EXPR:
+    save_id(expr->_id);
+    break;
+  case CONST_EXPR:
+    save_token(token_at(expr->_constant));
+    break;
+  case INDEX:
+    put(expr->_index.type);
+    save_expression(expr->_index.object);
+    save_expression(expr->_index.index);
+    break;
+  case FUNC_CALL:
+    save_expression(expr->_call.function_ptr);
+    save_expression_list(expr->_call.parameter_list);
+    break;
+  case POSTFIX:
+  case UNARY:
+    save_token(token_at(expr->_unary.operator));
+    save_expression(expr->_unary.base);
+    break;
+  case CAST:
+    save_specifier_list(expr->_cast.type);
+    save_expression(expr->_cast.base);
+    break;
+  case BINARY:
+    save_token(token_at(expr->_binary.operator));
+    save_expression(expr->_binary.left);
+    save_expression(expr->_binary.right);
+    break;
+  case TERNARY:
+    save_expression(expr->_ternary.condition);
+    save_expression(expr->_ternary.true_branch);
+    save_expression(expr->_ternary.false_branch);
+    break;
+  }
+}
+
+bool write_section(FILE *file, const void *data, size_t count, size_t size) {
+  return count == 0 || fwrite(data, size, count, file) == count;
+}
+
+bool save_pch(const char *path) {
+  AST tree = get_tree();
+
+  for (struct type_alias *cur = alias_list; cur != NULL; cur = cur->next) {
+    out.aliases = reserve(out.aliases, &out.alias_capacity,
+                          out.alias_count + 1, sizeof(uint32_t));
+    out.aliases[out.alias_count++] = write_name(cur->type_name) - 1;
+  }
+
+  save_declaration_list(tree ? &tree->external_declarations : NULL);
+
+  struct pch_header header = {
+    .version = PCH_VERSION,
+    .token_count = out.token_count,
+    .name_count = out.name_count,
+    .alias_count = out.alias_count,
+    .word_count = out.word_count,
+    .text_size = out.text_size,
+  };
+
+  memcpy(header.magic, PCH_MAGIC, sizeof(header.magic));
+
+  FILE *file = fopen(path, "wb");
+  bool written =
+    file && write_section(file, &header, 1, sizeof(header)) &&
+    write_section(file, out.tokens, out.token_count,
+                  sizeof(struct pch_token)) &&
+    write_section(file, out.names, out.name_count, sizeof(struct pch_name)) &&
+    write_section(file, out.aliases, out.alias_count, sizeof(uint32_t)) &&
+    write_section(file, out.words, out.word_count, sizeof(uint32_t)) &&
+    write_section(file, out.text, out.text_size, sizeof(char));
+
+  if (file && fclose(file) != 0) {
+    written = false;
+  }
+
+  free(out.tokens);
+  free(out.names);
+  free(out.aliases);
+  free(out.words);
+  free(out.text);
+  free(out.name_of);
+  memset(&out, 0, sizeof(out));
+
+  return written;
+}
+
+// Reading
+
+void corrupt(void) {
+  ERRORV("pch", "Corrupt precompiled header %s", in.path);
+}
+
+uint32_t get(void) {
+  if (in.next_word >= in.header->word_count) {
+    corrupt();
+    return 0;
+  }
+
+  return in.words[in.next_word++];
+}
+
+Token load_token(void) {
+  Token token = {.kind = EOF, .location = NO_LOCATION};
+
+  if (in.next_token >= in.header->token_count) {
+    corrupt();
+    return token;
+  }
+
+  const struct pch_token *saved = &in.tokens[in.next_token++];
+
+  // The spelling is followed by a NUL in the text section.
+  if ((uint64_t)saved->text + saved->length >= in.header->text_size ||
+      saved->name > in.header->name_count) {
+    corrupt();
+    return token;
+  }
+
+  token.kind = saved->kind;
+  token.code = saved->code;
+  token.flags = saved->flags;
+  token.length = saved->length;
+  token.interned = saved->name ? in.ids[saved->name - 1] : NO_INTERN;
+  token.data = &in.text[saved->text];
+  token.constant.bits = saved->bits;
+  token.constant.type = saved->constant_type;
+  token.constant.exponent = saved->exponent;
+
+  return token;
+}
+
+expr_ref load_expression(void);
+stmt_ref load_statement(void);
+decl_list_ref load_declaration_list(void);
+
+id_ref load_id(void) {
+  if (!get()) {
+    return NO_NODE;
+  }
+
+  Token name = load_token();
+  return create_id(&name);
+}
+
+spec_ref load_specifier(void) {
+  Token token;
+
+  switch (get()) {
+  case TOKEN + 1:
+    token = load_token();
+    return create_token_specifier(&token);
+  case ID_SPEC + 1:
+    return create_id_specifier(load_id());
+  default:
+    corrupt();
+    return NO_NODE;
+  }
+}
+
+spec_list_ref load_specifier_list(void) {
+  uint32_t count = get();
+
+  if (count == 0) {
+    return NO_NODE;
+  }
+
+  spec_list_ref list = create_specifier_list(NO_NODE);
+  spec_ref last = NO_NODE;
+
+  for (uint32_t i = 1; i < count; i++) {
+    spec_ref specifier = load_specifier();
+
+    if (last) {
+      spec_at(last)->next = specifier;
+    } else {
+      spec_list_at(list)->head = specifier;
+    }
+
+    last = specifier;
+  }
+
+  return list;
+}
+
+init_decl_list_ref load_init_declarator_list(void) {
+  uint32_t count = get();
+
+  if (count == 0) {
+    return NO_NODE;
+  }
+
+  init_decl_list_ref list = create_init_declarator_list(NO_NODE);
+
+  for (uint32_t i = 1; i < count; i++) {
+    id_ref declarator = load_id();
+    expr_ref initializer = load_expression();
+
+    append_initialized_declarator(
+      list, create_initialized_declarator(declarator, initializer));
+  }
+
+  return list;
+}
+
+decl_ref load_declaration(void) {
+  uint32_t type = get();
+
+  if (type == 0) {
+    return NO_NODE;
+  }
+
+  spec_list_ref specifiers = load_specifier_list();
+
+  switch (type - 1) {
+  case VARIABLE:
+    return create_variable_declaration(specifiers,
+                                       load_init_declarator_list());
+  case FUNCTION: {
+    id_ref name = load_id();
+    decl_list_ref parameters = load_declaration_list();
+    return create_function(specifiers, name, parameters, load_statement());
+  }
+  case TYPEDEF:
+    return create_type_definition(specifiers, load_id());
+  default:
+    corrupt();
+    return NO_NODE;
+  }
+}
+
+decl_list_ref load_declaration_list(void) {
+  uint32_t count = get();
+
+  if (count == 0) {
+    return NO_NODE;
+  }
+
+  decl_list_ref list = create_declaration_list(NO_NODE);
+
+  for (uint32_t i = 1; i < count; i++) {
+    append_declaration(list, load_declaration());
+  }
+
+  return list;
+}
+
+stmt_list_ref load_statement_list(void) {
+  uint32_t count = get();
+
+  if (count == 0) {
+    return NO_NODE;
+  }
+
+  stmt_list_ref list = create_stmt_list(NO_NODE);
+
+  for (uint32_t i = 1; i < count; i++) {
+    append_stmt(list, load_statement());
+  }
+
+  return list;
+}
+
+// Operands are loaded into locals first, as arguments are evaluated in no
+// particular order.
+stmt_ref load_statement(void) {
+  uint32_t type = get();
+  decl_ref decl;
+  expr_ref first;
+  expr_ref second;
+  expr_ref third;
+  stmt_ref body;
+  bool check_first;
+
+  if (type == 0) {
+    return NO_NODE;
+  }
+
+  switch (type - 1) {
+  case BREAK:
+    return create_break_stmt();
+  case CONTINUE:
+    return create_continue_stmt();
+  case COMPOUND:
+    return create_compound_stmt(load_statement_list());
+  case DECL:
+    return create_decl_stmt(load_declaration());
+  case EXPR:
+    return create_expr_stmt(load_expression());
+  case FOR:
+    decl = load_declaration();
+    first = load_expression();
+    second = load_expression();
+    third = load_expression();
+    body = load_statement();
+
+    if (decl) {
+      return create_for_stmt_with_decl(decl, second, third, body);
+    }
+
+    return create_for_stmt_with_expr(first, second, third, body);
+  case GOTO:
+    return create_goto_stmt(load_id());
+  case IF:
+    first = load_expression();
+    body = load_statement();
+    return create_if_stmt(first, body, load_statement());
+  case LABEL:
+    return create_label_stmt(load_id());
+  case RETURN:
+    return create_return_stmt(load_expression());
+  case SWITCH:
+    first = load_expression();
+    return create_switch_stmt(first, load_statement());
+  case SWITCH_LABEL:
+    first = load_expression();
+    return first ? create_case_stmt(first) : create_default_stmt();
+  case WHILE:
+    check_first = get();
+    first = load_expression();
+    body = load_statement();
+
+    if (check_first) {
+      return create_while_stmt(first, body);
+    }
+
+    return create_do_while_stmt(body, first);
+  default:
+    corrupt();
+    return NO_NODE;
+  }
+}
+
+expr_list_ref load_expression_list(void) {
+  uint32_t count = get();
+
+  if (count == 0) {
+    return NO_NODE;
+  }
+
+  expr_list_ref list = create_expr_list(NO_NODE);
+
+  for (uint32_t i = 1; i < count; i++) {
+    append_expr(list, load_expression());
+  }
+
+  return list;
+}
+
+expr_ref load_expression(void) {
+  uint32_t type = get();
+  enum index_t index_type;
+  expr_ref first;
+  expr_ref second;
+  spec_list_ref cast_type;
+  Token token;
+
+  if (type == 0) {
+    return NO_NODE;
+  }
+
+  switch (type - 1) {
+  case ID_EXPR:
+    return create_id_expression(load_id());
+  case CONST_EXPR:
+    token = load_token();
+    return create_const_expression(&token);
+  case INDEX:
+    index_type = get();
+    first = load_expression();
+    second = load_expression();
+
+    switch (index_type) {
+    case ARRAY:
+      return create_array_index_expression(first, second);
+    case DOT:
+      return create_dot_index_expression(first, second);
+    case ARROW:
+      return create_arrow_index_expression(first, second);
+    }
+
+    corrupt();
+    return NO_NODE;
+  case FUNC_CALL:
+    first = load_expression();
+    return create_call_expression(first, load_expression_list());
+  case POSTFIX:
+    token = load_token();
+    return create_postfix_expression(load_expression(), &token);
+  case UNARY:
+    token = load_token();
+    return create_unary_expression(&token, load_expression());
+  case CAST:
+    cast_type = load_specifier_list();
+    return create_cast_expression(cast_type, load_expression());
+  case BINARY:
+    token = load_token();
+    first = load_expression();
+    return create_binary_expression(first, &token, load_expression());
+  case TERNARY:
+    first = load_expression();
+    second = load_expression();
+    return create_ternary_expression(first, second, load_expression());
+  default:
+    corrupt();
+    return NO_NODE;
+  }
+}
+
+bool load_pch(const char *path) {
+  free_pch();
+
+  if (!load_source(path, &in.buffer)) {
+    return false;
+  }
+
+  in.path = path;
+  in.loaded = true;
+
+  const char *data = in.buffer.data;
+  const struct pch_header *header = (const struct pch_header *)data;
+
+  if (in.buffer.length < sizeof(struct pch_header) ||
+      memcmp(header->magic, PCH_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != PCH_VERSION) {
+    return false;
+  }
+
+  size_t offset = sizeof(struct pch_header);
+
+  in.header = header;
+  in.tokens = (const struct pch_token *)&data[offset];
+  offset += header->token_count * sizeof(struct pch_token);
+  in.names = (const struct pch_name *)&data[offset];
+  offset += header->name_count * sizeof(struct pch_name);
+  in.aliases = (const uint32_t *)&data[offset];
+  offset += header->alias_count * sizeof(uint32_t);
+  in.words = (const uint32_t *)&data[offset];
+  offset += header->word_count * sizeof(uint32_t);
+  in.text = &data[offset];
+  offset += header->text_size;
+
+  if (offset != in.buffer.length) {
+    corrupt();
+    return false;
+  }
+
+  in.ids = malloc(header->name_count * sizeof(intern_t) + 1);
+
+  if (!in.ids) {
+    CRITICAL("pch", "Out of memory!");
+  }
+
+  for (uint32_t i = 0; i < header->name_count; i++) {
+    const struct pch_name *name = &in.names[i];
+
+    if ((uint64_t)name->text + name->length >= header->text_size) {
+      corrupt();
+      return false;
+    }
+
+    in.ids[i] = intern(&in.text[name->text], name->length);
+  }
+
+  for (uint32_t i = 0; i < header->alias_count; i++) {
+    if (in.aliases[i] >= header->name_count) {
+      corrupt();
+      return false;
+    }
+
+    add_type_alias(in.ids[in.aliases[i]]);
+  }
+
+  in.declarations = load_declaration_list();
+
+  if (in.next_word != header->word_count ||
+      in.next_token != header->token_count) {
+    corrupt();
+    return false;
+  }
+
+  return true;
+}
+
+void seed_translation_unit(void) {
+  AST tree = get_tree();
+
+  const struct declaration_list *declarations = decl_list_at(in.declarations);
+
+  if (!tree || !declarations || !declarations->head) {
+    return;
+  }
+
+  decl_at(declarations->tail)->next = tree->external_declarations.head;
+  tree->external_declarations.head = declarations->head;
+
+  // The list itself is left to free_unused_parse_branches().
+  in.declarations = NO_NODE;
+}
+
+void free_pch(void) {
+  if (in.loaded) {
+    release_source(&in.buffer);
+  }
+
+  free(in.ids);
+  memset(&in, 0, sizeof(in));
+}
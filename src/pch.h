@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+
+/**
+ * Writes the translation unit just parsed as a precompiled header: the
+ * tokens kept by its external declarations, the declarations themselves and
+ * every typedef name registered with the parser.
+ *
+ * Macros are not kept, so a header meant to be precompiled should only
+ * declare.
+ *
+ * @param path The file to write.
+ * @return false if the file could not be written.
+ */
+bool save_pch(const char *path);
+
+/**
+ * Loads a precompiled header written by save_pch(), without lexing or parsing
+ * the header again. Its typedef names are registered with the parser at once,
+ * its declarations are added by seed_translation_unit().
+ *
+ * The file stays mapped until free_pch(), as tokens reference it directly.
+ *
+ * @param path The file to read.
+ * @return false if the file could not be read or was not written by this
+ * version of the compiler.
+ */
+bool load_pch(const char *path);
+
+/**
+ * Puts the declarations of the loaded precompiled header before those of the
+ * translation unit just parsed, as if it was included on the first line.
+ * Does nothing if no header was loaded.
+ */
+void seed_translation_unit(void);
+
+/**
+ * Unmaps the loaded precompiled header. The tokens it handed out are invalid
+ * after.
+ */
+void free_pch(void);
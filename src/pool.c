@@ -0,0 +1,156 @@
+#include "pool.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK_WORDS (POOL_CHUNK_NODES / 64)
+#define INITIAL_CHUNK_CAPACITY 4
+
+static inline bool test_node(const uint64_t *bitmap, uint32_t index) {
+  return bitmap[index / 64] & (UINT64_C(1) << (index % 64));
+}
+
+static inline void set_node(uint64_t *bitmap, uint32_t index) {
+  bitmap[index / 64] |= UINT64_C(1) << (index % 64);
+}
+
+static inline void clear_node(uint64_t *bitmap, uint32_t index) {
+  bitmap[index / 64] &= ~(UINT64_C(1) << (index % 64));
+}
+
+void *grow_pool_array(void *array, size_t capacity, size_t size) {
+  void *grown = realloc(array, capacity * size);
+
+  if (grown == NULL) {
+    CRITICAL("pool", "Out of memory!");
+  }
+
+  return grown;
+}
+
+void add_pool_chunk(Pool *pool) {
+  if (pool->chunk_count == pool->chunk_capacity) {
+    size_t capacity = pool->chunk_capacity == 0 ? INITIAL_CHUNK_CAPACITY
+                                                : pool->chunk_capacity * 2;
+
+    pool->chunks =
+      grow_pool_array(pool->chunks, capacity, sizeof(unsigned char *));
+    pool->fresh =
+      grow_pool_array(pool->fresh, capacity * CHUNK_WORDS, sizeof(uint64_t));
+    pool->marks =
+      grow_pool_array(pool->marks, capacity * CHUNK_WORDS, sizeof(uint64_t));
+    pool->fresh_counts =
+      grow_pool_array(pool->fresh_counts, capacity, sizeof(uint32_t));
+    pool->chunk_capacity = capacity;
+  }
+
+  size_t chunk = pool->chunk_count++;
+
+  pool->chunks[chunk] = malloc(POOL_CHUNK_NODES * pool->node_size);
+
+  if (pool->chunks[chunk] == NULL) {
+    CRITICAL("pool", "Out of memory!");
+  }
+
+  memset(&pool->fresh[chunk * CHUNK_WORDS], 0, CHUNK_WORDS * sizeof(uint64_t));
+  memset(&pool->marks[chunk * CHUNK_WORDS], 0, CHUNK_WORDS * sizeof(uint64_t));
+  pool->fresh_counts[chunk] = 0;
+}
+
+uint32_t pool_allocate(Pool *pool) {
+  uint32_t index = pool->free_list;
+
+  if (index != NO_NODE) {
+    memcpy(&pool->free_list, pool_at(pool, index), sizeof(uint32_t));
+  } else {
+    if (pool->count == UINT32_MAX) {
+      CRITICAL("pool", "Too many nodes!");
+    }
+
+    // NO_NODE takes the first slot.
+    if (pool->count == 0) {
+      pool->count = 1;
+    }
+
+    if ((pool->count >> POOL_CHUNK_BITS) == pool->chunk_count) {
+      add_pool_chunk(pool);
+    }
+
+    index = pool->count++;
+  }
+
+  set_node(pool->fresh, index);
+  pool->fresh_counts[index >> POOL_CHUNK_BITS]++;
+
+  void *node = pool_at(pool, index);
+  memset(node, 0, pool->node_size);
+  return index;
+}
+
+void push_free_node(Pool *pool, uint32_t index) {
+  memcpy(pool_at(pool, index), &pool->free_list, sizeof(uint32_t));
+  pool->free_list = index;
+}
+
+void pool_release(Pool *pool, uint32_t index) {
+  if (index == NO_NODE) {
+    return;
+  }
+
+  if (test_node(pool->fresh, index)) {
+    clear_node(pool->fresh, index);
+    clear_node(pool->marks, index);
+    pool->fresh_counts[index >> POOL_CHUNK_BITS]--;
+  }
+
+  push_free_node(pool, index);
+}
+
+void pool_mark(Pool *pool, uint32_t index) {
+  if (index != NO_NODE && test_node(pool->fresh, index)) {
+    set_node(pool->marks, index);
+  }
+}
+
+size_t pool_sweep(Pool *pool) {
+  size_t freed = 0;
+
+  for (size_t chunk = 0; chunk < pool->chunk_count; chunk++) {
+    if (pool->fresh_counts[chunk] == 0) {
+      continue;
+    }
+
+    for (size_t word = chunk * CHUNK_WORDS; word < (chunk + 1) * CHUNK_WORDS;
+         word++) {
+      uint64_t unmarked = pool->fresh[word] & ~pool->marks[word];
+
+      while (unmarked) {
+        uint32_t index = word * 64 + __builtin_ctzll(unmarked);
+        unmarked &= unmarked - 1;
+
+        push_free_node(pool, index);
+        freed++;
+      }
+
+      pool->fresh[word] = 0;
+      pool->marks[word] = 0;
+    }
+
+    pool->fresh_counts[chunk] = 0;
+  }
+
+  return freed;
+}
+
+void pool_free(Pool *pool) {
+  for (size_t i = 0; i < pool->chunk_count; i++) {
+    free(pool->chunks[i]);
+  }
+
+  free(pool->chunks);
+  free(pool->fresh);
+  free(pool->marks);
+  free(pool->fresh_counts);
+  *pool = (Pool){.node_size = pool->node_size};
+}
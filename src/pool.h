@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The index of no node, where a pointer would be NULL.
+#define NO_NODE 0
+
+// Nodes per chunk, as a shift so that finding one is a shift and a mask.
+#define POOL_CHUNK_BITS 10
+#define POOL_CHUNK_NODES (1u << POOL_CHUNK_BITS)
+
+/**
+ * Nodes of one kind, packed one after the other in chunks that never move
+ * and referred to by 32-bit index. Indices start at 1, NO_NODE is none. A
+ * pointer to a node stays valid until the node is released.
+ *
+ * Like the blocks of an Arena, nodes allocated since the last pool_sweep()
+ * are fresh, and a sweep frees the fresh nodes that were not marked with
+ * pool_mark() since. Freed nodes are reused by later allocations.
+ */
+typedef struct PoolStruct {
+  size_t node_size;
+
+  // Chunk i holds nodes [i * POOL_CHUNK_NODES, (i + 1) * POOL_CHUNK_NODES).
+  unsigned char **chunks;
+  size_t chunk_count;
+  size_t chunk_capacity;
+
+  // A bit per node: fresh ones, and the fresh ones that were marked.
+  uint64_t *fresh;
+  uint64_t *marks;
+  // Fresh nodes per chunk, so sweeps skip chunks without any.
+  uint32_t *fresh_counts;
+
+  // Nodes handed out so far, counting NO_NODE.
+  uint32_t count;
+  // Freed nodes, linked through their first four bytes.
+  uint32_t free_list;
+} Pool;
+
+/**
+ * @return A zeroed node. Runs out of memory like the rest of the compiler,
+ * with CRITICAL.
+ */
+uint32_t pool_allocate(Pool *pool);
+
+/**
+ * @return The node at `index`, NULL for NO_NODE.
+ */
+static inline void *pool_at(const Pool *pool, uint32_t index) {
+  if (index == NO_NODE) {
+    return NULL;
+  }
+
+  return pool->chunks[index >> POOL_CHUNK_BITS] +
+         (index & (POOL_CHUNK_NODES - 1)) * pool->node_size;
+}
+
+/**
+ * Frees a node for reuse. NO_NODE is ignored.
+ */
+void pool_release(Pool *pool, uint32_t index);
+
+/**
+ * Keeps a fresh node from being freed by the next sweep. NO_NODE is ignored.
+ */
+void pool_mark(Pool *pool, uint32_t index);
+
+/**
+ * Frees the fresh nodes that were not marked, and makes the others old.
+ *
+ * @return How many nodes were freed.
+ */
+size_t pool_sweep(Pool *pool);
+
+/**
+ * Frees every node at once, leaving the pool empty and ready for reuse.
+ */
+void pool_free(Pool *pool);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "scanner.h"
+#include <stdint.h>
+
+// Binding power of the binary operators, all left associative, shared by
+// `#if` evaluation and the recursive descent parser. Other codes are 0. The
+// %left declarations of parser.y list the same levels, loosest first.
+static const uint8_t binary_precedence[TC_COUNT] = {
+  [PU_STAR] = 10, [PU_SLASH] = 10, [PU_PERCENT] = 10, [PU_PLUS] = 9,
+  [PU_MINUS] = 9, [PU_SHFL] = 8,   [PU_SHFR] = 8,     [PU_LT] = 7,
+  [PU_GT] = 7,    [PU_LTE] = 7,    [PU_GTE] = 7,      [PU_EE] = 6,
+  [PU_NE] = 6,    [PU_AMP] = 5,    [PU_CARET] = 4,    [PU_PIPE] = 3,
+  [PU_LAND] = 2,  [PU_LOR] = 1,
+};
@@ -0,0 +1,2837 @@
+#include "preprocess.h"
+#include "common.h"
+#include "log.h"
+#include "precedence.h"
+#include "scan_simd.h"
+#include "source.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define INITIAL_LIST_CAPACITY 16
+#define INITIAL_BUCKET_COUNT 256
+
+// Kind of the empty token an empty argument stands for around ##, removed
+// once a replacement is done (ISO/IEC 9899:2023 § 6.10.5.3).
+#define PLACEMARKER 0
+
+// Defined before the main file is read (ISO/IEC 9899:2023 § 6.10.10).
+#define PREDEFINED_MACROS                                                      \
+  "#define __STDC__ 1\n"                                                       \
+  "#define __STDC_VERSION__ 202311L\n"                                         \
+  "#define __STDC_HOSTED__ 1\n"                                                \
+  "#define __STDC_UTF_16__ 1\n"                                                \
+  "#define __STDC_UTF_32__ 1\n"                                                \
+  "#define __x86_64__ 1\n"                                                     \
+  "#define __LP64__ 1\n"
+
+// Padded like any other source, see SOURCE_PADDING.
+const char predefined_source[sizeof(PREDEFINED_MACROS) + SOURCE_PADDING] =
+  PREDEFINED_MACROS;
+
+#define PREPROCESSOR_ERROR(location, ...)                                      \
+  do {                                                                         \
+    char message[512];                                                         \
+    char where[LOCATION_TEXT_SIZE];                                            \
+    snprintf(message, sizeof(message), __VA_ARGS__);                           \
+    format_location(location, where, sizeof(where));                           \
+    ERRORV("preprocessor", "%s at %s", message, where);                        \
+  } while (0)
+
+struct token_list {
+  Token *tokens;
+  size_t count;
+  size_t capacity;
+};
+
+// Open addressing from interned spellings to values, NO_INTERN marks an empty
+// bucket. The bucket count is a power of two and at most half are used.
+struct id_map {
+  intern_t *keys;
+  void **values;
+  size_t bucket_count;
+  size_t count;
+};
+
+enum macro_kind {
+  MACRO_OBJECT,
+  MACRO_FUNCTION,
+  // Replaced by the preprocessor itself.
+  MACRO_FILE,
+  MACRO_LINE,
+};
+
+struct macro {
+  intern_t name;
+  enum macro_kind kind;
+  // The last parameter is __VA_ARGS__.
+  bool variadic;
+  size_t param_count;
+  intern_t *params;
+  struct token_list body;
+  SourceLocation location;
+
+  // Every macro ever defined. They are only freed with the preprocessor,
+  // since a directive among the arguments of an invocation may redefine the
+  // macro being invoked.
+  struct macro *next;
+};
+
+struct source_file {
+  intern_t path;
+  dev_t device;
+  ino_t inode;
+
+  // Loaded on first inclusion and kept, tokens point into it.
+  SourceBuffer buffer;
+  bool loaded;
+  bool entered;
+  bool pragma_once;
+  // The macro guarding the whole file, NO_INTERN if it is not guarded.
+  intern_t guard;
+
+  struct source_file *next;
+};
+
+// Cached for candidate paths that do not name a regular file.
+struct source_file missing_file;
+
+// Multiple-include detection, following what has been seen of a file so far.
+enum guard_state {
+  // Only whitespace and comments.
+  GUARD_START,
+  // Inside an #ifndef opening the file.
+  GUARD_INSIDE,
+  // Past the #endif closing it, nothing else may follow.
+  GUARD_AFTER,
+  GUARD_NONE,
+};
+
+struct include_frame {
+  struct include_frame *parent;
+  Scanner *scanner;
+  Scanner own_scanner;
+  // NULL for the predefined macros and for files that cannot be stat'ed.
+  struct source_file *file;
+  // Spelled by __FILE__.
+  const char *name;
+  // Quoted includes are looked up here first, NULL for the current directory.
+  const char *directory;
+  // Conditionals opened in including files.
+  size_t conditional_depth;
+  // Included with <...>, or from such a header.
+  bool system;
+
+  enum guard_state guard_state;
+  intern_t guard;
+  // The depth of the guarding conditional.
+  size_t guard_depth;
+};
+
+struct conditional {
+  SourceLocation location;
+  // A group was already kept, every later one is skipped.
+  bool taken;
+  bool seen_else;
+};
+
+// A set of macro names, interned so equal sets share an id. A token made by
+// replacing a macro carries the macros that must not replace it again
+// (ISO/IEC 9899:2023 § 6.10.5.4), following Prosser's algorithm.
+typedef uint32_t hideset_t;
+
+// The empty set, that of every token read from a file.
+#define NO_HIDESET 0
+
+#define HIDESET_CACHE_SIZE 256
+
+struct hideset {
+  // Sorted members, in `pp.hideset_members`.
+  uint32_t start;
+  uint32_t length;
+  uint32_t hash;
+};
+
+// A recent union or intersection.
+struct hideset_operation {
+  hideset_t a;
+  hideset_t b;
+  hideset_t result;
+  bool intersect;
+};
+
+// A token being replaced.
+struct pp_token {
+  Token token;
+  hideset_t hideset;
+};
+
+// Grows to the deepest expansion seen, then is reused by every later one.
+struct token_stack {
+  struct pp_token *tokens;
+  size_t count;
+  size_t capacity;
+};
+
+// Tokens read before those of the current file, innermost last. They are
+// [begin, end) of `pp.arena`.
+struct context {
+  size_t begin;
+  size_t end;
+  size_t next;
+  // Arguments are replaced in a context of their own, which must not be read
+  // past.
+  bool barrier;
+};
+
+enum directive {
+  D_NONE,
+  D_UNKNOWN,
+  D_IF,
+  D_IFDEF,
+  D_IFNDEF,
+  D_ELIF,
+  D_ELIFDEF,
+  D_ELIFNDEF,
+  D_ELSE,
+  D_ENDIF,
+  D_DEFINE,
+  D_UNDEF,
+  D_INCLUDE,
+  D_EMBED,
+  D_LINE,
+  D_ERROR,
+  D_WARNING,
+  D_PRAGMA,
+  // Not a directive, the end of the file was reached while skipping.
+  D_EOF,
+};
+
+// ISO/IEC 9899:2023 § 6.10
+const struct {
+  const char *name;
+  enum directive directive;
+} directives[] = {
+  {"if", D_IF},           {"ifdef", D_IFDEF},     {"ifndef", D_IFNDEF},
+  {"elif", D_ELIF},       {"elifdef", D_ELIFDEF}, {"elifndef", D_ELIFNDEF},
+  {"else", D_ELSE},       {"endif", D_ENDIF},     {"define", D_DEFINE},
+  {"undef", D_UNDEF},     {"include", D_INCLUDE}, {"embed", D_EMBED},
+  {"line", D_LINE},       {"error", D_ERROR},     {"warning", D_WARNING},
+  {"pragma", D_PRAGMA},
+};
+
+struct preprocessor {
+  struct include_frame *frame;
+  size_t include_depth;
+
+  struct id_map macros;
+  struct macro *all_macros;
+  // Macros named like keywords, which are otherwise never looked up.
+  size_t keyword_macros;
+
+  // Candidate paths to the file they name, or &missing_file.
+  struct id_map paths;
+  struct source_file *files;
+  // Every file entered by #include, in the order first entered.
+  IncludedFile *included;
+  size_t included_count;
+  size_t included_capacity;
+
+  // Only lines starting with # are read, see set_directives_only().
+  bool directives_only;
+  // See set_token_dump().
+  bool dump_tokens;
+
+  const char **include_directories;
+  size_t include_directory_count;
+  size_t include_directory_capacity;
+
+  struct conditional *conditionals;
+  size_t conditional_count;
+  size_t conditional_capacity;
+
+  struct context *contexts;
+  size_t context_count;
+  size_t context_capacity;
+
+  // The tokens of every context, in the same order. A context's tokens are
+  // copied here when it is pushed and dropped when it is popped.
+  struct token_stack arena;
+  // Arguments, their replacements and the replacement lists being built.
+  // Each expansion pops what it pushed once its context is pushed.
+  struct token_stack scratch;
+  // Argument bounds of the invocations being replaced, see struct arguments.
+  size_t *bounds;
+  size_t bound_count;
+  size_t bound_capacity;
+
+  struct hideset *hidesets;
+  size_t hideset_count;
+  size_t hideset_capacity;
+  intern_t *hideset_members;
+  size_t member_count;
+  size_t member_capacity;
+  // Open addressing over hideset ids by hash, NO_HIDESET marks an empty
+  // bucket.
+  hideset_t *hideset_buckets;
+  size_t hideset_bucket_count;
+  struct hideset_operation hideset_cache[HIDESET_CACHE_SIZE];
+
+  // A token read past the name of a function-like macro that was not
+  // followed by an argument list.
+  struct pp_token lookahead;
+  bool has_lookahead;
+
+  // Where the outermost macro being replaced was invoked, for __LINE__.
+  SourceLocation expansion_location;
+
+  // Scratch space for directive lines, and for their replaced tokens.
+  struct token_list line;
+  struct token_list replaced;
+  char *text;
+  size_t text_capacity;
+
+  Token current;
+  PreprocessorStats stats;
+
+  intern_t defined_name;
+  intern_t has_include_name;
+  intern_t va_args_name;
+  intern_t va_opt_name;
+};
+
+_Thread_local struct preprocessor pp;
+
+bool next_unexpanded(struct pp_token *token);
+bool next_expanded(struct pp_token *token);
+
+void push_list_token(struct token_list *list, const Token *token) {
+  if (list->count == list->capacity) {
+    size_t capacity =
+      list->capacity ? list->capacity * 2 : INITIAL_LIST_CAPACITY;
+    Token *tokens = realloc(list->tokens, capacity * sizeof(Token));
+
+    if (!tokens) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    list->tokens = tokens;
+    list->capacity = capacity;
+  }
+
+  list->tokens[list->count++] = *token;
+}
+
+void free_list(struct token_list *list) {
+  free(list->tokens);
+  *list = (struct token_list){NULL, 0, 0};
+}
+
+/**
+ * @return A scratch buffer of at least `size` bytes followed by
+ * SOURCE_PADDING NUL bytes, valid until the next call.
+ */
+char *reserve_text(size_t size) {
+  if (pp.text_capacity < size) {
+    size_t capacity = pp.text_capacity ? pp.text_capacity : 256;
+
+    while (capacity < size) {
+      capacity *= 2;
+    }
+
+    char *text = realloc(pp.text, capacity + SOURCE_PADDING);
+
+    if (!text) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    pp.text = text;
+    pp.text_capacity = capacity;
+  }
+
+  memset(&pp.text[size], 0, SOURCE_PADDING);
+  return pp.text;
+}
+
+void *id_map_get(const struct id_map *map, intern_t key) {
+  if (map->bucket_count == 0) {
+    return NULL;
+  }
+
+  size_t mask = map->bucket_count - 1;
+
+  for (size_t i = interned_hash(key) & mask;; i = (i + 1) & mask) {
+    if (map->keys[i] == key) {
+      return map->values[i];
+    } else if (map->keys[i] == NO_INTERN) {
+      return NULL;
+    }
+  }
+}
+
+void id_map_insert(struct id_map *map, intern_t key, void *value) {
+  size_t mask = map->bucket_count - 1;
+  size_t i = interned_hash(key) & mask;
+
+  while (map->keys[i] != NO_INTERN && map->keys[i] != key) {
+    i = (i + 1) & mask;
+  }
+
+  map->count += map->keys[i] == NO_INTERN;
+  map->keys[i] = key;
+  map->values[i] = value;
+}
+
+void id_map_put(struct id_map *map, intern_t key, void *value) {
+  if ((map->count + 1) * 2 > map->bucket_count) {
+    struct id_map grown = {NULL, NULL, 0, 0};
+
+    grown.bucket_count =
+      map->bucket_count ? map->bucket_count * 2 : INITIAL_BUCKET_COUNT;
+    grown.keys = calloc(grown.bucket_count, sizeof(intern_t));
+    grown.values = calloc(grown.bucket_count, sizeof(void *));
+
+    if (!grown.keys || !grown.values) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    for (size_t i = 0; i < map->bucket_count; i++) {
+      if (map->keys[i] != NO_INTERN) {
+        id_map_insert(&grown, map->keys[i], map->values[i]);
+      }
+    }
+
+    free(map->keys);
+    free(map->values);
+    *map = grown;
+  }
+
+  id_map_insert(map, key, value);
+}
+
+void free_id_map(struct id_map *map) {
+  free(map->keys);
+  free(map->values);
+  *map = (struct id_map){NULL, NULL, 0, 0};
+}
+
+bool is_punct(const Token *token, enum token_code code) {
+  return token->kind == PUNCT && token->code == code;
+}
+
+// Keywords are identifiers to the preprocessor.
+bool is_name(const Token *token) {
+  return token->kind == IDENTIFIER || token->kind == KEYWORD;
+}
+
+intern_t token_name(const Token *token) {
+  return token->interned != NO_INTERN ? token->interned
+                                      : intern_spelling(token);
+}
+
+bool is_spelled(const Token *token, const char *spelling) {
+  size_t length = strlen(spelling);
+  return token->length == length && memcmp(token->data, spelling, length) == 0;
+}
+
+/**
+ * Writes the spellings of tokens, separated by a space where the source had
+ * whitespace.
+ */
+void spell_tokens(const Token *tokens, size_t count, char *buffer,
+                  size_t size) {
+  size_t length = 0;
+
+  for (size_t i = 0; i < count && length + 1 < size; i++) {
+    if (i > 0 && (tokens[i].flags & TF_LEADING_SPACE) && length + 2 < size) {
+      buffer[length++] = ' ';
+    }
+
+    size_t copied = min(tokens[i].length, size - length - 1);
+    memcpy(&buffer[length], tokens[i].data, copied);
+    length += copied;
+  }
+
+  buffer[length] = '\0';
+}
+
+enum directive directive_kind(const Token *name) {
+  if (!is_name(name)) {
+    return D_UNKNOWN;
+  }
+
+  for (size_t i = 0; i < NELEMS(directives); i++) {
+    if (is_spelled(name, directives[i].name)) {
+      return directives[i].directive;
+    }
+  }
+
+  return D_UNKNOWN;
+}
+
+struct macro *find_macro(intern_t name) {
+  return id_map_get(&pp.macros, name);
+}
+
+void push_pp_token(struct token_stack *stack, struct pp_token token) {
+  if (stack->count == stack->capacity) {
+    size_t capacity =
+      stack->capacity ? stack->capacity * 2 : INITIAL_LIST_CAPACITY;
+    struct pp_token *tokens =
+      realloc(stack->tokens, capacity * sizeof(struct pp_token));
+
+    if (!tokens) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    stack->tokens = tokens;
+    stack->capacity = capacity;
+  }
+
+  stack->tokens[stack->count++] = token;
+}
+
+void free_stack(struct token_stack *stack) {
+  free(stack->tokens);
+  *stack = (struct token_stack){NULL, 0, 0};
+}
+
+/**
+ * Pushes a context reading a copy of tokens from the scratch stack.
+ */
+void push_context(size_t begin, size_t end, bool barrier) {
+  if (pp.context_count == pp.context_capacity) {
+    size_t capacity = pp.context_capacity ? pp.context_capacity * 2
+                                          : INITIAL_LIST_CAPACITY;
+    struct context *contexts =
+      realloc(pp.contexts, capacity * sizeof(struct context));
+
+    if (!contexts) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    pp.contexts = contexts;
+    pp.context_capacity = capacity;
+  }
+
+  size_t start = pp.arena.count;
+
+  for (size_t i = begin; i < end; i++) {
+    push_pp_token(&pp.arena, pp.scratch.tokens[i]);
+  }
+
+  pp.contexts[pp.context_count++] =
+    (struct context){start, pp.arena.count, start, barrier};
+}
+
+void pop_context(void) {
+  pp.arena.count = pp.contexts[--pp.context_count].begin;
+}
+
+// Hidesets
+
+uint32_t hash_members(const intern_t *members, size_t length) {
+  uint32_t hash = 2166136261u;
+
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ members[i]) * 16777619u;
+  }
+
+  return hash;
+}
+
+/**
+ * @return Room for `length` members past those of every set.
+ */
+intern_t *reserve_members(size_t length) {
+  if (pp.member_count + length > pp.member_capacity) {
+    size_t capacity = pp.member_capacity ? pp.member_capacity : 256;
+
+    while (capacity < pp.member_count + length) {
+      capacity *= 2;
+    }
+
+    intern_t *members =
+      realloc(pp.hideset_members, capacity * sizeof(intern_t));
+
+    if (!members) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    pp.hideset_members = members;
+    pp.member_capacity = capacity;
+  }
+
+  return &pp.hideset_members[pp.member_count];
+}
+
+void place_hideset(hideset_t id) {
+  size_t mask = pp.hideset_bucket_count - 1;
+  size_t i = pp.hidesets[id].hash & mask;
+
+  while (pp.hideset_buckets[i] != NO_HIDESET) {
+    i = (i + 1) & mask;
+  }
+
+  pp.hideset_buckets[i] = id;
+}
+
+/**
+ * Interns the sorted members just past those of every set, see
+ * reserve_members(). They are only kept if no equal set exists.
+ */
+hideset_t make_hideset(size_t length) {
+  if (length == 0) {
+    return NO_HIDESET;
+  }
+
+  const intern_t *members = &pp.hideset_members[pp.member_count];
+  uint32_t hash = hash_members(members, length);
+  size_t mask = pp.hideset_bucket_count - 1;
+
+  for (size_t i = hash & mask; pp.hideset_bucket_count > 0;
+       i = (i + 1) & mask) {
+    hideset_t id = pp.hideset_buckets[i];
+
+    if (id == NO_HIDESET) {
+      break;
+    }
+
+    const struct hideset *set = &pp.hidesets[id];
+
+    if (set->hash == hash && set->length == length &&
+        memcmp(&pp.hideset_members[set->start], members,
+               length * sizeof(intern_t)) == 0) {
+      return id;
+    }
+  }
+
+  if (pp.hideset_count >= pp.hideset_capacity) {
+    size_t capacity = pp.hideset_capacity ? pp.hideset_capacity * 2 : 64;
+    struct hideset *hidesets =
+      realloc(pp.hidesets, capacity * sizeof(struct hideset));
+
+    if (!hidesets) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    pp.hidesets = hidesets;
+    pp.hideset_capacity = capacity;
+  }
+
+  hideset_t id = (hideset_t)pp.hideset_count++;
+  pp.hidesets[id] = (struct hideset){(uint32_t)pp.member_count,
+                                     (uint32_t)length, hash};
+  pp.member_count += length;
+
+  if (pp.hideset_count * 2 > pp.hideset_bucket_count) {
+    size_t bucket_count =
+      pp.hideset_bucket_count ? pp.hideset_bucket_count * 2
+                              : INITIAL_BUCKET_COUNT;
+
+    free(pp.hideset_buckets);
+    pp.hideset_buckets = calloc(bucket_count, sizeof(hideset_t));
+    pp.hideset_bucket_count = bucket_count;
+
+    if (!pp.hideset_buckets) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    for (hideset_t other = 1; other < id; other++) {
+      place_hideset(other);
+    }
+  }
+
+  place_hideset(id);
+  return id;
+}
+
+bool hideset_contains(hideset_t hideset, intern_t name) {
+  if (hideset == NO_HIDESET) {
+    return false;
+  }
+
+  const struct hideset *set = &pp.hidesets[hideset];
+
+  for (size_t i = 0; i < set->length; i++) {
+    if (pp.hideset_members[set->start + i] == name) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * @return The union of two hidesets, or their intersection.
+ */
+hideset_t combine_hidesets(hideset_t a, hideset_t b, bool intersect) {
+  if (a == b) {
+    return a;
+  } else if (a == NO_HIDESET || b == NO_HIDESET) {
+    return intersect ? NO_HIDESET : a | b;
+  }
+
+  struct hideset_operation *cached =
+    &pp.hideset_cache[(a * 31 + b * 7 + intersect) % HIDESET_CACHE_SIZE];
+
+  if (cached->a == a && cached->b == b && cached->intersect == intersect) {
+    return cached->result;
+  }
+
+  struct hideset x = pp.hidesets[a];
+  struct hideset y = pp.hidesets[b];
+  intern_t *out = reserve_members(x.length + y.length);
+  const intern_t *first = &pp.hideset_members[x.start];
+  const intern_t *second = &pp.hideset_members[y.start];
+  size_t length = 0;
+  size_t i = 0;
+  size_t j = 0;
+
+  // Both are sorted, so they merge like lists.
+  while (i < x.length || j < y.length) {
+    if (j == y.length || (i < x.length && first[i] < second[j])) {
+      if (!intersect) {
+        out[length++] = first[i];
+      }
+
+      i++;
+    } else if (i == x.length || second[j] < first[i]) {
+      if (!intersect) {
+        out[length++] = second[j];
+      }
+
+      j++;
+    } else {
+      out[length++] = first[i];
+      i++;
+      j++;
+    }
+  }
+
+  *cached = (struct hideset_operation){a, b, make_hideset(length), intersect};
+  return cached->result;
+}
+
+hideset_t add_to_hideset(hideset_t hideset, intern_t name) {
+  *reserve_members(1) = name;
+  return combine_hidesets(hideset, make_hideset(1), false);
+}
+
+// Files
+
+const char *directory_of(const char *path) {
+  const char *slash = strrchr(path, '/');
+
+  if (!slash) {
+    return NULL;
+  }
+
+  size_t length = slash == path ? 1 : (size_t)(slash - path);
+  return interned_text(intern(path, length));
+}
+
+/**
+ * Finds the file a path names, stat'ing each distinct path only once.
+ *
+ * @return The file, or NULL if the path does not name a regular file.
+ */
+struct source_file *lookup_path(const char *path) {
+  intern_t key = intern(path, strlen(path));
+  struct source_file *file = id_map_get(&pp.paths, key);
+
+  if (file) {
+    return file == &missing_file ? NULL : file;
+  }
+
+  struct stat info;
+
+  if (stat(path, &info) != 0 || !S_ISREG(info.st_mode)) {
+    id_map_put(&pp.paths, key, &missing_file);
+    return NULL;
+  }
+
+  // Another path to a file seen before shares its record, and so its guard.
+  for (file = pp.files; file; file = file->next) {
+    if (file->device == info.st_dev && file->inode == info.st_ino) {
+      break;
+    }
+  }
+
+  if (!file) {
+    file = calloc(1, sizeof(struct source_file));
+
+    if (!file) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    file->path = key;
+    file->device = info.st_dev;
+    file->inode = info.st_ino;
+    file->next = pp.files;
+    pp.files = file;
+  }
+
+  id_map_put(&pp.paths, key, file);
+  return file;
+}
+
+struct source_file *lookup_in(const char *directory, const char *name) {
+  if (!directory) {
+    return lookup_path(name);
+  }
+
+  char path[PATH_MAX];
+
+  if ((size_t)snprintf(path, sizeof(path), "%s/%s", directory, name) >=
+      sizeof(path)) {
+    return NULL;
+  }
+
+  return lookup_path(path);
+}
+
+/**
+ * Resolves the name of an #include or __has_include.
+ *
+ * @return The file, or NULL if it is in none of the places searched.
+ */
+struct source_file *find_include(const char *name, bool quoted) {
+  if (name[0] == '/') {
+    return lookup_path(name);
+  }
+
+  struct source_file *file;
+
+  if (quoted && (file = lookup_in(pp.frame->directory, name))) {
+    return file;
+  }
+
+  for (size_t i = 0; i < pp.include_directory_count; i++) {
+    if ((file = lookup_in(pp.include_directories[i], name))) {
+      return file;
+    }
+  }
+
+  return NULL;
+}
+
+void push_frame(struct include_frame *frame) {
+  frame->parent = pp.frame;
+  frame->conditional_depth = pp.conditional_count;
+  frame->guard_state = GUARD_START;
+  frame->guard = NO_INTERN;
+  frame->guard_depth = 0;
+
+  pp.frame = frame;
+  pp.include_depth++;
+  pp.stats.files_entered++;
+}
+
+struct include_frame *new_frame(void) {
+  struct include_frame *frame = calloc(1, sizeof(struct include_frame));
+
+  if (!frame) {
+    CRITICAL("preprocessor", "Out of memory!");
+  }
+
+  frame->scanner = &frame->own_scanner;
+  return frame;
+}
+
+void note_included(const char *path, bool system) {
+  if (pp.included_count == pp.included_capacity) {
+    size_t capacity =
+      pp.included_capacity ? pp.included_capacity * 2 : INITIAL_LIST_CAPACITY;
+    IncludedFile *included =
+      realloc(pp.included, capacity * sizeof(IncludedFile));
+
+    if (!included) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    pp.included = included;
+    pp.included_capacity = capacity;
+  }
+
+  pp.included[pp.included_count++] = (IncludedFile){path, system};
+}
+
+void enter_file(struct source_file *file, const Token *hash, bool system) {
+  const char *path = interned_text(file->path);
+
+  if (!file->loaded) {
+    if (!load_source(path, &file->buffer)) {
+      PREPROCESSOR_ERROR(hash->location, "Cannot read include file %s", path);
+    }
+
+    file->loaded = true;
+  }
+
+  if (register_source(path, file->buffer.data, file->buffer.length) ==
+      NO_LOCATION) {
+    PREPROCESSOR_ERROR(hash->location, "Out of source locations including %s",
+                       path);
+  }
+
+  struct include_frame *frame = new_frame();
+
+  init_scanner(frame->scanner, file->buffer.data);
+  frame->file = file;
+  frame->name = path;
+  frame->directory = directory_of(path);
+  frame->system = system;
+
+  if (!file->entered) {
+    note_included(path, system);
+    file->entered = true;
+  }
+
+  push_frame(frame);
+}
+
+void leave_file(void) {
+  struct include_frame *frame = pp.frame;
+
+  if (pp.conditional_count > frame->conditional_depth) {
+    PREPROCESSOR_ERROR(pp.conditionals[pp.conditional_count - 1].location,
+                       "Unterminated conditional directive");
+  }
+
+  // Later includes are dropped while the guard stays defined.
+  if (frame->file && frame->guard_state == GUARD_AFTER) {
+    frame->file->guard = frame->guard;
+  }
+
+  pp.frame = frame->parent;
+  pp.include_depth--;
+  free(frame);
+}
+
+// Directives
+
+/**
+ * @return The byte offset of the next unconsumed token of a scanner, or of
+ * the whitespace before it.
+ */
+size_t scanner_position(Scanner *scanner) {
+  if (scanner->tokens || scanner->count > 0) {
+    return peek_token(scanner, 0)->location - scanner->base;
+  }
+
+  return scanner->index;
+}
+
+/**
+ * Checks whether the current line of a scanner has no tokens left. The rest
+ * of the line is not lexed, so a directive never lexes the line after it.
+ */
+bool at_line_end(Scanner *scanner) {
+  if (scanner->tokens || scanner->count > 0) {
+    Token *next = peek_token(scanner, 0);
+    return next->kind == EOF || (next->flags & TF_LINE_START);
+  }
+
+  const char *file = scanner->file;
+  size_t i = scanner->index;
+
+  for (;;) {
+    if (file[i] == ' ' || file[i] == '\t' || file[i] == '\v' ||
+        file[i] == '\f' || file[i] == '\r') {
+      i++;
+    } else if (file[i] == '\\' &&
+               (file[i + 1] == '\n' ||
+                (file[i + 1] == '\r' && file[i + 2] == '\n'))) {
+      i += 2 + (file[i + 1] == '\r');
+    } else if (file[i] == '/' && file[i + 1] == '*') {
+      i = skip_block_comment(file, i + 2);
+    } else {
+      return file[i] == '\n' || file[i] == '\0' ||
+             (file[i] == '/' && file[i + 1] == '/');
+    }
+  }
+}
+
+/**
+ * Reads the rest of a directive line into `pp.line`.
+ */
+void read_line(struct include_frame *frame) {
+  pp.line.count = 0;
+
+  while (!at_line_end(frame->scanner)) {
+    push_list_token(&pp.line, next_token(frame->scanner));
+  }
+}
+
+void note_directive(struct include_frame *frame, enum directive directive,
+                    intern_t guard) {
+  switch (frame->guard_state) {
+  case GUARD_START:
+    frame->guard_state = guard != NO_INTERN ? GUARD_INSIDE : GUARD_NONE;
+    frame->guard = guard;
+    frame->guard_depth = pp.conditional_count + 1;
+    break;
+  case GUARD_INSIDE:
+    if (pp.conditional_count != frame->guard_depth) {
+      break;
+    } else if (directive == D_ENDIF) {
+      frame->guard_state = GUARD_AFTER;
+    } else if (directive >= D_ELIF && directive <= D_ELSE) {
+      frame->guard_state = GUARD_NONE;
+    }
+    break;
+  case GUARD_AFTER:
+    frame->guard_state = GUARD_NONE;
+    break;
+  case GUARD_NONE:
+    break;
+  }
+}
+
+/**
+ * @return The macro an "#if !defined X" or "#if !defined(X)" line tests,
+ * NO_INTERN for any other line.
+ */
+intern_t negated_defined(const Token *tokens, size_t count) {
+  if (count < 3 || !is_punct(&tokens[0], PU_BANG) ||
+      !is_spelled(&tokens[1], "defined")) {
+    return NO_INTERN;
+  }
+
+  if (count == 3 && is_name(&tokens[2])) {
+    return token_name(&tokens[2]);
+  }
+
+  if (count == 5 && is_punct(&tokens[2], PU_LPAREN) && is_name(&tokens[3]) &&
+      is_punct(&tokens[4], PU_RPAREN)) {
+    return token_name(&tokens[3]);
+  }
+
+  return NO_INTERN;
+}
+
+intern_t macro_operand(const Token *hash, const Token *tokens, size_t count) {
+  if (count < 2 || !is_name(&tokens[1])) {
+    PREPROCESSOR_ERROR(hash->location, "Expected a macro name after #%.*s",
+                       (int)tokens[0].length, tokens[0].data);
+  }
+
+  return token_name(&tokens[1]);
+}
+
+size_t parse_params(struct macro *macro, const Token *tokens, size_t count,
+                    size_t index) {
+  size_t i = index;
+  size_t capacity = 0;
+
+  for (;;) {
+    if (macro->param_count == capacity) {
+      capacity = capacity ? capacity * 2 : 4;
+      intern_t *params = realloc(macro->params, capacity * sizeof(intern_t));
+
+      if (!params) {
+        CRITICAL("preprocessor", "Out of memory!");
+      }
+
+      macro->params = params;
+    }
+
+    if (i < count && macro->param_count == 0 &&
+        is_punct(&tokens[i], PU_RPAREN)) {
+      return i + 1;
+    }
+
+    if (i < count && is_punct(&tokens[i], PU_ELLIPSIS)) {
+      macro->variadic = true;
+      macro->params[macro->param_count++] = pp.va_args_name;
+      i++;
+
+      if (i < count && is_punct(&tokens[i], PU_RPAREN)) {
+        return i + 1;
+      }
+    } else if (i < count && is_name(&tokens[i])) {
+      macro->params[macro->param_count++] = token_name(&tokens[i]);
+      i++;
+
+      if (i < count && is_punct(&tokens[i], PU_RPAREN)) {
+        return i + 1;
+      } else if (i < count && is_punct(&tokens[i], PU_COMMA)) {
+        i++;
+        continue;
+      }
+    }
+
+    PREPROCESSOR_ERROR(i < count ? tokens[i].location : macro->location,
+                       "Invalid parameter list for macro %s",
+                       interned_text(macro->name));
+  }
+}
+
+int param_index(const struct macro *macro, const Token *token) {
+  if (macro->kind != MACRO_FUNCTION || !is_name(token)) {
+    return -1;
+  }
+
+  intern_t name = token_name(token);
+
+  for (size_t i = 0; i < macro->param_count; i++) {
+    if (macro->params[i] == name) {
+      return (int)i;
+    }
+  }
+
+  return -1;
+}
+
+bool is_va_opt(const struct macro *macro, const Token *token) {
+  return macro->variadic && is_name(token) &&
+         token_name(token) == pp.va_opt_name;
+}
+
+void check_body(const struct macro *macro) {
+  const Token *body = macro->body.tokens;
+  size_t count = macro->body.count;
+
+  if (count > 0 && (is_punct(&body[0], PU_DHASH) ||
+                    is_punct(&body[count - 1], PU_DHASH))) {
+    PREPROCESSOR_ERROR(macro->location,
+                       "## cannot be at either end of macro %s",
+                       interned_text(macro->name));
+  }
+
+  for (size_t i = 0; macro->kind == MACRO_FUNCTION && i < count; i++) {
+    if (is_punct(&body[i], PU_HASH) &&
+        (i + 1 == count || (param_index(macro, &body[i + 1]) < 0 &&
+                            !is_va_opt(macro, &body[i + 1])))) {
+      PREPROCESSOR_ERROR(body[i].location, "# is not followed by a parameter");
+    }
+
+    if (is_name(&body[i]) && !macro->variadic &&
+        (token_name(&body[i]) == pp.va_args_name ||
+         token_name(&body[i]) == pp.va_opt_name)) {
+      PREPROCESSOR_ERROR(body[i].location,
+                         "%.*s can only appear in a variadic macro",
+                         (int)body[i].length, body[i].data);
+    }
+  }
+}
+
+bool same_definition(const struct macro *a, const struct macro *b) {
+  if (a->kind != b->kind || a->variadic != b->variadic ||
+      a->param_count != b->param_count || a->body.count != b->body.count) {
+    return false;
+  }
+
+  for (size_t i = 0; i < a->param_count; i++) {
+    if (a->params[i] != b->params[i]) {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < a->body.count; i++) {
+    const Token *x = &a->body.tokens[i];
+    const Token *y = &b->body.tokens[i];
+
+    if (x->length != y->length || memcmp(x->data, y->data, x->length) != 0 ||
+        (x->flags & TF_LEADING_SPACE) != (y->flags & TF_LEADING_SPACE)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void free_macro(struct macro *macro) {
+  free(macro->params);
+  free_list(&macro->body);
+  free(macro);
+}
+
+struct macro *new_macro(intern_t name, enum macro_kind kind,
+                        SourceLocation location) {
+  struct macro *macro = calloc(1, sizeof(struct macro));
+
+  if (!macro) {
+    CRITICAL("preprocessor", "Out of memory!");
+  }
+
+  macro->name = name;
+  macro->kind = kind;
+  macro->location = location;
+  macro->next = pp.all_macros;
+  pp.all_macros = macro;
+
+  return macro;
+}
+
+void define_macro(const Token *hash, const Token *tokens, size_t count) {
+  intern_t name = macro_operand(hash, tokens, count);
+
+  if (name == pp.defined_name || name == pp.has_include_name) {
+    PREPROCESSOR_ERROR(tokens[1].location, "%s cannot be defined",
+                       interned_text(name));
+  }
+
+  struct macro *macro = new_macro(name, MACRO_OBJECT, tokens[1].location);
+  size_t i = 2;
+
+  // Only a parenthesis right after the name starts a parameter list.
+  if (i < count && is_punct(&tokens[i], PU_LPAREN) &&
+      !(tokens[i].flags & TF_LEADING_SPACE)) {
+    macro->kind = MACRO_FUNCTION;
+    i = parse_params(macro, tokens, count, i + 1);
+  }
+
+  for (; i < count; i++) {
+    push_list_token(&macro->body, &tokens[i]);
+  }
+
+  if (macro->body.count > 0) {
+    macro->body.tokens[0].flags &= ~TF_LEADING_SPACE;
+  }
+
+  check_body(macro);
+
+  struct macro *old = find_macro(name);
+
+  if (old && !same_definition(old, macro)) {
+    char where[LOCATION_TEXT_SIZE];
+    format_location(macro->location, where, sizeof(where));
+    WARNINGV("preprocessor", "Macro %s redefined at %s", interned_text(name),
+             where);
+  }
+
+  pp.keyword_macros += tokens[1].kind == KEYWORD;
+  id_map_put(&pp.macros, name, macro);
+}
+
+void define_builtin(const char *name, enum macro_kind kind) {
+  intern_t id = intern(name, strlen(name));
+  id_map_put(&pp.macros, id, new_macro(id, kind, NO_LOCATION));
+}
+
+
+void undefine_macro(const Token *hash, const Token *tokens, size_t count) {
+  intern_t name = macro_operand(hash, tokens, count);
+
+  // The name stays in the table with no macro, see find_macro().
+  if (find_macro(name)) {
+    id_map_put(&pp.macros, name, NULL);
+  }
+}
+
+// Replacement
+
+Token text_token(kind_t kind, const char *text, size_t length,
+                 const Token *origin) {
+  intern_t id = intern(text, length);
+  Token token = {0};
+
+  token.kind = kind;
+  token.code = TC_NONE;
+  token.flags = origin->flags;
+  token.location = origin->location;
+  token.length = (uint32_t)length;
+  token.interned = id;
+  token.data = interned_text(id);
+
+  return token;
+}
+
+/**
+ * Spells scratch tokens as a string literal, for the # operator (ISO/IEC
+ * 9899:2023 § 6.10.5.2).
+ */
+Token stringify(size_t begin, size_t end, const Token *origin) {
+  size_t size = 2;
+
+  for (size_t i = begin; i < end; i++) {
+    size += 2 * pp.scratch.tokens[i].token.length + 1;
+  }
+
+  char *text = reserve_text(size);
+  size_t length = 0;
+
+  text[length++] = '"';
+
+  for (size_t i = begin; i < end; i++) {
+    const Token *token = &pp.scratch.tokens[i].token;
+    bool literal = token->kind == STRING || token->kind == CONSTANT;
+
+    // Left by an empty __VA_OPT__ or ## operand.
+    if (token->kind == PLACEMARKER) {
+      continue;
+    }
+
+    if (length > 1 && (token->flags & TF_LEADING_SPACE)) {
+      text[length++] = ' ';
+    }
+
+    for (size_t j = 0; j < token->length; j++) {
+      char character = token->data[j];
+
+      if (literal && (character == '"' || character == '\\')) {
+        text[length++] = '\\';
+      }
+
+      text[length++] = character;
+    }
+  }
+
+  text[length++] = '"';
+  return text_token(STRING, text, length, origin);
+}
+
+/**
+ * Joins two tokens for the ## operator (ISO/IEC 9899:2023 § 6.10.5.3). The
+ * result is lexed again, and must be a single token.
+ *
+ * @param lhs The left operand, which receives the result.
+ * @param rhs The right operand.
+ */
+void paste_tokens(Token *lhs, const Token *rhs) {
+  if (rhs->kind == PLACEMARKER) {
+    return;
+  }
+
+  if (lhs->kind == PLACEMARKER) {
+    uint8_t flags = lhs->flags;
+    *lhs = *rhs;
+    lhs->flags = (flags & ~TF_UCN) | (rhs->flags & TF_UCN);
+    return;
+  }
+
+  size_t length = lhs->length + rhs->length;
+  char *text = reserve_text(length);
+
+  memcpy(text, lhs->data, lhs->length);
+  memcpy(&text[lhs->length], rhs->data, rhs->length);
+
+  Token result;
+  size_t index = 0;
+  scan_token(text, NO_LOCATION, &index, &result);
+
+  if (result.kind == EOF || result.length != length) {
+    PREPROCESSOR_ERROR(lhs->location,
+                       "Pasting \"%.*s\" and \"%.*s\" does not give a valid "
+                       "token",
+                       (int)lhs->length, lhs->data, (int)rhs->length,
+                       rhs->data);
+  }
+
+  intern_t id = intern(text, length);
+
+  result.flags = (lhs->flags & ~TF_UCN) | (result.flags & TF_UCN);
+  result.location = lhs->location;
+  result.data = interned_text(id);
+  result.interned = result.kind == IDENTIFIER || result.kind == CONSTANT ||
+                        result.kind == STRING
+                      ? intern_spelling(&result)
+                      : NO_INTERN;
+  *lhs = result;
+}
+
+// Arguments of a function-like macro invocation, kept in `pp.bounds` from
+// index `bounds` on. Argument i is [bounds[i], bounds[i + 1]) of the scratch
+// stack. The range of its full replacement follows the count + 1 bounds,
+// SIZE_MAX until it is computed.
+struct arguments {
+  size_t bounds;
+  size_t count;
+};
+
+void push_bound(size_t bound) {
+  if (pp.bound_count == pp.bound_capacity) {
+    size_t capacity =
+      pp.bound_capacity ? pp.bound_capacity * 2 : INITIAL_LIST_CAPACITY;
+    size_t *bounds = realloc(pp.bounds, capacity * sizeof(size_t));
+
+    if (!bounds) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    pp.bounds = bounds;
+    pp.bound_capacity = capacity;
+  }
+
+  pp.bounds[pp.bound_count++] = bound;
+}
+
+size_t argument_begin(const struct arguments *args, size_t index) {
+  return pp.bounds[args->bounds + index];
+}
+
+size_t argument_end(const struct arguments *args, size_t index) {
+  return pp.bounds[args->bounds + index + 1];
+}
+
+// Valid until the next push_bound().
+size_t *replaced_range(const struct arguments *args, size_t index) {
+  return &pp.bounds[args->bounds + args->count + 1 + 2 * index];
+}
+
+/**
+ * Reads the arguments of a function-like macro invocation onto the scratch
+ * stack, up to and including the closing parenthesis.
+ *
+ * @param rparen Receives the closing parenthesis.
+ */
+void collect_arguments(struct macro *macro, const Token *name,
+                       struct arguments *args, struct pp_token *rparen) {
+  size_t depth = 0;
+
+  args->bounds = pp.bound_count;
+  args->count = 0;
+  push_bound(pp.scratch.count);
+
+  for (;;) {
+    if (!next_unexpanded(rparen) || rparen->token.kind == EOF) {
+      PREPROCESSOR_ERROR(name->location,
+                         "Unterminated argument list invoking macro %s",
+                         interned_text(macro->name));
+    }
+
+    const Token *token = &rparen->token;
+
+    if (is_punct(token, PU_LPAREN)) {
+      depth++;
+    } else if (is_punct(token, PU_RPAREN)) {
+      if (depth == 0) {
+        break;
+      }
+
+      depth--;
+    } else if (is_punct(token, PU_COMMA) && depth == 0 &&
+               !(macro->variadic && args->count + 1 >= macro->param_count)) {
+      // The variable arguments keep their commas.
+      push_bound(pp.scratch.count);
+      args->count++;
+      continue;
+    }
+
+    push_pp_token(&pp.scratch, *rparen);
+  }
+
+  push_bound(pp.scratch.count);
+  args->count++;
+
+  if (macro->param_count == 0 && args->count == 1 &&
+      argument_begin(args, 0) == argument_end(args, 0)) {
+    pp.bound_count--;
+    args->count = 0;
+  } else if (macro->variadic && args->count + 1 == macro->param_count) {
+    // The variable arguments may be left out entirely.
+    push_bound(pp.scratch.count);
+    args->count++;
+  }
+
+  if (args->count != macro->param_count) {
+    PREPROCESSOR_ERROR(name->location,
+                       "Macro %s expects %zu arguments, but %zu were given",
+                       interned_text(macro->name), macro->param_count,
+                       args->count);
+  }
+
+  for (size_t i = 0; i < 2 * args->count; i++) {
+    push_bound(SIZE_MAX);
+  }
+}
+
+/**
+ * Fully replaces scratch tokens on their own, without reading past them. The
+ * result is pushed onto the scratch stack.
+ */
+void replace_range(size_t begin, size_t end) {
+  struct pp_token token;
+
+  push_context(begin, end, true);
+
+  while (next_expanded(&token)) {
+    push_pp_token(&pp.scratch, token);
+  }
+
+  pop_context();
+}
+
+/**
+ * Fully replaces the tokens of a directive line into `pp.replaced`.
+ */
+void replace_line(const Token *tokens, size_t count) {
+  size_t mark = pp.scratch.count;
+
+  for (size_t i = 0; i < count; i++) {
+    push_pp_token(&pp.scratch, (struct pp_token){tokens[i], NO_HIDESET});
+  }
+
+  replace_range(mark, mark + count);
+  pp.replaced.count = 0;
+
+  for (size_t i = mark + count; i < pp.scratch.count; i++) {
+    push_list_token(&pp.replaced, &pp.scratch.tokens[i].token);
+  }
+
+  pp.scratch.count = mark;
+}
+
+// Operands of ## are not replaced first.
+bool is_paste_operand(const struct macro *macro, size_t index) {
+  const Token *body = macro->body.tokens;
+
+  return (index > 0 && is_punct(&body[index - 1], PU_DHASH)) ||
+         (index + 1 < macro->body.count && is_punct(&body[index + 1], PU_DHASH));
+}
+
+/**
+ * Replaces every argument used outside of # and ##, and the variable arguments
+ * if there is a __VA_OPT__, once each, before any of the replacement list is
+ * built above them.
+ */
+void replace_arguments(struct macro *macro, const struct arguments *args) {
+  const Token *body = macro->body.tokens;
+
+  for (size_t i = 0; i < macro->body.count; i++) {
+    int param = param_index(macro, &body[i]);
+
+    if (is_va_opt(macro, &body[i])) {
+      // Whether the variable arguments are empty is decided once they are
+      // replaced (ISO/IEC 9899:2023 § 6.10.5.2).
+      param = (int)macro->param_count - 1;
+    } else if (param < 0 || is_paste_operand(macro, i) ||
+               (i > 0 && is_punct(&body[i - 1], PU_HASH))) {
+      continue;
+    }
+
+    if (replaced_range(args, param)[0] != SIZE_MAX) {
+      continue;
+    }
+
+    size_t begin = pp.scratch.count;
+    replace_range(argument_begin(args, param), argument_end(args, param));
+
+    size_t *range = replaced_range(args, param);
+    range[0] = begin;
+    range[1] = pp.scratch.count;
+  }
+}
+
+void push_placemarker(const Token *origin) {
+  Token placemarker = *origin;
+
+  placemarker.kind = PLACEMARKER;
+  placemarker.length = 0;
+  push_pp_token(&pp.scratch, (struct pp_token){placemarker, NO_HIDESET});
+}
+
+/**
+ * Pushes scratch tokens again in place of a parameter, or a placemarker if
+ * there are none. The first one takes the spacing of the parameter.
+ */
+void push_argument(const Token *param, size_t begin, size_t end) {
+  if (begin == end) {
+    push_placemarker(param);
+    return;
+  }
+
+  size_t first = pp.scratch.count;
+
+  for (size_t i = begin; i < end; i++) {
+    push_pp_token(&pp.scratch, pp.scratch.tokens[i]);
+  }
+
+  pp.scratch.tokens[first].token.flags &= ~TF_LEADING_SPACE;
+  pp.scratch.tokens[first].token.flags |= param->flags & TF_LEADING_SPACE;
+}
+
+size_t substitute_va_opt(struct macro *macro, const struct arguments *args,
+                         size_t index, size_t end);
+
+/**
+ * Substitutes arguments into part of a replacement list, applying # and ##.
+ * The result is pushed onto the scratch stack, with placemarkers for empty
+ * operands.
+ *
+ * @param args The arguments, NULL for object-like macros.
+ * @param start The first token of the part.
+ * @param end Just past the last one.
+ */
+void substitute(struct macro *macro, const struct arguments *args,
+                size_t start, size_t end) {
+  const Token *body = macro->body.tokens;
+  size_t out_begin = pp.scratch.count;
+  // Where the right operand of a ## begins.
+  size_t paste_at = SIZE_MAX;
+
+  for (size_t i = start; i < end; i++) {
+    const Token *token = &body[i];
+    size_t first = pp.scratch.count;
+    int param;
+
+    if (is_punct(token, PU_DHASH) && i + 1 < end) {
+      paste_at = first;
+      continue;
+    }
+
+    if (is_punct(token, PU_HASH) && args && i + 1 < end &&
+        (param = param_index(macro, &body[i + 1])) >= 0) {
+      Token string = stringify(argument_begin(args, param),
+                               argument_end(args, param), token);
+
+      push_pp_token(&pp.scratch, (struct pp_token){string, NO_HIDESET});
+      i++;
+    } else if (is_punct(token, PU_HASH) && i + 2 < end &&
+               is_va_opt(macro, &body[i + 1]) &&
+               is_punct(&body[i + 2], PU_LPAREN)) {
+      i = substitute_va_opt(macro, args, i + 1, end);
+
+      Token string = stringify(first, pp.scratch.count, token);
+
+      pp.scratch.count = first;
+      push_pp_token(&pp.scratch, (struct pp_token){string, NO_HIDESET});
+    } else if (is_va_opt(macro, token) && i + 1 < end &&
+               is_punct(&body[i + 1], PU_LPAREN)) {
+      i = substitute_va_opt(macro, args, i, end);
+    } else if (args && (param = param_index(macro, token)) >= 0) {
+      if (is_paste_operand(macro, i)) {
+        push_argument(token, argument_begin(args, param),
+                      argument_end(args, param));
+      } else {
+        size_t *range = replaced_range(args, param);
+        push_argument(token, range[0], range[1]);
+      }
+    } else {
+      push_pp_token(&pp.scratch, (struct pp_token){*token, NO_HIDESET});
+    }
+
+    if (paste_at == first && first > out_begin && pp.scratch.count > first) {
+      struct pp_token *lhs = &pp.scratch.tokens[first - 1];
+      const struct pp_token *rhs = &pp.scratch.tokens[first];
+
+      // A pasted token is only hidden from macros hiding both operands.
+      if (lhs->token.kind == PLACEMARKER) {
+        lhs->hideset = rhs->hideset;
+      } else if (rhs->token.kind != PLACEMARKER) {
+        lhs->hideset = combine_hidesets(lhs->hideset, rhs->hideset, true);
+      }
+
+      paste_tokens(&lhs->token, &rhs->token);
+      memmove(&pp.scratch.tokens[first], &pp.scratch.tokens[first + 1],
+              (pp.scratch.count - first - 1) * sizeof(struct pp_token));
+      pp.scratch.count--;
+    }
+
+    paste_at = SIZE_MAX;
+  }
+}
+
+/**
+ * Substitutes __VA_OPT__(...) at `body[index]`, pushing its contents onto the
+ * scratch stack if the variable arguments have any tokens once replaced, and
+ * a placemarker otherwise (ISO/IEC 9899:2023 § 6.10.5.2).
+ *
+ * @return The index of the closing parenthesis.
+ */
+size_t substitute_va_opt(struct macro *macro, const struct arguments *args,
+                         size_t index, size_t end) {
+  const Token *body = macro->body.tokens;
+  const Token *token = &body[index];
+  size_t first = pp.scratch.count;
+  size_t close = index + 2;
+  size_t depth = 0;
+
+  for (; close < end; close++) {
+    if (is_punct(&body[close], PU_LPAREN)) {
+      depth++;
+    } else if (is_punct(&body[close], PU_RPAREN) && depth-- == 0) {
+      break;
+    }
+  }
+
+  if (close == end) {
+    PREPROCESSOR_ERROR(token->location, "Unterminated __VA_OPT__");
+  }
+
+  size_t *range = replaced_range(args, macro->param_count - 1);
+
+  if (range[1] > range[0]) {
+    substitute(macro, args, index + 2, close);
+  }
+
+  if (pp.scratch.count == first) {
+    push_placemarker(token);
+  }
+
+  pp.scratch.tokens[first].token.flags &= ~TF_LEADING_SPACE;
+  pp.scratch.tokens[first].token.flags |= token->flags & TF_LEADING_SPACE;
+  return close;
+}
+
+Token builtin_token(struct macro *macro, const Token *name) {
+  if (macro->kind == MACRO_LINE) {
+    // Inside a replacement, the line of the outermost invocation.
+    SourceLocation location =
+      pp.context_count > 0 ? pp.expansion_location : name->location;
+    size_t line = location_coord(location).line_number;
+    char text[32];
+    int length = snprintf(text, sizeof(text), "%zu", line);
+    Token token = text_token(CONSTANT, text, (size_t)length, name);
+
+    token.constant = (Constant){line, CT_INT, 0};
+    return token;
+  }
+
+  const char *file = pp.frame->name;
+  char *text = reserve_text(2 * strlen(file) + 2);
+  size_t length = 0;
+
+  text[length++] = '"';
+
+  for (; *file; file++) {
+    if (*file == '"' || *file == '\\') {
+      text[length++] = '\\';
+    }
+
+    text[length++] = *file;
+  }
+
+  text[length++] = '"';
+  return text_token(STRING, text, length, name);
+}
+
+/**
+ * Replaces a macro invocation, pushing its replacement to be read next.
+ *
+ * Nothing is allocated once the stacks have grown: arguments and the
+ * replacement are built on the scratch stack, which is popped again once the
+ * result is copied into the arena.
+ *
+ * @param name The name of the macro, already read.
+ * @return false if a function-like macro is not followed by arguments, and
+ * so is not invoked.
+ */
+bool expand_macro(struct macro *macro, const struct pp_token *name) {
+  size_t mark = pp.scratch.count;
+  size_t bound_mark = pp.bound_count;
+  size_t result;
+  hideset_t hideset = NO_HIDESET;
+
+  if (pp.context_count == 0) {
+    pp.expansion_location = name->token.location;
+  }
+
+  if (macro->kind == MACRO_FILE || macro->kind == MACRO_LINE) {
+    result = pp.scratch.count;
+    push_pp_token(&pp.scratch, (struct pp_token){
+                                 builtin_token(macro, &name->token),
+                                 name->hideset});
+  } else if (macro->kind == MACRO_OBJECT) {
+    hideset = add_to_hideset(name->hideset, macro->name);
+    result = pp.scratch.count;
+    substitute(macro, NULL, 0, macro->body.count);
+  } else {
+    struct pp_token next;
+
+    if (!next_unexpanded(&next)) {
+      return false;
+    }
+
+    if (!is_punct(&next.token, PU_LPAREN)) {
+      pp.lookahead = next;
+      pp.has_lookahead = true;
+      return false;
+    }
+
+    struct arguments args;
+    struct pp_token rparen;
+
+    collect_arguments(macro, &name->token, &args, &rparen);
+    hideset = add_to_hideset(
+      combine_hidesets(name->hideset, rparen.hideset, true), macro->name);
+    replace_arguments(macro, &args);
+
+    result = pp.scratch.count;
+    substitute(macro, &args, 0, macro->body.count);
+  }
+
+  size_t kept = result;
+
+  for (size_t i = result; i < pp.scratch.count; i++) {
+    struct pp_token token = pp.scratch.tokens[i];
+
+    if (token.token.kind != PLACEMARKER) {
+      token.hideset = combine_hidesets(token.hideset, hideset, false);
+      pp.scratch.tokens[kept++] = token;
+    }
+  }
+
+  if (kept > result) {
+    Token *first = &pp.scratch.tokens[result].token;
+
+    first->flags &= ~(TF_LEADING_SPACE | TF_LINE_START);
+    first->flags |= name->token.flags & TF_LEADING_SPACE;
+  }
+
+  pp.stats.expansions++;
+  push_context(result, kept, false);
+  pp.scratch.count = mark;
+  pp.bound_count = bound_mark;
+  return true;
+}
+
+// Reading
+
+void handle_directive(struct include_frame *frame, const Token *hash);
+size_t skip_group_lines(const char *file, size_t index);
+
+/**
+ * Reads the next token of the current file after directives, leaving files
+ * that end for the file that included them.
+ */
+void read_file_token(Token *token) {
+  for (;;) {
+    struct include_frame *frame = pp.frame;
+
+    if (pp.directives_only) {
+      // Other lines are skipped without being lexed.
+      Scanner *scanner = frame->scanner;
+      size_t i = skip_group_lines(scanner->file, scanner_position(scanner));
+
+      seek_scanner(scanner, i);
+
+      if (scanner->file[i] == '#') {
+        Token hash = *next_token(scanner);
+
+        handle_directive(frame, &hash);
+        continue;
+      }
+    }
+
+    Token *next = next_token(frame->scanner);
+
+    if (next->kind == EOF) {
+      if (frame->parent) {
+        leave_file();
+        continue;
+      }
+
+      if (pp.conditional_count > 0) {
+        PREPROCESSOR_ERROR(pp.conditionals[pp.conditional_count - 1].location,
+                           "Unterminated conditional directive");
+      }
+    } else if (is_punct(next, PU_HASH) && (next->flags & TF_LINE_START)) {
+      Token hash = *next;
+
+      handle_directive(frame, &hash);
+      continue;
+    } else if (frame->guard_state != GUARD_INSIDE) {
+      frame->guard_state = GUARD_NONE;
+    }
+
+    *token = *next;
+
+    // Including files splits lines, even at the very start of a file.
+    if (token->flags & TF_LINE_START) {
+      token->flags |= TF_LEADING_SPACE;
+    }
+
+    return;
+  }
+}
+
+bool next_unexpanded(struct pp_token *token) {
+  if (pp.has_lookahead) {
+    *token = pp.lookahead;
+    pp.has_lookahead = false;
+    return true;
+  }
+
+  while (pp.context_count > 0) {
+    struct context *context = &pp.contexts[pp.context_count - 1];
+
+    if (context->next < context->end) {
+      *token = pp.arena.tokens[context->next++];
+      return true;
+    }
+
+    if (context->barrier) {
+      return false;
+    }
+
+    pop_context();
+  }
+
+  read_file_token(&token->token);
+  token->hideset = NO_HIDESET;
+  return true;
+}
+
+bool next_expanded(struct pp_token *token) {
+  for (;;) {
+    if (!next_unexpanded(token)) {
+      return false;
+    }
+
+    const Token *name = &token->token;
+
+    if (!is_name(name) || (name->flags & TF_NO_EXPAND) ||
+        (name->kind == KEYWORD && pp.keyword_macros == 0)) {
+      return true;
+    }
+
+    intern_t id = token_name(name);
+    struct macro *macro = find_macro(id);
+
+    if (!macro || hideset_contains(token->hideset, id) ||
+        !expand_macro(macro, token)) {
+      return true;
+    }
+  }
+}
+
+// Conditional inclusion
+
+struct pp_value {
+  uint64_t value;
+  bool is_unsigned;
+};
+
+struct evaluator {
+  const Token *tokens;
+  size_t count;
+  size_t next;
+  // Of the directive, for errors at the end of the line.
+  SourceLocation location;
+};
+
+const Token *peek_operand(struct evaluator *evaluator) {
+  return evaluator->next < evaluator->count
+           ? &evaluator->tokens[evaluator->next]
+           : NULL;
+}
+
+const Token *take_operand(struct evaluator *evaluator) {
+  if (evaluator->next == evaluator->count) {
+    PREPROCESSOR_ERROR(evaluator->location,
+                       "Expected an expression in preprocessor condition");
+  }
+
+  return &evaluator->tokens[evaluator->next++];
+}
+
+void expect_operand(struct evaluator *evaluator, enum token_code code,
+                    const char *spelling) {
+  const Token *token = peek_operand(evaluator);
+
+  if (!token || !is_punct(token, code)) {
+    PREPROCESSOR_ERROR(token ? token->location : evaluator->location,
+                       "Expected '%s' in preprocessor condition", spelling);
+  }
+
+  evaluator->next++;
+}
+
+// Plain character constants are int with a signed char per byte, like GCC.
+uint64_t char_constant_value(const Token *token) {
+  const char *text = token->data;
+  size_t end = token->length - 1;
+  bool plain = text[0] == '\'';
+  size_t count = 0;
+  uint64_t value = 0;
+  size_t i = 0;
+
+  while (text[i] != '\'') {
+    i++;
+  }
+
+  for (i++; i < end; count++) {
+    uint64_t character = (unsigned char)text[i++];
+
+    if (character == '\\') {
+      character = (unsigned char)text[i++];
+
+      switch (character) {
+      case 'a':
+        character = '\a';
+        break;
+      case 'b':
+        character = '\b';
+        break;
+      case 'f':
+        character = '\f';
+        break;
+      case 'n':
+        character = '\n';
+        break;
+      case 'r':
+        character = '\r';
+        break;
+      case 't':
+        character = '\t';
+        break;
+      case 'v':
+        character = '\v';
+        break;
+      case 'x':
+      case 'u':
+      case 'U':
+        character = 0;
+
+        while (i < end && isxdigit((unsigned char)text[i])) {
+          char digit = (char)tolower((unsigned char)text[i++]);
+          character = character * 16 +
+                      (uint64_t)(digit <= '9' ? digit - '0' : digit - 'a' + 10);
+        }
+        break;
+      default:
+        if ('0' <= character && character <= '7') {
+          character -= '0';
+
+          for (size_t n = 1; n < 3 && '0' <= text[i] && text[i] <= '7'; n++) {
+            character = character * 8 + (uint64_t)(text[i++] - '0');
+          }
+        }
+        break;
+      }
+    }
+
+    value = plain ? (value << 8) | (character & 0xff) : character;
+  }
+
+  if (plain && count == 1) {
+    value = (uint64_t)(int64_t)(signed char)value;
+  }
+
+  return value;
+}
+
+struct pp_value evaluate_conditional(struct evaluator *evaluator,
+                                     bool evaluated);
+
+bool read_header_name(const Token *tokens, size_t count, size_t *index,
+                      char *name, size_t size, bool *quoted);
+
+struct pp_value evaluate_unary(struct evaluator *evaluator, bool evaluated) {
+  const Token *token = take_operand(evaluator);
+  struct pp_value value;
+
+  if (token->kind == PUNCT) {
+    switch (token->code) {
+    case PU_LPAREN:
+      value = evaluate_conditional(evaluator, evaluated);
+      expect_operand(evaluator, PU_RPAREN, ")");
+      return value;
+    case PU_PLUS:
+      return evaluate_unary(evaluator, evaluated);
+    case PU_MINUS:
+      value = evaluate_unary(evaluator, evaluated);
+      value.value = -value.value;
+      return value;
+    case PU_TILDE:
+      value = evaluate_unary(evaluator, evaluated);
+      value.value = ~value.value;
+      return value;
+    case PU_BANG:
+      value = evaluate_unary(evaluator, evaluated);
+      return (struct pp_value){value.value == 0, false};
+    default:
+      break;
+    }
+  } else if (token->kind == CONSTANT) {
+    switch (token->constant.type) {
+    case CT_NONE:
+      return (struct pp_value){char_constant_value(token), false};
+    case CT_UNSIGNED:
+    case CT_UNSIGNED_LONG:
+    case CT_UNSIGNED_LONG_LONG:
+    case CT_UNSIGNED_BITINT:
+      return (struct pp_value){token->constant.bits, true};
+    case CT_INT:
+    case CT_LONG:
+    case CT_LONG_LONG:
+    case CT_BITINT:
+    case CT_BOOL:
+    case CT_NULLPTR:
+      return (struct pp_value){token->constant.bits, false};
+    default:
+      PREPROCESSOR_ERROR(token->location,
+                         "Floating constant in preprocessor condition");
+    }
+  } else if (is_name(token) && token_name(token) == pp.defined_name) {
+    bool parenthesized = peek_operand(evaluator) &&
+                         is_punct(peek_operand(evaluator), PU_LPAREN);
+
+    evaluator->next += parenthesized;
+    const Token *operand = take_operand(evaluator);
+
+    if (!is_name(operand)) {
+      PREPROCESSOR_ERROR(operand->location,
+                         "Expected a macro name after defined");
+    }
+
+    if (parenthesized) {
+      expect_operand(evaluator, PU_RPAREN, ")");
+    }
+
+    return (struct pp_value){find_macro(token_name(operand)) != NULL, false};
+  } else if (is_name(token) && token_name(token) == pp.has_include_name) {
+    char name[PATH_MAX];
+    bool quoted;
+
+    expect_operand(evaluator, PU_LPAREN, "(");
+
+    if (!read_header_name(evaluator->tokens, evaluator->count,
+                          &evaluator->next, name, sizeof(name), &quoted)) {
+      PREPROCESSOR_ERROR(token->location,
+                         "Expected \"FILENAME\" or <FILENAME> in "
+                         "__has_include");
+    }
+
+    expect_operand(evaluator, PU_RPAREN, ")");
+    return (struct pp_value){find_include(name, quoted) != NULL, false};
+  } else if (is_name(token)) {
+    // Names left after replacement are 0 (ISO/IEC 9899:2023 § 6.10.2).
+    return (struct pp_value){0, false};
+  }
+
+  PREPROCESSOR_ERROR(token->location,
+                     "Unexpected '%.*s' in preprocessor condition",
+                     (int)token->length, token->data);
+  return (struct pp_value){0, false};
+}
+
+// Arithmetic is done in intmax_t or uintmax_t (ISO/IEC 9899:2023 § 6.10.2).
+struct pp_value apply_operator(const Token *operator, struct pp_value lhs,
+                               struct pp_value rhs, bool evaluated) {
+  bool is_unsigned = lhs.is_unsigned || rhs.is_unsigned;
+  uint64_t a = lhs.value;
+  uint64_t b = rhs.value;
+
+  switch (operator->code) {
+  case PU_STAR:
+    return (struct pp_value){a * b, is_unsigned};
+  case PU_SLASH:
+  case PU_PERCENT:
+    if (b == 0) {
+      if (evaluated) {
+        PREPROCESSOR_ERROR(operator->location,
+                           "Division by zero in preprocessor condition");
+      }
+
+      return (struct pp_value){0, is_unsigned};
+    }
+
+    if (is_unsigned) {
+      return (struct pp_value){operator->code == PU_SLASH ? a / b : a % b,
+                               true};
+    }
+
+    if ((int64_t)a == INT64_MIN && (int64_t)b == -1) {
+      return (struct pp_value){operator->code == PU_SLASH ? a : 0, false};
+    }
+
+    return (struct pp_value){
+      (uint64_t)(operator->code == PU_SLASH ? (int64_t)a / (int64_t)b
+                                            : (int64_t)a % (int64_t)b),
+      false};
+  case PU_PLUS:
+    return (struct pp_value){a + b, is_unsigned};
+  case PU_MINUS:
+    return (struct pp_value){a - b, is_unsigned};
+  case PU_SHFL:
+    return (struct pp_value){b < 64 ? a << b : 0, lhs.is_unsigned};
+  case PU_SHFR:
+    if (lhs.is_unsigned) {
+      return (struct pp_value){b < 64 ? a >> b : 0, true};
+    }
+
+    return (struct pp_value){(uint64_t)((int64_t)a >> min(b, 63)), false};
+  case PU_LT:
+    return (struct pp_value){
+      is_unsigned ? a < b : (int64_t)a < (int64_t)b, false};
+  case PU_GT:
+    return (struct pp_value){
+      is_unsigned ? a > b : (int64_t)a > (int64_t)b, false};
+  case PU_LTE:
+    return (struct pp_value){
+      is_unsigned ? a <= b : (int64_t)a <= (int64_t)b, false};
+  case PU_GTE:
+    return (struct pp_value){
+      is_unsigned ? a >= b : (int64_t)a >= (int64_t)b, false};
+  case PU_EE:
+    return (struct pp_value){a == b, false};
+  case PU_NE:
+    return (struct pp_value){a != b, false};
+  case PU_AMP:
+    return (struct pp_value){a & b, is_unsigned};
+  case PU_CARET:
+    return (struct pp_value){a ^ b, is_unsigned};
+  default:
+    return (struct pp_value){a | b, is_unsigned};
+  }
+}
+
+/**
+ * Evaluates binary operators by precedence climbing. Operands that are not
+ * evaluated, after && or || has decided, cannot fail.
+ *
+ * @param precedence The lowest precedence of operators to apply.
+ */
+struct pp_value evaluate_binary(struct evaluator *evaluator, int precedence,
+                                bool evaluated) {
+  struct pp_value lhs = evaluate_unary(evaluator, evaluated);
+
+  for (;;) {
+    const Token *operator = peek_operand(evaluator);
+    int operator_precedence =
+      operator && operator->kind == PUNCT ? binary_precedence[operator->code]
+                                          : 0;
+
+    if (operator_precedence == 0 || operator_precedence < precedence) {
+      return lhs;
+    }
+
+    evaluator->next++;
+
+    if (operator->code == PU_LAND || operator->code == PU_LOR) {
+      bool decided = operator->code == PU_LAND ? lhs.value == 0
+                                               : lhs.value != 0;
+      struct pp_value rhs = evaluate_binary(
+        evaluator, operator_precedence + 1, evaluated && !decided);
+
+      lhs = (struct pp_value){decided ? operator->code == PU_LOR
+                                      : rhs.value != 0,
+                              false};
+    } else {
+      struct pp_value rhs =
+        evaluate_binary(evaluator, operator_precedence + 1, evaluated);
+      lhs = apply_operator(operator, lhs, rhs, evaluated);
+    }
+  }
+}
+
+struct pp_value evaluate_conditional(struct evaluator *evaluator,
+                                     bool evaluated) {
+  struct pp_value condition = evaluate_binary(evaluator, 1, evaluated);
+  const Token *question = peek_operand(evaluator);
+
+  if (!question || !is_punct(question, PU_QUESTION)) {
+    return condition;
+  }
+
+  evaluator->next++;
+
+  struct pp_value then =
+    evaluate_conditional(evaluator, evaluated && condition.value != 0);
+  expect_operand(evaluator, PU_COLON, ":");
+  struct pp_value otherwise =
+    evaluate_conditional(evaluator, evaluated && condition.value == 0);
+
+  return (struct pp_value){condition.value ? then.value : otherwise.value,
+                           then.is_unsigned || otherwise.is_unsigned};
+}
+
+bool evaluate_condition(Token *tokens, size_t count, SourceLocation location) {
+  // Operands of defined and __has_include are not replaced.
+  for (size_t i = 0; i < count; i++) {
+    if (!is_name(&tokens[i])) {
+      continue;
+    }
+
+    intern_t name = token_name(&tokens[i]);
+
+    if (name == pp.defined_name) {
+      size_t operand = i + 1 < count && is_punct(&tokens[i + 1], PU_LPAREN)
+                         ? i + 2
+                         : i + 1;
+
+      if (operand < count) {
+        tokens[operand].flags |= TF_NO_EXPAND;
+      }
+    } else if (name == pp.has_include_name) {
+      for (size_t j = i + 1; j < count; j++) {
+        tokens[j].flags |= TF_NO_EXPAND;
+
+        if (is_punct(&tokens[j], PU_RPAREN)) {
+          break;
+        }
+      }
+    }
+  }
+
+  replace_line(tokens, count);
+
+  struct evaluator evaluator = {pp.replaced.tokens, pp.replaced.count, 0,
+                                location};
+  struct pp_value value = evaluate_conditional(&evaluator, true);
+  const Token *extra = peek_operand(&evaluator);
+
+  if (extra) {
+    PREPROCESSOR_ERROR(extra->location,
+                       "Unexpected '%.*s' in preprocessor condition",
+                       (int)extra->length, extra->data);
+  }
+
+  return value.value != 0;
+}
+
+bool evaluate_directive(enum directive directive, const Token *hash,
+                        Token *tokens, size_t count) {
+  if (directive == D_IF || directive == D_ELIF) {
+    if (count < 2) {
+      PREPROCESSOR_ERROR(hash->location, "Expected an expression after #%.*s",
+                         (int)tokens[0].length, tokens[0].data);
+    }
+
+    return evaluate_condition(&tokens[1], count - 1, hash->location);
+  }
+
+  bool defined = find_macro(macro_operand(hash, tokens, count)) != NULL;
+  return directive == D_IFDEF || directive == D_ELIFDEF ? defined : !defined;
+}
+
+/**
+ * Skips the rest of a line in a skipped group, through comments and quotes
+ * that may hide a newline.
+ *
+ * @return The index of the newline ending the line, or of the NUL.
+ */
+size_t skip_group_line(const char *file, size_t index) {
+  size_t i = index;
+
+  for (;;) {
+    i = skip_plain_chars(file, i);
+
+    if (file[i] == '\n' || file[i] == '\0') {
+      return i;
+    }
+
+    if (file[i] == '\\' && file[i + 1] != '\0') {
+      i += 2;
+    } else if (file[i] == '/' && file[i + 1] == '*') {
+      i = skip_block_comment(file, i + 2);
+    } else if (file[i] == '/' && file[i + 1] == '/') {
+      i = skip_line(file, i + 2);
+    } else if (file[i] == '"' || file[i] == '\'') {
+      // An unterminated quote, such as an apostrophe in prose, ends with its
+      // line.
+      char quote = file[i++];
+
+      while (file[i] != quote && file[i] != '\n' && file[i] != '\0') {
+        i += file[i] == '\\' && file[i + 1] != '\0' ? 2 : 1;
+      }
+
+      i += file[i] == quote;
+    } else {
+      i++;
+    }
+  }
+}
+
+/**
+ * Finds the next line of a skipped group that starts with #. Lines in between
+ * are never lexed, so they need not be made of valid tokens.
+ *
+ * @return The index of the # or of the NUL.
+ */
+size_t skip_group_lines(const char *file, size_t index) {
+  size_t i = index;
+
+  for (;;) {
+    while (file[i] == ' ' || file[i] == '\t' || file[i] == '\v' ||
+           file[i] == '\f' || file[i] == '\r' ||
+           (file[i] == '/' && file[i + 1] == '*')) {
+      i = file[i] == '/' ? skip_block_comment(file, i + 2) : i + 1;
+    }
+
+    if (file[i] == '#' || file[i] == '\0') {
+      return i;
+    }
+
+    i = skip_group_line(file, i);
+    i += file[i] == '\n';
+  }
+}
+
+/**
+ * Skips a group whose condition is false, up to the #elif, #else or #endif
+ * ending it. Nested conditionals are skipped whole.
+ *
+ * @param hash Receives the # of the directive ending the group. The scanner
+ * is left just past it.
+ * @return The directive, or D_EOF if the file ends first.
+ */
+enum directive skip_group(struct include_frame *frame, Token *hash) {
+  Scanner *scanner = frame->scanner;
+  const char *file = scanner->file;
+  size_t i = scanner_position(scanner);
+  size_t depth = 0;
+
+  for (;;) {
+    i = skip_group_lines(file, i);
+    seek_scanner(scanner, i);
+
+    if (file[i] == '\0') {
+      return D_EOF;
+    }
+
+    *hash = *next_token(scanner);
+
+    enum directive directive =
+      at_line_end(scanner) ? D_NONE : directive_kind(peek_token(scanner, 0));
+
+    if (directive >= D_IF && directive <= D_IFNDEF) {
+      depth++;
+    } else if (directive >= D_ELIF && directive <= D_ENDIF) {
+      if (depth == 0) {
+        return directive;
+      }
+
+      depth -= directive == D_ENDIF;
+    }
+
+    i = skip_group_line(file, i + 1);
+  }
+}
+
+/**
+ * Skips groups of the innermost conditional until one is kept or it ends.
+ */
+void skip_conditional(struct include_frame *frame) {
+  for (;;) {
+    struct conditional *conditional =
+      &pp.conditionals[pp.conditional_count - 1];
+    Token hash;
+    enum directive directive = skip_group(frame, &hash);
+
+    if (directive == D_EOF) {
+      PREPROCESSOR_ERROR(conditional->location,
+                         "Unterminated conditional directive");
+    }
+
+    read_line(frame);
+    note_directive(frame, directive, NO_INTERN);
+
+    if (directive == D_ENDIF) {
+      pp.conditional_count--;
+      return;
+    }
+
+    if (conditional->seen_else) {
+      PREPROCESSOR_ERROR(hash.location, "#%.*s after #else",
+                         (int)pp.line.tokens[0].length,
+                         pp.line.tokens[0].data);
+    }
+
+    conditional->seen_else = directive == D_ELSE;
+
+    // Once a group is kept, later #elif conditions are not evaluated.
+    if (!conditional->taken &&
+        (directive == D_ELSE ||
+         evaluate_directive(directive, &hash, pp.line.tokens,
+                            pp.line.count))) {
+      conditional->taken = true;
+      return;
+    }
+  }
+}
+
+void push_conditional(SourceLocation location, bool taken) {
+  if (pp.conditional_count == pp.conditional_capacity) {
+    size_t capacity = pp.conditional_capacity ? pp.conditional_capacity * 2
+                                              : INITIAL_LIST_CAPACITY;
+    struct conditional *conditionals =
+      realloc(pp.conditionals, capacity * sizeof(struct conditional));
+
+    if (!conditionals) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    pp.conditionals = conditionals;
+    pp.conditional_capacity = capacity;
+  }
+
+  pp.conditionals[pp.conditional_count++] =
+    (struct conditional){location, taken, false};
+}
+
+/**
+ * @return The conditional an #elif, #else or #endif belongs to, which must
+ * have been opened in the same file.
+ */
+struct conditional *current_conditional(struct include_frame *frame,
+                                        const Token *hash) {
+  if (pp.conditional_count == frame->conditional_depth) {
+    PREPROCESSOR_ERROR(hash->location, "#%.*s without #if",
+                       (int)pp.line.tokens[0].length, pp.line.tokens[0].data);
+  }
+
+  return &pp.conditionals[pp.conditional_count - 1];
+}
+
+// Source file inclusion
+
+bool read_header_name(const Token *tokens, size_t count, size_t *index,
+                      char *name, size_t size, bool *quoted) {
+  size_t i = *index;
+
+  if (i < count && tokens[i].kind == STRING && tokens[i].data[0] == '"') {
+    size_t length = tokens[i].length - 2;
+
+    if (length >= size) {
+      return false;
+    }
+
+    memcpy(name, &tokens[i].data[1], length);
+    name[length] = '\0';
+    *quoted = true;
+    *index = i + 1;
+    return true;
+  }
+
+  if (i == count || !is_punct(&tokens[i], PU_LT)) {
+    return false;
+  }
+
+  // Lexed as separate tokens, spelled again with their spacing.
+  size_t length = 0;
+
+  for (i++; i < count && !is_punct(&tokens[i], PU_GT); i++) {
+    bool space = length > 0 && (tokens[i].flags & TF_LEADING_SPACE);
+
+    if (length + space + tokens[i].length >= size) {
+      return false;
+    }
+
+    if (space) {
+      name[length++] = ' ';
+    }
+
+    memcpy(&name[length], tokens[i].data, tokens[i].length);
+    length += tokens[i].length;
+  }
+
+  if (i == count) {
+    return false;
+  }
+
+  name[length] = '\0';
+  *quoted = false;
+  *index = i + 1;
+  return true;
+}
+
+void include_file(const Token *hash, Token *tokens, size_t count) {
+  char name[PATH_MAX];
+  bool quoted;
+  size_t index = 1;
+  const Token *header = tokens;
+  size_t header_count = count;
+
+  // Otherwise the line is replaced first (ISO/IEC 9899:2023 § 6.10.3).
+  if (!read_header_name(tokens, count, &index, name, sizeof(name), &quoted)) {
+    replace_line(&tokens[1], count - 1);
+    header = pp.replaced.tokens;
+    header_count = pp.replaced.count;
+    index = 0;
+
+    if (!read_header_name(header, header_count, &index, name, sizeof(name),
+                          &quoted)) {
+      PREPROCESSOR_ERROR(hash->location,
+                         "Expected \"FILENAME\" or <FILENAME> after #include");
+    }
+  }
+
+  if (index != header_count) {
+    PREPROCESSOR_ERROR(header[index].location,
+                       "Unexpected '%.*s' after #include",
+                       (int)header[index].length, header[index].data);
+  }
+
+  struct source_file *file = find_include(name, quoted);
+  bool system = !quoted || pp.frame->system;
+
+  // There are no system include directories to look in.
+  if (!file && !quoted && pp.directives_only) {
+    return;
+  }
+
+  if (!file) {
+    PREPROCESSOR_ERROR(hash->location, "Cannot find include file %.256s",
+                       name);
+  }
+
+  if ((file->pragma_once && file->entered) ||
+      (file->guard != NO_INTERN && find_macro(file->guard))) {
+    pp.stats.includes_skipped++;
+    return;
+  }
+
+  if (pp.include_depth >= MAX_INCLUDE_DEPTH) {
+    PREPROCESSOR_ERROR(hash->location, "#include nested more than %d deep",
+                       MAX_INCLUDE_DEPTH);
+  }
+
+  enter_file(file, hash, system);
+}
+
+void handle_directive(struct include_frame *frame, const Token *hash) {
+  read_line(frame);
+
+  // The null directive.
+  if (pp.line.count == 0) {
+    return;
+  }
+
+  Token *tokens = pp.line.tokens;
+  size_t count = pp.line.count;
+  enum directive directive = directive_kind(&tokens[0]);
+  intern_t guard = NO_INTERN;
+
+  if (directive == D_IFNDEF && count == 2 && is_name(&tokens[1])) {
+    guard = token_name(&tokens[1]);
+  } else if (directive == D_IF) {
+    guard = negated_defined(&tokens[1], count - 1);
+  }
+
+  note_directive(frame, directive, guard);
+
+  switch (directive) {
+  case D_IF:
+  case D_IFDEF:
+  case D_IFNDEF: {
+    bool value = evaluate_directive(directive, hash, tokens, count);
+
+    push_conditional(hash->location, value);
+
+    if (!value) {
+      skip_conditional(frame);
+    }
+    break;
+  }
+  case D_ELIF:
+  case D_ELIFDEF:
+  case D_ELIFNDEF:
+  case D_ELSE: {
+    // Reached from a kept group, so every later group is skipped.
+    struct conditional *conditional = current_conditional(frame, hash);
+
+    if (conditional->seen_else) {
+      PREPROCESSOR_ERROR(hash->location, "#%.*s after #else",
+                         (int)tokens[0].length, tokens[0].data);
+    }
+
+    conditional->seen_else = directive == D_ELSE;
+    skip_conditional(frame);
+    break;
+  }
+  case D_ENDIF:
+    current_conditional(frame, hash);
+    pp.conditional_count--;
+    break;
+  case D_DEFINE:
+    define_macro(hash, tokens, count);
+    break;
+  case D_UNDEF:
+    undefine_macro(hash, tokens, count);
+    break;
+  case D_INCLUDE:
+    include_file(hash, tokens, count);
+    break;
+  case D_EMBED:
+    PREPROCESSOR_ERROR(hash->location, "#embed is not supported");
+    break;
+  case D_LINE:
+    // Diagnostics keep the physical line.
+    break;
+  case D_ERROR:
+  case D_WARNING: {
+    char text[256];
+    char where[LOCATION_TEXT_SIZE];
+
+    spell_tokens(&tokens[1], count - 1, text, sizeof(text));
+    format_location(hash->location, where, sizeof(where));
+
+    if (directive == D_ERROR) {
+      ERRORV("preprocessor", "#error %s at %s", text, where);
+    } else {
+      WARNINGV("preprocessor", "#warning %s at %s", text, where);
+    }
+    break;
+  }
+  case D_PRAGMA:
+    // Other pragmas are ignored (ISO/IEC 9899:2023 § 6.10.8).
+    if (count == 2 && is_spelled(&tokens[1], "once") && frame->file) {
+      frame->file->pragma_once = true;
+    }
+    break;
+  default:
+    // GNU line markers, "# 1 "file"", are left alone.
+    if (tokens[0].kind != CONSTANT) {
+      PREPROCESSOR_ERROR(hash->location,
+                         "Invalid preprocessing directive #%.*s",
+                         (int)tokens[0].length, tokens[0].data);
+    }
+    break;
+  }
+}
+
+// Lifetime
+
+void release_translation_unit(void) {
+  pp.context_count = 0;
+  pp.arena.count = 0;
+  pp.scratch.count = 0;
+  pp.bound_count = 0;
+
+  // Hideset 0 is the empty set.
+  pp.hideset_count = 1;
+  pp.member_count = 0;
+  memset(pp.hideset_cache, 0, sizeof(pp.hideset_cache));
+
+  if (pp.hideset_buckets) {
+    memset(pp.hideset_buckets, 0,
+           pp.hideset_bucket_count * sizeof(*pp.hideset_buckets));
+  }
+
+  while (pp.frame) {
+    struct include_frame *frame = pp.frame;
+    pp.frame = frame->parent;
+    free(frame);
+  }
+
+  while (pp.all_macros) {
+    struct macro *macro = pp.all_macros;
+    pp.all_macros = macro->next;
+    free_macro(macro);
+  }
+
+  while (pp.files) {
+    struct source_file *file = pp.files;
+    pp.files = file->next;
+
+    if (file->loaded) {
+      release_source(&file->buffer);
+    }
+
+    free(file);
+  }
+
+  free_id_map(&pp.macros);
+  free_id_map(&pp.paths);
+
+  pp.included_count = 0;
+  pp.include_depth = 0;
+  pp.keyword_macros = 0;
+  pp.conditional_count = 0;
+  pp.has_lookahead = false;
+  pp.stats = (PreprocessorStats){0, 0, 0};
+}
+
+void add_include_directory(const char *directory) {
+  if (pp.include_directory_count == pp.include_directory_capacity) {
+    size_t capacity = pp.include_directory_capacity
+                        ? pp.include_directory_capacity * 2
+                        : INITIAL_LIST_CAPACITY;
+    const char **directories =
+      realloc(pp.include_directories, capacity * sizeof(const char *));
+
+    if (!directories) {
+      CRITICAL("preprocessor", "Out of memory!");
+    }
+
+    pp.include_directories = directories;
+    pp.include_directory_capacity = capacity;
+  }
+
+  pp.include_directories[pp.include_directory_count++] = directory;
+}
+
+void init_preprocessor(Scanner *scanner, const char *path) {
+  release_translation_unit();
+
+  pp.defined_name = intern("defined", strlen("defined"));
+  pp.has_include_name = intern("__has_include", strlen("__has_include"));
+  pp.va_args_name = intern("__VA_ARGS__", strlen("__VA_ARGS__"));
+  pp.va_opt_name = intern("__VA_OPT__", strlen("__VA_OPT__"));
+
+  define_builtin("__FILE__", MACRO_FILE);
+  define_builtin("__LINE__", MACRO_LINE);
+
+  struct include_frame *main_frame = new_frame();
+
+  main_frame->scanner = scanner;
+  main_frame->name = interned_text(intern(path, strlen(path)));
+  main_frame->directory = directory_of(path);
+  main_frame->file = lookup_path(path);
+
+  if (main_frame->file) {
+    main_frame->file->entered = true;
+  }
+
+  push_frame(main_frame);
+
+  // Read before the main file, as if it included them.
+  const char *name = "<built-in>";
+  struct include_frame *predefined = new_frame();
+
+  if (register_source(name, predefined_source, strlen(predefined_source)) ==
+      NO_LOCATION) {
+    CRITICAL("preprocessor", "Out of source locations!");
+  }
+
+  init_scanner(predefined->scanner, predefined_source);
+  predefined->name = name;
+  push_frame(predefined);
+}
+
+Token *preprocess_token(void) {
+  struct pp_token token;
+
+  next_expanded(&token);
+  pp.current = token.token;
+
+  if (pp.dump_tokens) {
+    Span span = token_span(&pp.current);
+    DEBUG("token [%d, %.*s, %zu:%zu, %zu:%zu]", pp.current.kind,
+          (int)pp.current.length, pp.current.data, span.start.line_number,
+          span.start.column, span.end.line_number, span.end.column);
+  }
+
+  return &pp.current;
+}
+
+PreprocessorStats get_preprocessor_stats(void) { return pp.stats; }
+
+void set_directives_only(bool directives_only) {
+  pp.directives_only = directives_only;
+}
+
+void set_token_dump(bool dump) { pp.dump_tokens = dump; }
+
+const IncludedFile *get_included_files(size_t *count) {
+  *count = pp.included_count;
+  return pp.included;
+}
+
+void free_preprocessor(void) {
+  release_translation_unit();
+
+  free(pp.include_directories);
+  free(pp.included);
+  free(pp.conditionals);
+  free(pp.contexts);
+  free_stack(&pp.arena);
+  free_stack(&pp.scratch);
+  free(pp.bounds);
+  free(pp.hidesets);
+  free(pp.hideset_members);
+  free(pp.hideset_buckets);
+  free_list(&pp.line);
+  free_list(&pp.replaced);
+  free(pp.text);
+
+  pp = (struct preprocessor){0};
+}
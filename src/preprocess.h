@@ -0,0 +1,94 @@
+#pragma once
+
+#include "scanner.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Deepest nesting of #include before it is considered runaway recursion.
+#define MAX_INCLUDE_DEPTH 200
+
+typedef struct PreprocessorStatsStruct {
+  // Files lexed, the main file and the predefined macros included.
+  size_t files_entered;
+  // #include directives dropped because of an include guard or #pragma once,
+  // without opening the file again.
+  size_t includes_skipped;
+  // Macro invocations replaced.
+  size_t expansions;
+} PreprocessorStats;
+
+typedef struct IncludedFileStruct {
+  const char *path;
+  // Included with <...>, or from a header that was.
+  bool system;
+} IncludedFile;
+
+/**
+ * Adds a directory searched by #include, after those added before. Quoted
+ * names are first looked up next to the including file.
+ *
+ * @param directory The directory, which must outlive the preprocessor.
+ */
+void add_include_directory(const char *directory);
+
+/**
+ * Starts preprocessing a translation unit, dropping the macros and files
+ * loaded by a previous one. Include directories are kept.
+ *
+ * Directives are handled as they are reached, between the scanner and the
+ * parser, so the unit is never materialized as a whole.
+ *
+ * @param scanner The scanner over the main file. The preprocessor reads from
+ * it directly, so it must outlive preprocessing.
+ * @param path The path of the main file, used for quoted includes, __FILE__
+ * and #pragma once.
+ */
+void init_preprocessor(Scanner *scanner, const char *path);
+
+/**
+ * Produces the next token after directives and macro replacement.
+ *
+ * After the end of the main file every call returns an EOF token.
+ *
+ * @return The token, valid until the next call.
+ */
+Token *preprocess_token(void);
+
+/**
+ * @return Counters for the translation unit being preprocessed.
+ */
+PreprocessorStats get_preprocessor_stats(void);
+
+/**
+ * Makes the preprocessor only act on directives, to find the files a
+ * translation unit includes. Lines that do not start with # are skipped
+ * without being lexed, so preprocess_token() only ever returns EOF.
+ *
+ * Headers included with <...> that cannot be found are left out rather than
+ * being an error, as there are no system include directories.
+ *
+ * Lasts until free_preprocessor().
+ */
+void set_directives_only(bool directives_only);
+
+/**
+ * Logs every token preprocess_token() returns with DEBUG, so the dump shows
+ * what the parser reads rather than what the file spells.
+ *
+ * Lasts until free_preprocessor().
+ */
+void set_token_dump(bool dump);
+
+/**
+ * @param count Receives the number of files.
+ * @return The files entered by #include so far, each once in the order they
+ * were first entered. Valid until the next init_preprocessor().
+ */
+const IncludedFile *get_included_files(size_t *count);
+
+/**
+ * Releases macros and included files. Tokens handed out reference included
+ * files, so this must come after they are no longer used.
+ */
+void free_preprocessor(void);
@@ -0,0 +1,301 @@
+#include "scan_simd.h"
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+struct scan_kernels {
+  size_t (*skip_whitespace)(const char *file, size_t index);
+  size_t (*skip_line)(const char *file, size_t index);
+  size_t (*skip_block_comment)(const char *file, size_t index);
+  size_t (*skip_identifier)(const char *file, size_t index);
+  size_t (*skip_string_chars)(const char *file, size_t index);
+  size_t (*skip_plain_chars)(const char *file, size_t index);
+};
+
+// Selected before main() by select_scan_kernels(), see set_scan_isa().
+const struct scan_kernels *kernels = NULL;
+
+static inline const char *align_block(const char *pointer, size_t bytes) {
+  return (const char *)((uintptr_t)pointer & ~(uintptr_t)(bytes - 1));
+}
+
+// Scalar kernels
+
+bool is_space_byte(char character) {
+  return character == ' ' || ('\t' <= character && character <= '\r');
+}
+
+bool is_ident_byte(char character) {
+  return ('A' <= character && character <= 'Z') ||
+         ('a' <= character && character <= 'z') ||
+         ('0' <= character && character <= '9') || character == '_';
+}
+
+size_t skip_whitespace_scalar(const char *file, size_t index) {
+  size_t i = index;
+
+  while (is_space_byte(file[i])) {
+    i++;
+  }
+
+  return i;
+}
+
+size_t skip_line_scalar(const char *file, size_t index) {
+  size_t i = index;
+
+  while (file[i] != '\0' && file[i] != '\n') {
+    i++;
+  }
+
+  return i;
+}
+
+size_t skip_block_comment_scalar(const char *file, size_t index) {
+  size_t i = index;
+
+  while (file[i] != '\0') {
+    if (file[i] == '*' && file[i + 1] == '/') {
+      return i + 2;
+    }
+
+    i++;
+  }
+
+  return i;
+}
+
+size_t skip_identifier_scalar(const char *file, size_t index) {
+  size_t i = index;
+
+  while (is_ident_byte(file[i])) {
+    i++;
+  }
+
+  return i;
+}
+
+size_t skip_string_chars_scalar(const char *file, size_t index) {
+  size_t i = index;
+
+  while (file[i] != '\0' && file[i] != '"' && file[i] != '\\' &&
+         file[i] != '\n') {
+    i++;
+  }
+
+  return i;
+}
+
+size_t skip_plain_chars_scalar(const char *file, size_t index) {
+  size_t i = index;
+
+  while (file[i] != '\0' && file[i] != '\n' && file[i] != '/' &&
+         file[i] != '"' && file[i] != '\'' && file[i] != '\\') {
+    i++;
+  }
+
+  return i;
+}
+
+const struct scan_kernels scalar_kernels = {
+  .skip_whitespace = skip_whitespace_scalar,
+  .skip_line = skip_line_scalar,
+  .skip_block_comment = skip_block_comment_scalar,
+  .skip_identifier = skip_identifier_scalar,
+  .skip_string_chars = skip_string_chars_scalar,
+  .skip_plain_chars = skip_plain_chars_scalar,
+};
+
+#ifdef HAVE_X86_KERNELS
+
+// Whole blocks are loaded, bytes past the end of the source included, see
+// scan_simd.inc. AddressSanitizer would report them, so the loads are not
+// instrumented; they are not inlined into the kernels in such builds.
+#define NO_ASAN __attribute__((no_sanitize("address")))
+
+// SSE2 kernels, 16 bytes per step
+
+#define SSE2 __attribute__((target("sse2")))
+
+static inline SSE2 NO_ASAN __m128i load_sse2(const char *block) {
+  return _mm_load_si128((const __m128i *)block);
+}
+
+static inline SSE2 uint32_t eq_sse2(__m128i v, char c) {
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+
+// Bytes are compared signed, so anything above 0x7f is never in range.
+static inline SSE2 uint32_t in_range_sse2(__m128i v, char low, char high) {
+  __m128i above = _mm_cmpgt_epi8(v, _mm_set1_epi8((char)(low - 1)));
+  __m128i below = _mm_cmplt_epi8(v, _mm_set1_epi8((char)(high + 1)));
+  return (uint32_t)_mm_movemask_epi8(_mm_and_si128(above, below));
+}
+
+static inline SSE2 uint32_t is_space_sse2(__m128i v) {
+  return eq_sse2(v, ' ') | in_range_sse2(v, '\t', '\r');
+}
+
+static inline SSE2 uint32_t is_ident_sse2(__m128i v) {
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  return in_range_sse2(lower, 'a', 'z') | in_range_sse2(v, '0', '9') |
+         eq_sse2(v, '_');
+}
+
+#define VEC_BYTES 16
+#define TARGET SSE2
+#define KERNEL(name) name##_sse2
+#define vec_t __m128i
+#define LOAD load_sse2
+#define EQ eq_sse2
+#define IS_SPACE is_space_sse2
+#define IS_IDENT is_ident_sse2
+#include "scan_simd.inc"
+#undef VEC_BYTES
+#undef TARGET
+#undef KERNEL
+#undef vec_t
+#undef LOAD
+#undef EQ
+#undef IS_SPACE
+#undef IS_IDENT
+
+const struct scan_kernels sse2_kernels = {
+  .skip_whitespace = skip_whitespace_sse2,
+  .skip_line = skip_line_sse2,
+  .skip_block_comment = skip_block_comment_sse2,
+  .skip_identifier = skip_identifier_sse2,
+  .skip_string_chars = skip_string_chars_sse2,
+  .skip_plain_chars = skip_plain_chars_sse2,
+};
+
+// AVX2 kernels, 32 bytes per step
+
+#define AVX2 __attribute__((target("avx2")))
+
+static inline AVX2 NO_ASAN __m256i load_avx2(const char *block) {
+  return _mm256_load_si256((const __m256i *)block);
+}
+
+static inline AVX2 uint32_t eq_avx2(__m256i v, char c) {
+  return (uint32_t)_mm256_movemask_epi8(
+    _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+}
+
+static inline AVX2 uint32_t in_range_avx2(__m256i v, char low, char high) {
+  __m256i above = _mm256_cmpgt_epi8(v, _mm256_set1_epi8((char)(low - 1)));
+  __m256i below = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(high + 1)), v);
+  return (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(above, below));
+}
+
+static inline AVX2 uint32_t is_space_avx2(__m256i v) {
+  return eq_avx2(v, ' ') | in_range_avx2(v, '\t', '\r');
+}
+
+static inline AVX2 uint32_t is_ident_avx2(__m256i v) {
+  __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  return in_range_avx2(lower, 'a', 'z') | in_range_avx2(v, '0', '9') |
+         eq_avx2(v, '_');
+}
+
+#define VEC_BYTES 32
+#define TARGET AVX2
+#define KERNEL(name) name##_avx2
+#define vec_t __m256i
+#define LOAD load_avx2
+#define EQ eq_avx2
+#define IS_SPACE is_space_avx2
+#define IS_IDENT is_ident_avx2
+#include "scan_simd.inc"
+#undef VEC_BYTES
+#undef TARGET
+#undef KERNEL
+#undef vec_t
+#undef LOAD
+#undef EQ
+#undef IS_SPACE
+#undef IS_IDENT
+
+const struct scan_kernels avx2_kernels = {
+  .skip_whitespace = skip_whitespace_avx2,
+  .skip_line = skip_line_avx2,
+  .skip_block_comment = skip_block_comment_avx2,
+  .skip_identifier = skip_identifier_avx2,
+  .skip_string_chars = skip_string_chars_avx2,
+  .skip_plain_chars = skip_plain_chars_avx2,
+};
+
+#endif
+
+enum scan_isa best_scan_isa(void) {
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) {
+    return SCAN_AVX2;
+  }
+
+  if (__builtin_cpu_supports("sse2")) {
+    return SCAN_SSE2;
+  }
+#endif
+
+  return SCAN_SCALAR;
+}
+
+bool set_scan_isa(enum scan_isa isa) {
+  if (isa > best_scan_isa()) {
+    return false;
+  }
+
+  switch (isa) {
+#ifdef HAVE_X86_KERNELS
+  case SCAN_AVX2:
+    kernels = &avx2_kernels;
+    break;
+  case SCAN_SSE2:
+    kernels = &sse2_kernels;
+    break;
+#endif
+  default:
+    kernels = &scalar_kernels;
+    break;
+  }
+
+  return true;
+}
+
+// Runs before any thread can scan, so they all read the same kernels.
+__attribute__((constructor)) void select_scan_kernels(void) {
+  set_scan_isa(best_scan_isa());
+}
+
+static inline const struct scan_kernels *get_kernels(void) { return kernels; }
+
+size_t skip_whitespace(const char *file, size_t index) {
+  return get_kernels()->skip_whitespace(file, index);
+}
+
+size_t skip_line(const char *file, size_t index) {
+  return get_kernels()->skip_line(file, index);
+}
+
+size_t skip_block_comment(const char *file, size_t index) {
+  return get_kernels()->skip_block_comment(file, index);
+}
+
+size_t skip_identifier(const char *file, size_t index) {
+  return get_kernels()->skip_identifier(file, index);
+}
+
+size_t skip_string_chars(const char *file, size_t index) {
+  return get_kernels()->skip_string_chars(file, index);
+}
+
+size_t skip_plain_chars(const char *file, size_t index) {
+  return get_kernels()->skip_plain_chars(file, index);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum scan_isa {
+  SCAN_SCALAR,
+  SCAN_SSE2,
+  SCAN_AVX2,
+};
+
+/**
+ * @return The widest instruction set the running CPU supports.
+ */
+enum scan_isa best_scan_isa(void);
+
+/**
+ * Selects the kernels used by the skip_*() functions, for the whole process.
+ * The best supported set is picked at startup. Not to be called while other
+ * threads are scanning.
+ *
+ * @param isa The instruction set to use.
+ * @return false if the running CPU does not support it.
+ */
+bool set_scan_isa(enum scan_isa isa);
+
+/**
+ * Skips whitespace.
+ *
+ * @return The index of the first non-whitespace byte.
+ */
+size_t skip_whitespace(const char *file, size_t index);
+
+/**
+ * Skips the rest of a line.
+ *
+ * @return The index of the next newline or NUL.
+ */
+size_t skip_line(const char *file, size_t index);
+
+/**
+ * Skips the body of a block comment.
+ *
+ * @return The index just past the closing star-slash, or of the NUL if the
+ * comment is unterminated.
+ */
+size_t skip_block_comment(const char *file, size_t index);
+
+/**
+ * Skips letters, digits and underscores.
+ *
+ * @return The index of the first byte that cannot continue an identifier.
+ */
+size_t skip_identifier(const char *file, size_t index);
+
+/**
+ * Skips plain string literal characters.
+ *
+ * @return The index of the next double quote, backslash, newline or NUL.
+ */
+size_t skip_string_chars(const char *file, size_t index);
+
+/**
+ * Skips characters that cannot start a comment, a literal or a line splice.
+ *
+ * @return The index of the next newline, slash, quote, apostrophe, backslash
+ * or NUL.
+ */
+size_t skip_plain_chars(const char *file, size_t index);
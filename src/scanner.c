@@ -1,65 +1,88 @@
 #include "scanner.h"
 #include "common.h"
+#include "float_conv.h"
 #include "log.h"
+#include "punct_dfa.h"
+#include "scan_simd.h"
+#include "xid_table.h"
 
+#include <pthread.h>
+#include <setjmp.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
+// Set while scan_parallel() lexes a chunk. Errors then jump back to leave a
+// LEX_ERROR token instead of being reported, see scan_chunk_token().
+_Thread_local jmp_buf *speculation = NULL;
+
+#define ABANDON_SPECULATION()                                                  \
+  do {                                                                         \
+    if (speculation)                                                           \
+      longjmp(*speculation, 1);                                                \
+  } while (0)
+
 #define SCANNER_ERROR(expected_list)                                           \
   do {                                                                         \
-    Coord pos = calc_coord(i);                                                 \
+    ABANDON_SPECULATION();                                                     \
+    char where[LOCATION_TEXT_SIZE];                                            \
+    format_location(pointer_location(&file[i]), where, sizeof(where));         \
     char found = file[i];                                                      \
     found = found == 0 ? '.' : found;                                          \
     found = found == '\n' ? '.' : found;                                       \
-    ERRORV("scanner",                                                          \
-           "Unexpected character '%c' at %zu:%zu, expected: [" expected_list   \
-           "]",                                                                \
-           found != 0 ? found : (char)(-1), pos.line_number, pos.column);      \
+    ERRORV("scanner", "Unexpected character '%c' at %s, expected: [%s]",       \
+           found != 0 ? found : (char)(-1), where, expected_list);             \
   } while (0)
 
-const char *keywords[] = {
-  "alignas",       "alignof",      "auto",          "bool",
-  "break",         "case",         "char",          "const",
-  "constexpr",     "continue",     "default",       "do",
-  "double",        "else",         "enum",          "extern",
-  "float",         "for",          "goto",          "if",
-  "inline",        "int",          "long",          "register",
-  "restrict",      "return",       "short",         "signed",
-  "sizeof",        "static",       "static_assert", "struct",
-  "switch",        "thread_local", "typedef",       "typeof",
-  "typeof_unqual", "union",        "unsigned",      "void",
-  "volatile",      "while",        "_Atomic",       "_BitInt",
-  "_Complex",      "_Decimal128",  "_Decimal32",    "_Decimal64",
-  "_Generic",      "_Imaginary",   "_Noreturn",
-};
-
-const char *predefined_constants[] = {
-  "false",
-  "nullptr",
-  "true",
-};
+Span token_span(const Token *token) {
+  Span result;
 
-size_t seen_newlines = 0;
-long last_newline = -1;
+  result.start = location_coord(token->location);
+  result.end = token->location == NO_LOCATION
+                 ? result.start
+                 : location_coord(token->location + token->length);
 
-void record_newline(size_t i) {
-  seen_newlines++;
-  last_newline = (long)i;
+  return result;
 }
 
-Coord calc_coord(size_t i) {
-  Coord result;
+/**
+ * @return Whether `file[index]` is a newline that is not spliced away by a
+ * backslash before it.
+ */
+bool ends_line(const char *file, size_t index) {
+  if (file[index] != '\n') {
+    return false;
+  }
 
-  result.line_number = seen_newlines + 1;
-  result.column = (size_t)((long)i - last_newline);
+  size_t i = index;
 
-  return result;
+  if (i > 0 && file[i - 1] == '\r') {
+    i--;
+  }
+
+  return i == 0 || file[i - 1] != '\\';
 }
 
+// What a byte can be in an identifier. Bytes of UTF-8 sequences and
+// backslashes may begin a character past ASCII, see scan_extended_char().
+enum ident_class {
+  IC_NONE,
+  IC_DIGIT,
+  IC_NONDIGIT,
+  IC_EXTENDED,
+};
+
+const uint8_t ident_class[256] = {
+  ['0' ... '9'] = IC_DIGIT,
+  ['A' ... 'Z'] = IC_NONDIGIT,
+  ['a' ... 'z'] = IC_NONDIGIT,
+  ['_'] = IC_NONDIGIT,
+  ['\\'] = IC_EXTENDED,
+  [0x80 ... 0xff] = IC_EXTENDED,
+};
+
 bool is_nondigit(char character) {
-  return ('A' <= character && character <= 'Z') ||
-         ('a' <= character && character <= 'z') || character == '_';
+  return ident_class[(unsigned char)character] == IC_NONDIGIT;
 }
 
 #define OCT_DIGIT_SEQ "0-7"
@@ -87,73 +110,228 @@ bool is_whitespace(char character) {
          character == '\n' || character == '\v' || character == '\f';
 }
 
-bool is_in_array(const char *value, size_t value_length, const char *array[],
-                 size_t len) {
-  for (size_t i = 0; i < len; i++) {
-    size_t constant_len = strlen(array[i]);
-
-    if (value_length != constant_len)
-      continue;
+#define MATCH(spelling, token_code)                                            \
+  do {                                                                         \
+    if (memcmp(value, spelling, sizeof(spelling) - 1) == 0)                    \
+      return token_code;                                                       \
+  } while (0)
 
-    if (strncmp(value, array[i], value_length) == 0) {
-      return true;
+/**
+ * Classifies an identifier as a keyword or predefined constant.
+ *
+ * Candidates are bucketed by length and then by first character, so no
+ * bucket holds more than five spellings and the lookup never walks the whole
+ * keyword set.
+ *
+ * @param value The first character of the identifier.
+ * @param length The length of the identifier.
+ * @return The keyword or predefined constant code, or TC_NONE.
+ */
+enum token_code classify_identifier(const char *value, size_t length) {
+  switch (length) {
+  case 2:
+    switch (value[0]) {
+    case 'd':
+      MATCH("do", KW_do);
+      break;
+    case 'i':
+      MATCH("if", KW_if);
+      break;
+    }
+    break;
+  case 3:
+    switch (value[0]) {
+    case 'f':
+      MATCH("for", KW_for);
+      break;
+    case 'i':
+      MATCH("int", KW_int);
+      break;
+    }
+    break;
+  case 4:
+    switch (value[0]) {
+    case 'a':
+      MATCH("auto", KW_auto);
+      break;
+    case 'b':
+      MATCH("bool", KW_bool);
+      break;
+    case 'c':
+      MATCH("case", KW_case);
+      MATCH("char", KW_char);
+      break;
+    case 'e':
+      MATCH("else", KW_else);
+      MATCH("enum", KW_enum);
+      break;
+    case 'g':
+      MATCH("goto", KW_goto);
+      break;
+    case 'l':
+      MATCH("long", KW_long);
+      break;
+    case 't':
+      MATCH("true", PC_true);
+      break;
+    case 'v':
+      MATCH("void", KW_void);
+      break;
+    }
+    break;
+  case 5:
+    switch (value[0]) {
+    case 'b':
+      MATCH("break", KW_break);
+      break;
+    case 'c':
+      MATCH("const", KW_const);
+      break;
+    case 'f':
+      MATCH("false", PC_false);
+      MATCH("float", KW_float);
+      break;
+    case 's':
+      MATCH("short", KW_short);
+      break;
+    case 'u':
+      MATCH("union", KW_union);
+      break;
+    case 'w':
+      MATCH("while", KW_while);
+      break;
+    }
+    break;
+  case 6:
+    switch (value[0]) {
+    case 'd':
+      MATCH("double", KW_double);
+      break;
+    case 'e':
+      MATCH("extern", KW_extern);
+      break;
+    case 'i':
+      MATCH("inline", KW_inline);
+      break;
+    case 'r':
+      MATCH("return", KW_return);
+      break;
+    case 's':
+      MATCH("signed", KW_signed);
+      MATCH("sizeof", KW_sizeof);
+      MATCH("static", KW_static);
+      MATCH("struct", KW_struct);
+      MATCH("switch", KW_switch);
+      break;
+    case 't':
+      MATCH("typeof", KW_typeof);
+      break;
+    }
+    break;
+  case 7:
+    switch (value[0]) {
+    case '_':
+      MATCH("_Atomic", KW__Atomic);
+      MATCH("_BitInt", KW__BitInt);
+      break;
+    case 'a':
+      MATCH("alignas", KW_alignas);
+      MATCH("alignof", KW_alignof);
+      break;
+    case 'd':
+      MATCH("default", KW_default);
+      break;
+    case 'n':
+      MATCH("nullptr", PC_nullptr);
+      break;
+    case 't':
+      MATCH("typedef", KW_typedef);
+      break;
     }
+    break;
+  case 8:
+    switch (value[0]) {
+    case '_':
+      MATCH("_Complex", KW__Complex);
+      MATCH("_Generic", KW__Generic);
+      break;
+    case 'c':
+      MATCH("continue", KW_continue);
+      break;
+    case 'r':
+      MATCH("register", KW_register);
+      MATCH("restrict", KW_restrict);
+      break;
+    case 'u':
+      MATCH("unsigned", KW_unsigned);
+      break;
+    case 'v':
+      MATCH("volatile", KW_volatile);
+      break;
+    }
+    break;
+  case 9:
+    switch (value[0]) {
+    case '_':
+      MATCH("_Noreturn", KW__Noreturn);
+      break;
+    case 'c':
+      MATCH("constexpr", KW_constexpr);
+      break;
+    }
+    break;
+  case 10:
+    switch (value[0]) {
+    case '_':
+      MATCH("_Decimal32", KW__Decimal32);
+      MATCH("_Decimal64", KW__Decimal64);
+      MATCH("_Imaginary", KW__Imaginary);
+      break;
+    }
+    break;
+  case 11:
+    switch (value[0]) {
+    case '_':
+      MATCH("_Decimal128", KW__Decimal128);
+      break;
+    }
+    break;
+  case 12:
+    switch (value[0]) {
+    case 't':
+      MATCH("thread_local", KW_thread_local);
+      break;
+    }
+    break;
+  case 13:
+    switch (value[0]) {
+    case 's':
+      MATCH("static_assert", KW_static_assert);
+      break;
+    case 't':
+      MATCH("typeof_unqual", KW_typeof_unqual);
+      break;
+    }
+    break;
   }
 
-  return false;
+  return TC_NONE;
 }
 
-size_t scan_whitespace(const char *file, size_t index) {
-  size_t i = index;
+#undef MATCH
 
-  while (file[i] != '\0' && is_whitespace(file[i])) {
-    if (file[i] == '\n') {
-      record_newline(i);
-    }
+// The runs below are skipped by the vector kernels in scan_simd.c.
 
-    i++;
-  }
-
-  return i;
+size_t scan_whitespace(const char *file, size_t index) {
+  return skip_whitespace(file, index);
 }
 
 size_t scan_reg_comment(const char *file, size_t index) {
-  size_t i = index;
-
-  while (file[i] != '\0' && file[i] != '\n') {
-    i++;
-  }
-
-  return i;
+  return skip_line(file, index);
 }
 
 size_t scan_inline_comment(const char *file, size_t index) {
-  size_t i = index;
-
-  while (file[i] != '\0') {
-    if (file[i] == '*') {
-      i++;
-
-      if (file[i] == '/') {
-        i++;
-        break;
-      }
-    } else {
-      i++;
-    }
-  }
-
-  return i;
-}
-
-size_t scan_identifier(const char *file, size_t index) {
-  size_t i = index;
-
-  while (is_nondigit(file[i]) || is_digit(file[i])) {
-    i++;
-  }
-
-  return i;
+  return skip_block_comment(file, index);
 }
 
 size_t scan_hex_quad(const char *file, size_t index) {
@@ -203,31 +381,308 @@ size_t scan_sign(const char *file, size_t index) {
   return index;
 }
 
-size_t scan_floating_suffix(const char *file, size_t index) {
-  static const char *suffixes[] = {
-    "f", "l", "F", "L", "df", "dd", "dl", "DF", "DD", "DL",
+// Value of an integer constant, accumulated while its digits are scanned.
+struct integer {
+  uint64_t value;
+  bool overflow;
+};
+
+unsigned digit_value(char digit) {
+  if (is_digit(digit)) {
+    return (unsigned)(digit - '0');
+  }
+
+  return (unsigned)((digit | 0x20) - 'a' + 10);
+}
+
+void push_digit(struct integer *integer, unsigned base, char digit) {
+  integer->overflow |=
+    __builtin_mul_overflow(integer->value, base, &integer->value);
+  integer->overflow |=
+    __builtin_add_overflow(integer->value, digit_value(digit), &integer->value);
+}
+
+// Identifiers
+
+/**
+ * Decodes the UTF-8 character at `file[index]`.
+ *
+ * @return Its length in bytes, 0 if the bytes are not well-formed UTF-8.
+ */
+size_t decode_utf8(const char *file, size_t index, uint32_t *code_point) {
+  const unsigned char *bytes = (const unsigned char *)&file[index];
+  size_t length;
+  uint32_t value;
+  uint32_t smallest;
+
+  if (bytes[0] < 0x80) {
+    *code_point = bytes[0];
+    return 1;
+  } else if ((bytes[0] & 0xe0) == 0xc0) {
+    length = 2;
+    value = bytes[0] & 0x1f;
+    smallest = 0x80;
+  } else if ((bytes[0] & 0xf0) == 0xe0) {
+    length = 3;
+    value = bytes[0] & 0x0f;
+    smallest = 0x800;
+  } else if ((bytes[0] & 0xf8) == 0xf0) {
+    length = 4;
+    value = bytes[0] & 0x07;
+    smallest = 0x10000;
+  } else {
+    return 0;
+  }
+
+  // A NUL is no continuation byte, so this never reads past the end.
+  for (size_t k = 1; k < length; k++) {
+    if ((bytes[k] & 0xc0) != 0x80) {
+      return 0;
+    }
+
+    value = value << 6 | (bytes[k] & 0x3f);
+  }
+
+  // Overlong forms, surrogates and values past Unicode are ill-formed.
+  if (value < smallest || value > 0x10ffff ||
+      (0xd800 <= value && value <= 0xdfff)) {
+    return 0;
+  }
+
+  *code_point = value;
+  return length;
+}
+
+/**
+ * @param index The index of the backslash of a universal character name.
+ * @param end The index past its digits.
+ * @return The code point it names.
+ */
+uint32_t universal_character_value(const char *file, size_t index,
+                                   size_t end) {
+  uint32_t code_point = 0;
+
+  for (size_t i = index + 2; i < end; i++) {
+    code_point = code_point << 4 | digit_value(file[i]);
+  }
+
+  return code_point;
+}
+
+/**
+ * Writes a code point in UTF-8.
+ *
+ * @return The number of bytes written, at most 4.
+ */
+size_t encode_utf8(uint32_t code_point, char *out) {
+  if (code_point < 0x80) {
+    out[0] = (char)code_point;
+    return 1;
+  } else if (code_point < 0x800) {
+    out[0] = (char)(0xc0 | code_point >> 6);
+    out[1] = (char)(0x80 | (code_point & 0x3f));
+    return 2;
+  } else if (code_point < 0x10000) {
+    out[0] = (char)(0xe0 | code_point >> 12);
+    out[1] = (char)(0x80 | (code_point >> 6 & 0x3f));
+    out[2] = (char)(0x80 | (code_point & 0x3f));
+    return 3;
+  }
+
+  out[0] = (char)(0xf0 | code_point >> 18);
+  out[1] = (char)(0x80 | (code_point >> 12 & 0x3f));
+  out[2] = (char)(0x80 | (code_point >> 6 & 0x3f));
+  out[3] = (char)(0x80 | (code_point & 0x3f));
+  return 4;
+}
+
+bool in_ranges(const uint32_t ranges[][2], size_t count, uint32_t code_point) {
+  size_t low = 0;
+  size_t high = count;
+
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+
+    if (code_point < ranges[middle][0]) {
+      high = middle;
+    } else if (code_point > ranges[middle][1]) {
+      low = middle + 1;
+    } else {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool is_xid_start(uint32_t code_point) {
+  return in_ranges(xid_start_ranges, NELEMS(xid_start_ranges), code_point);
+}
+
+bool is_xid_continue(uint32_t code_point) {
+  return in_ranges(xid_continue_ranges, NELEMS(xid_continue_ranges),
+                   code_point);
+}
+
+/**
+ * Scans a UTF-8 character or universal character name of an identifier,
+ * ISO/IEC 9899:2023 § 6.4.2.1.
+ *
+ * @param accepts is_xid_start() or is_xid_continue().
+ * @param flags Gets TF_UCN if a universal character name is accepted.
+ * @return The index past it, or `index` if it cannot be part of the
+ * identifier there.
+ */
+size_t scan_extended_char(const char *file, size_t index,
+                          bool (*accepts)(uint32_t), uint8_t *flags) {
+  size_t i = index;
+  uint32_t code_point = 0;
+
+  if (file[i] == '\\') {
+    if (file[i + 1] != 'u' && file[i + 1] != 'U') {
+      return index;
+    }
+
+    i = scan_universal_character(file, i);
+    code_point = universal_character_value(file, index, i);
+
+    // Names of basic characters are not allowed, whatever they spell.
+    if (code_point < 0xa0) {
+      return index;
+    }
+  } else {
+    i += decode_utf8(file, i, &code_point);
+
+    if (i == index) {
+      ABANDON_SPECULATION();
+      char where[LOCATION_TEXT_SIZE];
+      format_location(pointer_location(&file[i]), where, sizeof(where));
+      ERRORV("scanner", "Malformed UTF-8 at %s", where);
+    }
+  }
+
+  if (!accepts(code_point)) {
+    return index;
+  }
+
+  if (file[index] == '\\') {
+    *flags |= TF_UCN;
+  }
+
+  return i;
+}
+
+/**
+ * Scans the rest of an identifier.
+ *
+ * @param flags Gets TF_UCN if a universal character name is part of it.
+ * @return The index past the identifier.
+ */
+size_t scan_identifier(const char *file, size_t index, uint8_t *flags) {
+  size_t i = skip_identifier(file, index);
+
+  // Only bytes past ASCII and backslashes stop the kernels early, plain
+  // identifiers take a single look up here.
+  while (ident_class[(unsigned char)file[i]] == IC_EXTENDED) {
+    size_t next = scan_extended_char(file, i, is_xid_continue, flags);
+
+    if (next == i) {
+      break;
+    }
+
+    i = skip_identifier(file, next);
+  }
+
+  return i;
+}
+
+/**
+ * Scans an identifier that starts past ASCII or with a backslash.
+ *
+ * @return The index past the identifier, `index` when the character cannot
+ * start one.
+ */
+size_t scan_extended_identifier(const char *file, size_t index,
+                                uint8_t *flags) {
+  size_t i = scan_extended_char(file, index, is_xid_start, flags);
+
+  if (i == index) {
+    // A universal character name is never a token of its own.
+    if (file[i] != '\\' || (file[i + 1] != 'u' && file[i + 1] != 'U')) {
+      return index;
+    }
+
+    ABANDON_SPECULATION();
+    char where[LOCATION_TEXT_SIZE];
+    format_location(pointer_location(&file[i]), where, sizeof(where));
+    ERRORV("scanner", "Unexpected character at %s", where);
+  }
+
+  return scan_identifier(file, i, flags);
+}
+
+/**
+ * Scans the suffix of a floating constant and converts its value. Decimal
+ * floating suffixes are recognized only to be reported, there is no decimal
+ * floating type to convert to.
+ *
+ * @param start The index of the first character of the constant.
+ * @param index The index just past its exponent.
+ * @return The index just past the suffix.
+ */
+size_t scan_floating_suffix(const char *file, size_t start, size_t index,
+                            Constant *constant) {
+  static const struct {
+    const char *spelling;
+    enum constant_type type;
+  } suffixes[] = {
+    {"f", CT_FLOAT},       {"l", CT_LONG_DOUBLE}, {"F", CT_FLOAT},
+    {"L", CT_LONG_DOUBLE}, {"df", CT_DECIMAL32},  {"dd", CT_DECIMAL64},
+    {"dl", CT_DECIMAL128}, {"DF", CT_DECIMAL32},  {"DD", CT_DECIMAL64},
+    {"DL", CT_DECIMAL128},
   };
 
+  size_t end = index;
+  constant->type = CT_DOUBLE;
+
   for (size_t i = 0; i < NELEMS(suffixes); i++) {
-    size_t length = strlen(suffixes[i]);
-    if (memcmp(&file[index], suffixes[i], length) == 0) {
-      return index + length;
+    size_t length = strlen(suffixes[i].spelling);
+    if (strncmp(&file[index], suffixes[i].spelling, length) == 0) {
+      constant->type = suffixes[i].type;
+      end = index + length;
+      break;
     }
   }
 
-  return index;
+  if (constant->type >= CT_DECIMAL32) {
+    ABANDON_SPECULATION();
+    char where[LOCATION_TEXT_SIZE];
+    format_location(pointer_location(&file[start]), where, sizeof(where));
+    ERRORV("scanner",
+           "Decimal floating constant at %s, decimal floating types are not "
+           "supported",
+           where);
+  }
+
+  convert_float(&file[start], index - start, constant);
+  return end;
 }
 
-size_t scan_digit_seq(const char *file, size_t index) {
+/**
+ * @param integer Accumulates the value of the digits, may be NULL.
+ */
+size_t scan_digit_seq(const char *file, size_t index, struct integer *integer) {
   size_t i = index;
 
-  if (is_digit(file[i])) {
-    i++;
-  } else {
+  if (!is_digit(file[i])) {
     SCANNER_ERROR(DEC_DIGIT_SEQ);
   }
 
   while (is_digit(file[i]) || file[i] == '\'') {
+    if (integer && file[i] != '\'') {
+      push_digit(integer, 10, file[i]);
+    }
+
     i++;
   }
 
@@ -241,16 +696,22 @@ size_t scan_digit_seq(const char *file, size_t index) {
   return i;
 }
 
-size_t scan_hex_digit_seq(const char *file, size_t index) {
+/**
+ * @param integer Accumulates the value of the digits, may be NULL.
+ */
+size_t scan_hex_digit_seq(const char *file, size_t index,
+                          struct integer *integer) {
   size_t i = index;
 
-  if (is_hex_digit(file[i])) {
-    i++;
-  } else {
+  if (!is_hex_digit(file[i])) {
     SCANNER_ERROR(HEX_DIGIT_SEQ);
   }
 
   while (is_hex_digit(file[i]) || file[i] == '\'') {
+    if (integer && file[i] != '\'') {
+      push_digit(integer, 16, file[i]);
+    }
+
     i++;
   }
 
@@ -269,11 +730,13 @@ size_t scan_binary_exp(const char *file, size_t index) {
 
   if (file[i] == 'p' || file[i] == 'P') {
     i++;
+  } else {
+    SCANNER_ERROR("p, P");
   }
 
   i = scan_sign(file, i);
 
-  return scan_digit_seq(file, i);
+  return scan_digit_seq(file, i, NULL);
 }
 
 size_t scan_exp(const char *file, size_t index) {
@@ -287,7 +750,7 @@ size_t scan_exp(const char *file, size_t index) {
 
   i = scan_sign(file, i);
 
-  return scan_digit_seq(file, i);
+  return scan_digit_seq(file, i, NULL);
 }
 
 size_t scan_fractional_const(const char *file, size_t index) {
@@ -299,7 +762,7 @@ size_t scan_fractional_const(const char *file, size_t index) {
     SCANNER_ERROR(".");
   }
 
-  return scan_digit_seq(file, i);
+  return scan_digit_seq(file, i, NULL);
 }
 
 size_t scan_period(const char *file, size_t index) {
@@ -327,7 +790,7 @@ size_t scan_hex_fractional_const(const char *file, size_t index) {
     SCANNER_ERROR(".");
   }
 
-  return scan_hex_digit_seq(file, i);
+  return scan_hex_digit_seq(file, i, NULL);
 }
 
 size_t scan_hex_fractional_const_opt(const char *file, size_t index) {
@@ -340,17 +803,74 @@ size_t scan_hex_fractional_const_opt(const char *file, size_t index) {
   }
 
   if (is_hex_digit(file[i])) {
-    return scan_fractional_const(file, index);
+    return scan_hex_fractional_const(file, index);
   }
 
   return i;
 }
 
-size_t scan_int_prefix_rest(const char *file, size_t index) {
+/**
+ * Scans the rest of a decimal floating constant.
+ *
+ * @param start The index of the first character of the constant.
+ * @param index The index just past its integer digits, if any.
+ */
+size_t scan_decimal_float(const char *file, size_t start, size_t index,
+                          Constant *constant) {
+  size_t i = index;
+
+  if (file[i] == '.') {
+    i = scan_period(file, i);
+  }
+
+  if (file[i] == 'e' || file[i] == 'E') {
+    i = scan_exp(file, i);
+  }
+
+  return scan_floating_suffix(file, start, i, constant);
+}
+
+/**
+ * Scans the rest of a hexadecimal floating constant.
+ *
+ * @param start The index of the first character of the constant.
+ * @param index The index just past its integer digits, if any.
+ */
+size_t scan_hex_float(const char *file, size_t start, size_t index,
+                      Constant *constant) {
+  size_t i = index;
+
+  // Without integer digits the fraction needs at least one.
+  if (file[i] == '.' && i == start + 2) {
+    i = scan_hex_fractional_const(file, i);
+  } else if (file[i] == '.') {
+    i = scan_hex_fractional_const_opt(file, i);
+  }
+
+  i = scan_binary_exp(file, i);
+
+  return scan_floating_suffix(file, start, i, constant);
+}
+
+enum int_size {
+  INT_PLAIN,
+  INT_LONG,
+  INT_LONG_LONG,
+  INT_BITINT,
+};
+
+struct int_suffix {
+  bool is_unsigned;
+  enum int_size size;
+};
+
+size_t scan_int_prefix_rest(const char *file, size_t index,
+                            struct int_suffix *suffix) {
   size_t i = index;
 
   if (file[i] == 'w') {
     i++;
+    suffix->size = INT_BITINT;
 
     if (file[i] == 'b') {
       i++;
@@ -359,6 +879,7 @@ size_t scan_int_prefix_rest(const char *file, size_t index) {
     }
   } else if (file[i] == 'W') {
     i++;
+    suffix->size = INT_BITINT;
 
     if (file[i] == 'B') {
       i++;
@@ -367,17 +888,21 @@ size_t scan_int_prefix_rest(const char *file, size_t index) {
     }
   } else if (file[i] == 'l') {
     i++;
+    suffix->size = INT_LONG;
 
     if (file[i] == 'l') {
       i++;
+      suffix->size = INT_LONG_LONG;
     } else if (file[i] == 'L') {
       SCANNER_ERROR("l");
     }
   } else if (file[i] == 'L') {
     i++;
+    suffix->size = INT_LONG;
 
     if (file[i] == 'L') {
       i++;
+      suffix->size = INT_LONG_LONG;
     } else if (file[i] == 'l') {
       SCANNER_ERROR("L");
     }
@@ -386,39 +911,129 @@ size_t scan_int_prefix_rest(const char *file, size_t index) {
   return i;
 }
 
-size_t scan_int_prefix_ufirst(const char *file, size_t index) {
+size_t scan_int_prefix_ufirst(const char *file, size_t index,
+                              struct int_suffix *suffix) {
   size_t i = index;
 
   if (file[index] == 'u' || file[index] == 'U') {
     i++;
+    suffix->is_unsigned = true;
   }
 
-  return scan_int_prefix_rest(file, i);
+  return scan_int_prefix_rest(file, i, suffix);
 }
 
-size_t scan_int_prefix_ulast(const char *file, size_t index) {
-  size_t i = scan_int_prefix_rest(file, index);
+size_t scan_int_prefix_ulast(const char *file, size_t index,
+                             struct int_suffix *suffix) {
+  size_t i = scan_int_prefix_rest(file, index, suffix);
 
   if (file[i] == 'u' || file[i] == 'U') {
     i++;
+    suffix->is_unsigned = true;
   }
 
   return i;
 }
 
-size_t scan_int_prefix_opt(const char *file, size_t index) {
+size_t scan_int_prefix_opt(const char *file, size_t index,
+                           struct int_suffix *suffix) {
   if (file[index] == 'u' || file[index] == 'U') {
-    return scan_int_prefix_ufirst(file, index);
+    return scan_int_prefix_ufirst(file, index, suffix);
   } else if (file[index] == 'w' || file[index] == 'W' || file[index] == 'l' ||
              file[index] == 'L') {
-    return scan_int_prefix_ulast(file, index);
+    return scan_int_prefix_ulast(file, index, suffix);
   }
 
   return index;
 }
 
-size_t scan_binary_number(const char *file, size_t index) {
+/**
+ * Picks the first type of the suffix's list that can represent the value
+ * (ISO/IEC 9899:2023 § 6.4.4.1). Unsigned types are only listed for octal,
+ * hexadecimal and binary constants, or when the suffix asks for one.
+ *
+ * @return The type, or CT_NONE if no type fits.
+ */
+enum constant_type integer_type(uint64_t value, bool decimal,
+                                struct int_suffix suffix) {
+  bool fits_int = value <= INT32_MAX;
+  bool fits_unsigned = value <= UINT32_MAX;
+  bool fits_long = value <= INT64_MAX;
+
+  if (suffix.is_unsigned) {
+    switch (suffix.size) {
+    case INT_PLAIN:
+      return fits_unsigned ? CT_UNSIGNED : CT_UNSIGNED_LONG;
+    case INT_LONG:
+      return CT_UNSIGNED_LONG;
+    case INT_LONG_LONG:
+      return CT_UNSIGNED_LONG_LONG;
+    case INT_BITINT:
+      return CT_UNSIGNED_BITINT;
+    }
+  }
+
+  switch (suffix.size) {
+  case INT_PLAIN:
+    if (fits_int) {
+      return CT_INT;
+    } else if (!decimal && fits_unsigned) {
+      return CT_UNSIGNED;
+    }
+
+    // fallthrough
+  case INT_LONG:
+    if (fits_long) {
+      return CT_LONG;
+    }
+
+    return decimal ? CT_NONE : CT_UNSIGNED_LONG;
+  case INT_LONG_LONG:
+    if (fits_long) {
+      return CT_LONG_LONG;
+    }
+
+    return decimal ? CT_NONE : CT_UNSIGNED_LONG_LONG;
+  case INT_BITINT:
+    return CT_BITINT;
+  }
+
+  return CT_NONE;
+}
+
+/**
+ * Scans the suffix of an integer constant and stores its value and type.
+ *
+ * @param start The index of the first character of the constant.
+ * @param index The index just past its digits.
+ * @return The index just past the suffix.
+ */
+size_t scan_integer_suffix(const char *file, size_t start, size_t index,
+                           const struct integer *integer, bool decimal,
+                           Constant *constant) {
+  struct int_suffix suffix = {false, INT_PLAIN};
+  size_t i = scan_int_prefix_opt(file, index, &suffix);
+
+  constant->bits = integer->value;
+  constant->type = integer->overflow
+                     ? CT_NONE
+                     : integer_type(integer->value, decimal, suffix);
+
+  // Values past 64 bits would need a wider _BitInt than we carry.
+  if (constant->type == CT_NONE) {
+    ABANDON_SPECULATION();
+    char where[LOCATION_TEXT_SIZE];
+    format_location(pointer_location(&file[start]), where, sizeof(where));
+    ERRORV("scanner", "Integer constant at %s is too large", where);
+  }
+
+  return i;
+}
+
+size_t scan_binary_number(const char *file, size_t index,
+                          Constant *constant) {
   size_t i = index;
+  struct integer integer = {0, false};
 
   if (file[i] == '0') {
     i++;
@@ -432,14 +1047,14 @@ size_t scan_binary_number(const char *file, size_t index) {
     SCANNER_ERROR("b, B");
   }
 
-  if (file[i] == '0' || file[i] == '1') {
-    i++;
-  } else {
+  if (file[i] != '0' && file[i] != '1') {
     SCANNER_ERROR("0, 1");
   }
 
   while (is_hex_digit(file[i]) || file[i] == '\'') {
-    if (file[i] != '0' && file[i] != '1' && file[i] != '\'') {
+    if (file[i] == '0' || file[i] == '1') {
+      push_digit(&integer, 2, file[i]);
+    } else if (file[i] != '\'') {
       SCANNER_ERROR("0, 1");
     }
 
@@ -453,11 +1068,12 @@ size_t scan_binary_number(const char *file, size_t index) {
     SCANNER_ERROR("0, 1");
   }
 
-  return scan_int_prefix_opt(file, i);
+  return scan_integer_suffix(file, index, i, &integer, false, constant);
 }
 
-size_t scan_octal_number(const char *file, size_t index) {
+size_t scan_octal_number(const char *file, size_t index, Constant *constant) {
   size_t i = index;
+  struct integer integer = {0, false};
 
   if (file[i] == '0') {
     i++;
@@ -465,22 +1081,26 @@ size_t scan_octal_number(const char *file, size_t index) {
     SCANNER_ERROR("0");
   }
 
-  if (file[i] == '.') {
-    i = scan_period(file, i);
+  // Decimal floating constants may start with 0, and use 8 and 9.
+  size_t bad_digit = 0;
 
-    if (file[i] == 'e' || file[i] == 'E') {
-      i = scan_exp(file, i);
+  while (is_digit(file[i]) || file[i] == '\'') {
+    if (is_octal_digit(file[i])) {
+      push_digit(&integer, 8, file[i]);
+    } else if (file[i] != '\'' && bad_digit == 0) {
+      bad_digit = i;
     }
 
-    return scan_floating_suffix(file, i);
+    i++;
   }
 
-  while (is_hex_digit(file[i]) || file[i] == '\'') {
-    if (!is_octal_digit(file[i]) && file[i] != '\'') {
-      SCANNER_ERROR(OCT_DIGIT_SEQ);
-    }
-
-    i++;
+  if (file[i] == '.' || file[i] == 'e' || file[i] == 'E') {
+    return scan_decimal_float(file, index, i, constant);
+  } else if (bad_digit != 0) {
+    i = bad_digit;
+    SCANNER_ERROR(OCT_DIGIT_SEQ);
+  } else if (is_hex_digit(file[i])) {
+    SCANNER_ERROR(OCT_DIGIT_SEQ);
   }
 
   i--;
@@ -490,33 +1110,30 @@ size_t scan_octal_number(const char *file, size_t index) {
     SCANNER_ERROR(OCT_DIGIT_SEQ);
   }
 
-  return scan_int_prefix_opt(file, i);
+  return scan_integer_suffix(file, index, i, &integer, false, constant);
 }
 
-size_t scan_decimal_number(const char *file, size_t index) {
+size_t scan_decimal_number(const char *file, size_t index,
+                           Constant *constant) {
   size_t i = index;
+  struct integer integer = {0, false};
 
   if (is_nonzero_digit(file[i])) {
-    i = scan_digit_seq(file, i);
-
-    if (file[i] == '.') {
-      i = scan_period(file, i);
-
-      if (file[i] == 'e' || file[i] == 'E') {
-        i = scan_exp(file, i);
-      }
+    i = scan_digit_seq(file, i, &integer);
 
-      i = scan_floating_suffix(file, i);
+    if (file[i] == '.' || file[i] == 'e' || file[i] == 'E') {
+      return scan_decimal_float(file, index, i, constant);
     }
   } else {
     SCANNER_ERROR(NON_ZERO_SEQ);
   }
 
-  return scan_int_prefix_opt(file, i);
+  return scan_integer_suffix(file, index, i, &integer, true, constant);
 }
 
-size_t scan_hex_number(const char *file, size_t index) {
+size_t scan_hex_number(const char *file, size_t index, Constant *constant) {
   size_t i = index;
+  struct integer integer = {0, false};
 
   if (file[i] == '0') {
     i++;
@@ -531,37 +1148,39 @@ size_t scan_hex_number(const char *file, size_t index) {
   }
 
   if (is_hex_digit(file[i])) {
-    i = scan_hex_digit_seq(file, i);
+    i = scan_hex_digit_seq(file, i, &integer);
 
-    if (file[i] == '.') {
-      i = scan_hex_fractional_const_opt(file, i);
-      i = scan_binary_exp(file, i);
-      i = scan_floating_suffix(file, i);
+    if (file[i] == '.' || file[i] == 'p' || file[i] == 'P') {
+      return scan_hex_float(file, index, i, constant);
     }
   } else if (file[i] == '.') {
-    i = scan_hex_fractional_const(file, i);
-    i = scan_binary_exp(file, i);
-    i = scan_floating_suffix(file, i);
+    return scan_hex_float(file, index, i, constant);
   } else {
     SCANNER_ERROR(HEX_DIGIT_SEQ);
   }
 
-  return scan_int_prefix_opt(file, i);
+  return scan_integer_suffix(file, index, i, &integer, false, constant);
 }
 
-size_t scan_number(const char *file, size_t index) {
+/**
+ * Scans an integer or floating constant.
+ *
+ * @param constant Set to the type of the constant, and the value of integers.
+ * @return The index just past the constant.
+ */
+size_t scan_number(const char *file, size_t index, Constant *constant) {
   size_t i = index;
 
   if (file[i] == '0') {
     if (file[i + 1] == 'x' || file[i + 1] == 'X') {
-      return scan_hex_number(file, i);
+      return scan_hex_number(file, i, constant);
     } else if (file[i + 1] == 'b' || file[i + 1] == 'B') {
-      return scan_binary_number(file, i);
+      return scan_binary_number(file, i, constant);
     }
 
-    return scan_octal_number(file, i);
+    return scan_octal_number(file, i, constant);
   } else if (is_digit(file[i])) {
-    return scan_decimal_number(file, i);
+    return scan_decimal_number(file, i, constant);
   } else {
     SCANNER_ERROR(DEC_DIGIT_SEQ);
   }
@@ -686,12 +1305,12 @@ size_t scan_s_char_seq(const char *file, size_t index) {
     SCANNER_ERROR("\"");
   }
 
-  while (file[i] != '\"') {
-    if (file[i] == '\n') {
-      SCANNER_ERROR("\"");
-    }
+  // Runs of plain characters are skipped in bulk, only escapes need a look.
+  i = skip_string_chars(file, i);
 
+  while (file[i] == '\\') {
     i = scan_char(file, i);
+    i = skip_string_chars(file, i);
   }
 
   if (file[i] == '"') {
@@ -703,80 +1322,120 @@ size_t scan_s_char_seq(const char *file, size_t index) {
   return i;
 }
 
-Token *alloc_new_token(const char *value, kind_t kind, size_t start, size_t end,
-                       Coord start_coord) {
-  size_t value_length = end - start;
-  Token *new_token = calloc(1, sizeof(Token));
+/**
+ * Matches the longest punctuator at `index` by walking the table generated
+ * from meta/gen_punct_dfa.c.
+ *
+ * @param code Set to the token code of the punctuator.
+ * @return The index just past the punctuator.
+ */
+size_t scan_punctuator(const char *file, size_t index, enum token_code *code) {
+  size_t i = index;
+  uint8_t state = PUNCT_START;
 
-  if (!new_token) {
-    return NULL;
-  }
+  for (;;) {
+    uint8_t next = punct_next[state][punct_class[(unsigned char)file[i]]];
 
-  new_token->kind = kind;
-  new_token->length = value_length;
-  new_token->next = NULL;
+    if (next == PUNCT_DEAD) {
+      break;
+    }
 
-  new_token->span.start = start_coord;
-  new_token->span.end = calc_coord(end);
+    state = next;
+    i++;
+  }
 
-  if (!value) {
-    new_token->data = NULL;
-    return new_token;
+  // Only `..` and `%:%` stop short of a punctuator.
+  if (punct_accept[state] == TC_NONE) {
+    SCANNER_ERROR(punct_expected[state]);
   }
 
-  char *data = malloc(value_length + 1);
+  *code = punct_accept[state];
+  return i;
+}
 
-  if (!data) {
-    free(new_token);
-    return NULL;
-  }
+#define INITIAL_TOKEN_CAPACITY 256
 
-  new_token->data = strncpy(data, value, value_length);
-  data[value_length] = '\0';
+struct token_buffer {
+  Token *tokens;
+  size_t count;
+  size_t capacity;
+};
 
-  return new_token;
-}
+Token *push_token(struct token_buffer *buffer) {
+  if (buffer->count == buffer->capacity) {
+    size_t capacity =
+      buffer->capacity ? buffer->capacity * 2 : INITIAL_TOKEN_CAPACITY;
+    Token *tokens = realloc(buffer->tokens, capacity * sizeof(Token));
 
-void append_linked_list(Token *new, Token **head, Token **tail) {
-  if (*tail) {
-    (*tail)->next = new;
-  } else {
-    *head = new;
+    if (!tokens) {
+      return NULL;
+    }
+
+    buffer->tokens = tokens;
+    buffer->capacity = capacity;
   }
 
-  *tail = new;
+  return &buffer->tokens[buffer->count++];
 }
 
-Token *scan(const char *file) {
-  Token *result = NULL;
-  Token *last = NULL;
-  size_t i;
+void fill_token(Token *token, const char *file, SourceLocation base,
+                kind_t kind, enum token_code code, size_t start, size_t end) {
+  token->kind = kind;
+  token->code = (uint8_t)code;
+  token->flags = 0;
+  token->location = base + (SourceLocation)start;
+  token->length = (uint32_t)(end - start);
+  token->interned = NO_INTERN;
+  token->data = &file[start];
+  token->constant = (Constant){0, CT_NONE, 0};
+}
+
+void scan_token(const char *file, SourceLocation base, size_t *index,
+                Token *token) {
+  size_t i = *index;
+  uint8_t flags = 0;
 
-  // reset global state
-  seen_newlines = 0;
-  last_newline = -1;
+  // Scanning may resume just after a newline, see scan_parallel().
+  if (i == 0) {
+    flags = TF_LINE_START;
+  } else if (ends_line(file, i - 1)) {
+    flags = TF_LINE_START | TF_LEADING_SPACE;
+  }
 
-  for (i = 0; file[i] != '\0';) {
+  while (file[i] != '\0') {
     kind_t kind = PUNCT;
+    enum token_code code = TC_NONE;
+    Constant constant = {0, CT_NONE, 0};
     size_t start = i;
-    Coord start_coord = calc_coord(i);
+
+    // Where a token that fails to lex starts, see scan_chunk_token().
+    token->location = base + (SourceLocation)start;
+    token->flags = flags;
 
     if (is_whitespace(file[i])) {
       i = scan_whitespace(file, i);
-      continue;
-    } else if (file[i] == '/') {
-      i++;
+      flags |= TF_LEADING_SPACE;
 
-      if (file[i] == '/') {
-        i = scan_reg_comment(file, i);
-        continue;
-      } else if (file[i] == '*') {
-        i++;
-        i = scan_inline_comment(file, i);
-        continue;
-      } else if (file[i] == '=') {
-        i++;
+      if (memchr(&file[start], '\n', i - start)) {
+        flags |= TF_LINE_START;
       }
+
+      continue;
+    } else if (file[i] == '/' && file[i + 1] == '/') {
+      i = scan_reg_comment(file, i + 2);
+      flags |= TF_LEADING_SPACE;
+      continue;
+    } else if (file[i] == '/' && file[i + 1] == '*') {
+      // Comments stand for one space, even when they span lines.
+      i = scan_inline_comment(file, i + 2);
+      flags |= TF_LEADING_SPACE;
+      continue;
+    } else if (file[i] == '\\' &&
+               (file[i + 1] == '\n' ||
+                (file[i + 1] == '\r' && file[i + 2] == '\n'))) {
+      // Line splice, the next line continues this one.
+      i += 2 + (file[i + 1] == '\r');
+      continue;
     } else if (file[i] == 'u') {
       kind = IDENTIFIER;
       i++;
@@ -798,7 +1457,7 @@ Token *scan(const char *file) {
         kind = STRING;
         i = scan_s_char_seq(file, i);
       } else {
-        i = scan_identifier(file, i);
+        i = scan_identifier(file, i, &flags);
       }
     } else if (file[i] == 'U' || file[i] == 'L') {
       kind = IDENTIFIER;
@@ -811,194 +1470,450 @@ Token *scan(const char *file) {
         kind = STRING;
         i = scan_s_char_seq(file, i);
       } else {
-        i = scan_identifier(file, i);
+        i = scan_identifier(file, i, &flags);
       }
     } else if (is_nondigit(file[i])) {
       kind = IDENTIFIER;
-      i = scan_identifier(file, i);
+      i = scan_identifier(file, i, &flags);
     } else if (is_digit(file[i])) {
       kind = CONSTANT;
-      i = scan_number(file, i);
-    } else if (file[i] == '.') {
-      i++;
-
-      if (is_digit(file[i])) {
-        kind = CONSTANT;
-        i = scan_fractional_const(file, i - 1);
-        i = scan_floating_suffix(file, i);
-      } else if (file[i] == '.') {
-        i++;
-
-        if (file[i] == '.') {
-          i++;
-        } else {
-          SCANNER_ERROR(".");
-        }
-      }
+      i = scan_number(file, i, &constant);
+    } else if (file[i] == '.' && is_digit(file[i + 1])) {
+      kind = CONSTANT;
+      i = scan_decimal_float(file, i, i, &constant);
     } else if (file[i] == '\'') {
       kind = CONSTANT;
       i = scan_c_char_seq(file, i);
     } else if (file[i] == '\"') {
       kind = STRING;
       i = scan_s_char_seq(file, i);
-    } else if (file[i] == '[' || file[i] == ']' || file[i] == '(' ||
-               file[i] == ')' || file[i] == '{' || file[i] == '}' ||
-               file[i] == '~' || file[i] == '?' || file[i] == ';' ||
-               file[i] == ',') {
-      i++;
-    } else if (file[i] == '-') {
-      i++;
+    } else if (punct_class[(unsigned char)file[i]] != 0) {
+      i = scan_punctuator(file, i, &code);
+    } else if (ident_class[(unsigned char)file[i]] == IC_EXTENDED &&
+               (i = scan_extended_identifier(file, i, &flags)) != start) {
+      kind = IDENTIFIER;
+    } else {
+      // Any other character is a preprocessing token of its own (ISO/IEC
+      // 9899:2023 § 6.4), an error only once it gets to the parser.
+      uint32_t code_point;
 
-      if (file[i] == '>' || file[i] == '-' || file[i] == '=') {
-        i++;
-      }
-    } else if (file[i] == '+') {
-      i++;
+      kind = OTHER;
+      i += decode_utf8(file, i, &code_point);
+    }
 
-      if (file[i] == '+' || file[i] == '=') {
-        i++;
-      }
-    } else if (file[i] == '<') {
-      i++;
+    const char *value_begin = &file[start];
+    size_t value_length = i - start;
 
-      if (file[i] == '<') {
-        i++;
+    if (kind == IDENTIFIER) {
+      code = classify_identifier(value_begin, value_length);
 
-        if (file[i] == '=') {
-          i++;
-        }
-      } else if (file[i] == '=' || file[i] == ':' || file[i] == '%') {
-        i++;
+      if (IS_KEYWORD_CODE(code)) {
+        kind = KEYWORD;
+      } else if (IS_PREDEFINED_CODE(code)) {
+        kind = CONSTANT;
+        constant.bits = code == PC_true;
+        constant.type = code == PC_nullptr ? CT_NULLPTR : CT_BOOL;
       }
-    } else if (file[i] == '>') {
-      i++;
+    }
 
-      if (file[i] == '>') {
-        i++;
+    fill_token(token, file, base, kind, code, start, i);
+    token->flags = flags;
+    token->constant = constant;
+    *index = i;
+    return;
+  }
 
-        if (file[i] == '=') {
-          i++;
-        }
-      } else if (file[i] == '=') {
-        i++;
-      }
-    } else if (file[i] == '=') {
-      i++;
+  fill_token(token, file, base, EOF, TC_NONE, i, i);
+  token->flags = flags | TF_LINE_START;
+  *index = i;
+}
 
-      if (file[i] == '=') {
-        i++;
-      }
-    } else if (file[i] == '!') {
-      i++;
+Token *scan(const char *file) {
+  struct token_buffer buffer = {NULL, 0, 0};
+  size_t index = 0;
+  Token *token;
+  SourceLocation base = register_source(NULL, file, strlen(file));
 
-      if (file[i] == '=') {
-        i++;
-      }
-    } else if (file[i] == '&') {
-      i++;
+  if (base == NO_LOCATION) {
+    return NULL;
+  }
 
-      if (file[i] == '=' || file[i] == '&') {
-        i++;
-      }
-    } else if (file[i] == '|') {
-      i++;
+  do {
+    if (!(token = push_token(&buffer))) {
+      free_tokens(buffer.tokens);
+      return NULL;
+    }
 
-      if (file[i] == '=' || file[i] == '|') {
-        i++;
-      }
-    } else if (file[i] == ':') {
-      i++;
+    scan_token(file, base, &index, token);
+  } while (token->kind != EOF);
 
-      if (file[i] == ':' || file[i] == '>') {
-        i++;
-      }
-    } else if (file[i] == '*') {
-      i++;
+  return buffer.tokens;
+}
 
-      if (file[i] == '=') {
-        i++;
-      }
-    } else if (file[i] == '%') {
-      i++;
+struct scan_chunk {
+  const char *file;
+  SourceLocation base;
+  // Where lexing starts, and the offset from which tokens belong to the next
+  // chunk. The last chunk keeps everything up to and including EOF.
+  size_t start;
+  size_t end;
+  bool last;
+
+  // The scan position, kept here rather than in a local so it survives the
+  // longjmp out of a failed scan_token().
+  size_t index;
+
+  struct token_buffer buffer;
+  // The first token scanned, the first token past `end` and the scan position
+  // it was scanned from.
+  Token first;
+  Token resync;
+  size_t resync_index;
+  bool failed;
+};
 
-      if (file[i] == '=' || file[i] == '>') {
-        i++;
-      } else if (file[i] == ':') {
-        i++;
+/**
+ * @return The offset just past the next newline at or after `index` that is
+ * not spliced, or of the NUL if there is none.
+ */
+size_t next_line(const char *file, size_t index) {
+  size_t i = index;
 
-        if (file[i] == '%') {
-          i++;
+  for (;;) {
+    i = skip_line(file, i);
 
-          if (file[i] == ':') {
-            i++;
-          } else {
-            SCANNER_ERROR(":");
-          }
-        }
-      }
-    } else if (file[i] == '^') {
-      i++;
+    if (file[i] == '\0') {
+      return i;
+    }
 
-      if (file[i] == '=') {
-        i++;
-      }
-    } else if (file[i] == '#') {
-      i++;
+    if (ends_line(file, i)) {
+      return i + 1;
+    }
 
-      if (file[i] == '#') {
-        i++;
-      }
-    } else {
-      size_t lineno = seen_newlines + 1;
-      size_t column = start - last_newline;
-      ERRORV("scanner", "Unexpected character %c at %zu:%zu", file[i], lineno,
-             column);
+    i++;
+  }
+}
+
+/**
+ * Scans the next token of a chunk. A token that does not lex becomes an empty
+ * LEX_ERROR token, and scanning goes on from the next line.
+ */
+void scan_chunk_token(struct scan_chunk *chunk, Token *token) {
+  jmp_buf abandon;
+
+  if (setjmp(abandon)) {
+    size_t start = token->location - chunk->base;
+    uint8_t flags = token->flags;
+
+    speculation = NULL;
+    fill_token(token, chunk->file, chunk->base, LEX_ERROR, TC_NONE, start,
+               start);
+    token->flags = flags;
+    chunk->index = next_line(chunk->file, start);
+    return;
+  }
+
+  speculation = &abandon;
+  scan_token(chunk->file, chunk->base, &chunk->index, token);
+  speculation = NULL;
+}
+
+/**
+ * Lexes the tokens of a chunk.
+ *
+ * @return false when out of memory.
+ */
+bool lex_chunk(struct scan_chunk *chunk) {
+  Token token;
+
+  chunk->buffer = (struct token_buffer){NULL, 0, 0};
+  chunk->index = chunk->start;
+  chunk->resync_index = chunk->start;
+  scan_chunk_token(chunk, &token);
+  chunk->first = token;
+
+  for (;;) {
+    if (token.kind == EOF ? !chunk->last
+                          : token.location - chunk->base >= chunk->end) {
+      break;
     }
 
-    const char *value_begin = &file[start];
-    size_t value_length = i - start;
+    Token *slot = push_token(&chunk->buffer);
 
-    if (kind == IDENTIFIER &&
-        is_in_array(value_begin, value_length, keywords, NELEMS(keywords))) {
-      kind = KEYWORD;
-    } else if (kind == IDENTIFIER &&
-               is_in_array(value_begin, value_length, predefined_constants,
-                           NELEMS(predefined_constants))) {
-      kind = CONSTANT;
+    if (!slot) {
+      return false;
     }
 
-    Token *new_token =
-      alloc_new_token(value_begin, kind, start, i, start_coord);
+    *slot = token;
 
-    if (!new_token) {
-      free_list(result);
-      return NULL;
+    if (token.kind == EOF) {
+      break;
     }
 
-    append_linked_list(new_token, &result, &last);
+    chunk->resync_index = chunk->index;
+    scan_chunk_token(chunk, &token);
   }
 
-  Token *eof = alloc_new_token(NULL, EOF, i, i, calc_coord(i));
+  chunk->resync = token;
+  return true;
+}
 
-  if (!eof) {
-    free_list(result);
-    return NULL;
+void *lex_chunk_on_thread(void *argument) {
+  struct scan_chunk *chunk = argument;
+
+  chunk->failed = !lex_chunk(chunk);
+  return NULL;
+}
+
+/**
+ * @return Whether two tokens were scanned alike, including the flags that
+ * depend on what came before them.
+ */
+bool same_token(const Token *a, const Token *b) {
+  return a->kind == b->kind && a->flags == b->flags &&
+         a->location == b->location && a->length == b->length;
+}
+
+Token *scan_parallel(const char *file, size_t length, size_t chunk_count) {
+  struct scan_chunk *chunks = calloc(chunk_count, sizeof(struct scan_chunk));
+  pthread_t *threads = calloc(chunk_count, sizeof(pthread_t));
+  bool *started = calloc(chunk_count, sizeof(bool));
+  Token *result = NULL;
+  size_t count = 0;
+
+  SourceLocation base = register_source(NULL, file, length);
+
+  if (!chunks || !threads || !started || base == NO_LOCATION) {
+    goto cleanup;
+  }
+
+  // Each chunk ends just after the first newline past its share of the
+  // source, so it starts a line. That is only a guess at a token boundary,
+  // which is checked below.
+  for (size_t start = 0; count < chunk_count; count++) {
+    struct scan_chunk *chunk = &chunks[count];
+    size_t end = length / chunk_count * (count + 1);
+
+    chunk->file = file;
+    chunk->base = base;
+    chunk->start = start;
+    chunk->last = count + 1 == chunk_count;
+
+    if (!chunk->last) {
+      end = next_line(file, end > start ? end : start);
+      chunk->last = file[end] == '\0';
+    }
+
+    if (chunk->last) {
+      chunk->end = length + 1;
+      count++;
+      break;
+    }
+
+    chunk->end = start = end;
+  }
+
+  for (size_t k = 1; k < count; k++) {
+    started[k] = pthread_create(&threads[k], NULL, lex_chunk_on_thread,
+                                &chunks[k]) == 0;
+    chunks[k].failed = !started[k];
+  }
+
+  lex_chunk_on_thread(&chunks[0]);
+
+  for (size_t k = 1; k < count; k++) {
+    if (started[k]) {
+      pthread_join(threads[k], NULL);
+    }
+  }
+
+  if (chunks[0].failed) {
+    goto cleanup;
+  }
+
+  // A chunk is kept if its first token is the one the serial scanner would
+  // find next, since lexing on from a token does not depend on what came
+  // before it. Other chunks are lexed again from where the previous one
+  // stopped.
+  size_t total = chunks[0].buffer.count;
+
+  for (size_t k = 1; k < count; k++) {
+    struct scan_chunk *chunk = &chunks[k];
+    struct scan_chunk *previous = &chunks[k - 1];
+
+    if (chunk->failed || !same_token(&chunk->first, &previous->resync)) {
+      free(chunk->buffer.tokens);
+      chunk->start = previous->resync_index;
+
+      if (!lex_chunk(chunk)) {
+        goto cleanup;
+      }
+    }
+
+    total += chunk->buffer.count;
+  }
+
+  result = malloc(total * sizeof(Token));
+
+  if (!result) {
+    goto cleanup;
   }
 
-  append_linked_list(eof, &result, &last);
+  total = 0;
+
+  for (size_t k = 0; k < count; k++) {
+    if (chunks[k].buffer.count) {
+      memcpy(&result[total], chunks[k].buffer.tokens,
+             chunks[k].buffer.count * sizeof(Token));
+      total += chunks[k].buffer.count;
+    }
+  }
+
+cleanup:
+  for (size_t k = 0; chunks && k < count; k++) {
+    free(chunks[k].buffer.tokens);
+  }
+
+  free(chunks);
+  free(threads);
+  free(started);
 
   return result;
 }
 
-void free_list(Token *list) {
-  if (!list)
+void init_scanner(Scanner *scanner, const char *file) {
+  scanner->file = file;
+  scanner->base = register_source(NULL, file, strlen(file));
+  scanner->index = 0;
+  scanner->tokens = NULL;
+  scanner->head = 0;
+  scanner->count = 0;
+
+  if (scanner->base == NO_LOCATION) {
+    CRITICAL("scanner", "Out of source locations!");
+  }
+}
+
+void init_scanner_from_tokens(Scanner *scanner, const char *file,
+                              Token *tokens) {
+  init_scanner(scanner, file);
+  scanner->tokens = tokens;
+}
+
+// Later phases compare identifiers and literals by their interned id. This
+// runs on the consuming thread only, so parallel scanning needs no locking.
+void intern_token(Token *token) {
+  if (token->interned == NO_INTERN &&
+      (token->kind == IDENTIFIER || token->kind == CONSTANT ||
+       token->kind == STRING)) {
+    token->interned = intern_spelling(token);
+  }
+}
+
+intern_t intern_spelling(const Token *token) {
+  if (token->kind != IDENTIFIER || !(token->flags & TF_UCN)) {
+    return intern(token->data, token->length);
+  }
+
+  // UTF-8 is shorter than the names it replaces.
+  char *text = malloc(token->length);
+  size_t length = 0;
+
+  if (!text) {
+    CRITICAL("scanner", "Out of memory!");
+  }
+
+  for (size_t i = 0; i < token->length;) {
+    if (token->data[i] == '\\') {
+      size_t end = scan_universal_character(token->data, i);
+      uint32_t code_point = universal_character_value(token->data, i, end);
+
+      length += encode_utf8(code_point, &text[length]);
+      i = end;
+    } else {
+      text[length++] = token->data[i++];
+    }
+  }
+
+  intern_t id = intern(text, length);
+  free(text);
+
+  return id;
+}
+
+Token *peek_token(Scanner *scanner, size_t n) {
+  if (n >= SCANNER_RING_SIZE) {
+    CRITICALV("scanner", "Cannot look %zu tokens ahead, the limit is %d", n,
+              SCANNER_RING_SIZE - 1);
+  }
+
+  if (scanner->tokens) {
+    Token *token = &scanner->tokens[scanner->index];
+
+    // Tokens past an error are only a guess, see scan_chunk_token().
+    for (; n > 0 && token->kind != EOF && token->kind != LEX_ERROR; n--) {
+      token++;
+    }
+
+    intern_token(token);
+    return token;
+  }
+
+  while (scanner->count <= n) {
+    size_t slot = (scanner->head + scanner->count) % SCANNER_RING_SIZE;
+    scan_token(scanner->file, scanner->base, &scanner->index,
+               &scanner->ring[slot]);
+    intern_token(&scanner->ring[slot]);
+    scanner->count++;
+  }
+
+  return &scanner->ring[(scanner->head + n) % SCANNER_RING_SIZE];
+}
+
+Token *next_token(Scanner *scanner) {
+  Token *token = peek_token(scanner, 0);
+
+  if (scanner->tokens) {
+    if (token->kind == LEX_ERROR) {
+      // Scanning the text again reports the error, as init_scanner() would
+      // have. Tokens are scanned on demand from there on.
+      scanner->index = token->location - scanner->base;
+      scanner->tokens = NULL;
+      return next_token(scanner);
+    }
+
+    if (token->kind != EOF) {
+      scanner->index++;
+    }
+
+    return token;
+  }
+
+  scanner->head = (scanner->head + 1) % SCANNER_RING_SIZE;
+  scanner->count--;
+
+  return token;
+}
+
+void seek_scanner(Scanner *scanner, size_t index) {
+  scanner->head = 0;
+  scanner->count = 0;
+
+  if (!scanner->tokens) {
+    scanner->index = index;
     return;
+  }
 
-  if (list->next)
-    free_list(list->next);
+  // Replayed tokens only ever move forward.
+  SourceLocation location = scanner->base + (SourceLocation)index;
+  size_t low = scanner->index;
 
-  if (list->data)
-    free((void *)list->data);
+  while (scanner->tokens[low].kind != EOF &&
+         scanner->tokens[low].location < location) {
+    low++;
+  }
 
-  free(list);
+  scanner->index = low;
 }
+
+void free_tokens(Token *tokens) { free(tokens); }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "intern.h"
+#include "source.h"
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -8,32 +10,347 @@
 #define PUNCT 3
 #define CONSTANT 4
 #define STRING 5
+// Text scan_parallel() could not lex, reported once the token is consumed.
+#define LEX_ERROR 6
+// A character that is no other token, like @ or $. Macros may take and
+// stringize it, the parser rejects it.
+#define OTHER 7
 
 #ifndef EOF
 // EOF should be defined as -1 anyways.
 #define EOF (-1)
 #endif
 
-typedef int kind_t;
+typedef int8_t kind_t;
 
-typedef struct Coord {
-  size_t line_number;
-  size_t column;
-} Coord;
+enum token_code {
+  TC_NONE = 0,
+
+  // Keywords (ISO/IEC 9899:2023 § 6.4.1)
+  KW_alignas,
+  KW_alignof,
+  KW_auto,
+  KW_bool,
+  KW_break,
+  KW_case,
+  KW_char,
+  KW_const,
+  KW_constexpr,
+  KW_continue,
+  KW_default,
+  KW_do,
+  KW_double,
+  KW_else,
+  KW_enum,
+  KW_extern,
+  KW_float,
+  KW_for,
+  KW_goto,
+  KW_if,
+  KW_inline,
+  KW_int,
+  KW_long,
+  KW_register,
+  KW_restrict,
+  KW_return,
+  KW_short,
+  KW_signed,
+  KW_sizeof,
+  KW_static,
+  KW_static_assert,
+  KW_struct,
+  KW_switch,
+  KW_thread_local,
+  KW_typedef,
+  KW_typeof,
+  KW_typeof_unqual,
+  KW_union,
+  KW_unsigned,
+  KW_void,
+  KW_volatile,
+  KW_while,
+  KW__Atomic,
+  KW__BitInt,
+  KW__Complex,
+  KW__Decimal128,
+  KW__Decimal32,
+  KW__Decimal64,
+  KW__Generic,
+  KW__Imaginary,
+  KW__Noreturn,
+
+  // Predefined constants (ISO/IEC 9899:2023 § 6.4.4.6)
+  PC_false,
+  PC_nullptr,
+  PC_true,
+
+  // Punctuators (ISO/IEC 9899:2023 § 6.4.6). Digraphs share the code of the
+  // punctuator they spell, see cl. 3.
+  PU_LBRACKET,
+  PU_RBRACKET,
+  PU_LPAREN,
+  PU_RPAREN,
+  PU_LBRACE,
+  PU_RBRACE,
+  PU_PERIOD,
+  PU_ARROW,
+  PU_INC,
+  PU_DEC,
+  PU_AMP,
+  PU_STAR,
+  PU_PLUS,
+  PU_MINUS,
+  PU_TILDE,
+  PU_BANG,
+  PU_SLASH,
+  PU_PERCENT,
+  PU_SHFL,
+  PU_SHFR,
+  PU_LT,
+  PU_GT,
+  PU_LTE,
+  PU_GTE,
+  PU_EE,
+  PU_NE,
+  PU_CARET,
+  PU_PIPE,
+  PU_LAND,
+  PU_LOR,
+  PU_QUESTION,
+  PU_COLON,
+  PU_DCOLON,
+  PU_SEMICOLON,
+  PU_ELLIPSIS,
+  PU_EQ,
+  PU_STARE,
+  PU_SLASHE,
+  PU_PERCENTE,
+  PU_PLUSE,
+  PU_MINUSE,
+  PU_SHFLE,
+  PU_SHFRE,
+  PU_ANDE,
+  PU_CARATE,
+  PU_ORE,
+  PU_COMMA,
+  PU_HASH,
+  PU_DHASH,
+
+  TC_COUNT,
+};
+
+#define IS_KEYWORD_CODE(code) (KW_alignas <= (code) && (code) <= KW__Noreturn)
+#define IS_PREDEFINED_CODE(code) (PC_false <= (code) && (code) <= PC_true)
+#define IS_PUNCT_CODE(code) (PU_LBRACKET <= (code) && (code) <= PU_DHASH)
 
 typedef struct SpanStruct {
   Coord start;
   Coord end;
 } Span;
 
+// Type of a constant (ISO/IEC 9899:2023 § 6.4.4), for an x86-64 target.
+enum constant_type {
+  // Not decoded, such as character constants.
+  CT_NONE = 0,
+
+  CT_INT,
+  CT_UNSIGNED,
+  CT_LONG,
+  CT_UNSIGNED_LONG,
+  CT_LONG_LONG,
+  CT_UNSIGNED_LONG_LONG,
+  // The width is the smallest one that holds the value.
+  CT_BITINT,
+  CT_UNSIGNED_BITINT,
+
+  CT_FLOAT,
+  CT_DOUBLE,
+  CT_LONG_DOUBLE,
+  CT_DECIMAL32,
+  CT_DECIMAL64,
+  CT_DECIMAL128,
+
+  CT_BOOL,
+  CT_NULLPTR,
+};
+
+typedef struct ConstantStruct {
+  // Value of integer and predefined constants. Binary floating constants
+  // keep their IEEE 754 encoding, the 64-bit significand for long double.
+  uint64_t bits;
+  enum constant_type type;
+  // Biased exponent of long double constants, 0 otherwise.
+  uint16_t exponent;
+} Constant;
+
+// Token flags, see Token.
+#define TF_LINE_START 0x1
+#define TF_LEADING_SPACE 0x2
+// Names a macro that must not be expanded, it was seen while that macro was
+// being replaced.
+#define TF_NO_EXPAND 0x4
+// An identifier spelled with universal character names, see intern_spelling().
+#define TF_UCN 0x8
+
 typedef struct TokenStruct {
   kind_t kind;
-  size_t length;
+  // Exact keyword, predefined constant or punctuator (enum token_code),
+  // TC_NONE otherwise.
+  uint8_t code;
+  // TF_LINE_START for the first token of a line, TF_LEADING_SPACE when
+  // whitespace or a comment comes before it. The preprocessor relies on them.
+  uint8_t flags;
+  // Where the token starts, NO_LOCATION for tokens that do not come from a
+  // source. See token_span() for line and column.
+  SourceLocation location;
+  uint32_t length;
+  // Spelling of identifiers and literals, interned once the token is handed
+  // out by peek_token() or next_token(). NO_INTERN otherwise.
+  intern_t interned;
+  // Points into the source buffer and is NOT NUL-terminated, use `length`.
   const char *data;
-  Span span;
-
-  struct TokenStruct *next;
+  // Decoded value of CONSTANT tokens, CT_NONE otherwise.
+  Constant constant;
 } Token;
 
+// Number of tokens the streaming scanner can hold ahead of its consumer.
+#define SCANNER_RING_SIZE 16
+
+typedef struct ScannerStruct {
+  const char *file;
+  SourceLocation base;
+  size_t index;
+
+  // Pre-scanned tokens to replay instead, `index` being the next one.
+  Token *tokens;
+
+  // Scanned but unconsumed tokens, oldest at `ring[head]`.
+  Token ring[SCANNER_RING_SIZE];
+  size_t head;
+  size_t count;
+} Scanner;
+
+enum token_code classify_identifier(const char *value, size_t length);
+
+/**
+ * Scans the next token at or after `*index`, skipping whitespace and comments.
+ *
+ * Once the end of the buffer is reached every call yields an EOF token.
+ *
+ * @param file The source buffer.
+ * @param base The location of the start of the buffer.
+ * @param index The scan position, advanced past the token.
+ * @param token The token to fill.
+ */
+void scan_token(const char *file, SourceLocation base, size_t *index,
+                Token *token);
+
+/**
+ * Scans a NUL-terminated source buffer into a contiguous token array.
+ *
+ * The array always ends with an EOF token. Tokens reference the source
+ * buffer directly, so it must outlive the returned array. The buffer is
+ * registered with the source manager if it is not already, see
+ * register_source().
+ *
+ * @param file The source buffer.
+ * @return The token array, or NULL when out of memory or locations.
+ */
 Token *scan(const char *file);
-void free_list(Token *list);
+
+/**
+ * Scans a source buffer on several threads, with the same result as scan()
+ * as long as it lexes.
+ *
+ * The buffer is cut after newlines into roughly equal chunks, each lexed on
+ * its own thread. A chunk may start inside a comment or literal, so it is
+ * only kept if its first token lines up with the end of the previous chunk,
+ * and is lexed again on the calling thread otherwise.
+ *
+ * Errors are not reported here, as the text may be in a group the
+ * preprocessor skips. A token that does not lex becomes a LEX_ERROR token and
+ * lexing goes on from the next line. The error is reported if a scanner
+ * replaying the tokens gets to it, see init_scanner_from_tokens().
+ *
+ * @param file The source buffer.
+ * @param length The length of the buffer, without the NUL.
+ * @param chunk_count The number of chunks, and so of threads, to use.
+ * @return The token array, or NULL when out of memory.
+ */
+Token *scan_parallel(const char *file, size_t length, size_t chunk_count);
+
+/**
+ * Releases a token array returned by scan() or scan_parallel().
+ */
+void free_tokens(Token *tokens);
+
+/**
+ * Prepares a streaming scanner over a NUL-terminated source buffer.
+ *
+ * The buffer is registered with the source manager like in scan(), so
+ * several scanners may be active at once.
+ *
+ * @param scanner The scanner to initialize.
+ * @param file The source buffer, which must outlive every token handed out.
+ */
+void init_scanner(Scanner *scanner, const char *file);
+
+/**
+ * Prepares a scanner that replays a token array from scan() or
+ * scan_parallel() rather than scanning on demand.
+ *
+ * Consuming a LEX_ERROR token scans its text again, which reports the error.
+ * Peeking stops at one, like at EOF.
+ *
+ * @param scanner The scanner to initialize.
+ * @param file The source buffer the tokens were scanned from.
+ * @param tokens The tokens, which must outlive the scanner.
+ */
+void init_scanner_from_tokens(Scanner *scanner, const char *file,
+                              Token *tokens);
+
+/**
+ * Looks at an upcoming token without consuming it, scanning on demand.
+ *
+ * @param scanner The scanner.
+ * @param n How many tokens to look past, 0 being the next one. Must be less
+ * than SCANNER_RING_SIZE.
+ * @return The token, which stays valid until it is consumed and the ring
+ * wraps around onto its slot.
+ */
+Token *peek_token(Scanner *scanner, size_t n);
+
+/**
+ * Consumes the next token, scanning it on demand.
+ *
+ * After the end of the source every call returns an EOF token.
+ *
+ * @param scanner The scanner.
+ * @return The token. Its slot is reused by later scanning, copy the token to
+ * keep it past the next call into the scanner.
+ */
+Token *next_token(Scanner *scanner);
+
+/**
+ * Moves a scanner forward to a byte offset of its source, dropping any
+ * lookahead. The offset must be at a token boundary or in whitespace, and not
+ * before the next unconsumed token.
+ *
+ * @param scanner The scanner.
+ * @param index The byte offset to continue from.
+ */
+void seek_scanner(Scanner *scanner, size_t index);
+
+/**
+ * Interns the spelling of a token. Identifiers with TF_UCN are interned with
+ * their universal character names written in UTF-8, so `\u00e9` and `é`
+ * spell the same identifier.
+ *
+ * @return The id of the spelling.
+ */
+intern_t intern_spelling(const Token *token);
+
+/**
+ * Resolves where a token starts and ends in its source.
+ */
+Span token_span(const Token *token);
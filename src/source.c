@@ -0,0 +1,351 @@
+#include "source.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define READ_CHUNK_SIZE 65536
+#define INITIAL_SOURCE_CAPACITY 16
+#define INITIAL_LINE_CAPACITY 1024
+
+// A registered buffer and the locations it owns, [base, base + length].
+struct source_entry {
+  const char *name;
+  const char *data;
+  size_t length;
+  SourceLocation base;
+
+  // Start offsets of each line, built on demand.
+  uint32_t *line_starts;
+  size_t line_count;
+  size_t line_capacity;
+};
+
+// Entries in registration order, so their bases are ascending.
+struct source_manager {
+  struct source_entry *entries;
+  size_t count;
+  size_t capacity;
+  // Location 0 is NO_LOCATION, so the first buffer starts at 1.
+  SourceLocation next;
+};
+
+_Thread_local struct source_manager sources = {NULL, 0, 0, 1};
+
+bool map_source(int fd, size_t length, SourceBuffer *buffer) {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  size_t file_pages = (length + page_size - 1) / page_size * page_size;
+
+  // Reserve one more page than the file needs. The kernel zero-fills the tail
+  // of the last file page and the extra anonymous page is all zeros, so the
+  // contents are always followed by a NUL sentinel.
+  size_t mapping_size = file_pages + page_size;
+  void *mapping = mmap(NULL, mapping_size, PROT_READ,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  if (length > 0 && mmap(mapping, length, PROT_READ, MAP_PRIVATE | MAP_FIXED,
+                         fd, 0) == MAP_FAILED) {
+    munmap(mapping, mapping_size);
+    return false;
+  }
+
+  buffer->data = mapping;
+  buffer->length = length;
+  buffer->mapping = mapping;
+  buffer->mapping_size = mapping_size;
+
+  return true;
+}
+
+bool read_source(int fd, SourceBuffer *buffer) {
+  size_t capacity = READ_CHUNK_SIZE;
+  size_t length = 0;
+  char *data = malloc(capacity + SOURCE_PADDING);
+
+  if (!data) {
+    return false;
+  }
+
+  for (;;) {
+    if (length == capacity) {
+      capacity *= 2;
+      char *grown = realloc(data, capacity + SOURCE_PADDING);
+
+      if (!grown) {
+        free(data);
+        return false;
+      }
+
+      data = grown;
+    }
+
+    ssize_t read_len = read(fd, &data[length], capacity - length);
+
+    if (read_len < 0) {
+      free(data);
+      return false;
+    }
+
+    if (read_len == 0) {
+      break;
+    }
+
+    length += (size_t)read_len;
+
+    if (length > MAX_SOURCE_LENGTH) {
+      free(data);
+      return false;
+    }
+  }
+
+  memset(&data[length], 0, SOURCE_PADDING);
+
+  buffer->data = data;
+  buffer->length = length;
+  buffer->mapping = NULL;
+  buffer->mapping_size = 0;
+
+  return true;
+}
+
+bool load_source(const char *path, SourceBuffer *buffer) {
+  bool is_stdin = strcmp(path, "-") == 0;
+  int fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info;
+  bool result;
+
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+    result = (size_t)info.st_size <= MAX_SOURCE_LENGTH &&
+             map_source(fd, (size_t)info.st_size, buffer);
+  } else {
+    // Pipes and terminals cannot be mapped or measured up front.
+    result = read_source(fd, buffer);
+  }
+
+  if (!is_stdin) {
+    close(fd);
+  }
+
+  return result;
+}
+
+void release_source(SourceBuffer *buffer) {
+  if (buffer->mapping) {
+    munmap(buffer->mapping, buffer->mapping_size);
+  } else {
+    free((void *)buffer->data);
+  }
+
+  buffer->data = NULL;
+  buffer->length = 0;
+  buffer->mapping = NULL;
+  buffer->mapping_size = 0;
+}
+
+void free_line_table(struct source_entry *entry) {
+  free(entry->line_starts);
+  entry->line_starts = NULL;
+  entry->line_count = 0;
+  entry->line_capacity = 0;
+}
+
+SourceLocation register_source(const char *name, const char *data,
+                               size_t length) {
+  for (size_t i = sources.count; i > 0; i--) {
+    struct source_entry *entry = &sources.entries[i - 1];
+
+    if (entry->data && entry->data == data && length <= entry->length) {
+      free_line_table(entry);
+      return entry->base;
+    }
+  }
+
+  if ((size_t)(UINT32_MAX - sources.next) <= length) {
+    return NO_LOCATION;
+  }
+
+  if (sources.count == sources.capacity) {
+    size_t capacity =
+      sources.capacity ? sources.capacity * 2 : INITIAL_SOURCE_CAPACITY;
+    struct source_entry *entries =
+      realloc(sources.entries, capacity * sizeof(struct source_entry));
+
+    if (!entries) {
+      return NO_LOCATION;
+    }
+
+    sources.entries = entries;
+    sources.capacity = capacity;
+  }
+
+  struct source_entry *entry = &sources.entries[sources.count++];
+
+  entry->name = name;
+  entry->data = data;
+  entry->length = length;
+  entry->base = sources.next;
+  entry->line_starts = NULL;
+  entry->line_count = 0;
+  entry->line_capacity = 0;
+
+  // One more location for the end of the source, where EOF sits.
+  sources.next += (SourceLocation)length + 1;
+
+  return entry->base;
+}
+
+void unregister_source(const char *data) {
+  for (size_t i = sources.count; i > 0; i--) {
+    struct source_entry *entry = &sources.entries[i - 1];
+
+    if (entry->data && entry->data == data) {
+      free_line_table(entry);
+      entry->data = NULL;
+      return;
+    }
+  }
+}
+
+SourceLocation pointer_location(const char *pointer) {
+  for (size_t i = sources.count; i > 0; i--) {
+    struct source_entry *entry = &sources.entries[i - 1];
+
+    if (entry->data && entry->data <= pointer &&
+        pointer <= entry->data + entry->length) {
+      return entry->base + (SourceLocation)(pointer - entry->data);
+    }
+  }
+
+  return NO_LOCATION;
+}
+
+struct source_entry *find_entry(SourceLocation location) {
+  if (location == NO_LOCATION || location >= sources.next) {
+    return NULL;
+  }
+
+  // Find the last source starting at or before the location.
+  size_t low = 0;
+  size_t high = sources.count;
+
+  while (high - low > 1) {
+    size_t middle = low + (high - low) / 2;
+
+    if (sources.entries[middle].base <= location) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+
+  return &sources.entries[low];
+}
+
+bool push_line_start(struct source_entry *entry, size_t offset) {
+  if (entry->line_count == entry->line_capacity) {
+    size_t capacity = entry->line_capacity ? entry->line_capacity * 2
+                                           : INITIAL_LINE_CAPACITY;
+    uint32_t *starts =
+      realloc(entry->line_starts, capacity * sizeof(uint32_t));
+
+    if (!starts) {
+      return false;
+    }
+
+    entry->line_starts = starts;
+    entry->line_capacity = capacity;
+  }
+
+  entry->line_starts[entry->line_count++] = (uint32_t)offset;
+  return true;
+}
+
+bool build_line_table(struct source_entry *entry) {
+  const char *end = entry->data + entry->length;
+
+  if (!push_line_start(entry, 0)) {
+    return false;
+  }
+
+  for (const char *line = entry->data;
+       (line = memchr(line, '\n', (size_t)(end - line))) != NULL;) {
+    line++;
+
+    if (!push_line_start(entry, (size_t)(line - entry->data))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+Coord location_coord(SourceLocation location) {
+  struct source_entry *entry = find_entry(location);
+
+  if (!entry || !entry->data ||
+      (!entry->line_starts && !build_line_table(entry))) {
+    return (Coord){(size_t)-1, (size_t)-1};
+  }
+
+  size_t offset = location - entry->base;
+
+  // Find the last line starting at or before the offset.
+  size_t low = 0;
+  size_t high = entry->line_count;
+
+  while (high - low > 1) {
+    size_t middle = low + (high - low) / 2;
+
+    if (entry->line_starts[middle] <= offset) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+
+  Coord result;
+
+  result.line_number = low + 1;
+  result.column = offset - entry->line_starts[low] + 1;
+
+  return result;
+}
+
+const char *location_name(SourceLocation location) {
+  struct source_entry *entry = find_entry(location);
+  return entry ? entry->name : NULL;
+}
+
+void format_location(SourceLocation location, char *buffer, size_t size) {
+  Coord coord = location_coord(location);
+  const char *name = location_name(location);
+
+  if (name) {
+    snprintf(buffer, size, "%s:%zu:%zu", name, coord.line_number,
+             coord.column);
+  } else {
+    snprintf(buffer, size, "%zu:%zu", coord.line_number, coord.column);
+  }
+}
+
+void free_sources(void) {
+  for (size_t i = 0; i < sources.count; i++) {
+    free_line_table(&sources.entries[i]);
+  }
+
+  free(sources.entries);
+  sources = (struct source_manager){NULL, 0, 0, 1};
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of NUL bytes guaranteed to follow the contents of a source buffer.
+// Scanners may read up to this many bytes past the terminating NUL.
+#define SOURCE_PADDING 64
+
+// Locations are 32 bits, so larger sources are rejected.
+#define MAX_SOURCE_LENGTH ((size_t)UINT32_MAX - 1)
+
+// A position in any source registered with register_source(). Each source
+// owns a contiguous range of locations, one per byte plus one for its end, so
+// a single value identifies both the source and the byte within it.
+typedef uint32_t SourceLocation;
+
+// Location of tokens that do not come from a source.
+#define NO_LOCATION 0
+
+// Enough for any "name:line:column" that format_location() writes.
+#define LOCATION_TEXT_SIZE 512
+
+typedef struct Coord {
+  size_t line_number;
+  size_t column;
+} Coord;
+
+typedef struct SourceBufferStruct {
+  // NUL-terminated contents, followed by at least SOURCE_PADDING NUL bytes.
+  const char *data;
+  size_t length;
+
+  // Private: the backing mapping, or NULL if the contents live on the heap.
+  void *mapping;
+  size_t mapping_size;
+} SourceBuffer;
+
+/**
+ * Loads a source file for the whole compilation.
+ *
+ * Regular files are memory-mapped with a trailing zero page acting as the NUL
+ * sentinel. Pipes, terminals and stdin (`-`) are read into a heap buffer.
+ *
+ * @param path The path of the file, or "-" for stdin.
+ * @param buffer The buffer to fill.
+ * @return false if the file could not be opened or read, or is longer than
+ * MAX_SOURCE_LENGTH.
+ */
+bool load_source(const char *path, SourceBuffer *buffer);
+
+/**
+ * Releases a buffer filled by load_source().
+ */
+void release_source(SourceBuffer *buffer);
+
+/**
+ * Gives a buffer the next free range of locations.
+ *
+ * A buffer registered again, at the same address and no longer than before,
+ * keeps its range and name but has its line table rebuilt on next use.
+ *
+ * @param name The name shown in diagnostics, or NULL for unnamed buffers.
+ * Must outlive the source manager.
+ * @param data The contents, which must outlive the source manager.
+ * @param length The length of the contents, without the NUL.
+ * @return The location of the first byte, or NO_LOCATION when out of memory
+ * or locations.
+ */
+SourceLocation register_source(const char *name, const char *data,
+                               size_t length);
+
+/**
+ * Forgets a registered buffer before it is freed or replaced. Its range of
+ * locations is not given out again, and keeps its name, but no longer
+ * resolves to lines and columns.
+ *
+ * @param data The contents given to register_source().
+ */
+void unregister_source(const char *data);
+
+/**
+ * Finds the location of a pointer into a registered buffer, the most
+ * recently registered one if buffers overlap.
+ *
+ * @return The location, or NO_LOCATION if no buffer contains the pointer.
+ */
+SourceLocation pointer_location(const char *pointer);
+
+/**
+ * Resolves a location into a line and column of its source.
+ *
+ * Line tables are built on first use with a single pass over the source, so
+ * the scanner itself never tracks lines.
+ *
+ * @return The 1-based line and column, all -1 for NO_LOCATION.
+ */
+Coord location_coord(SourceLocation location);
+
+/**
+ * @return The name of the source a location belongs to, NULL if unnamed.
+ */
+const char *location_name(SourceLocation location);
+
+/**
+ * Writes a location as "name:line:column", or "line:column" for unnamed
+ * sources, for diagnostics.
+ *
+ * @param buffer The output, at least LOCATION_TEXT_SIZE bytes.
+ */
+void format_location(SourceLocation location, char *buffer, size_t size);
+
+/**
+ * Forgets every registered buffer and releases their line tables. The buffers
+ * themselves belong to the caller.
+ */
+void free_sources(void);
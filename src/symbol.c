@@ -6,10 +6,10 @@
 #include <stdlib.h>
 #include <string.h>
 
-struct scope *current_scope = NULL;
+_Thread_local struct scope *current_scope = NULL;
 
 struct scope *create_scope(void) {
-  struct scope *new_scope = malloc(sizeof(struct scope));
+  struct scope *new_scope = allocate_node(sizeof(struct scope));
   new_scope->parent = current_scope;
   new_scope->symbols = NULL;
 
@@ -28,11 +28,11 @@ void destroy_scope(struct scope *scope) {
 
   while (symbol != NULL) {
     next_symbol = symbol->next;
-    free(symbol);
+    release_node(symbol);
     symbol = next_symbol;
   }
 
-  free(scope);
+  release_node(scope);
 }
 
 void create_symbol(struct id *id) {
@@ -40,8 +40,8 @@ void create_symbol(struct id *id) {
     CRITICAL("link", "Cannot create symbol without a scope");
   }
 
-  struct symbol *new_symbol = malloc(sizeof(struct symbol));
-  new_symbol->name = id->name->data;
+  struct symbol *new_symbol = allocate_node(sizeof(struct symbol));
+  new_symbol->name = id->name.interned;
   new_symbol->next = current_scope->symbols;
   current_scope->symbols = new_symbol;
 }
@@ -53,7 +53,7 @@ struct symbol *find_symbol(Token *name) {
     struct symbol *symbol = scope->symbols;
 
     while (symbol != NULL) {
-      if (strcmp(symbol->name, name->data) == 0) {
+      if (symbol->name == name->interned) {
         // Found the symbol
         return symbol;
       }
@@ -76,14 +76,15 @@ void link_symbols(void) {
 }
 
 void symbol_id(struct id *id) {
-  struct symbol *symbol = find_symbol(id->name);
+  struct symbol *symbol = find_symbol(&id->name);
 
   if (symbol == NULL) {
+    char where[LOCATION_TEXT_SIZE];
+    format_location(id->name.location, where, sizeof(where));
+
     // todo: accumulate errors
-    ERRORV("link",
-           "Cannot find declaration for symbol '%s' (seen on line %zu:%zu)",
-           id->name->data, id->name->span.start.line_number,
-           id->name->span.start.column);
+    ERRORV("link", "Cannot find declaration for symbol '%.*s' (seen at %s)",
+           (int)id->name.length, id->name.data, where);
   }
 
   id->symbol = symbol;
@@ -95,7 +96,7 @@ void symbol_token_specifier(struct specifier *specifier) {
 }
 
 void symbol_id_specifier(struct specifier *specifier) {
-  symbol_id(specifier->_id);
+  symbol_id(id_at(specifier->_id));
 }
 
 void symbol_specifier(struct specifier *specifier) {
@@ -112,8 +113,8 @@ void symbol_specifier(struct specifier *specifier) {
 }
 
 void symbol_specifier_list(struct specifier_list *list) {
-  for (struct specifier *cur = list->head; cur != NULL; cur = cur->next) {
-    symbol_specifier(cur);
+  for (spec_ref cur = list->head; cur != NO_NODE; cur = spec_at(cur)->next) {
+    symbol_specifier(spec_at(cur));
   }
 }
 
@@ -122,60 +123,61 @@ void symbol_expression(struct expression *expr);
 void symbol_declaration(struct declaration *decl);
 
 void symbol_initialized_declarator(struct initialized_declarator *decl) {
-  create_symbol(decl->declarator);
-  symbol_id(decl->declarator);
+  create_symbol(id_at(decl->declarator));
+  symbol_id(id_at(decl->declarator));
 
   if (decl->initializer)
-    symbol_expression(decl->initializer);
+    symbol_expression(expr_at(decl->initializer));
 }
 
 void symbol_init_declarator_list(struct init_declarator_list *list) {
   if (list == NULL)
     return;
 
-  for (struct initialized_declarator *cur = list->head; cur != NULL;
-       cur = cur->next) {
-    symbol_initialized_declarator(cur);
+  for (init_decl_ref cur = list->head; cur != NO_NODE;
+       cur = init_decl_at(cur)->next) {
+    symbol_initialized_declarator(init_decl_at(cur));
   }
 }
 
 void symbol_declaration_list(struct declaration_list *list) {
-  struct declaration *cur = list->head;
-  struct declaration *next = NULL;
+  decl_ref cur = list->head;
+  decl_ref next = NO_NODE;
 
   while (cur) {
-    next = cur->next;
-    symbol_declaration(cur);
+    next = decl_at(cur)->next;
+    symbol_declaration(decl_at(cur));
     cur = next;
   }
 }
 
 void symbol_variable_definition(struct declaration *decl) {
-  symbol_specifier_list(decl->_var.specifiers);
-  symbol_init_declarator_list(decl->_var.init_declarator_list);
+  symbol_specifier_list(spec_list_at(decl->_var.specifiers));
+  symbol_init_declarator_list(
+    init_decl_list_at(decl->_var.init_declarator_list));
 }
 
 void symbol_function_definition(struct declaration *decl) {
-  create_symbol(decl->_func.name);
+  create_symbol(id_at(decl->_func.name));
 
   decl->_func.parameter_scope = create_scope();
 
-  symbol_specifier_list(decl->_func.specifiers);
-  symbol_id(decl->_func.name);
+  symbol_specifier_list(spec_list_at(decl->_func.specifiers));
+  symbol_id(id_at(decl->_func.name));
 
   if (decl->_func.parameters)
-    symbol_declaration_list(decl->_func.parameters);
+    symbol_declaration_list(decl_list_at(decl->_func.parameters));
 
-  symbol_statement(decl->_func.body);
+  symbol_statement(stmt_at(decl->_func.body));
 
   current_scope = current_scope->parent;
 }
 
 void symbol_type_definition(struct declaration *decl) {
-  create_symbol(decl->_type_def.name);
+  create_symbol(id_at(decl->_type_def.name));
 
-  symbol_specifier_list(decl->_type_def.specifiers);
-  symbol_id(decl->_type_def.name);
+  symbol_specifier_list(spec_list_at(decl->_type_def.specifiers));
+  symbol_id(id_at(decl->_type_def.name));
 }
 
 void symbol_declaration(struct declaration *decl) {
@@ -200,9 +202,9 @@ void symbol_statement_list(struct statement_list *list) {
   if (list == NULL)
     return;
 
-  for (struct statement *child = list->head; child != NULL;
-       child = child->next) {
-    symbol_statement(child);
+  for (stmt_ref child = list->head; child != NO_NODE;
+       child = stmt_at(child)->next) {
+    symbol_statement(stmt_at(child));
   }
 }
 
@@ -210,7 +212,7 @@ void symbol_compound_stmt(struct statement *stmt) {
   stmt->_compound.local_scope = create_scope();
 
   // current scope is already set to the new scope
-  symbol_statement_list(stmt->_compound.statements);
+  symbol_statement_list(stmt_list_at(stmt->_compound.statements));
 
   // restore the previous scope after the body has been processed
   current_scope = current_scope->parent;
@@ -219,72 +221,74 @@ void symbol_compound_stmt(struct statement *stmt) {
 void symbol_continue_stmt(struct statement *stmt) { UNUSED(stmt); }
 
 void symbol_decl_stmt(struct statement *stmt) {
-  symbol_declaration(stmt->_decl);
+  symbol_declaration(decl_at(stmt->_decl));
 }
 
 void symbol_expr_stmt(struct statement *stmt) {
-  symbol_expression(stmt->_expr);
+  symbol_expression(expr_at(stmt->_expr));
 }
 
 void symbol_for_stmt(struct statement *stmt) {
   if (stmt->_for.decl) {
-    symbol_declaration(stmt->_for.decl);
+    symbol_declaration(decl_at(stmt->_for.decl));
   }
 
   if (stmt->_for.preloop_expression) {
-    symbol_expression(stmt->_for.preloop_expression);
+    symbol_expression(expr_at(stmt->_for.preloop_expression));
   }
 
   if (stmt->_for.condition) {
-    symbol_expression(stmt->_for.condition);
+    symbol_expression(expr_at(stmt->_for.condition));
   }
 
   if (stmt->_for.step_expression) {
-    symbol_expression(stmt->_for.step_expression);
+    symbol_expression(expr_at(stmt->_for.step_expression));
   }
 
   if (stmt->_for.body) {
-    symbol_statement(stmt->_for.body);
+    symbol_statement(stmt_at(stmt->_for.body));
   }
 }
 
-void symbol_goto_stmt(struct statement *stmt) { symbol_id(stmt->_goto); }
+void symbol_goto_stmt(struct statement *stmt) { symbol_id(id_at(stmt->_goto)); }
 
 void symbol_if_stmt(struct statement *stmt) {
   if (stmt->_if.condition) {
-    symbol_expression(stmt->_if.condition);
+    symbol_expression(expr_at(stmt->_if.condition));
   }
 
   if (stmt->_if.body) {
-    symbol_statement(stmt->_if.body);
+    symbol_statement(stmt_at(stmt->_if.body));
   }
 
   if (stmt->_if.else_body) {
-    symbol_statement(stmt->_if.else_body);
+    symbol_statement(stmt_at(stmt->_if.else_body));
   }
 }
 
-void symbol_label_stmt(struct statement *stmt) { symbol_id(stmt->_label.name); }
+void symbol_label_stmt(struct statement *stmt) {
+  symbol_id(id_at(stmt->_label.name));
+}
 
 void symbol_return_stmt(struct statement *stmt) {
   if (stmt->_return.ret_expr) {
-    symbol_expression(stmt->_return.ret_expr);
+    symbol_expression(expr_at(stmt->_return.ret_expr));
   }
 }
 
 void symbol_switch_stmt(struct statement *stmt) {
   if (stmt->_switch.condition) {
-    symbol_expression(stmt->_switch.condition);
+    symbol_expression(expr_at(stmt->_switch.condition));
   }
 
   if (stmt->_switch.body) {
-    symbol_statement(stmt->_switch.body);
+    symbol_statement(stmt_at(stmt->_switch.body));
   }
 }
 
 void symbol_switch_label_stmt(struct statement *stmt) {
   if (stmt->_switch_label.test) {
-    symbol_expression(stmt->_switch_label.test);
+    symbol_expression(expr_at(stmt->_switch_label.test));
   }
 }
 
@@ -292,11 +296,11 @@ void symbol_while_stmt(struct statement *stmt) {
   // stmt->_while.should_check_condition_first
 
   if (stmt->_while.condition) {
-    symbol_expression(stmt->_while.condition);
+    symbol_expression(expr_at(stmt->_while.condition));
   }
 
   if (stmt->_while.body) {
-    symbol_statement(stmt->_while.body);
+    symbol_statement(stmt_at(stmt->_while.body));
   }
 }
 
@@ -353,31 +357,33 @@ void symbol_constant_expr(struct expression *expr) {
   // expr->_constant
 }
 
-void symbol_id_expression(struct expression *expr) { symbol_id(expr->_id); }
+void symbol_id_expression(struct expression *expr) {
+  symbol_id(id_at(expr->_id));
+}
 
 void symbol_index_expression(struct expression *expr) {
   if (expr->_index.object) {
-    symbol_expression(expr->_index.object);
+    symbol_expression(expr_at(expr->_index.object));
   }
 
   if (expr->_index.index) {
-    symbol_expression(expr->_index.index);
+    symbol_expression(expr_at(expr->_index.index));
   }
 }
 
 void symbol_func_call(struct expression *expr) {
   if (expr->_call.function_ptr) {
-    symbol_expression(expr->_call.function_ptr);
+    symbol_expression(expr_at(expr->_call.function_ptr));
   }
 
   if (expr->_call.parameter_list) {
-    symbol_expression_list(expr->_call.parameter_list);
+    symbol_expression_list(expr_list_at(expr->_call.parameter_list));
   }
 }
 
 void symbol_postfix_expr(struct expression *expr) {
   if (expr->_unary.base) {
-    symbol_expression(expr->_unary.base);
+    symbol_expression(expr_at(expr->_unary.base));
   }
 
   // expr->_unary.operator
@@ -387,43 +393,43 @@ void symbol_unary_expr(struct expression *expr) {
   // expr->_unary.operator
 
   if (expr->_unary.base) {
-    symbol_expression(expr->_unary.base);
+    symbol_expression(expr_at(expr->_unary.base));
   }
 }
 
 void symbol_cast_expr(struct expression *expr) {
   if (expr->_cast.type) {
-    symbol_specifier_list(expr->_cast.type);
+    symbol_specifier_list(spec_list_at(expr->_cast.type));
   }
 
   if (expr->_cast.base) {
-    symbol_expression(expr->_cast.base);
+    symbol_expression(expr_at(expr->_cast.base));
   }
 }
 
 void symbol_binary_expr(struct expression *expr) {
   if (expr->_binary.left) {
-    symbol_expression(expr->_binary.left);
+    symbol_expression(expr_at(expr->_binary.left));
   }
 
   // expr->_binary.operator
 
   if (expr->_binary.right) {
-    symbol_expression(expr->_binary.right);
+    symbol_expression(expr_at(expr->_binary.right));
   }
 }
 
 void symbol_ternary_expr(struct expression *expr) {
   if (expr->_ternary.condition) {
-    symbol_expression(expr->_ternary.condition);
+    symbol_expression(expr_at(expr->_ternary.condition));
   }
 
   if (expr->_ternary.true_branch) {
-    symbol_expression(expr->_ternary.true_branch);
+    symbol_expression(expr_at(expr->_ternary.true_branch));
   }
 
   if (expr->_ternary.false_branch) {
-    symbol_expression(expr->_ternary.false_branch);
+    symbol_expression(expr_at(expr->_ternary.false_branch));
   }
 }
 
@@ -470,15 +476,15 @@ void symbol_expression_list(struct expression_list *list) {
     return;
   }
 
-  struct expression *cur = list->head;
+  expr_ref cur = list->head;
 
-  if (cur == NULL) {
+  if (cur == NO_NODE) {
     return;
   }
 
-  while (cur != NULL) {
-    symbol_expression(cur);
-    cur = cur->next;
+  while (cur != NO_NODE) {
+    symbol_expression(expr_at(cur));
+    cur = expr_at(cur)->next;
   }
 }
 
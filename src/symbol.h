@@ -3,7 +3,7 @@
 #include "scanner.h"
 
 struct symbol {
-  const char *name;
+  intern_t name;
   struct symbol *next;
 };
 
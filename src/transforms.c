@@ -8,26 +8,20 @@
 // Fake tokens
 Token false_token = {
   .kind = CONSTANT,
-  .data = "false",
+  .code = PC_false,
+  .location = NO_LOCATION,
   .length = 5,
-  .span =
-    {
-      .start = {-1, -1},
-      .end = {-1, -1},
-    },
-  .next = NULL,
+  .data = "false",
+  .constant = {0, CT_BOOL, 0},
 };
 
 Token true_token = {
   .kind = CONSTANT,
+  .code = PC_true,
+  .location = NO_LOCATION,
+  .length = 4,
   .data = "true",
-  .length = 5,
-  .span =
-    {
-      .start = {-1, -1},
-      .end = {-1, -1},
-    },
-  .next = NULL,
+  .constant = {1, CT_BOOL, 0},
 };
 
 void transform_translation_unit(struct translation_unit *unit);
@@ -49,7 +43,7 @@ void transform_token_specifier(struct specifier *specifier) {
 }
 
 void transform_id_specifier(struct specifier *specifier) {
-  transform_id(specifier->_id);
+  transform_id(id_at(specifier->_id));
 }
 
 void transform_specifier(struct specifier *specifier) {
@@ -66,8 +60,8 @@ void transform_specifier(struct specifier *specifier) {
 }
 
 void transform_specifier_list(struct specifier_list *list) {
-  for (struct specifier *cur = list->head; cur != NULL; cur = cur->next) {
-    transform_specifier(cur);
+  for (spec_ref cur = list->head; cur != NO_NODE; cur = spec_at(cur)->next) {
+    transform_specifier(spec_at(cur));
   }
 }
 
@@ -76,51 +70,52 @@ void transform_expression(struct expression *expr);
 void transform_declaration(struct declaration *decl);
 
 void transform_initialized_declarator(struct initialized_declarator *decl) {
-  transform_id(decl->declarator);
+  transform_id(id_at(decl->declarator));
 
   if (decl->initializer)
-    transform_expression(decl->initializer);
+    transform_expression(expr_at(decl->initializer));
 }
 
 void transform_init_declarator_list(struct init_declarator_list *list) {
   if (list == NULL)
     return;
 
-  for (struct initialized_declarator *cur = list->head; cur != NULL;
-       cur = cur->next) {
-    transform_initialized_declarator(cur);
+  for (init_decl_ref cur = list->head; cur != NO_NODE;
+       cur = init_decl_at(cur)->next) {
+    transform_initialized_declarator(init_decl_at(cur));
   }
 }
 
 void transform_declaration_list(struct declaration_list *list) {
-  struct declaration *cur = list->head;
-  struct declaration *next = NULL;
+  decl_ref cur = list->head;
+  decl_ref next = NO_NODE;
 
   while (cur) {
-    next = cur->next;
-    transform_declaration(cur);
+    next = decl_at(cur)->next;
+    transform_declaration(decl_at(cur));
     cur = next;
   }
 }
 
 void transform_variable_definition(struct declaration *decl) {
-  transform_specifier_list(decl->_var.specifiers);
-  transform_init_declarator_list(decl->_var.init_declarator_list);
+  transform_specifier_list(spec_list_at(decl->_var.specifiers));
+  transform_init_declarator_list(
+    init_decl_list_at(decl->_var.init_declarator_list));
 }
 
 void transform_function_definition(struct declaration *decl) {
-  transform_specifier_list(decl->_func.specifiers);
-  transform_id(decl->_func.name);
+  transform_specifier_list(spec_list_at(decl->_func.specifiers));
+  transform_id(id_at(decl->_func.name));
 
   if (decl->_func.parameters)
-    transform_declaration_list(decl->_func.parameters);
+    transform_declaration_list(decl_list_at(decl->_func.parameters));
 
-  transform_statement(decl->_func.body);
+  transform_statement(stmt_at(decl->_func.body));
 }
 
 void transform_type_definition(struct declaration *decl) {
-  transform_specifier_list(decl->_type_def.specifiers);
-  transform_id(decl->_type_def.name);
+  transform_specifier_list(spec_list_at(decl->_type_def.specifiers));
+  transform_id(id_at(decl->_type_def.name));
 }
 
 void transform_declaration(struct declaration *decl) {
@@ -145,87 +140,89 @@ void transform_statement_list(struct statement_list *list) {
   if (list == NULL)
     return;
 
-  for (struct statement *child = list->head; child != NULL;
-       child = child->next) {
-    transform_statement(child);
+  for (stmt_ref child = list->head; child != NO_NODE;
+       child = stmt_at(child)->next) {
+    transform_statement(stmt_at(child));
   }
 }
 
 void transform_compound_stmt(struct statement *stmt) {
-  transform_statement_list(stmt->_compound.statements);
+  transform_statement_list(stmt_list_at(stmt->_compound.statements));
 }
 
 void transform_continue_stmt(struct statement *stmt) { UNUSED(stmt); }
 
 void transform_decl_stmt(struct statement *stmt) {
-  transform_declaration(stmt->_decl);
+  transform_declaration(decl_at(stmt->_decl));
 }
 
 void transform_expr_stmt(struct statement *stmt) {
-  transform_expression(stmt->_expr);
+  transform_expression(expr_at(stmt->_expr));
 }
 
 void transform_for_stmt(struct statement *stmt) {
   if (stmt->_for.decl) {
-    transform_declaration(stmt->_for.decl);
+    transform_declaration(decl_at(stmt->_for.decl));
   }
 
   if (stmt->_for.preloop_expression) {
-    transform_expression(stmt->_for.preloop_expression);
+    transform_expression(expr_at(stmt->_for.preloop_expression));
   }
 
   if (stmt->_for.condition) {
-    transform_expression(stmt->_for.condition);
+    transform_expression(expr_at(stmt->_for.condition));
   }
 
   if (stmt->_for.step_expression) {
-    transform_expression(stmt->_for.step_expression);
+    transform_expression(expr_at(stmt->_for.step_expression));
   }
 
   if (stmt->_for.body) {
-    transform_statement(stmt->_for.body);
+    transform_statement(stmt_at(stmt->_for.body));
   }
 }
 
-void transform_goto_stmt(struct statement *stmt) { transform_id(stmt->_goto); }
+void transform_goto_stmt(struct statement *stmt) {
+  transform_id(id_at(stmt->_goto));
+}
 
 void transform_if_stmt(struct statement *stmt) {
   if (stmt->_if.condition) {
-    transform_expression(stmt->_if.condition);
+    transform_expression(expr_at(stmt->_if.condition));
   }
 
   if (stmt->_if.body) {
-    transform_statement(stmt->_if.body);
+    transform_statement(stmt_at(stmt->_if.body));
   }
 
   if (stmt->_if.else_body) {
-    transform_statement(stmt->_if.else_body);
+    transform_statement(stmt_at(stmt->_if.else_body));
   }
 }
 
 void transform_label_stmt(struct statement *stmt) {
-  transform_id(stmt->_label.name);
+  transform_id(id_at(stmt->_label.name));
 }
 
 void transform_return_stmt(struct statement *stmt) {
   if (stmt->_return.ret_expr) {
-    transform_expression(stmt->_return.ret_expr);
+    transform_expression(expr_at(stmt->_return.ret_expr));
   }
 }
 
 void transform_switch_stmt(struct statement *stmt) {
   if (stmt->_switch.condition) {
-    transform_expression(stmt->_switch.condition);
+    transform_expression(expr_at(stmt->_switch.condition));
   }
 
   if (stmt->_switch.body) {
-    transform_statement(stmt->_switch.body);
+    transform_statement(stmt_at(stmt->_switch.body));
   }
 }
 
 void transform_switch_label_stmt(struct statement *stmt) {
   if (stmt->_switch_label.test) {
-    transform_expression(stmt->_switch_label.test);
+    transform_expression(expr_at(stmt->_switch_label.test));
   }
 }
 
@@ -233,11 +230,11 @@ void transform_while_stmt(struct statement *stmt) {
   // stmt->_while.should_check_condition_first
 
   if (stmt->_while.condition) {
-    transform_expression(stmt->_while.condition);
+    transform_expression(expr_at(stmt->_while.condition));
   }
 
   if (stmt->_while.body) {
-    transform_statement(stmt->_while.body);
+    transform_statement(stmt_at(stmt->_while.body));
   }
 }
 
@@ -295,32 +292,32 @@ void transform_constant_expr(struct expression *expr) {
 }
 
 void transform_id_expression(struct expression *expr) {
-  transform_id(expr->_id);
+  transform_id(id_at(expr->_id));
 }
 
 void transform_index_expression(struct expression *expr) {
   if (expr->_index.object) {
-    transform_expression(expr->_index.object);
+    transform_expression(expr_at(expr->_index.object));
   }
 
   if (expr->_index.index) {
-    transform_expression(expr->_index.index);
+    transform_expression(expr_at(expr->_index.index));
   }
 }
 
 void transform_func_call(struct expression *expr) {
   if (expr->_call.function_ptr) {
-    transform_expression(expr->_call.function_ptr);
+    transform_expression(expr_at(expr->_call.function_ptr));
   }
 
   if (expr->_call.parameter_list) {
-    transform_expression_list(expr->_call.parameter_list);
+    transform_expression_list(expr_list_at(expr->_call.parameter_list));
   }
 }
 
 void transform_postfix_expr(struct expression *expr) {
   if (expr->_unary.base) {
-    transform_expression(expr->_unary.base);
+    transform_expression(expr_at(expr->_unary.base));
   }
 
   // expr->_unary.operator
@@ -330,30 +327,29 @@ void transform_unary_expr(struct expression *expr) {
   // expr->_unary.operator
 
   if (expr->_unary.base) {
-    transform_expression(expr->_unary.base);
+    transform_expression(expr_at(expr->_unary.base));
   }
 }
 
 void transform_cast_expr(struct expression *expr) {
   if (expr->_cast.type) {
-    transform_specifier_list(expr->_cast.type);
+    transform_specifier_list(spec_list_at(expr->_cast.type));
   }
 
   if (expr->_cast.base) {
-    transform_expression(expr->_cast.base);
+    transform_expression(expr_at(expr->_cast.base));
   }
 }
 
 void transform_ternary_expr(struct expression *expr);
 
 void short_circuit_binary_expr(struct expression *expr) {
-  bool is_and = strcmp(expr->_binary.operator->data, "&&") == 0;
+  bool is_and = token_at(expr->_binary.operator)->code == PU_LAND;
 
   struct expression ternary = {
     .type = TERNARY,
-    .reg = expr->reg,
-    .reg_count = expr->reg_count,
-    .next = NULL,
+    .id = expr->id,
+    .next = NO_NODE,
   };
 
   ternary._ternary.condition = expr->_binary.left;
@@ -362,41 +358,44 @@ void short_circuit_binary_expr(struct expression *expr) {
   ternary._ternary.false_branch =
     is_and ? create_const_expression(&false_token) : expr->_binary.right;
 
+  // The ternary has no operator to keep.
+  pool_release(&ast_nodes.tokens, expr->_binary.operator);
   memcpy(expr, &ternary, sizeof(struct expression));
 
   transform_ternary_expr(expr);
 }
 
 void transform_binary_expr(struct expression *expr) {
-  if (strcmp(expr->_binary.operator->data, "&&") == 0 ||
-      strcmp(expr->_binary.operator->data, "||") == 0) {
+  const Token *operator = token_at(expr->_binary.operator);
+
+  if (operator->code == PU_LAND || operator->code == PU_LOR) {
     // Short-circuit evaluation for logical operators
     short_circuit_binary_expr(expr);
     return;
   }
 
   if (expr->_binary.left) {
-    transform_expression(expr->_binary.left);
+    transform_expression(expr_at(expr->_binary.left));
   }
 
   // expr->_binary.operator
 
   if (expr->_binary.right) {
-    transform_expression(expr->_binary.right);
+    transform_expression(expr_at(expr->_binary.right));
   }
 }
 
 void transform_ternary_expr(struct expression *expr) {
   if (expr->_ternary.condition) {
-    transform_expression(expr->_ternary.condition);
+    transform_expression(expr_at(expr->_ternary.condition));
   }
 
   if (expr->_ternary.true_branch) {
-    transform_expression(expr->_ternary.true_branch);
+    transform_expression(expr_at(expr->_ternary.true_branch));
   }
 
   if (expr->_ternary.false_branch) {
-    transform_expression(expr->_ternary.false_branch);
+    transform_expression(expr_at(expr->_ternary.false_branch));
   }
 }
 
@@ -443,15 +442,15 @@ void transform_expression_list(struct expression_list *list) {
     return;
   }
 
-  struct expression *cur = list->head;
+  expr_ref cur = list->head;
 
-  if (cur == NULL) {
+  if (cur == NO_NODE) {
     return;
   }
 
-  while (cur != NULL) {
-    transform_expression(cur);
-    cur = cur->next;
+  while (cur != NO_NODE) {
+    transform_expression(expr_at(cur));
+    cur = expr_at(cur)->next;
   }
 }
 
@@ -1,113 +1,131 @@
 #include "tree.h"
+#include "arena.h"
+#include "common.h"
 #include "log.h"
-
-#define NEW(ty) allocate_or_error(sizeof(ty))
-
-struct allocation {
-  void *address;
-  struct allocation *next;
+#include "symbol.h"
+
+// The nodes of the tree, each kind packed in a pool of its own.
+_Thread_local struct node_pools ast_nodes = {
+  .ids = {.node_size = sizeof(struct id)},
+  .specifiers = {.node_size = sizeof(struct specifier)},
+  .specifier_lists = {.node_size = sizeof(struct specifier_list)},
+  .initialized_declarators = {.node_size =
+                                sizeof(struct initialized_declarator)},
+  .init_declarator_lists = {.node_size = sizeof(struct init_declarator_list)},
+  .declarations = {.node_size = sizeof(struct declaration)},
+  .declaration_lists = {.node_size = sizeof(struct declaration_list)},
+  .expressions = {.node_size = sizeof(struct expression)},
+  .expression_lists = {.node_size = sizeof(struct expression_list)},
+  .statements = {.node_size = sizeof(struct statement)},
+  .statement_lists = {.node_size = sizeof(struct statement_list)},
+  .tokens = {.node_size = sizeof(Token)},
 };
 
-struct allocation *allocation_list;
+// Translation units, and the scopes and symbols linking adds to the tree.
+_Thread_local Arena ast_arena;
 
-AST root = NULL;
+_Thread_local AST root = NULL;
 
-void *allocate_or_error(size_t size) {
-  void *result = malloc(size);
-  struct allocation *allocation = malloc(sizeof(struct allocation));
+void *allocate_node(size_t size) { return arena_allocate(&ast_arena, size); }
 
-  if (result == NULL || allocation == NULL) {
-    CRITICAL("ast", "Out of memory!");
-  }
+void release_node(void *node) { arena_release(&ast_arena, node); }
 
-  allocation->address = result;
-  allocation->next = allocation_list;
-  allocation_list = allocation;
+// Copies a token of an expression into the token pool.
+token_ref create_token(const Token *token) {
+  token_ref ref = pool_allocate(&ast_nodes.tokens);
 
-  return result;
+  *token_at(ref) = *token;
+
+  return ref;
 }
 
 // Creating functions
 
-struct id *create_id(Token *name) {
-  struct id *result = NEW(struct id);
+id_ref create_id(const Token *name) {
+  id_ref ref = pool_allocate(&ast_nodes.ids);
+  struct id *result = id_at(ref);
 
-  result->name = name;
+  result->name = *name;
 
-  return result;
+  return ref;
 }
 
-struct declaration *
-create_variable_declaration(struct specifier_list *specifiers,
-                            struct init_declarator_list *init_declarator_list) {
-  struct declaration *decl = NEW(struct declaration);
+decl_ref create_variable_declaration(spec_list_ref specifiers,
+                                     init_decl_list_ref init_declarator_list) {
+  decl_ref ref = pool_allocate(&ast_nodes.declarations);
+  struct declaration *decl = decl_at(ref);
 
   decl->type = VARIABLE;
   decl->_var.specifiers = specifiers;
   decl->_var.init_declarator_list = init_declarator_list;
-  decl->next = NULL;
+  decl->next = NO_NODE;
 
-  return decl;
+  return ref;
 }
 
-struct declaration *create_function(struct specifier_list *specifiers,
-                                    struct id *identifier,
-                                    struct declaration_list *parameters,
-                                    struct statement *body) {
-  struct declaration *decl = NEW(struct declaration);
+decl_ref create_function(spec_list_ref specifiers, id_ref identifier,
+                         decl_list_ref parameters, stmt_ref body) {
+  decl_ref ref = pool_allocate(&ast_nodes.declarations);
+  struct declaration *decl = decl_at(ref);
 
   decl->type = FUNCTION;
   decl->_func.specifiers = specifiers;
   decl->_func.name = identifier;
   decl->_func.parameters = parameters;
   decl->_func.body = body;
+  decl->_func.parameter_scope = NULL;
 
-  decl->next = NULL;
+  decl->next = NO_NODE;
 
-  return decl;
+  return ref;
 }
 
-struct declaration *create_type_definition(struct specifier_list *specifiers,
-                                           struct id *identifier) {
-  struct declaration *decl = NEW(struct declaration);
+decl_ref create_type_definition(spec_list_ref specifiers, id_ref identifier) {
+  decl_ref ref = pool_allocate(&ast_nodes.declarations);
+  struct declaration *decl = decl_at(ref);
 
   decl->type = TYPEDEF;
   decl->_type_def.specifiers = specifiers;
   decl->_type_def.name = identifier;
-  decl->next = NULL;
+  decl->next = NO_NODE;
 
-  return decl;
+  return ref;
 }
 
-struct declaration_list *create_declaration_list(struct declaration *first) {
-  struct declaration_list *list = NEW(struct declaration_list);
+decl_list_ref create_declaration_list(decl_ref first) {
+  decl_list_ref ref = pool_allocate(&ast_nodes.declaration_lists);
+  struct declaration_list *list = decl_list_at(ref);
 
   list->head = first;
   list->tail = first;
 
-  return list;
+  return ref;
 }
 
-struct declaration_list *append_declaration(struct declaration_list *list,
-                                            struct declaration *new_elem) {
-  if (list->head == NULL) {
+void append_to_declarations(struct declaration_list *list, decl_ref new_elem) {
+  if (list->head == NO_NODE) {
     list->head = new_elem;
   }
 
   if (list->tail) {
-    list->tail->next = new_elem;
+    decl_at(list->tail)->next = new_elem;
   }
 
   list->tail = new_elem;
+}
 
+decl_list_ref append_declaration(decl_list_ref list, decl_ref new_elem) {
+  append_to_declarations(decl_list_at(list), new_elem);
   return list;
 }
 
-struct translation_unit *create_translation_unit(struct declaration *first) {
-  struct translation_unit *unit = NEW(struct translation_unit);
+struct translation_unit *create_translation_unit(decl_ref first) {
+  struct translation_unit *unit =
+    allocate_node(sizeof(struct translation_unit));
 
   unit->external_declarations.head = first;
   unit->external_declarations.tail = first;
+  unit->global_scope = NULL;
 
   root = unit;
 
@@ -115,474 +133,443 @@ struct translation_unit *create_translation_unit(struct declaration *first) {
 }
 
 struct translation_unit *
-append_external_declaration(struct translation_unit *unit,
-                            struct declaration *new_elem) {
-  append_declaration(&unit->external_declarations, new_elem);
+append_external_declaration(struct translation_unit *unit, decl_ref new_elem) {
+  append_to_declarations(&unit->external_declarations, new_elem);
   return unit;
 }
 
-struct specifier *create_token_specifier(Token *token) {
-  struct specifier *spec = NEW(struct specifier);
+spec_ref create_token_specifier(const Token *token) {
+  spec_ref ref = pool_allocate(&ast_nodes.specifiers);
+  struct specifier *spec = spec_at(ref);
 
   spec->type = TOKEN;
-  spec->_token = token;
-  spec->next = NULL;
+  spec->_token = *token;
+  spec->next = NO_NODE;
 
-  return spec;
+  return ref;
 }
 
-struct specifier *create_id_specifier(struct id *id) {
-  struct specifier *spec = NEW(struct specifier);
+spec_ref create_id_specifier(id_ref id) {
+  spec_ref ref = pool_allocate(&ast_nodes.specifiers);
+  struct specifier *spec = spec_at(ref);
 
   spec->type = ID_SPEC;
   spec->_id = id;
-  spec->next = NULL;
+  spec->next = NO_NODE;
 
-  return spec;
+  return ref;
 }
 
-struct specifier_list *create_specifier_list(struct specifier *tail) {
-  struct specifier_list *list = NEW(struct specifier_list);
+spec_list_ref create_specifier_list(spec_ref tail) {
+  spec_list_ref ref = pool_allocate(&ast_nodes.specifier_lists);
+  struct specifier_list *list = spec_list_at(ref);
 
   list->head = tail;
 
-  return list;
+  return ref;
 }
 
-struct specifier_list *prepend_specifier(struct specifier *prefix,
-                                         struct specifier_list *list) {
-  prefix->next = list->head;
-  list->head = prefix;
+spec_list_ref prepend_specifier(spec_ref prefix, spec_list_ref list) {
+  spec_at(prefix)->next = spec_list_at(list)->head;
+  spec_list_at(list)->head = prefix;
   return list;
 }
 
-struct statement *create_break_stmt() {
-  struct statement *stmt = NEW(struct statement);
+// Makes a statement of the given type, for the create_*_stmt functions.
+static stmt_ref new_statement(enum statement_t type, struct statement **stmt) {
+  stmt_ref ref = pool_allocate(&ast_nodes.statements);
+
+  *stmt = stmt_at(ref);
+  (*stmt)->type = type;
+  (*stmt)->next = NO_NODE;
+
+  return ref;
+}
 
-  stmt->type = BREAK;
-  stmt->next = NULL;
+stmt_ref create_break_stmt() {
+  struct statement *stmt;
 
-  return stmt;
+  return new_statement(BREAK, &stmt);
 }
 
-struct statement *create_compound_stmt(struct statement_list *list) {
-  struct statement *stmt = NEW(struct statement);
+stmt_ref create_compound_stmt(stmt_list_ref list) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(COMPOUND, &stmt);
 
-  stmt->type = COMPOUND;
   stmt->_compound.statements = list;
   stmt->_compound.local_scope = NULL;
-  stmt->next = NULL;
 
-  return stmt;
+  return ref;
 }
 
-struct statement *create_continue_stmt() {
-  struct statement *stmt = NEW(struct statement);
-
-  stmt->type = CONTINUE;
-  stmt->next = NULL;
+stmt_ref create_continue_stmt() {
+  struct statement *stmt;
 
-  return stmt;
+  return new_statement(CONTINUE, &stmt);
 }
 
-struct statement *create_decl_stmt(struct declaration *decl) {
-  struct statement *stmt = NEW(struct statement);
+stmt_ref create_decl_stmt(decl_ref decl) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(DECL, &stmt);
 
-  stmt->type = DECL;
   stmt->_decl = decl;
-  stmt->next = NULL;
 
-  return stmt;
+  return ref;
 }
 
-struct statement *create_expr_stmt(struct expression *expr) {
-  struct statement *stmt = NEW(struct statement);
+stmt_ref create_expr_stmt(expr_ref expr) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(EXPR, &stmt);
 
-  stmt->type = EXPR;
   stmt->_expr = expr;
-  stmt->next = NULL;
 
-  return stmt;
+  return ref;
 }
 
-struct statement *create_for_stmt_with_decl(struct declaration *decl,
-                                            struct expression *condition,
-                                            struct expression *step_expression,
-                                            struct statement *body) {
-  struct statement *stmt = NEW(struct statement);
-
-  stmt->type = FOR;
+stmt_ref create_for_stmt_with_decl(decl_ref decl, expr_ref condition,
+                                   expr_ref step_expression, stmt_ref body) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(FOR, &stmt);
 
-  stmt->_for.is_initializer_decl = decl != NULL;
+  stmt->_for.is_initializer_decl = decl != NO_NODE;
   stmt->_for.decl = decl;
-  stmt->_for.preloop_expression = NULL;
+  stmt->_for.preloop_expression = NO_NODE;
   stmt->_for.condition = condition;
   stmt->_for.step_expression = step_expression;
   stmt->_for.body = body;
 
-  stmt->next = NULL;
-
-  return stmt;
+  return ref;
 }
 
-struct statement *create_for_stmt_with_expr(struct expression *init,
-                                            struct expression *condition,
-                                            struct expression *step_expression,
-                                            struct statement *body) {
-  struct statement *stmt = NEW(struct statement);
-
-  stmt->type = FOR;
+stmt_ref create_for_stmt_with_expr(expr_ref init, expr_ref condition,
+                                   expr_ref step_expression, stmt_ref body) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(FOR, &stmt);
 
   stmt->_for.is_initializer_decl = false;
-  stmt->_for.decl = NULL;
+  stmt->_for.decl = NO_NODE;
   stmt->_for.preloop_expression = init;
   stmt->_for.condition = condition;
   stmt->_for.step_expression = step_expression;
   stmt->_for.body = body;
 
-  stmt->next = NULL;
-
-  return stmt;
+  return ref;
 }
 
-struct statement *create_goto_stmt(struct id *label) {
-  struct statement *stmt = NEW(struct statement);
+stmt_ref create_goto_stmt(id_ref label) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(GOTO, &stmt);
 
-  stmt->type = GOTO;
   stmt->_goto = label;
-  stmt->next = NULL;
 
-  return stmt;
+  return ref;
 }
 
-struct statement *create_if_stmt(struct expression *condition,
-                                 struct statement *body,
-                                 struct statement *else_body) {
-  struct statement *stmt = NEW(struct statement);
+stmt_ref create_if_stmt(expr_ref condition, stmt_ref body, stmt_ref else_body) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(IF, &stmt);
 
-  stmt->type = IF;
   stmt->_if.condition = condition;
   stmt->_if.body = body;
   stmt->_if.else_body = else_body;
-  stmt->next = NULL;
 
-  return stmt;
+  return ref;
 }
 
-struct statement *create_label_stmt(struct id *name) {
-  struct statement *stmt = NEW(struct statement);
+stmt_ref create_label_stmt(id_ref name) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(LABEL, &stmt);
 
-  stmt->type = LABEL;
   stmt->_label.name = name;
-  stmt->next = NULL;
 
-  return stmt;
+  return ref;
 }
 
-struct statement *create_return_stmt(struct expression *expr) {
-  struct statement *stmt = NEW(struct statement);
+stmt_ref create_return_stmt(expr_ref expr) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(RETURN, &stmt);
 
-  stmt->type = RETURN;
   stmt->_return.ret_expr = expr;
-  stmt->next = NULL;
 
-  return stmt;
+  return ref;
 }
 
-struct statement *create_switch_stmt(struct expression *condition,
-                                     struct statement *body) {
-  struct statement *stmt = NEW(struct statement);
+stmt_ref create_switch_stmt(expr_ref condition, stmt_ref body) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(SWITCH, &stmt);
 
-  stmt->type = SWITCH;
   stmt->_switch.condition = condition;
   stmt->_switch.body = body;
-  stmt->next = NULL;
 
-  return stmt;
+  return ref;
 }
 
-struct statement *create_case_stmt(struct expression *test) {
-  struct statement *stmt = NEW(struct statement);
+stmt_ref create_case_stmt(expr_ref test) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(SWITCH_LABEL, &stmt);
 
-  stmt->type = SWITCH_LABEL;
   stmt->_switch_label.test = test;
-  stmt->next = NULL;
 
-  return stmt;
+  return ref;
 }
 
-struct statement *create_default_stmt() {
-  struct statement *stmt = NEW(struct statement);
+stmt_ref create_default_stmt() {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(SWITCH_LABEL, &stmt);
 
-  stmt->type = SWITCH_LABEL;
-  stmt->_switch_label.test = NULL;
-  stmt->next = NULL;
+  stmt->_switch_label.test = NO_NODE;
 
-  return stmt;
+  return ref;
 }
 
-struct statement *create_do_while_stmt(struct statement *body,
-                                       struct expression *condition) {
-  struct statement *stmt = NEW(struct statement);
+stmt_ref create_do_while_stmt(stmt_ref body, expr_ref condition) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(WHILE, &stmt);
 
-  stmt->type = WHILE;
   stmt->_while.should_check_condition_first = false;
   stmt->_while.condition = condition;
   stmt->_while.body = body;
-  stmt->next = NULL;
 
-  return stmt;
+  return ref;
 }
 
-struct statement *create_while_stmt(struct expression *condition,
-                                    struct statement *body) {
-  struct statement *stmt = NEW(struct statement);
+stmt_ref create_while_stmt(expr_ref condition, stmt_ref body) {
+  struct statement *stmt;
+  stmt_ref ref = new_statement(WHILE, &stmt);
 
-  stmt->type = WHILE;
   stmt->_while.should_check_condition_first = true;
   stmt->_while.condition = condition;
   stmt->_while.body = body;
-  stmt->next = NULL;
 
-  return stmt;
+  return ref;
 }
 
-struct statement_list *create_stmt_list(struct statement *first) {
-  struct statement_list *list = NEW(struct statement_list);
+stmt_list_ref create_stmt_list(stmt_ref first) {
+  stmt_list_ref ref = pool_allocate(&ast_nodes.statement_lists);
+  struct statement_list *list = stmt_list_at(ref);
 
   list->head = first;
   list->tail = first;
 
-  return list;
+  return ref;
 }
 
-struct statement_list *prepend_stmt(struct statement *new_stmt,
-                                    struct statement_list *list) {
-  new_stmt->next = list->head;
+stmt_list_ref prepend_stmt(stmt_ref new_stmt, stmt_list_ref list_ref) {
+  struct statement_list *list = stmt_list_at(list_ref);
+
+  stmt_at(new_stmt)->next = list->head;
   list->head = new_stmt;
 
-  if (list->tail == NULL)
+  if (list->tail == NO_NODE)
     list->tail = new_stmt;
 
-  return list;
+  return list_ref;
 }
 
-struct statement_list *append_stmt(struct statement_list *list,
-                                   struct statement *new_stmt) {
-  if (list->head == NULL) {
+stmt_list_ref append_stmt(stmt_list_ref list_ref, stmt_ref new_stmt) {
+  struct statement_list *list = stmt_list_at(list_ref);
+
+  if (list->head == NO_NODE) {
     list->head = new_stmt;
   }
 
   if (list->tail) {
-    list->tail->next = new_stmt;
+    stmt_at(list->tail)->next = new_stmt;
   }
 
   list->tail = new_stmt;
 
-  return list;
+  return list_ref;
 }
 
-struct expression *create_id_expression(struct id *id) {
-  struct expression *expr = NEW(struct expression);
+// Makes an expression whose id is its index, see get_expression_count().
+static expr_ref new_expression(enum expression_t type,
+                               struct expression **expr) {
+  expr_ref ref = pool_allocate(&ast_nodes.expressions);
 
-  expr->type = ID_EXPR;
-  expr->_id = id;
-  expr->next = NULL;
+  *expr = expr_at(ref);
+  (*expr)->type = type;
+  (*expr)->id = ref;
+  (*expr)->next = NO_NODE;
 
-  return expr;
+  return ref;
 }
 
-struct expression *create_const_expression(Token *constant) {
-  struct expression *expr = NEW(struct expression);
+expr_ref create_id_expression(id_ref id) {
+  struct expression *expr;
+  expr_ref ref = new_expression(ID_EXPR, &expr);
 
-  expr->type = CONST_EXPR;
-  expr->_constant = constant;
-  expr->next = NULL;
+  expr->_id = id;
 
-  return expr;
+  return ref;
 }
 
-struct expression *create_dot_index_expression(struct expression *obj,
-                                               struct expression *index) {
-  struct expression *expr = NEW(struct expression);
+expr_ref create_const_expression(const Token *constant) {
+  struct expression *expr;
+  expr_ref ref = new_expression(CONST_EXPR, &expr);
 
-  expr->type = INDEX;
-  expr->_index.type = DOT;
-  expr->_index.object = obj;
-  expr->_index.index = index;
-  expr->next = NULL;
+  expr->_constant = create_token(constant);
 
-  return expr;
+  return ref;
 }
 
-struct expression *create_arrow_index_expression(struct expression *obj,
-                                                 struct expression *index) {
-  struct expression *expr = NEW(struct expression);
+// Makes an expression of one of the index types.
+static expr_ref create_index_expression(enum index_t type, expr_ref obj,
+                                        expr_ref index) {
+  struct expression *expr;
+  expr_ref ref = new_expression(INDEX, &expr);
 
-  expr->type = INDEX;
-  expr->_index.type = ARROW;
+  expr->_index.type = type;
   expr->_index.object = obj;
   expr->_index.index = index;
-  expr->next = NULL;
 
-  return expr;
+  return ref;
 }
 
-struct expression *create_array_index_expression(struct expression *obj,
-                                                 struct expression *index) {
-  struct expression *expr = NEW(struct expression);
+expr_ref create_dot_index_expression(expr_ref obj, expr_ref index) {
+  return create_index_expression(DOT, obj, index);
+}
 
-  expr->type = INDEX;
-  expr->_index.type = ARRAY;
-  expr->_index.object = obj;
-  expr->_index.index = index;
-  expr->next = NULL;
+expr_ref create_arrow_index_expression(expr_ref obj, expr_ref index) {
+  return create_index_expression(ARROW, obj, index);
+}
 
-  return expr;
+expr_ref create_array_index_expression(expr_ref obj, expr_ref index) {
+  return create_index_expression(ARRAY, obj, index);
 }
 
-struct expression *
-create_call_expression(struct expression *function_ptr,
-                       struct expression_list *parameter_list) {
-  struct expression *expr = NEW(struct expression);
+expr_ref create_call_expression(expr_ref function_ptr,
+                                expr_list_ref parameter_list) {
+  struct expression *expr;
+  expr_ref ref = new_expression(FUNC_CALL, &expr);
 
-  expr->type = FUNC_CALL;
   expr->_call.function_ptr = function_ptr;
   expr->_call.parameter_list = parameter_list;
-  expr->next = NULL;
 
-  return expr;
+  return ref;
 }
 
-struct expression *create_postfix_expression(struct expression *base,
-                                             Token *operator) {
-  struct expression *expr = NEW(struct expression);
+expr_ref create_postfix_expression(expr_ref base, const Token *operator) {
+  struct expression *expr;
+  expr_ref ref = new_expression(POSTFIX, &expr);
 
-  expr->type = POSTFIX;
   expr->_unary.base = base;
-  expr->_unary.operator = operator;
-  expr->next = NULL;
+  expr->_unary.operator = create_token(operator);
 
-  return expr;
+  return ref;
 }
 
-struct expression *create_unary_expression(Token *operator,
-                                           struct expression *base) {
-  struct expression *expr = NEW(struct expression);
+expr_ref create_unary_expression(const Token *operator, expr_ref base) {
+  struct expression *expr;
+  expr_ref ref = new_expression(UNARY, &expr);
 
-  expr->type = UNARY;
   expr->_unary.base = base;
-  expr->_unary.operator = operator;
-  expr->next = NULL;
+  expr->_unary.operator = create_token(operator);
 
-  return expr;
+  return ref;
 }
 
-struct expression *create_cast_expression(struct specifier_list *type,
-                                          struct expression *base) {
-  struct expression *expr = NEW(struct expression);
+expr_ref create_cast_expression(spec_list_ref type, expr_ref base) {
+  struct expression *expr;
+  expr_ref ref = new_expression(CAST, &expr);
 
-  expr->type = CAST;
   expr->_cast.type = type;
   expr->_cast.base = base;
-  expr->next = NULL;
 
-  return expr;
+  return ref;
 }
 
-struct expression *create_binary_expression(struct expression *left,
-                                            Token *operator,
-                                            struct expression *right) {
-  struct expression *expr = NEW(struct expression);
+expr_ref create_binary_expression(expr_ref left, const Token *operator,
+                                  expr_ref right) {
+  struct expression *expr;
+  expr_ref ref = new_expression(BINARY, &expr);
 
-  expr->type = BINARY;
-  expr->_binary.operator = operator;
+  expr->_binary.operator = create_token(operator);
   expr->_binary.left = left;
   expr->_binary.right = right;
-  expr->next = NULL;
 
-  return expr;
+  return ref;
 }
 
-struct expression *create_ternary_expression(struct expression *condition,
-                                             struct expression *true_branch,
-                                             struct expression *false_branch) {
-  struct expression *expr = NEW(struct expression);
+expr_ref create_ternary_expression(expr_ref condition, expr_ref true_branch,
+                                   expr_ref false_branch) {
+  struct expression *expr;
+  expr_ref ref = new_expression(TERNARY, &expr);
 
-  expr->type = TERNARY;
   expr->_ternary.condition = condition;
   expr->_ternary.true_branch = true_branch;
   expr->_ternary.false_branch = false_branch;
-  expr->next = NULL;
 
-  return expr;
+  return ref;
 }
 
-struct expression_list *create_expr_list(struct expression *first_elem) {
-  struct expression_list *list = NEW(struct expression_list);
+expr_list_ref create_expr_list(expr_ref first_elem) {
+  expr_list_ref ref = pool_allocate(&ast_nodes.expression_lists);
+  struct expression_list *list = expr_list_at(ref);
 
   list->head = first_elem;
   list->tail = first_elem;
 
-  return list;
+  return ref;
 }
 
-struct expression_list *append_expr(struct expression_list *list,
-                                    struct expression *expr) {
-  if (list->head == NULL)
+expr_list_ref append_expr(expr_list_ref list_ref, expr_ref expr) {
+  struct expression_list *list = expr_list_at(list_ref);
+
+  if (list->head == NO_NODE)
     list->head = expr;
 
   if (list->tail)
-    list->tail->next = expr;
+    expr_at(list->tail)->next = expr;
 
   list->tail = expr;
 
-  return list;
+  return list_ref;
 }
 
-struct initialized_declarator *
-create_initialized_declarator(struct id *declarator,
-                              struct expression *initializer) {
-  struct initialized_declarator *decl = NEW(struct initialized_declarator);
+init_decl_ref create_initialized_declarator(id_ref declarator,
+                                            expr_ref initializer) {
+  init_decl_ref ref = pool_allocate(&ast_nodes.initialized_declarators);
+  struct initialized_declarator *decl = init_decl_at(ref);
 
   decl->declarator = declarator;
   decl->initializer = initializer;
-  decl->next = NULL;
+  decl->next = NO_NODE;
 
-  return decl;
+  return ref;
 }
 
-struct init_declarator_list *
-create_init_declarator_list(struct initialized_declarator *first_elem) {
-  struct init_declarator_list *list = NEW(struct init_declarator_list);
+init_decl_list_ref create_init_declarator_list(init_decl_ref first_elem) {
+  init_decl_list_ref ref = pool_allocate(&ast_nodes.init_declarator_lists);
+  struct init_declarator_list *list = init_decl_list_at(ref);
 
   list->head = first_elem;
   list->tail = first_elem;
 
-  return list;
+  return ref;
 }
 
-struct init_declarator_list *
-append_initialized_declarator(struct init_declarator_list *list,
-                              struct initialized_declarator *new_elem) {
-  if (list->head == NULL)
+init_decl_list_ref append_initialized_declarator(init_decl_list_ref list_ref,
+                                                 init_decl_ref new_elem) {
+  struct init_declarator_list *list = init_decl_list_at(list_ref);
+
+  if (list->head == NO_NODE)
     list->head = new_elem;
 
   if (list->tail)
-    list->tail->next = new_elem;
+    init_decl_at(list->tail)->next = new_elem;
 
   list->tail = new_elem;
-  return list;
+  return list_ref;
 }
 
 // Destroying functions
 
-void destroy_id(struct id *id) {
-  if (id)
-    free(id);
-}
+void destroy_id(id_ref id) { pool_release(&ast_nodes.ids, id); }
+
+void destroy_specifier(spec_ref ref) {
+  struct specifier *specifier = spec_at(ref);
 
-void destroy_specifier(struct specifier *specifier) {
   switch (specifier->type) {
   case TOKEN: /* Do nothing */
     break;
@@ -591,62 +578,63 @@ void destroy_specifier(struct specifier *specifier) {
     break;
   }
 
-  free(specifier);
+  pool_release(&ast_nodes.specifiers, ref);
 }
 
-void destroy_specifiers(struct specifier_list *list) {
-  struct specifier *cur = list->head;
-  struct specifier *next = NULL;
+void destroy_specifiers(spec_list_ref list) {
+  spec_ref cur = spec_list_at(list)->head;
+  spec_ref next = NO_NODE;
 
   while (cur) {
-    next = cur->next;
+    next = spec_at(cur)->next;
     destroy_specifier(cur);
     cur = next;
   }
 
-  free(list);
+  pool_release(&ast_nodes.specifier_lists, list);
 }
 
-void destroy_statement(struct statement *stmt);
-void destroy_expression(struct expression *expr);
-void destroy_declaration(struct declaration *decl);
+void destroy_statement(stmt_ref stmt);
+void destroy_expression(expr_ref expr);
+
+void destroy_initialized_declarator(init_decl_ref ref) {
+  struct initialized_declarator *decl = init_decl_at(ref);
 
-void destroy_initialized_declarator(struct initialized_declarator *decl) {
   destroy_id(decl->declarator);
 
   if (decl->initializer)
     destroy_expression(decl->initializer);
 
-  free(decl);
+  pool_release(&ast_nodes.initialized_declarators, ref);
 }
 
-void destroy_init_declarator_list(struct init_declarator_list *list) {
-  if (list == NULL)
+void destroy_init_declarator_list(init_decl_list_ref list) {
+  if (list == NO_NODE)
     return;
 
-  struct initialized_declarator *cur = list->head;
-  struct initialized_declarator *next = NULL;
+  init_decl_ref cur = init_decl_list_at(list)->head;
+  init_decl_ref next = NO_NODE;
 
   while (cur) {
-    next = cur->next;
+    next = init_decl_at(cur)->next;
     destroy_initialized_declarator(cur);
     cur = next;
   }
 
-  free(list);
+  pool_release(&ast_nodes.init_declarator_lists, list);
 }
 
-void destroy_declaration_list(struct declaration_list *list) {
-  struct declaration *cur = list->head;
-  struct declaration *next = NULL;
+void destroy_declaration_list(decl_list_ref list) {
+  decl_ref cur = decl_list_at(list)->head;
+  decl_ref next = NO_NODE;
 
   while (cur) {
-    next = cur->next;
+    next = decl_at(cur)->next;
     destroy_declaration(cur);
     cur = next;
   }
 
-  free(list);
+  pool_release(&ast_nodes.declaration_lists, list);
 }
 
 void destroy_variable_definition(struct declaration *decl) {
@@ -674,7 +662,9 @@ void destroy_type_definition(struct declaration *decl) {
   destroy_id(decl->_type_def.name);
 }
 
-void destroy_declaration(struct declaration *decl) {
+void destroy_declaration(decl_ref ref) {
+  struct declaration *decl = decl_at(ref);
+
   switch (decl->type) {
   case VARIABLE:
     destroy_variable_definition(decl);
@@ -689,46 +679,28 @@ void destroy_declaration(struct declaration *decl) {
     CRITICAL("ast", "Unknown declaration type");
   }
 
-  free(decl);
+  pool_release(&ast_nodes.declarations, ref);
 }
 
-void destroy_break_stmt(struct statement *stmt) { free(stmt); }
-
-void destroy_statement_list(struct statement_list *list) {
-  if (list == NULL)
+void destroy_statement_list(stmt_list_ref list) {
+  if (list == NO_NODE)
     return;
 
-  struct statement *cur = list->head;
-  struct statement *next = NULL;
+  stmt_ref cur = stmt_list_at(list)->head;
+  stmt_ref next = NO_NODE;
 
-  while (cur != NULL) {
-    next = cur->next;
+  while (cur != NO_NODE) {
+    next = stmt_at(cur)->next;
     destroy_statement(cur);
     cur = next;
   }
 
-  free(list);
+  pool_release(&ast_nodes.statement_lists, list);
 }
 
 void destroy_compound_stmt(struct statement *stmt) {
   destroy_statement_list(stmt->_compound.statements);
   destroy_scope(stmt->_compound.local_scope);
-  free(stmt);
-}
-
-void destroy_continue_stmt(struct statement *stmt) { free(stmt); }
-
-void destroy_decl_stmt(struct statement *stmt) {
-  destroy_declaration(stmt->_decl);
-  free(stmt);
-}
-
-void destroy_expr_stmt(struct statement *stmt) {
-  if (stmt->_expr) {
-    destroy_expression(stmt->_expr);
-  }
-
-  free(stmt);
 }
 
 void destroy_for_stmt(struct statement *stmt) {
@@ -751,13 +723,6 @@ void destroy_for_stmt(struct statement *stmt) {
   if (stmt->_for.body) {
     destroy_statement(stmt->_for.body);
   }
-
-  free(stmt);
-}
-
-void destroy_goto_stmt(struct statement *stmt) {
-  destroy_id(stmt->_goto);
-  free(stmt);
 }
 
 void destroy_if_stmt(struct statement *stmt) {
@@ -772,21 +737,6 @@ void destroy_if_stmt(struct statement *stmt) {
   if (stmt->_if.else_body) {
     destroy_statement(stmt->_if.else_body);
   }
-
-  free(stmt);
-}
-
-void destroy_label_stmt(struct statement *stmt) {
-  destroy_id(stmt->_label.name);
-  free(stmt);
-}
-
-void destroy_return_stmt(struct statement *stmt) {
-  if (stmt->_return.ret_expr) {
-    destroy_expression(stmt->_return.ret_expr);
-  }
-
-  free(stmt);
 }
 
 void destroy_switch_stmt(struct statement *stmt) {
@@ -797,16 +747,6 @@ void destroy_switch_stmt(struct statement *stmt) {
   if (stmt->_switch.body) {
     destroy_statement(stmt->_switch.body);
   }
-
-  free(stmt);
-}
-
-void destroy_switch_label_stmt(struct statement *stmt) {
-  if (stmt->_switch_label.test) {
-    destroy_expression(stmt->_switch_label.test);
-  }
-
-  free(stmt);
 }
 
 void destroy_while_stmt(struct statement *stmt) {
@@ -817,251 +757,172 @@ void destroy_while_stmt(struct statement *stmt) {
   if (stmt->_while.body) {
     destroy_statement(stmt->_while.body);
   }
-
-  free(stmt);
 }
 
-void destroy_statement(struct statement *stmt) {
+void destroy_statement(stmt_ref ref) {
+  struct statement *stmt = stmt_at(ref);
+
   switch (stmt->type) {
   case BREAK:
-    destroy_break_stmt(stmt);
     break;
   case COMPOUND:
     destroy_compound_stmt(stmt);
     break;
   case CONTINUE:
-    destroy_continue_stmt(stmt);
     break;
   case DECL:
-    destroy_decl_stmt(stmt);
+    destroy_declaration(stmt->_decl);
     break;
   case EXPR:
-    destroy_expr_stmt(stmt);
+    destroy_expression(stmt->_expr);
     break;
   case FOR:
     destroy_for_stmt(stmt);
     break;
   case GOTO:
-    destroy_goto_stmt(stmt);
+    destroy_id(stmt->_goto);
     break;
   case IF:
     destroy_if_stmt(stmt);
     break;
   case LABEL:
-    destroy_label_stmt(stmt);
+    destroy_id(stmt->_label.name);
     break;
   case RETURN:
-    destroy_return_stmt(stmt);
+    destroy_expression(stmt->_return.ret_expr);
     break;
   case SWITCH:
     destroy_switch_stmt(stmt);
     break;
   case SWITCH_LABEL:
-    destroy_switch_label_stmt(stmt);
+    destroy_expression(stmt->_switch_label.test);
     break;
   case WHILE:
     destroy_while_stmt(stmt);
     break;
   }
+
+  pool_release(&ast_nodes.statements, ref);
 }
 
-void destroy_expr_list(struct expression_list *list) {
-  struct expression *cur = list->head;
-  struct expression *next = NULL;
+void destroy_expr_list(expr_list_ref list) {
+  expr_ref cur = expr_list_at(list)->head;
+  expr_ref next = NO_NODE;
 
   while (cur) {
-    next = cur->next;
+    next = expr_at(cur)->next;
     destroy_expression(cur);
     cur = next;
   }
 
-  free(list);
-}
-
-void destroy_id_expression(struct expression *expr) {
-  destroy_id(expr->_id);
-  free(expr);
+  pool_release(&ast_nodes.expression_lists, list);
 }
 
-void destroy_const_expression(struct expression *expr) { free(expr); }
+void destroy_expression(expr_ref ref) {
+  struct expression *expr = expr_at(ref);
 
-void destroy_index_expression(struct expression *expr) {
-  destroy_expression(expr->_index.object);
-  destroy_expression(expr->_index.index);
-  free(expr);
-}
-
-void destroy_call_expression(struct expression *expr) {
-  destroy_expression(expr->_call.function_ptr);
-  destroy_expr_list(expr->_call.parameter_list);
-  free(expr);
-}
-
-void destroy_unary_expression(struct expression *expr) {
-  destroy_expression(expr->_unary.base);
-  free(expr);
-}
-
-void destroy_cast_expression(struct expression *expr) {
-  destroy_specifiers(expr->_cast.type);
-  destroy_expression(expr->_cast.base);
-  free(expr);
-}
-
-void destroy_binary_expression(struct expression *expr) {
-  destroy_expression(expr->_binary.left);
-  destroy_expression(expr->_binary.right);
-  free(expr);
-}
-
-void destroy_ternary_expression(struct expression *expr) {
-  destroy_expression(expr->_ternary.condition);
-  destroy_expression(expr->_ternary.true_branch);
-  destroy_expression(expr->_ternary.false_branch);
-  free(expr);
-}
+  if (expr == NULL)
+    return;
 
-void destroy_expression(struct expression *expr) {
   switch (expr->type) {
   case ID_EXPR:
-    destroy_id_expression(expr);
+    destroy_id(expr->_id);
     break;
   case CONST_EXPR:
-    destroy_const_expression(expr);
+    pool_release(&ast_nodes.tokens, expr->_constant);
     break;
   case INDEX:
-    destroy_index_expression(expr);
+    destroy_expression(expr->_index.object);
+    destroy_expression(expr->_index.index);
     break;
   case FUNC_CALL:
-    destroy_call_expression(expr);
+    destroy_expression(expr->_call.function_ptr);
+    destroy_expr_list(expr->_call.parameter_list);
     break;
   case POSTFIX:
-    destroy_unary_expression(expr);
-    break;
   case UNARY:
-    destroy_unary_expression(expr);
+    pool_release(&ast_nodes.tokens, expr->_unary.operator);
+    destroy_expression(expr->_unary.base);
     break;
   case CAST:
-    destroy_cast_expression(expr);
+    destroy_specifiers(expr->_cast.type);
+    destroy_expression(expr->_cast.base);
     break;
   case BINARY:
-    destroy_binary_expression(expr);
+    pool_release(&ast_nodes.tokens, expr->_binary.operator);
+    destroy_expression(expr->_binary.left);
+    destroy_expression(expr->_binary.right);
     break;
   case TERNARY:
-    destroy_ternary_expression(expr);
+    destroy_expression(expr->_ternary.condition);
+    destroy_expression(expr->_ternary.true_branch);
+    destroy_expression(expr->_ternary.false_branch);
     break;
   }
-}
 
-void destroy_translation_unit(struct translation_unit *unit) {
-  struct declaration *cur = unit->external_declarations.head;
-  struct declaration *next = NULL;
+  pool_release(&ast_nodes.expressions, ref);
+}
 
-  while (cur) {
-    next = cur->next;
-    destroy_declaration(cur);
-    cur = next;
-  }
+// Sense allocations, so sweeping the pools and the arena keeps them
 
-  destroy_scope(unit->global_scope);
-  free(unit);
+void sense_allocation(const void *address) {
+  arena_mark(&ast_arena, address);
 }
 
-// Sense allocations
-void delete_allocation_entry(void *address) {
-  struct allocation *prev = NULL;
-  for (struct allocation *cur = allocation_list; cur != NULL; cur = cur->next) {
-    if (cur->address != address) {
-      prev = cur;
-      continue;
-    }
-
-    if (prev) {
-      prev->next = cur->next;
-    } else {
-      allocation_list = cur->next;
-    }
+void sense_scope(struct scope *scope) {
+  if (scope == NULL)
+    return;
 
-    free(cur);
-    break;
+  for (struct symbol *cur = scope->symbols; cur != NULL; cur = cur->next) {
+    sense_allocation(cur);
   }
-}
 
-void sense_id(struct id *id) {
-  if (id)
-    delete_allocation_entry(id);
+  sense_allocation(scope);
 }
 
-void sense_specifier(struct specifier *specifier) {
-  switch (specifier->type) {
-  case TOKEN: /* Do nothing */
-    break;
-  case ID_SPEC:
-    sense_id(specifier->_id);
-    break;
-  }
+void sense_id(id_ref id) { pool_mark(&ast_nodes.ids, id); }
 
-  delete_allocation_entry(specifier);
-}
+void sense_specifiers(spec_list_ref list) {
+  for (spec_ref cur = spec_list_at(list)->head; cur != NO_NODE;
+       cur = spec_at(cur)->next) {
+    struct specifier *specifier = spec_at(cur);
 
-void sense_specifiers(struct specifier_list *list) {
-  struct specifier *cur = list->head;
-  struct specifier *next = NULL;
+    if (specifier->type == ID_SPEC)
+      sense_id(specifier->_id);
 
-  while (cur) {
-    next = cur->next;
-    sense_specifier(cur);
-    cur = next;
+    pool_mark(&ast_nodes.specifiers, cur);
   }
 
-  delete_allocation_entry(list);
+  pool_mark(&ast_nodes.specifier_lists, list);
 }
 
-void sense_statement(struct statement *stmt);
-void sense_expression(struct expression *expr);
-void sense_declaration(struct declaration *expr);
-
-void sense_initialized_declarator(struct initialized_declarator *decl) {
-  sense_id(decl->declarator);
-
-  if (decl->initializer)
-    sense_expression(decl->initializer);
-
-  delete_allocation_entry(decl);
-}
+void sense_statement(stmt_ref stmt);
+void sense_expression(expr_ref expr);
+void sense_declaration(decl_ref decl);
 
-void sense_init_declarator_list(struct init_declarator_list *list) {
-  if (list == NULL)
+void sense_init_declarator_list(init_decl_list_ref list) {
+  if (list == NO_NODE)
     return;
 
-  struct initialized_declarator *cur = list->head;
-  struct initialized_declarator *next = NULL;
+  for (init_decl_ref cur = init_decl_list_at(list)->head; cur != NO_NODE;
+       cur = init_decl_at(cur)->next) {
+    struct initialized_declarator *decl = init_decl_at(cur);
 
-  while (cur) {
-    next = cur->next;
-    sense_initialized_declarator(cur);
-    cur = next;
+    sense_id(decl->declarator);
+    sense_expression(decl->initializer);
+    pool_mark(&ast_nodes.initialized_declarators, cur);
   }
 
-  delete_allocation_entry(list);
+  pool_mark(&ast_nodes.init_declarator_lists, list);
 }
 
-void sense_declaration_list(struct declaration_list *list) {
-  struct declaration *cur = list->head;
-  struct declaration *next = NULL;
-
-  while (cur) {
-    next = cur->next;
+void sense_declaration_list(decl_list_ref list) {
+  for (decl_ref cur = decl_list_at(list)->head; cur != NO_NODE;
+       cur = decl_at(cur)->next) {
     sense_declaration(cur);
-    cur = next;
   }
 
-  delete_allocation_entry(list);
-}
-
-void sense_variable_definition(struct declaration *decl) {
-  sense_specifiers(decl->_var.specifiers);
-  sense_init_declarator_list(decl->_var.init_declarator_list);
+  pool_mark(&ast_nodes.declaration_lists, list);
 }
 
 void sense_function_definition(struct declaration *decl) {
@@ -1072,77 +933,59 @@ void sense_function_definition(struct declaration *decl) {
     sense_declaration_list(decl->_func.parameters);
 
   sense_statement(decl->_func.body);
+  sense_scope(decl->_func.parameter_scope);
 }
 
-void sense_type_definition(struct declaration *decl) {
-  sense_specifiers(decl->_type_def.specifiers);
-  sense_id(decl->_type_def.name);
-}
+void sense_declaration(decl_ref ref) {
+  struct declaration *decl = decl_at(ref);
 
-void sense_declaration(struct declaration *decl) {
   switch (decl->type) {
   case VARIABLE:
-    sense_variable_definition(decl);
+    sense_specifiers(decl->_var.specifiers);
+    sense_init_declarator_list(decl->_var.init_declarator_list);
     break;
   case FUNCTION:
     sense_function_definition(decl);
     break;
   case TYPEDEF:
-    sense_type_definition(decl);
+    sense_specifiers(decl->_type_def.specifiers);
+    sense_id(decl->_type_def.name);
     break;
   default:
     CRITICAL("ast", "Unknown declaration type");
   }
 
-  delete_allocation_entry(decl);
+  pool_mark(&ast_nodes.declarations, ref);
 }
 
-void sense_statement_list(struct statement_list *list) {
-  if (list == NULL)
+void sense_statement_list(stmt_list_ref list) {
+  if (list == NO_NODE)
     return;
 
-  for (struct statement *child = list->head; child != NULL;
-       child = child->next) {
+  for (stmt_ref child = stmt_list_at(list)->head; child != NO_NODE;
+       child = stmt_at(child)->next) {
     sense_statement(child);
   }
 
-  delete_allocation_entry(list);
+  pool_mark(&ast_nodes.statement_lists, list);
 }
 
-void sense_compound_stmt(struct statement *stmt) {
-  sense_statement_list(stmt->_compound.statements);
-}
-
-void sense_decl_stmt(struct statement *stmt) { sense_declaration(stmt->_decl); }
-
 void sense_for_stmt(struct statement *stmt) {
   if (stmt->_for.decl) {
     sense_declaration(stmt->_for.decl);
   }
 
-  if (stmt->_for.preloop_expression) {
-    sense_expression(stmt->_for.preloop_expression);
-  }
-
-  if (stmt->_for.condition) {
-    sense_expression(stmt->_for.condition);
-  }
-
-  if (stmt->_for.step_expression) {
-    sense_expression(stmt->_for.step_expression);
-  }
+  sense_expression(stmt->_for.preloop_expression);
+  sense_expression(stmt->_for.condition);
+  sense_expression(stmt->_for.step_expression);
 
   if (stmt->_for.body) {
     sense_statement(stmt->_for.body);
   }
 }
 
-void sense_goto_stmt(struct statement *stmt) { sense_id(stmt->_goto); }
-
 void sense_if_stmt(struct statement *stmt) {
-  if (stmt->_if.condition) {
-    sense_expression(stmt->_if.condition);
-  }
+  sense_expression(stmt->_if.condition);
 
   if (stmt->_if.body) {
     sense_statement(stmt->_if.body);
@@ -1153,12 +996,8 @@ void sense_if_stmt(struct statement *stmt) {
   }
 }
 
-void sense_label_stmt(struct statement *stmt) { sense_id(stmt->_label.name); }
-
 void sense_switch_stmt(struct statement *stmt) {
-  if (stmt->_switch.condition) {
-    sense_expression(stmt->_switch.condition);
-  }
+  sense_expression(stmt->_switch.condition);
 
   if (stmt->_switch.body) {
     sense_statement(stmt->_switch.body);
@@ -1166,50 +1005,45 @@ void sense_switch_stmt(struct statement *stmt) {
 }
 
 void sense_while_stmt(struct statement *stmt) {
-  if (stmt->_while.condition) {
-    sense_expression(stmt->_while.condition);
-  }
+  sense_expression(stmt->_while.condition);
 
   if (stmt->_while.body) {
     sense_statement(stmt->_while.body);
   }
 }
 
-void sense_statement(struct statement *stmt) {
+void sense_statement(stmt_ref ref) {
+  struct statement *stmt = stmt_at(ref);
+
   switch (stmt->type) {
   case BREAK:
     break;
   case COMPOUND:
-    sense_compound_stmt(stmt);
+    sense_statement_list(stmt->_compound.statements);
+    sense_scope(stmt->_compound.local_scope);
     break;
   case CONTINUE:
     break;
   case DECL:
-    sense_decl_stmt(stmt);
+    sense_declaration(stmt->_decl);
     break;
   case EXPR:
-    if (stmt->_expr) {
-      sense_expression(stmt->_expr);
-    }
-
+    sense_expression(stmt->_expr);
     break;
   case FOR:
     sense_for_stmt(stmt);
     break;
   case GOTO:
-    sense_goto_stmt(stmt);
+    sense_id(stmt->_goto);
     break;
   case IF:
     sense_if_stmt(stmt);
     break;
   case LABEL:
-    sense_label_stmt(stmt);
+    sense_id(stmt->_label.name);
     break;
   case RETURN:
-    if (stmt->_return.ret_expr) {
-      sense_expression(stmt->_return.ret_expr);
-    }
-
+    sense_expression(stmt->_return.ret_expr);
     break;
   case SWITCH:
     sense_switch_stmt(stmt);
@@ -1222,142 +1056,139 @@ void sense_statement(struct statement *stmt) {
     break;
   }
 
-  delete_allocation_entry(stmt);
+  pool_mark(&ast_nodes.statements, ref);
 }
 
-void sense_expr_list(struct expression_list *list) {
-  struct expression *cur = list->head;
-  struct expression *next = NULL;
-
-  while (cur) {
-    next = cur->next;
+void sense_expr_list(expr_list_ref list) {
+  for (expr_ref cur = expr_list_at(list)->head; cur != NO_NODE;
+       cur = expr_at(cur)->next) {
     sense_expression(cur);
-    cur = next;
   }
 
-  delete_allocation_entry(list);
-}
-
-void sense_id_expression(struct expression *expr) {
-  sense_id(expr->_id);
-  delete_allocation_entry(expr);
-}
-
-void sense_const_expression(struct expression *expr) {
-  delete_allocation_entry(expr);
-}
-
-void sense_index_expression(struct expression *expr) {
-  sense_expression(expr->_index.object);
-  sense_expression(expr->_index.index);
-  delete_allocation_entry(expr);
-}
-
-void sense_call_expression(struct expression *expr) {
-  sense_expression(expr->_call.function_ptr);
-  sense_expr_list(expr->_call.parameter_list);
-  delete_allocation_entry(expr);
-}
-
-void sense_unary_expression(struct expression *expr) {
-  sense_expression(expr->_unary.base);
-  delete_allocation_entry(expr);
-}
-
-void sense_cast_expression(struct expression *expr) {
-  sense_specifiers(expr->_cast.type);
-  sense_expression(expr->_cast.base);
-  delete_allocation_entry(expr);
-}
-
-void sense_binary_expression(struct expression *expr) {
-  sense_expression(expr->_binary.left);
-  sense_expression(expr->_binary.right);
-  delete_allocation_entry(expr);
+  pool_mark(&ast_nodes.expression_lists, list);
 }
 
-void sense_ternary_expression(struct expression *expr) {
-  sense_expression(expr->_ternary.condition);
-  sense_expression(expr->_ternary.true_branch);
-  sense_expression(expr->_ternary.false_branch);
-  delete_allocation_entry(expr);
-}
+void sense_expression(expr_ref ref) {
+  struct expression *expr = expr_at(ref);
 
-void sense_expression(struct expression *expr) {
   if (expr == NULL)
     return;
 
   switch (expr->type) {
   case ID_EXPR:
-    sense_id_expression(expr);
+    sense_id(expr->_id);
     break;
   case CONST_EXPR:
-    sense_const_expression(expr);
+    pool_mark(&ast_nodes.tokens, expr->_constant);
     break;
   case INDEX:
-    sense_index_expression(expr);
+    sense_expression(expr->_index.object);
+    sense_expression(expr->_index.index);
     break;
   case FUNC_CALL:
-    sense_call_expression(expr);
+    sense_expression(expr->_call.function_ptr);
+    sense_expr_list(expr->_call.parameter_list);
     break;
   case POSTFIX:
-    sense_unary_expression(expr);
-    break;
   case UNARY:
-    sense_unary_expression(expr);
+    pool_mark(&ast_nodes.tokens, expr->_unary.operator);
+    sense_expression(expr->_unary.base);
     break;
   case CAST:
-    sense_cast_expression(expr);
+    sense_specifiers(expr->_cast.type);
+    sense_expression(expr->_cast.base);
     break;
   case BINARY:
-    sense_binary_expression(expr);
+    pool_mark(&ast_nodes.tokens, expr->_binary.operator);
+    sense_expression(expr->_binary.left);
+    sense_expression(expr->_binary.right);
     break;
   case TERNARY:
-    sense_ternary_expression(expr);
+    sense_expression(expr->_ternary.condition);
+    sense_expression(expr->_ternary.true_branch);
+    sense_expression(expr->_ternary.false_branch);
     break;
   }
+
+  pool_mark(&ast_nodes.expressions, ref);
 }
 
 void sense_translation_unit(struct translation_unit *unit) {
-  struct declaration *cur = unit->external_declarations.head;
-  struct declaration *next = NULL;
-
-  while (cur) {
-    next = cur->next;
+  for (decl_ref cur = unit->external_declarations.head; cur != NO_NODE;
+       cur = decl_at(cur)->next) {
     sense_declaration(cur);
-    cur = next;
   }
 
-  delete_allocation_entry(unit);
+  sense_scope(unit->global_scope);
+  sense_allocation(unit);
 }
 
 AST get_tree() { return root; }
 
+void set_tree(AST tree) { root = tree; }
+
+size_t get_expression_count(void) { return ast_nodes.expressions.count; }
+
+// Every pool, to sweep or free them all.
+#define NODE_POOL_COUNT (sizeof(struct node_pools) / sizeof(Pool))
+
+static Pool *node_pool(size_t i) { return &((Pool *)&ast_nodes)[i]; }
+
+size_t get_tree_memory(void) {
+  size_t bytes = 0;
+
+  for (size_t i = 0; i < NODE_POOL_COUNT; i++) {
+    Pool *pool = node_pool(i);
+
+    bytes += (size_t)pool->count * pool->node_size;
+  }
+
+  return bytes;
+}
+
+// Frees the nodes allocated since the last sweep that sensing did not reach.
+size_t free_unsensed_allocations(void) {
+  size_t freed = arena_sweep(&ast_arena);
+
+  for (size_t i = 0; i < NODE_POOL_COUNT; i++) {
+    freed += pool_sweep(node_pool(i));
+  }
+
+  return freed;
+}
+
 void free_unused_parse_branches() {
   if (!root)
     return;
 
   sense_translation_unit(root);
 
-  size_t unused_allocations_count = 0;
-  struct allocation *cur = allocation_list;
-  allocation_list = NULL;
-
-  struct allocation *next = NULL;
-  while (cur != NULL) {
-    next = cur->next;
-    free(cur->address);
-    free(cur);
-    cur = next;
-    unused_allocations_count++;
-  }
+  size_t unused_allocations_count = free_unsensed_allocations();
 
 #ifndef NDEBUG
-  DEBUG("Freed %zu unused blocks", unused_allocations_count);
+  DEBUG("Freed %zu unused nodes", unused_allocations_count);
+#else
+  UNUSED(unused_allocations_count);
 #endif
 }
 
+void free_unused_declaration_branches(decl_ref first, decl_ref last) {
+  for (decl_ref cur = first; cur != NO_NODE; cur = decl_at(cur)->next) {
+    sense_declaration(cur);
+
+    if (cur == last)
+      break;
+  }
+
+  free_unsensed_allocations();
+}
+
 void destroy_ast() {
-  if (root)
-    destroy_translation_unit(root);
+  // Parse branches that were never freed go too.
+  for (size_t i = 0; i < NODE_POOL_COUNT; i++) {
+    pool_free(node_pool(i));
+  }
+
+  arena_free(&ast_arena);
+  root = NULL;
 }
@@ -2,102 +2,177 @@
 
 typedef struct translation_unit *AST;
 
-struct id *create_id(Token *name);
-struct declaration *
-create_variable_declaration(struct specifier_list *specifiers,
-                            struct init_declarator_list *init_declarator_list);
-struct declaration *create_function(struct specifier_list *specifiers,
-                                    struct id *identifier,
-                                    struct declaration_list *parameters,
-                                    struct statement *body);
-struct declaration *create_type_definition(struct specifier_list *specifiers,
-                                           struct id *identifier);
-struct declaration_list *create_declaration_list(struct declaration *first);
-struct declaration_list *append_declaration(struct declaration_list *list,
-                                            struct declaration *new_elem);
-struct translation_unit *create_translation_unit(struct declaration *first);
+// The nodes of the tree, a pool per kind. See the *_at() functions below.
+struct node_pools {
+  Pool ids;
+  Pool specifiers;
+  Pool specifier_lists;
+  Pool initialized_declarators;
+  Pool init_declarator_lists;
+  Pool declarations;
+  Pool declaration_lists;
+  Pool expressions;
+  Pool expression_lists;
+  Pool statements;
+  Pool statement_lists;
+  Pool tokens;
+};
+
+extern _Thread_local struct node_pools ast_nodes;
+
+static inline struct id *id_at(id_ref ref) {
+  return pool_at(&ast_nodes.ids, ref);
+}
+
+static inline struct specifier *spec_at(spec_ref ref) {
+  return pool_at(&ast_nodes.specifiers, ref);
+}
+
+static inline struct specifier_list *spec_list_at(spec_list_ref ref) {
+  return pool_at(&ast_nodes.specifier_lists, ref);
+}
+
+static inline struct initialized_declarator *init_decl_at(init_decl_ref ref) {
+  return pool_at(&ast_nodes.initialized_declarators, ref);
+}
+
+static inline struct init_declarator_list *
+init_decl_list_at(init_decl_list_ref ref) {
+  return pool_at(&ast_nodes.init_declarator_lists, ref);
+}
+
+static inline struct declaration *decl_at(decl_ref ref) {
+  return pool_at(&ast_nodes.declarations, ref);
+}
+
+static inline struct declaration_list *decl_list_at(decl_list_ref ref) {
+  return pool_at(&ast_nodes.declaration_lists, ref);
+}
+
+static inline struct expression *expr_at(expr_ref ref) {
+  return pool_at(&ast_nodes.expressions, ref);
+}
+
+static inline struct expression_list *expr_list_at(expr_list_ref ref) {
+  return pool_at(&ast_nodes.expression_lists, ref);
+}
+
+static inline struct statement *stmt_at(stmt_ref ref) {
+  return pool_at(&ast_nodes.statements, ref);
+}
+
+static inline struct statement_list *stmt_list_at(stmt_list_ref ref) {
+  return pool_at(&ast_nodes.statement_lists, ref);
+}
+
+static inline Token *token_at(token_ref ref) {
+  return pool_at(&ast_nodes.tokens, ref);
+}
+
+id_ref create_id(const Token *name);
+decl_ref create_variable_declaration(spec_list_ref specifiers,
+                                     init_decl_list_ref init_declarator_list);
+decl_ref create_function(spec_list_ref specifiers, id_ref identifier,
+                         decl_list_ref parameters, stmt_ref body);
+decl_ref create_type_definition(spec_list_ref specifiers, id_ref identifier);
+decl_list_ref create_declaration_list(decl_ref first);
+decl_list_ref append_declaration(decl_list_ref list, decl_ref new_elem);
+struct translation_unit *create_translation_unit(decl_ref first);
 struct translation_unit *
-append_external_declaration(struct translation_unit *list,
-                            struct declaration *new_elem);
-
-struct specifier *create_token_specifier(Token *token);
-struct specifier *create_id_specifier(struct id *id);
-
-struct specifier_list *create_specifier_list(struct specifier *tail);
-struct specifier_list *prepend_specifier(struct specifier *prefix,
-                                         struct specifier_list *list);
-
-struct statement *create_break_stmt();
-struct statement *create_compound_stmt(struct statement_list *list);
-struct statement *create_continue_stmt();
-struct statement *create_decl_stmt(struct declaration *decl);
-struct statement *create_expr_stmt(struct expression *expr);
-struct statement *create_for_stmt_with_decl(struct declaration *decl,
-                                            struct expression *condition,
-                                            struct expression *step_expression,
-                                            struct statement *body);
-struct statement *create_for_stmt_with_expr(struct expression *init,
-                                            struct expression *condition,
-                                            struct expression *step_expression,
-                                            struct statement *body);
-struct statement *create_goto_stmt(struct id *label);
-struct statement *create_if_stmt(struct expression *condition,
-                                 struct statement *body,
-                                 struct statement *else_body);
-struct statement *create_label_stmt(struct id *name);
-struct statement *create_return_stmt(struct expression *expr);
-struct statement *create_switch_stmt(struct expression *condition,
-                                     struct statement *body);
-struct statement *create_case_stmt(struct expression *test);
-struct statement *create_default_stmt();
-struct statement *create_do_while_stmt(struct statement *body,
-                                       struct expression *condition);
-struct statement *create_while_stmt(struct expression *condition,
-                                    struct statement *body);
-
-struct statement_list *create_stmt_list(struct statement *first);
-struct statement_list *prepend_stmt(struct statement *new_stmt,
-                                    struct statement_list *list);
-struct statement_list *append_stmt(struct statement_list *list,
-                                   struct statement *new_stmt);
-
-struct expression *create_id_expression(struct id *id);
-struct expression *create_const_expression(Token *constant);
-struct expression *create_dot_index_expression(struct expression *obj,
-                                               struct expression *index);
-struct expression *create_arrow_index_expression(struct expression *obj,
-                                                 struct expression *index);
-struct expression *create_array_index_expression(struct expression *obj,
-                                                 struct expression *index);
-struct expression *
-create_call_expression(struct expression *function_ptr,
-                       struct expression_list *parameter_list);
-struct expression *create_postfix_expression(struct expression *base,
-                                             Token *operator);
-struct expression *create_unary_expression(Token *operator,
-                                           struct expression * base);
-struct expression *create_cast_expression(struct specifier_list *type,
-                                          struct expression *base);
-struct expression *create_binary_expression(struct expression *left,
-                                            Token *operator,
-                                            struct expression * right);
-struct expression *create_ternary_expression(struct expression *condition,
-                                             struct expression *true_branch,
-                                             struct expression *false_branch);
-
-struct expression_list *create_expr_list(struct expression *first_elem);
-struct expression_list *append_expr(struct expression_list *list,
-                                    struct expression *expr);
-
-struct initialized_declarator *
-create_initialized_declarator(struct id *declarator,
-                              struct expression *initializer);
-struct init_declarator_list *
-create_init_declarator_list(struct initialized_declarator *first_elem);
-struct init_declarator_list *
-append_initialized_declarator(struct init_declarator_list *list,
-                              struct initialized_declarator *new_elem);
+append_external_declaration(struct translation_unit *list, decl_ref new_elem);
+
+/**
+ * Appends to a list of declarations held by value, like the external
+ * declarations of a translation unit.
+ */
+void append_to_declarations(struct declaration_list *list, decl_ref new_elem);
+
+spec_ref create_token_specifier(const Token *token);
+spec_ref create_id_specifier(id_ref id);
+
+spec_list_ref create_specifier_list(spec_ref tail);
+spec_list_ref prepend_specifier(spec_ref prefix, spec_list_ref list);
+
+stmt_ref create_break_stmt();
+stmt_ref create_compound_stmt(stmt_list_ref list);
+stmt_ref create_continue_stmt();
+stmt_ref create_decl_stmt(decl_ref decl);
+stmt_ref create_expr_stmt(expr_ref expr);
+stmt_ref create_for_stmt_with_decl(decl_ref decl, expr_ref condition,
+                                   expr_ref step_expression, stmt_ref body);
+stmt_ref create_for_stmt_with_expr(expr_ref init, expr_ref condition,
+                                   expr_ref step_expression, stmt_ref body);
+stmt_ref create_goto_stmt(id_ref label);
+stmt_ref create_if_stmt(expr_ref condition, stmt_ref body, stmt_ref else_body);
+stmt_ref create_label_stmt(id_ref name);
+stmt_ref create_return_stmt(expr_ref expr);
+stmt_ref create_switch_stmt(expr_ref condition, stmt_ref body);
+stmt_ref create_case_stmt(expr_ref test);
+stmt_ref create_default_stmt();
+stmt_ref create_do_while_stmt(stmt_ref body, expr_ref condition);
+stmt_ref create_while_stmt(expr_ref condition, stmt_ref body);
+
+stmt_list_ref create_stmt_list(stmt_ref first);
+stmt_list_ref prepend_stmt(stmt_ref new_stmt, stmt_list_ref list);
+stmt_list_ref append_stmt(stmt_list_ref list, stmt_ref new_stmt);
+
+expr_ref create_id_expression(id_ref id);
+expr_ref create_const_expression(const Token *constant);
+expr_ref create_dot_index_expression(expr_ref obj, expr_ref index);
+expr_ref create_arrow_index_expression(expr_ref obj, expr_ref index);
+expr_ref create_array_index_expression(expr_ref obj, expr_ref index);
+expr_ref create_call_expression(expr_ref function_ptr,
+                                expr_list_ref parameter_list);
+expr_ref create_postfix_expression(expr_ref base, const Token *operator);
+expr_ref create_unary_expression(const Token *operator, expr_ref base);
+expr_ref create_cast_expression(spec_list_ref type, expr_ref base);
+expr_ref create_binary_expression(expr_ref left, const Token *operator,
+                                  expr_ref right);
+expr_ref create_ternary_expression(expr_ref condition, expr_ref true_branch,
+                                   expr_ref false_branch);
+
+expr_list_ref create_expr_list(expr_ref first_elem);
+expr_list_ref append_expr(expr_list_ref list, expr_ref expr);
+
+init_decl_ref create_initialized_declarator(id_ref declarator,
+                                            expr_ref initializer);
+init_decl_list_ref create_init_declarator_list(init_decl_ref first_elem);
+init_decl_list_ref append_initialized_declarator(init_decl_list_ref list,
+                                                 init_decl_ref new_elem);
+
+/**
+ * Allocates memory that lives as long as the tree, see destroy_ast(). Nodes
+ * have pools of their own, this is for the rest, like scopes.
+ */
+void *allocate_node(size_t size);
+
+/**
+ * Frees memory for reuse before the rest of the tree. Does nothing for memory
+ * that allocate_node() did not return.
+ */
+void release_node(void *node);
 
 AST get_tree();
+void set_tree(AST tree);
+
+/**
+ * @return One more than the largest expression id so far, to size tables
+ * indexed by id. Restarts at 0 with destroy_ast().
+ */
+size_t get_expression_count(void);
+
+/**
+ * @return The bytes of every node handed out so far, in use or free, not
+ * counting the rest of the chunks they are in.
+ */
+size_t get_tree_memory(void);
+
 void free_unused_parse_branches();
+void free_unused_declaration_branches(decl_ref first, decl_ref last);
+void destroy_declaration(decl_ref decl);
+
+/**
+ * Frees every node at once, with whatever parse branches were never swept,
+ * and forgets the tree.
+ */
 void destroy_ast();
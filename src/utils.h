@@ -3,12 +3,6 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-#include "scanner.h"
-
-typedef union ConstantValue {
-  uint64_t bits;
-} Constant;
-
 /**
  * Transforms an array into a max-heap.
  *
@@ -24,11 +18,3 @@ void heapify(uint64_t *array, size_t nelements);
  * @param nelements The number of elements in the array.
  */
 void heap_sort(uint64_t *array, size_t nelements);
-
-/**
- * Evaluates a constant token and returns its value.
- *
- * @param token The token to evaluate.
- * @return The value of the token.
- */
-Constant eval_token(Token *token);
@@ -3,8 +3,8 @@
 #include <unity.h>
 
 size_t get_token_list_length(Token *tokens) {
-  size_t len = 0;
-  for (Token *cur = tokens; cur != NULL; cur = cur->next) {
+  size_t len = 1;
+  for (Token *cur = tokens; cur->kind != EOF; cur++) {
     len++;
   }
 
@@ -23,7 +23,8 @@ void assert_span_equal(Span *expected, Span *actual) {
 
 void assert_token_equal(Token *expected, Token *actual) {
   TEST_ASSERT_EQUAL(expected->kind, actual->kind);
+  TEST_ASSERT_EQUAL(expected->code, actual->code);
+  TEST_ASSERT_EQUAL(expected->location, actual->location);
   TEST_ASSERT_EQUAL(expected->length, actual->length);
-  assert_span_equal(&expected->span, &actual->span);
-  TEST_ASSERT_EQUAL_STRING(expected->data, actual->data);
+  TEST_ASSERT_EQUAL_MEMORY(expected->data, actual->data, expected->length);
 }
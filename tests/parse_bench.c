@@ -0,0 +1,146 @@
+// Measures how fast the parsers get through a translation unit, in tokens per
+// second, next to the preprocessor alone.
+//
+// Usage: parse_bench [file.c]
+//
+// Without a file, a source about the size of test_inputs/test900.c is made up
+// from functions the grammar accepts; test900.c itself needs function
+// declarators, which it does not have yet.
+
+#include <descent.h>
+#include <parser.h>
+#include <preprocess.h>
+#include <scanner.h>
+#include <source.h>
+#include <tree.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GENERATED_LENGTH (20 * 1024)
+#define RUNS 20
+
+static const char *const GENERATED_FUNCTION =
+  "int step%d(int n, long *out) {\n"
+  "  int total = 0;\n"
+  "  for (int i = 0; i < n; i++) {\n"
+  "    if (i %% 3 == 0 && n > %d)\n"
+  "      total += (long)i * 2 + out[i];\n"
+  "    else\n"
+  "      total = total - (i << 1) | %d;\n"
+  "  }\n"
+  "  while (total > 100) { total = total / 2; }\n"
+  "  switch (total & 3) { case 1: total++; break; default: break; }\n"
+  "  return total ? total : -n;\n"
+  "}\n";
+
+const char *source;
+const char *path;
+size_t token_count;
+// The bytes of tree nodes the last pass left.
+size_t tree_memory;
+
+char *generate_source(void) {
+  char *text = malloc(GENERATED_LENGTH + 1024);
+  size_t length = 0;
+
+  if (text == NULL) {
+    exit(1);
+  }
+
+  text[0] = '\0';
+
+  for (int i = 0; length < GENERATED_LENGTH; i++) {
+    length += sprintf(text + length, "int count%d = %d;\n", i, i);
+    length += sprintf(text + length, GENERATED_FUNCTION, i, i, i);
+  }
+
+  return text;
+}
+
+double seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int preprocess_only(void) {
+  token_count = 0;
+
+  while (preprocess_token()->kind != EOF) {
+    token_count++;
+  }
+
+  return 0;
+}
+
+int parse_glr(void) {
+  init_parser();
+  return yyparse();
+}
+
+// Times one pass over the source, leaving out freeing the tree.
+double run(int (*pass)(void)) {
+  Scanner scanner;
+
+  init_scanner(&scanner, source);
+  init_preprocessor(&scanner, path);
+
+  double begin = seconds();
+
+  if (pass() != 0) {
+    exit(1);
+  }
+
+  double elapsed = seconds() - begin;
+
+  tree_memory = get_tree_memory();
+  free_type_alias_memory();
+  destroy_ast();
+  free_preprocessor();
+  return elapsed;
+}
+
+// Prints the average speed of a pass.
+void measure(const char *name, int (*pass)(void)) {
+  double elapsed = 0;
+
+  for (int i = 0; i < RUNS; i++) {
+    elapsed += run(pass);
+  }
+
+  double each = elapsed / RUNS;
+  printf("%-16s %9.3f ms %12.0f tokens/s %8zu KiB of nodes\n", name,
+         each * 1e3, token_count / each, tree_memory / 1024);
+}
+
+int main(int argc, char **argv) {
+  SourceBuffer buffer;
+
+  if (argc > 1) {
+    if (!load_source(argv[1], &buffer)) {
+      fprintf(stderr, "Could not read %s\n", argv[1]);
+      return 1;
+    }
+
+    source = buffer.data;
+    path = argv[1];
+  } else {
+    source = generate_source();
+    path = "generated.c";
+  }
+
+  run(preprocess_only);
+  printf("%s: %zu bytes, %zu tokens\n", path, strlen(source), token_count);
+
+  measure("preprocessor", preprocess_only);
+  measure("glr", parse_glr);
+  measure("descent", parse_translation_unit);
+
+  ParseStats stats = get_parse_stats();
+  printf("descent: %zu declarations, %zu left to glr\n", stats.declarations,
+         stats.fallbacks);
+  return 0;
+}
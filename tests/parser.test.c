@@ -1,17 +1,669 @@
 #include <test_utils.h>
 #include <unity.h>
+#include <arena.h>
 #include <scanner.h>
+#include <descent.h>
+#include <incremental.h>
 #include <parser.h>
+#include <pch.h>
+#include <pool.h>
+#include <precedence.h>
+#include <pthread.h>
+#include <preprocess.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tree.h>
+#include <unistd.h>
 
 void setUp(void) { reset_log_checks(); }
 void tearDown(void) { }
 
 void test_simple_program(void) {
   const char* input = "int main(){}";
-  Token *tokens = scan(input);
+  Scanner scanner;
 
-  init_parser(tokens);
+  init_scanner(&scanner, input);
+  init_preprocessor(&scanner, "test.c");
+  init_parser();
   int result = yyparse();
 
   TEST_ASSERT_EQUAL(0, result);
 }
+
+struct declaration *nth_declaration(size_t n) {
+  decl_ref decl = get_tree()->external_declarations.head;
+
+  for (; n > 0; n--) {
+    decl = decl_at(decl)->next;
+  }
+
+  return decl_at(decl);
+}
+
+struct statement *first_statement(stmt_ref compound) {
+  return stmt_at(stmt_list_at(stmt_at(compound)->_compound.statements)->head);
+}
+
+Token *declarator_name(struct declaration *decl) {
+  struct initialized_declarator *first =
+    init_decl_at(init_decl_list_at(decl->_var.init_declarator_list)->head);
+  return &id_at(first->declarator)->name;
+}
+
+void test_precompiled_header(void) {
+  char path[] = "/tmp/copper-pch-XXXXXX";
+  int fd = mkstemp(path);
+  Scanner scanner;
+
+  TEST_ASSERT_NOT_EQUAL(-1, fd);
+  close(fd);
+
+  init_scanner(&scanner, "int total = 2;\nint twice(int x) { return x * 2; }");
+  init_preprocessor(&scanner, "header.h");
+  init_parser();
+  TEST_ASSERT_EQUAL(0, yyparse());
+
+  // Registering a typedef logs in debug builds, which would end the test, as
+  // would free_unused_parse_branches().
+  add_type_alias(intern("count", strlen("count")));
+  TEST_ASSERT_TRUE(save_pch(path));
+
+  free_type_alias_memory();
+  destroy_ast();
+
+  // `count` only parses as a type if the header's typedef names are loaded.
+  TEST_ASSERT_TRUE(load_pch(path));
+  init_scanner(&scanner, "count main() { return total * 3; }");
+  init_preprocessor(&scanner, "test.c");
+  init_parser();
+  TEST_ASSERT_EQUAL(0, yyparse());
+  seed_translation_unit();
+
+  struct declaration *decl = nth_declaration(0);
+  TEST_ASSERT_EQUAL(VARIABLE, decl->type);
+
+  struct initialized_declarator *total = init_decl_at(
+    init_decl_list_at(decl->_var.init_declarator_list)->head);
+  TEST_ASSERT_EQUAL_STRING(
+    "total", interned_text(id_at(total->declarator)->name.interned));
+
+  struct expression *initializer = expr_at(total->initializer);
+  TEST_ASSERT_EQUAL(CONST_EXPR, initializer->type);
+  TEST_ASSERT_EQUAL(2, token_at(initializer->_constant)->constant.bits);
+  TEST_ASSERT_EQUAL(FUNCTION, nth_declaration(1)->type);
+  TEST_ASSERT_EQUAL_STRING(
+    "twice",
+    interned_text(id_at(nth_declaration(1)->_func.name)->name.interned));
+  TEST_ASSERT_EQUAL(FUNCTION, nth_declaration(2)->type);
+  TEST_ASSERT_EQUAL(NO_NODE, nth_declaration(2)->next);
+
+  free_type_alias_memory();
+  destroy_ast();
+  free_pch();
+  unlink(path);
+}
+
+void test_precompiled_header_ucn_names(void) {
+  char path[] = "/tmp/copper-pch-XXXXXX";
+  int fd = mkstemp(path);
+  Scanner scanner;
+
+  TEST_ASSERT_NOT_EQUAL(-1, fd);
+  close(fd);
+
+  init_scanner(&scanner, "int caf\\u00e9 = 1;");
+  init_preprocessor(&scanner, "header.h");
+  init_parser();
+  TEST_ASSERT_EQUAL(0, yyparse());
+  TEST_ASSERT_TRUE(save_pch(path));
+
+  free_type_alias_memory();
+  destroy_ast();
+
+  // The spelling comes back as written, the name as UTF-8.
+  TEST_ASSERT_TRUE(load_pch(path));
+  init_scanner(&scanner, "int x;");
+  init_preprocessor(&scanner, "test.c");
+  init_parser();
+  TEST_ASSERT_EQUAL(0, yyparse());
+  seed_translation_unit();
+
+  Token *name = declarator_name(nth_declaration(0));
+
+  TEST_ASSERT_EQUAL(9, name->length);
+  TEST_ASSERT_EQUAL_MEMORY("caf\\u00e9", name->data, 9);
+  TEST_ASSERT_EQUAL_STRING("caf\xc3\xa9", interned_text(name->interned));
+
+  free_type_alias_memory();
+  destroy_ast();
+  free_pch();
+  unlink(path);
+}
+
+void test_incremental_reparse(void) {
+  const char *before = "#define N 4\n"
+                       "int a = N;\n"
+                       "int f(int x) { return x + a; }\n"
+                       "int b = 2;\n"
+                       "int g(void) { return b; }\n";
+  const char *after = "#define N 4\n"
+                      "int a = N;\n"
+                      "int f(int x) {\n  return x * N + a;\n}\n"
+                      "int b = 2;\n"
+                      "int g(void) { return b; } int c;\n";
+
+  TEST_ASSERT_TRUE(parse_source("test.c", before, strlen(before)));
+  TEST_ASSERT_EQUAL(4, get_incremental_stats().declarations_parsed);
+
+  struct declaration *a = nth_declaration(0);
+  struct declaration *b = nth_declaration(2);
+  struct declaration *g = nth_declaration(3);
+
+  size_t body = strstr(before, "{ return x") - before;
+  size_t end = strlen(before) - 1;
+  Edit edits[] = {
+    {body + 1, 1, 3},
+    {body + 11, 1, 5},
+    {body + 15, 1, 1},
+    {end, 0, 7},
+  };
+
+  TEST_ASSERT_TRUE(reparse_source(after, strlen(after), edits, 4));
+
+  // Lexing stops after f, and starts again after g. EOF is lexed too.
+  IncrementalStats stats = get_incremental_stats();
+  TEST_ASSERT_EQUAL(2, stats.declarations_parsed);
+  TEST_ASSERT_EQUAL(3, stats.declarations_reused);
+  TEST_ASSERT_EQUAL(19, stats.tokens_lexed);
+
+  TEST_ASSERT_EQUAL_PTR(a, nth_declaration(0));
+  TEST_ASSERT_EQUAL_PTR(b, nth_declaration(2));
+  TEST_ASSERT_EQUAL_PTR(g, nth_declaration(3));
+  TEST_ASSERT_EQUAL(NO_NODE, nth_declaration(4)->next);
+
+  // Macros defined at the top are expanded in the new declarations.
+  struct expression *sum = expr_at(
+    first_statement(nth_declaration(1)->_func.body)->_return.ret_expr);
+  TEST_ASSERT_EQUAL(BINARY, sum->type);
+
+  struct expression *product = expr_at(sum->_binary.left);
+  TEST_ASSERT_EQUAL(BINARY, product->type);
+  TEST_ASSERT_EQUAL(
+    4, token_at(expr_at(product->_binary.right)->_constant)->constant.bits);
+
+  // Reused tokens moved with the text after the edits.
+  Token *name = &id_at(g->_func.name)->name;
+  Coord coord = location_coord(name->location);
+  TEST_ASSERT_EQUAL(7, coord.line_number);
+  TEST_ASSERT_EQUAL(5, coord.column);
+  TEST_ASSERT_EQUAL_MEMORY("g(void)", name->data, 7);
+
+  free_incremental();
+  free_preprocessor();
+}
+
+void test_incremental_directives(void) {
+  const char *input = "int a;\n#define N 4\nint b = N;\n";
+
+  TEST_ASSERT_FALSE(parse_source("test.c", input, strlen(input)));
+  TEST_ASSERT_EQUAL(NO_NODE, get_tree()->external_declarations.head);
+
+  // Adding one below the top falls back to a full parse, which rejects it.
+  const char *fixed = "int a;\nint b = N;\n";
+  TEST_ASSERT_TRUE(parse_source("test.c", fixed, strlen(fixed)));
+
+  Edit edit = {7, 0, 12};
+  TEST_ASSERT_FALSE(reparse_source(input, strlen(input), &edit, 1));
+
+  free_incremental();
+  free_preprocessor();
+}
+
+void test_incremental_text_unregistered(void) {
+  const char *input = "int a;\n";
+
+  TEST_ASSERT_TRUE(parse_source("test.c", input, strlen(input)));
+  SourceLocation old = declarator_name(nth_declaration(0))->location;
+
+  // A source past the text's capacity moves it to a new buffer.
+  size_t length = 8192;
+  char *longer = malloc(length + 1);
+
+  for (size_t i = 0; i < length; i += 8) {
+    memcpy(&longer[i], "int ab;\n", 8);
+  }
+
+  longer[length] = '\0';
+
+  Edit edit = {0, strlen(input), length};
+  TEST_ASSERT_TRUE(reparse_source(longer, length, &edit, 1));
+  TEST_ASSERT_EQUAL((size_t)-1, location_coord(old).line_number);
+
+  SourceLocation last = declarator_name(nth_declaration(length / 8 - 1))
+                          ->location;
+  TEST_ASSERT_EQUAL(length / 8, location_coord(last).line_number);
+
+  free_incremental();
+  TEST_ASSERT_EQUAL((size_t)-1, location_coord(last).line_number);
+
+  free_preprocessor();
+  free(longer);
+}
+
+void test_descent_parse(void) {
+  const char *input = "int total = 2, *cursor;\n"
+                      "struct point origin;\n"
+                      "struct pair { int a; int b; } pair;\n"
+                      "unsigned scale(int x, long *y) {\n"
+                      "  for (int i = 0; i < x; i++) { total += (long)i * 2; }\n"
+                      "  if (x) x = -x; else while (x < 3) x++;\n"
+                      "  do { x--; } while (x > 0 && total != 1 ? 1 : 0);\n"
+                      "  switch (x) { case 1: break; default: goto done; }\n"
+                      "done:\n"
+                      "  return sizeof(int) + *y;\n"
+                      "}\n";
+  Scanner scanner;
+
+  init_scanner(&scanner, input);
+  init_preprocessor(&scanner, "test.c");
+  TEST_ASSERT_EQUAL(0, parse_translation_unit());
+
+  // The struct body is left to the GLR parser.
+  ParseStats stats = get_parse_stats();
+  TEST_ASSERT_EQUAL(3, stats.declarations);
+  TEST_ASSERT_EQUAL(1, stats.fallbacks);
+
+  struct declaration *globals = nth_declaration(0);
+  struct initialized_declarator *cursor = init_decl_at(
+    init_decl_at(init_decl_list_at(globals->_var.init_declarator_list)->head)
+      ->next);
+  TEST_ASSERT_EQUAL_STRING(
+    "cursor", interned_text(id_at(cursor->declarator)->name.interned));
+  TEST_ASSERT_EQUAL(NO_NODE, cursor->initializer);
+  TEST_ASSERT_EQUAL(VARIABLE, nth_declaration(2)->type);
+
+  struct declaration *scale = nth_declaration(3);
+  TEST_ASSERT_EQUAL(FUNCTION, scale->type);
+  TEST_ASSERT_NOT_EQUAL(
+    NO_NODE, decl_at(decl_list_at(scale->_func.parameters)->head)->next);
+  TEST_ASSERT_EQUAL(NO_NODE, scale->next);
+
+  // The cast only applies to i, and binds tighter than the multiplication.
+  struct statement *loop = first_statement(scale->_func.body);
+  TEST_ASSERT_EQUAL(FOR, loop->type);
+  struct expression *add = expr_at(first_statement(loop->_for.body)->_expr);
+  struct expression *product = expr_at(add->_binary.right);
+  TEST_ASSERT_EQUAL(PU_PLUSE, token_at(add->_binary.operator)->code);
+  TEST_ASSERT_EQUAL(PU_STAR, token_at(product->_binary.operator)->code);
+  TEST_ASSERT_EQUAL(CAST, expr_at(product->_binary.left)->type);
+
+  struct statement *branch = stmt_at(loop->next);
+  TEST_ASSERT_EQUAL(IF, branch->type);
+  TEST_ASSERT_EQUAL(WHILE, first_statement(branch->_if.else_body)->type);
+
+  // The label is a block item of its own.
+  struct statement *label =
+    stmt_at(stmt_at(stmt_at(branch->next)->next)->next);
+  TEST_ASSERT_EQUAL(LABEL, label->type);
+  TEST_ASSERT_EQUAL(RETURN, stmt_at(label->next)->type);
+
+  destroy_ast();
+  free_preprocessor();
+}
+
+// The else of test108 belongs to the inner if.
+void assert_dangling_else(stmt_ref body) {
+  struct statement *outer = first_statement(body);
+
+  while (outer->type != IF) {
+    outer = stmt_at(outer->next);
+  }
+
+  TEST_ASSERT_EQUAL(NO_NODE, outer->_if.else_body);
+
+  struct statement *inner = first_statement(outer->_if.body);
+  TEST_ASSERT_EQUAL(IF, inner->type);
+  TEST_ASSERT_NOT_EQUAL(NO_NODE, inner->_if.else_body);
+}
+
+void test_dangling_else(void) {
+  const char *input = "int main() {\n"
+                      "  if (12)\n"
+                      "    if (3)\n"
+                      "      return 0;\n"
+                      "  else\n"
+                      "    return 1;\n"
+                      "}\n";
+  // The struct body sends the whole function to the GLR parser.
+  const char *fallback = "int main() {\n"
+                         "  struct p { int a; } q;\n"
+                         "  if (12)\n"
+                         "    if (3)\n"
+                         "      return 0;\n"
+                         "  else\n"
+                         "    return 1;\n"
+                         "}\n";
+  Scanner scanner;
+
+  init_scanner(&scanner, input);
+  init_preprocessor(&scanner, "test.c");
+  init_parser();
+  TEST_ASSERT_EQUAL(0, yyparse());
+  assert_dangling_else(nth_declaration(0)->_func.body);
+  destroy_ast();
+  free_preprocessor();
+
+  init_scanner(&scanner, input);
+  init_preprocessor(&scanner, "test.c");
+  TEST_ASSERT_EQUAL(0, parse_translation_unit());
+  TEST_ASSERT_EQUAL(0, get_parse_stats().fallbacks);
+  assert_dangling_else(nth_declaration(0)->_func.body);
+  destroy_ast();
+  free_preprocessor();
+
+  init_scanner(&scanner, fallback);
+  init_preprocessor(&scanner, "test.c");
+  TEST_ASSERT_EQUAL(0, parse_translation_unit());
+  TEST_ASSERT_EQUAL(1, get_parse_stats().fallbacks);
+  assert_dangling_else(nth_declaration(0)->_func.body);
+  destroy_ast();
+  free_preprocessor();
+}
+
+void test_binary_precedence(void) {
+  // The %left declarations of parser.y must agree with binary_precedence.
+  const char *operators[] = {"*",  "/",  "%",  "+", "-", "<<", ">>",
+                             "<",  ">",  "<=", ">=", "==", "!=", "&",
+                             "^",  "|",  "&&", "||"};
+  size_t count = sizeof(operators) / sizeof(operators[0]);
+  Scanner scanner;
+
+  for (size_t i = 0; i < count; i++) {
+    for (size_t j = 0; j < count; j++) {
+      char input[64];
+      snprintf(input, sizeof(input), "int f() { return a %s b %s c; }",
+               operators[i], operators[j]);
+
+      init_scanner(&scanner, input);
+      init_preprocessor(&scanner, "test.c");
+      init_parser();
+      TEST_ASSERT_EQUAL(0, yyparse());
+
+      struct expression *root = expr_at(
+        first_statement(nth_declaration(0)->_func.body)->_return.ret_expr);
+      uint8_t outer = binary_precedence[token_at(root->_binary.operator)->code];
+
+      // Left associative, so the first operator binds first unless the
+      // second binds tighter.
+      if (expr_at(root->_binary.left)->type == BINARY) {
+        struct expression *inner = expr_at(root->_binary.left);
+        TEST_ASSERT_TRUE(
+          binary_precedence[token_at(inner->_binary.operator)->code] >= outer);
+      } else {
+        struct expression *inner = expr_at(root->_binary.right);
+        TEST_ASSERT_EQUAL(BINARY, inner->type);
+        TEST_ASSERT_TRUE(
+          binary_precedence[token_at(inner->_binary.operator)->code] > outer);
+      }
+
+      destroy_ast();
+      free_preprocessor();
+    }
+  }
+}
+
+void test_descent_syntax_error_failure(void) {
+  const char *input = "int a;\nint f(int x) {\n  x = (x + 1;\n}\n";
+  Scanner scanner;
+
+  init_scanner(&scanner, input);
+  init_preprocessor(&scanner, "test.c");
+
+  // The GLR parser reports the error, so the message does not change.
+  expect_error("syntax error at symbol \";\" (3:13)");
+  parse_translation_unit();
+}
+
+void test_other_character_failure(void) {
+  const char *input = "#define at(x) x\nint a = at(@);\n";
+  Scanner scanner;
+
+  init_scanner(&scanner, input);
+  init_preprocessor(&scanner, "test.c");
+
+  // Macros take it like any token, only the parser rejects it.
+  expect_error("syntax error at character \"@\" (2:12)");
+  parse_translation_unit();
+}
+
+void test_type_alias_scopes(void) {
+  const char *input = "int twice(int count) { return count * 2; }\n"
+                      "count total;\n";
+  intern_t count = intern("count", strlen("count"));
+  intern_t inner = intern("inner", strlen("inner"));
+  Scanner scanner;
+
+  add_type_alias(count);
+
+  // A typedef name of a block scope is gone once it ends.
+  enter_type_scope();
+  add_type_alias(inner);
+  TEST_ASSERT_TRUE(is_type_alias(inner));
+  leave_type_scope();
+  TEST_ASSERT_FALSE(is_type_alias(inner));
+
+  // The parameter hides `count` in the body only.
+  init_scanner(&scanner, input);
+  init_preprocessor(&scanner, "test.c");
+  TEST_ASSERT_EQUAL(0, parse_translation_unit());
+  TEST_ASSERT_EQUAL(0, get_parse_stats().fallbacks);
+  TEST_ASSERT_TRUE(is_type_alias(count));
+
+  struct expression *product = expr_at(
+    first_statement(nth_declaration(0)->_func.body)->_return.ret_expr);
+  TEST_ASSERT_EQUAL(BINARY, product->type);
+  TEST_ASSERT_EQUAL(ID_EXPR, expr_at(product->_binary.left)->type);
+  TEST_ASSERT_EQUAL(VARIABLE, nth_declaration(1)->type);
+
+  free_type_alias_memory();
+  destroy_ast();
+  free_preprocessor();
+}
+
+void test_expression_ids(void) {
+  Scanner scanner;
+
+  init_scanner(&scanner, "int a = 1 + 2;\n");
+  init_preprocessor(&scanner, "test.c");
+  TEST_ASSERT_EQUAL(0, parse_translation_unit());
+
+  // Numbered as they were made, operands first, from 1 as NO_NODE is 0.
+  struct expression *sum = expr_at(
+    init_decl_at(
+      init_decl_list_at(nth_declaration(0)->_var.init_declarator_list)->head)
+      ->initializer);
+  TEST_ASSERT_EQUAL(1, expr_at(sum->_binary.left)->id);
+  TEST_ASSERT_EQUAL(2, expr_at(sum->_binary.right)->id);
+  TEST_ASSERT_EQUAL(3, sum->id);
+  TEST_ASSERT_EQUAL(4, get_expression_count());
+
+  destroy_ast();
+  free_preprocessor();
+  TEST_ASSERT_EQUAL(0, get_expression_count());
+}
+
+#define THREAD_COUNT 4
+#define THREAD_ROUNDS 50
+
+struct parse_job {
+  int number;
+  pthread_t thread;
+  bool passed;
+};
+
+// Parses a source of its own over and over, with either parser. Unity cannot
+// fail a test from another thread, so it only records whether every tree was
+// right.
+void *parse_on_thread(void *argument) {
+  struct parse_job *job = argument;
+  char input[128];
+  char name[32];
+  Scanner scanner;
+
+  snprintf(input, sizeof(input),
+           "int total%d = %d;\nint twice(int x) { return x * 2; }\n",
+           job->number, job->number);
+  snprintf(name, sizeof(name), "total%d", job->number);
+  job->passed = true;
+
+  for (int round = 0; round < THREAD_ROUNDS; round++) {
+    init_scanner(&scanner, input);
+    init_preprocessor(&scanner, "test.c");
+
+    int result;
+
+    if (round % 2) {
+      init_parser();
+      result = yyparse();
+    } else {
+      result = parse_translation_unit();
+    }
+
+    struct declaration *decl = nth_declaration(0);
+    struct initialized_declarator *total =
+      init_decl_at(init_decl_list_at(decl->_var.init_declarator_list)->head);
+    const Token *constant = token_at(expr_at(total->initializer)->_constant);
+
+    job->passed = job->passed && result == 0 &&
+                  strcmp(interned_text(id_at(total->declarator)->name.interned),
+                         name) == 0 &&
+                  constant->constant.bits == (uint64_t)job->number &&
+                  nth_declaration(1)->type == FUNCTION;
+
+    destroy_ast();
+    free_preprocessor();
+  }
+
+  free_interned_strings();
+  free_sources();
+  return NULL;
+}
+
+void test_parse_on_threads(void) {
+  struct parse_job jobs[THREAD_COUNT];
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    jobs[i].number = i + 1;
+    TEST_ASSERT_EQUAL(
+      0, pthread_create(&jobs[i].thread, NULL, parse_on_thread, &jobs[i]));
+  }
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_join(jobs[i].thread, NULL);
+    TEST_ASSERT_TRUE(jobs[i].passed);
+  }
+}
+
+// Parses sources that fail, one with a syntax error and one with #error,
+// over and over.
+void *fail_on_thread(void *argument) {
+  struct parse_job *job = argument;
+  const char *inputs[] = {"int twice(int x) { return x * ; }\n",
+                          "int a;\n#error stop\nint b;\n"};
+  Scanner scanner;
+
+  job->passed = true;
+
+  for (int round = 0; round < THREAD_ROUNDS; round++) {
+    init_scanner(&scanner, inputs[round % 2]);
+    init_preprocessor(&scanner, "test.c");
+    job->passed = job->passed && parse_translation_unit() != 0;
+
+    free_type_alias_memory();
+    destroy_ast();
+    free_preprocessor();
+  }
+
+  free_interned_strings();
+  free_sources();
+  return NULL;
+}
+
+void test_failing_parse_on_thread(void) {
+  struct parse_job jobs[THREAD_COUNT];
+
+  // The first one fails every translation unit, the others go on.
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    jobs[i].number = i + 1;
+    TEST_ASSERT_EQUAL(0, pthread_create(&jobs[i].thread, NULL,
+                                        i == 0 ? fail_on_thread
+                                               : parse_on_thread,
+                                        &jobs[i]));
+  }
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_join(jobs[i].thread, NULL);
+    TEST_ASSERT_TRUE(jobs[i].passed);
+  }
+}
+
+void test_arena_sweep(void) {
+  Arena arena = {0};
+  int local = 0;
+
+  int *kept = arena_allocate(&arena, sizeof(int));
+  char *dropped = arena_allocate(&arena, 40);
+  char *released = arena_allocate(&arena, 40);
+
+  arena_release(&arena, released);
+  arena_mark(&arena, kept);
+  arena_mark(&arena, &local);
+  TEST_ASSERT_EQUAL(1, arena_sweep(&arena));
+
+  // Freed blocks are reused for the same size, the last one freed first.
+  TEST_ASSERT_EQUAL_PTR(dropped, arena_allocate(&arena, 33));
+  TEST_ASSERT_EQUAL_PTR(released, arena_allocate(&arena, 48));
+  TEST_ASSERT_NOT_EQUAL(kept, arena_allocate(&arena, sizeof(int)));
+
+  // Only blocks allocated since the last sweep are swept.
+  TEST_ASSERT_EQUAL(3, arena_sweep(&arena));
+  TEST_ASSERT_EQUAL(0, arena_sweep(&arena));
+
+  arena_free(&arena);
+}
+
+void test_pool_sweep(void) {
+  Pool pool = {.node_size = sizeof(uint64_t)};
+
+  uint32_t kept = pool_allocate(&pool);
+  uint32_t dropped = pool_allocate(&pool);
+  uint32_t released = pool_allocate(&pool);
+
+  // NO_NODE is never handed out.
+  TEST_ASSERT_EQUAL(1, kept);
+
+  *(uint64_t *)pool_at(&pool, kept) = 7;
+  pool_release(&pool, released);
+  pool_mark(&pool, kept);
+  pool_mark(&pool, NO_NODE);
+  TEST_ASSERT_EQUAL(1, pool_sweep(&pool));
+
+  // Freed nodes are reused zeroed, the last one freed first.
+  TEST_ASSERT_EQUAL(dropped, pool_allocate(&pool));
+  TEST_ASSERT_EQUAL(released, pool_allocate(&pool));
+  TEST_ASSERT_EQUAL(0, *(uint64_t *)pool_at(&pool, released));
+  TEST_ASSERT_EQUAL(7, *(uint64_t *)pool_at(&pool, kept));
+
+  // Only nodes allocated since the last sweep are swept, chunks stay put.
+  void *first = pool_at(&pool, kept);
+
+  for (uint32_t i = 0; i < POOL_CHUNK_NODES; i++) {
+    pool_allocate(&pool);
+  }
+
+  TEST_ASSERT_EQUAL_PTR(first, pool_at(&pool, kept));
+  TEST_ASSERT_EQUAL(POOL_CHUNK_NODES + 2, pool_sweep(&pool));
+  TEST_ASSERT_EQUAL(0, pool_sweep(&pool));
+
+  pool_free(&pool);
+}
@@ -0,0 +1,361 @@
+#include <preprocess.h>
+#include <scanner.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <test_utils.h>
+#include <unistd.h>
+#include <unity.h>
+
+char output[1024];
+
+void setUp(void) { reset_log_checks(); }
+
+void tearDown(void) { free_preprocessor(); }
+
+// Spells the preprocessed tokens, with one space wherever there was
+// whitespace before a token.
+const char *preprocess_file(const char *input, const char *path) {
+  Scanner scanner;
+  size_t length = 0;
+
+  init_scanner(&scanner, input);
+  init_preprocessor(&scanner, path);
+
+  for (Token *token = preprocess_token(); token->kind != EOF;
+       token = preprocess_token()) {
+    if (length > 0 && (token->flags & TF_LEADING_SPACE)) {
+      output[length++] = ' ';
+    }
+
+    memcpy(&output[length], token->data, token->length);
+    length += token->length;
+  }
+
+  output[length] = '\0';
+  return output;
+}
+
+const char *preprocess_text(const char *input) {
+  return preprocess_file(input, "test.c");
+}
+
+void write_file(const char *directory, const char *name, const char *text) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", directory, name);
+
+  FILE *file = fopen(path, "w");
+  TEST_ASSERT_NOT_NULL(file);
+  fputs(text, file);
+  fclose(file);
+}
+
+void remove_file(const char *directory, const char *name) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", directory, name);
+  unlink(path);
+}
+
+void test_object_macros(void) {
+  const char *input = "#define N 4\n"
+                      "#define M N + N\n"
+                      "int a = M;\n"
+                      "#undef N\n"
+                      "int b = M;";
+
+  TEST_ASSERT_EQUAL_STRING("int a = 4 + 4; int b = N + N;",
+                           preprocess_text(input));
+}
+
+void test_function_macros(void) {
+  const char *input = "#define MAX(a, b) ((a) > (b) ? (a) : (b))\n"
+                      "#define EMPTY()\n"
+                      "MAX(1, f(2, 3)) EMPTY() MAX (x, y) MAX;";
+
+  TEST_ASSERT_EQUAL_STRING("((1) > (f(2, 3)) ? (1) : (f(2, 3))) ((x) > (y) "
+                           "? (x) : (y)) MAX;",
+                           preprocess_text(input));
+}
+
+void test_stringify_and_paste(void) {
+  const char *input = "#define STR(x) #x\n"
+                      "#define CAT(a, b) a ## b\n"
+                      "STR(a   \"b\\n\"  c) CAT(x, 1) CAT(, y) CAT(1, .5e3) "
+                      "CAT(+, =)";
+
+  TEST_ASSERT_EQUAL_STRING("\"a \\\"b\\\\n\\\" c\" x1 y 1.5e3 +=",
+                           preprocess_text(input));
+}
+
+void test_recursive_macros(void) {
+  const char *input = "#define f(x) x + f(x)\n"
+                      "#define g g\n"
+                      "#define h(x) x\n"
+                      "f(1) g h(h(2))";
+
+  TEST_ASSERT_EQUAL_STRING("1 + f(1) g 2", preprocess_text(input));
+}
+
+void test_variadic_macros(void) {
+  const char *input = "#define F(a, ...) f(a __VA_OPT__(,) __VA_ARGS__)\n"
+                      "F(1) F(1, 2, 3)";
+
+  TEST_ASSERT_EQUAL_STRING("f(1) f(1 , 2, 3)", preprocess_text(input));
+}
+
+void test_va_opt_standard_example(void) {
+  // The EXAMPLE of ISO/IEC 9899:2023 6.10.5.2, less the definitions that are
+  // constraint violations.
+  const char *input = "#define F(...) f(0 __VA_OPT__(,) __VA_ARGS__)\n"
+                      "#define G(X, ...) f(0, X __VA_OPT__(,) __VA_ARGS__)\n"
+                      "#define SDEF(sname, ...) S sname __VA_OPT__(= { "
+                      "__VA_ARGS__ })\n"
+                      "#define EMP\n"
+                      "F(a, b, c) F() F(EMP)\n"
+                      "G(a, b, c) G(a, ) G(a)\n"
+                      "SDEF(foo); SDEF(bar, 1, 2);\n"
+                      "#define H2(X, Y, ...) __VA_OPT__(X ## Y,) __VA_ARGS__\n"
+                      "H2(a, b, c, d)\n"
+                      "#define H3(X, ...) #__VA_OPT__(X##X X##X)\n"
+                      "H3(, 0)\n"
+                      "#define H4(X, ...) __VA_OPT__(a X ## X) ## b\n"
+                      "H4(, 1)\n"
+                      "#define H5A(...) __VA_OPT__()/**/__VA_OPT__()\n"
+                      "#define H5B(X) a ## X ## b\n"
+                      "#define H5C(X) H5B(X)\n"
+                      "H5C(H5A())";
+
+  TEST_ASSERT_EQUAL_STRING("f(0 , a, b, c) f(0) f(0) "
+                           "f(0, a , b, c) f(0, a) f(0, a) "
+                           "S foo; S bar = { 1, 2 }; "
+                           "ab, c, d \"\" a b ab",
+                           preprocess_text(input));
+}
+
+void test_va_opt_after_replacement(void) {
+  // Variable arguments that replace to nothing count as absent.
+  const char *input = "#define EMP\n"
+                      "#define F(a, ...) f(a __VA_OPT__(,) __VA_ARGS__)\n"
+                      "#define S(...) #__VA_OPT__(x  y)\n"
+                      "F(0, EMP) S(1) S(EMP)";
+
+  TEST_ASSERT_EQUAL_STRING("f(0) \"x y\" \"\"", preprocess_text(input));
+}
+
+void test_builtin_macros(void) {
+  const char *input = "__LINE__ __FILE__\n"
+                      "#define L __LINE__\n"
+                      "L __STDC_VERSION__";
+
+  TEST_ASSERT_EQUAL_STRING("1 \"test.c\" 3 202311L", preprocess_text(input));
+}
+
+void test_conditionals(void) {
+  const char *input = "#if 1 + 2 * 3 == 7 && defined(X) == 0\n"
+                      "a\n"
+                      "#elif 1 / 0\n"
+                      "b\n"
+                      "#else\n"
+                      "c\n"
+                      "#endif\n"
+                      "#ifdef X\n"
+                      "d\n"
+                      "#else\n"
+                      "e\n"
+                      "#endif\n"
+                      "#if 0\n"
+                      "don't lex \" this\n"
+                      "#if garbage (\n"
+                      "#else\n"
+                      "#endif\n"
+                      "#elif -1 < 0u\n"
+                      "f\n"
+                      "#else\n"
+                      "g\n"
+                      "#endif\n"
+                      "#if (2 || 1 / 0) && 'A' == 65 && true ? 1 : 0\n"
+                      "h\n"
+                      "#endif";
+
+  TEST_ASSERT_EQUAL_STRING("a e g h", preprocess_text(input));
+}
+
+void test_unterminated_conditional_failure(void) {
+  const char *input = "int x;\n#ifdef X\nint y;";
+
+  expect_error("Unterminated conditional directive at 2:1");
+  preprocess_text(input);
+
+  TEST_FAIL_MESSAGE("Expected an error");
+}
+
+void test_division_by_zero_failure(void) {
+  const char *input = "#if 1 % (2 - 2)\n#endif";
+
+  expect_error("Division by zero in preprocessor condition at 1:7");
+  preprocess_text(input);
+
+  TEST_FAIL_MESSAGE("Expected an error");
+}
+
+void test_error_directive_failure(void) {
+  const char *input = "int x;\n  #  error stop  here\n";
+
+  expect_error("#error stop here at 2:3");
+  preprocess_text(input);
+
+  TEST_FAIL_MESSAGE("Expected an error");
+}
+
+void test_include_guards(void) {
+  char directory[] = "/tmp/copper-pp-XXXXXX";
+  TEST_ASSERT_NOT_NULL(mkdtemp(directory));
+
+  write_file(directory, "guard.h",
+             "// Comments may come first\n"
+             "#ifndef GUARD_H\n"
+             "#define GUARD_H\n"
+             "int guarded;\n"
+             "#endif\n");
+  write_file(directory, "defined.h",
+             "#if !defined(DEFINED_H)\n"
+             "#define DEFINED_H\n"
+             "int defined;\n"
+             "#endif\n");
+  write_file(directory, "once.h", "#pragma once\nint once;\n");
+  write_file(directory, "plain.h", "int plain;\n");
+
+  char path[512];
+  snprintf(path, sizeof(path), "%s/main.c", directory);
+  add_include_directory(directory);
+
+  const char *input = "#include \"guard.h\"\n"
+                      "#include \"guard.h\"\n"
+                      "#include \"defined.h\"\n"
+                      "#include \"defined.h\"\n"
+                      "#include \"once.h\"\n"
+                      "#include <once.h>\n"
+                      "#define PLAIN <plain.h>\n"
+                      "#include \"plain.h\"\n"
+                      "#include PLAIN\n"
+                      "#if __has_include(<plain.h>) && "
+                      "!__has_include(\"no.h\")\n"
+                      "int found;\n"
+                      "#endif";
+
+  TEST_ASSERT_EQUAL_STRING("int guarded; int defined; int once; int plain; "
+                           "int plain; int found;",
+                           preprocess_file(input, path));
+
+  PreprocessorStats stats = get_preprocessor_stats();
+  TEST_ASSERT_EQUAL(3, stats.includes_skipped);
+  // The predefined macros, the main file and five includes.
+  TEST_ASSERT_EQUAL(7, stats.files_entered);
+
+  remove_file(directory, "guard.h");
+  remove_file(directory, "defined.h");
+  remove_file(directory, "once.h");
+  remove_file(directory, "plain.h");
+  rmdir(directory);
+}
+
+// EXAMPLE 3 of ISO/IEC 9899:2023 6.10.5.5, and a macro name followed by
+// the rest of its invocation.
+void test_standard_example(void) {
+  const char *input = "#define x 3\n"
+                      "#define f(a) f(x * (a))\n"
+                      "#undef x\n"
+                      "#define x 2\n"
+                      "#define g f\n"
+                      "#define z z[0]\n"
+                      "#define h g(~\n"
+                      "#define m(a) a(w)\n"
+                      "#define w 0,1\n"
+                      "#define t(a) a\n"
+                      "#define p() int\n"
+                      "#define q(x) x\n"
+                      "#define r(x,y) x ## y\n"
+                      "#define str(x) # x\n"
+                      "f(y+1) + f(f(z)) % t(t(g)(0) + t)(1);\n"
+                      "g(x+(3,4)-w) | h 5) & m\n"
+                      "(f)^m(m);\n"
+                      "p() i[q()] = { q(1), r(2,3), r(4,), r(,5), r(,) };\n"
+                      "char c[2][6] = { str(hello), str() };\n"
+                      "#define k(a, b) a * b\n"
+                      "#define l(a) a*k\n"
+                      "l(2)(9, 8)";
+
+  TEST_ASSERT_EQUAL_STRING(
+    "f(2 * (y+1)) + f(2 * (f(2 * (z[0])))) % f(2 * (0)) + t(1); "
+    "f(2 * (2+(3,4)-0,1)) | f(2 * (~ 5)) & f(2 * (0,1))^m(0,1); "
+    "int i[] = { 1, 23, 4, 5, }; "
+    "char c[2][6] = { \"hello\", \"\" }; "
+    "2*9 * 8",
+    preprocess_text(input));
+}
+
+// EXAMPLE 4 of ISO/IEC 9899:2023 6.10.5.5, where @ and \ are tokens of their
+// own outside a literal.
+void test_stringify_other_characters(void) {
+  const char *input = "#define str(s) # s\n"
+                      "fputs(str(strncmp(\"abc\\0d\", \"abc\", '\\4') "
+                      "// this goes away\n"
+                      "      == 0) str(: @\\n), s);";
+
+  TEST_ASSERT_EQUAL_STRING(
+    "fputs(\"strncmp(\\\"abc\\\\0d\\\", \\\"abc\\\", '\\\\4') == 0\" "
+    "\": @\\n\", s);",
+    preprocess_text(input));
+}
+
+void test_directives_only(void) {
+  char directory[] = "/tmp/copper-pp-XXXXXX";
+  TEST_ASSERT_NOT_NULL(mkdtemp(directory));
+
+  write_file(directory, "a.h", "#include \"b.h\"\nint a = \"#include\";\n");
+  write_file(directory, "b.h", "#pragma once\n#define USE_C 1\n");
+  write_file(directory, "c.h", "#include <sys.h>\n#include \"b.h\"\n");
+  write_file(directory, "d.h", "int d;\n");
+  write_file(directory, "sys.h", "#include \"d.h\"\n");
+
+  char path[512];
+  snprintf(path, sizeof(path), "%s/main.c", directory);
+  add_include_directory(directory);
+  set_directives_only(true);
+
+  const char *input = "int main(void) { return '\"'; }\n"
+                      "#include \"a.h\"\n"
+                      "/*\n"
+                      "#include \"d.h\"\n"
+                      "*/ char *s = \"\\\n"
+                      "#include \\\"d.h\\\"\";\n"
+                      "#if USE_C\n"
+                      "  #  include \"c.h\"\n"
+                      "#else\n"
+                      "#include \"d.h\"\n"
+                      "#endif\n"
+                      "#include <stdio.h>\n"
+                      "int x;";
+
+  TEST_ASSERT_EQUAL_STRING("", preprocess_file(input, path));
+
+  size_t count = 0;
+  const IncludedFile *files = get_included_files(&count);
+  const char *names[] = {"a.h", "b.h", "c.h", "sys.h", "d.h"};
+  bool system[] = {false, false, false, true, true};
+  TEST_ASSERT_EQUAL(5, count);
+
+  for (size_t i = 0; i < count; i++) {
+    char expected[512];
+    snprintf(expected, sizeof(expected), "%s/%s", directory, names[i]);
+    TEST_ASSERT_EQUAL_STRING(expected, files[i].path);
+    TEST_ASSERT_EQUAL(system[i], files[i].system);
+  }
+
+  remove_file(directory, "a.h");
+  remove_file(directory, "b.h");
+  remove_file(directory, "c.h");
+  remove_file(directory, "d.h");
+  remove_file(directory, "sys.h");
+  rmdir(directory);
+}
@@ -17,8 +17,8 @@ const char *const SKIP_TESTS[] = {
   "test310.c", // FIXME: sizeof not implemented
   "test311.c", // FIXME: braced initializers not implemented
   "test350.c", // FIXME: sizeof not implemented
-  "test600.c", // FIXME: pre-processing not implemented (can't include stdio.h)
-  "test601.c", // FIXME: pre-processing not implemented (can't include stdio.h)
+  "test600.c", // FIXME: scanf and printf are used without being declared
+  "test601.c", // FIXME: time and printf are used without being declared
   "test602.c", // has a syntax error (gcc agrees) TODO: check if this is a
                // valid C23 program
   "test900.c", // FIXME: pointers are not implemented
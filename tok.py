@@ -0,0 +1,9 @@
+import re,sys
+pat = re.compile(r'''\s*(?:(?P<s>(?:u8|u|U|L)?"(?:\\.|[^"\\])*")|(?P<c>(?:u8|u|U|L)?'(?:\\.|[^'\\])*')|(?P<n>\.?[0-9](?:[eEpP][+-]|[0-9A-Za-z_.'])*)|(?P<i>[A-Za-z_][A-Za-z_0-9]*)|(?P<p>%:%:|\.\.\.|<<=|>>=|->|\+\+|--|<<|>>|<=|>=|==|!=|&&|\|\||\*=|/=|%=|\+=|-=|&=|\^=|\|=|##|<:|:>|<%|%>|%:|::|[][(){}.&*+\-~!/%<>^|?:;=,#]))''')
+txt=sys.stdin.read()
+txt="\n".join(l for l in txt.split("\n") if not l.startswith("#"))
+pos=0
+while True:
+  m=pat.match(txt,pos)
+  if not m or m.end()==pos: break
+  print(m.group(m.lastgroup)); pos=m.end()